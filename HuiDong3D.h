@@ -13,12 +13,29 @@
 #pragma once
 
 #include <math.h>
+#include <float.h>
 #include <time.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <new>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define HD3D_SSE2
+#include <emmintrin.h>
+#endif
 
  // ͼο
 #include <easyx.h>
 #include <stdio.h>
+#include <ctype.h>
+#include <io.h>
+#include <fcntl.h>
 
 #define _HD3D_BEGIN	namespace HD3D {
 #define _HD3D_END	}
@@ -38,6 +55,353 @@ _HD3D_BEGIN
 */
 #define MIN_TIME_COST 1.0 / 9999
 
+/**
+ * @brief դؾȣλÿÿϷΪ 2^n 
+*/
+#define RASTER_SUBPIXEL_BITS 4
+
+/**
+ * @brief դʱĿСأ
+*/
+#define RASTER_BLOCK_SIZE 8
+
+/**
+ * @brief FXAA ıԵֲֵȶԱȶСȵ 1/2^n ز
+*/
+#define FXAA_EDGE_THRESHOLD_SHIFT 3
+
+/**
+ * @brief FXAA СԵֵ 0~255ĶԱȶȲ
+*/
+#define FXAA_EDGE_THRESHOLD_MIN 16
+
+/**
+ * @brief FXAA رԵѰұԵ˵أ
+*/
+#define FXAA_SEARCH_STEPS 8
+
+/**
+ * @brief ֱ̬ʵŵűȡ 1/n 
+ * @note ֵԱűÿ֡΢Сر仯Ҳֱ·Ļ壨ز壩
+*/
+#define DYNAMIC_RESOLUTION_STEPS 32
+
+/**
+ * @brief ֱ̬ƽ׶κʱϵָƶƽһ֡Ȩأ
+*/
+#define DYNAMIC_RESOLUTION_SMOOTHING 0.2
+
+/**
+ * @brief ֿСλ 2^n * 2^n Ŀ洢
+ * @note Ĭ 4x4 Ϊһ飬ռ 64 ֽڣһУеزʱҲͬһ
+*/
+#define TEXTURE_TILE_BITS 2
+
+/**
+ * @brief  mipmap 
+*/
+#define TEXTURE_MAX_LEVELS 16
+
+/**
+ * @brief BVH Ҷӽڵ
+ * @note SAH ΪֵüʱҶӽڵ԰Σ 4 
+*/
+#define BVH_LEAF_SIZE 4
+
+/**
+ * @brief BVH ʱ SAH ʹõͰ
+*/
+#define BVH_SAH_BINS 16
+
+/**
+ * @brief BVH  SAH ȣĽڵ㰴԰뻮
+ * @note ջĴСɴ˾
+*/
+#define BVH_MAX_DEPTH 64
+
+/**
+ * @brief ڵ޳ʹõĲȻı߳λ 0 Ϊ 2^n x 2^n Ԫ
+*/
+#define HIZ_SIZE_BITS 7
+#define HIZ_SIZE (1 << HIZ_SIZE_BITS)
+
+/**
+ * @brief ׷ʱֿĴСأΪż
+*/
+#define RAYTRACE_TILE_SIZE 16
+
+/**
+ * @brief 㻺ŻʱģĶ㻺С
+ * @note ҲǼ ACMR ʱĬϵĻС
+*/
+#define VERTEX_CACHE_SIZE 32
+
+/**
+ * @brief ռźÿĬϰĶ
+ * @see Object3D::SpatialReorder
+*/
+#define MESH_CHUNK_SIZE 256
+
+/**
+ * @brief нıģļʱÿССֽڣ
+ * @note Сļֿ飬ʡȥ̵߳Ŀ
+*/
+#define PARSE_CHUNK_MIN_SIZE (1 << 20)
+
+/**
+ * @brief ʽʱɴģ͵ĶֱʣΧϵĸ
+ * @see MeshStreamer
+*/
+#define STREAM_COARSE_GRID 32
+
+/**
+ * @brief յĸʽ汾еĽṹб仯ʱ
+ * @see SaveScenceSnapshot
+*/
+#define SCENE_SNAPSHOT_VERSION 1
+
+/**
+ * @brief ΪĿ
+ * @see Animator3D::AddPositionTrack
+*/
+#define ANIMATION_TARGET_CAMERA -1
+
+//////// ڴ
+
+/**
+ * @brief ڴ࣬ڷֱͳƸֵڴռ
+*/
+enum MemoryTag
+{
+	memory_polygon,		/** @brief εĶ㡢ɫ */
+	memory_mesh,		/** @brief 棨ȥغĶ㡢ߡͱߣ */
+	memory_scene,		/** @brief 顢Դ */
+	memory_texture,		/** @brief  */
+	memory_framebuffer,	/** @brief ֡ */
+	memory_bvh,			/** @brief BVH  BVH ʱʱ */
+	memory_render,		/** @brief ȾСü塢ȻȾе */
+	memory_stream,		/** @brief ֡Ļ */
+	memory_tags_num		/** @brief Ϊ GetMemoryStats Ĳʱʾзܺ */
+};
+
+/**
+ * @brief ڴͳ
+*/
+struct MemoryStats
+{
+	long long nBytes;		/** @brief ǰռõֽ */
+	long long nPeakBytes;	/** @brief ռֽķֵϴ ResetMemoryPeak  */
+	long long nAllocs;		/** @brief ۼƷ */
+	long long nFrees;		/** @brief ۼͷŴ */
+};
+
+/**
+ * @brief 亯
+ * @param[in] size : ֽ
+ * @param[in] tag : ڴ
+ * @param[in] pUser : SetMemoryAllocator û
+ * @return ٰ 16 ֽڶڴ棬ʧʱ NULL
+*/
+typedef void* (*MemoryAllocFunc)(size_t size, MemoryTag tag, void* pUser);
+
+/**
+ * @brief ͷźͬ MemoryAllocFunc
+*/
+typedef void (*MemoryFreeFunc)(void* p, size_t size, MemoryTag tag, void* pUser);
+
+/**
+ * @brief ڴ治ʱĴ亯 NULL ʱ AllocArray ã
+ * @param[in] size : ֽ
+ * @param[in] tag : ڴ
+ * @param[in] pUser : SetOutOfMemoryHandler û
+ * @return  true ʱ³Է䣨ͷ˻ſԤ㣩 false ʱֹ
+*/
+typedef bool (*OutOfMemoryFunc)(size_t size, MemoryTag tag, void* pUser);
+
+/**
+ * @brief ڴȫ״̬
+*/
+struct MemoryState
+{
+	MemoryAllocFunc pAlloc;		/** @brief 亯Ϊ NULL ʱʹ malloc */
+	MemoryFreeFunc pFree;		/** @brief ͷźΪ NULL ʱʹ free */
+	void* pUser;				/** @brief û */
+	OutOfMemoryFunc pOutOfMemory;	/** @brief ڴ治ʱĴΪ NULL ʱֱֹ */
+	void* pOutOfMemoryUser;			/** @brief  pOutOfMemory û */
+
+	std::atomic<long long> pBytes[memory_tags_num + 1];		/** @brief ĵǰֽһΪܺ */
+	std::atomic<long long> pPeakBytes[memory_tags_num + 1];	/** @brief ķֵֽ */
+	std::atomic<long long> pAllocs[memory_tags_num + 1];	/** @brief ķ */
+	std::atomic<long long> pFrees[memory_tags_num + 1];		/** @brief ͷŴ */
+};
+
+/**
+ * @brief ȡڴȫ״̬
+*/
+inline MemoryState& GetMemoryState()
+{
+	static MemoryState state = {};
+	return state;
+}
+
+/**
+ * @brief ÿڲʹõķ亯ͷź
+ * @param[in] pAlloc : 亯Ϊ NULL ʱָʹ malloc / free
+ * @param[in] pFree : ͷź
+ * @param[in] pUser : û
+ * @note ڴءڴԤ¼λá
+ *			亯ܾ䣨 NULLʱ AllocArray  SetOutOfMemoryHandler õĴ᷵ NULL
+ * @attention ڿκڴ֮ǰãκζΡ塢֮ǰ֮ٸ
+ *			ڴᱻʱͬĺͷ
+*/
+inline void SetMemoryAllocator(MemoryAllocFunc pAlloc, MemoryFreeFunc pFree, void* pUser = NULL)
+{
+	MemoryState& state = GetMemoryState();
+	state.pAlloc = pAlloc && pFree ? pAlloc : NULL;
+	state.pFree = pAlloc && pFree ? pFree : NULL;
+	state.pUser = pUser;
+}
+
+/**
+ * @brief ڴ治ʱĴ
+ * @param[in] pHandler : Ϊ NULL ʱڴ治ֱֹ
+ * @param[in] pUser : û
+ * @note ͷŻ󷵻 true ԣ޷ָʱӦ falseн򣩣ڲʹ÷ʧܵڴ档
+ *			ģʱĿʹ TryAllocArrayԤʱ뺯 false
+*/
+inline void SetOutOfMemoryHandler(OutOfMemoryFunc pHandler, void* pUser = NULL)
+{
+	MemoryState& state = GetMemoryState();
+	state.pOutOfMemory = pHandler;
+	state.pOutOfMemoryUser = pUser;
+}
+
+/**
+ * @brief ȡڴͳ
+ * @param[in] tag : ڴ࣬Ϊ memory_tags_num ʱзܺ
+ * @note ͳƵݵֽÿη 16 ֽڵͷ
+*/
+inline MemoryStats GetMemoryStats(MemoryTag tag = memory_tags_num)
+{
+	MemoryState& state = GetMemoryState();
+	return { state.pBytes[tag].load(),state.pPeakBytes[tag].load(),state.pAllocs[tag].load(),state.pFrees[tag].load() };
+}
+
+/**
+ * @brief ѸķֵΪǰֵ
+ * @note ÿ֡ʼʱã֡ʱȡֵ뵱ǰֵ֮Ϊһ֡ʱڴֵ
+*/
+inline void ResetMemoryPeak()
+{
+	MemoryState& state = GetMemoryState();
+	for (int i = 0; i <= memory_tags_num; i++)
+		state.pPeakBytes[i] = state.pBytes[i].load();
+}
+
+/**
+ * @brief ¼һηͷ
+ * @param[in] tag : ڴ
+ * @param[in] bytes : ֽ
+ * @param[in] bFree : ǷΪͷ
+*/
+inline void RecordMemory(MemoryTag tag, long long bytes, bool bFree)
+{
+	MemoryState& state = GetMemoryState();
+	int pIndex[2] = { tag,memory_tags_num };
+	for (int index : pIndex)
+	{
+		long long now = state.pBytes[index] += bFree ? -bytes : bytes;
+		(bFree ? state.pFrees[index] : state.pAllocs[index])++;
+		long long peak = state.pPeakBytes[index].load();
+		while (now > peak && !state.pPeakBytes[index].compare_exchange_weak(peak, now));
+	}
+}
+
+/**
+ * @brief ڲͷԪͷ࣬ͷʱݴͳƺ
+*/
+struct MemoryBlockHeader
+{
+	size_t nCount;		/** @brief Ԫ */
+	size_t tag;			/** @brief ڴ */
+};
+
+/**
+ * @brief Է䲢ĬϹһ飬ʧʱ NULL
+ * @param[in] num : Ԫ
+ * @param[in] tag : ڴ
+ * @return 飬亯ʧܣֽʱ NULLڴ治Ĵ
+ * @note ֻܹʧܵĵط絼ģʱļݷ飩طʹ AllocArray
+ * @see AllocArray
+*/
+template<class T>
+inline T* TryAllocArray(size_t num, MemoryTag tag)
+{
+	static_assert(alignof(T) <= sizeof(MemoryBlockHeader), "AllocArray: alignment too large");
+	if (num > (SIZE_MAX - sizeof(MemoryBlockHeader)) / sizeof(T)) return NULL;
+	MemoryState& state = GetMemoryState();
+	size_t size = sizeof(MemoryBlockHeader) + sizeof(T) * num;
+	void* p = state.pAlloc ? state.pAlloc(size, tag, state.pUser) : malloc(size);
+	if (!p) return NULL;
+
+	MemoryBlockHeader* pHeader = (MemoryBlockHeader*)p;
+	pHeader->nCount = num;
+	pHeader->tag = tag;
+	RecordMemory(tag, (long long)(sizeof(T) * num), false);
+
+	T* pArray = (T*)(pHeader + 1);
+	for (size_t i = 0; i < num; i++)
+		new (pArray + i) T;
+	return pArray;
+}
+
+/**
+ * @brief 䲢ĬϹһ飨 new T[num]
+ * @param[in] num : Ԫ
+ * @param[in] tag : ڴ
+ * @return 飬᷵ NULL
+ * @note ͨ SetMemoryAllocator õķ亯䣬ڴͳƣ FreeArray ͷš
+ *			亯ʧʱ SetOutOfMemoryHandler õĴ true ʱԣֹ
+*/
+template<class T>
+inline T* AllocArray(size_t num, MemoryTag tag)
+{
+	for (;;)
+	{
+		T* pArray = TryAllocArray<T>(num, tag);
+		if (pArray) return pArray;
+
+		MemoryState& state = GetMemoryState();
+		if (!state.pOutOfMemory || !state.pOutOfMemory(sizeof(MemoryBlockHeader) + sizeof(T) * num, tag, state.pOutOfMemoryUser))
+		{
+			fprintf(stderr, "HuiDong3D: out of memory (%zu elements of %zu bytes, tag %d).\n", num, sizeof(T), (int)tag);
+			abort();
+		}
+	}
+}
+
+/**
+ * @brief ͷ AllocArray 飨 delete[]
+ * @param[in] pArray : 飬Ϊ NULL ʱκ
+*/
+template<class T>
+inline void FreeArray(T* pArray)
+{
+	if (!pArray) return;
+	MemoryBlockHeader* pHeader = (MemoryBlockHeader*)pArray - 1;
+	size_t num = pHeader->nCount;
+	MemoryTag tag = (MemoryTag)pHeader->tag;
+	for (size_t i = num; i > 0; i--)
+		pArray[i - 1].~T();
+	RecordMemory(tag, (long long)(sizeof(T) * num), true);
+
+	MemoryState& state = GetMemoryState();
+	if (state.pFree)
+		state.pFree(pHeader, sizeof(MemoryBlockHeader) + sizeof(T) * num, tag, state.pUser);
+	else
+		free(pHeader);
+}
+
 //////// Ͷ
 
 /**
@@ -80,6 +444,19 @@ struct ColorPoint3D
 	operator Point3D() const { return { x,y,z }; }
 };
 
+/**
+ * @brief 
+ * @note u, v Ϊ 1 [0,1] Ĳظƽ̡
+ *			q Ϊ͸Ȩأ꣩ʼΪ 1ͶӰʱ u, v, q һͬͶӰϵ
+ *			դʱԲֵ u/q, v/q ȡӶõ͸ȷĽ
+*/
+struct TexCoord
+{
+	double u;
+	double v;
+	double q;
+};
+
 /**
  * @brief 3D 壬洢С x,y,z ֵ
 */
@@ -88,6 +465,22 @@ struct Rectangle3D
 	double min_x, min_y, min_z, max_x, max_y, max_z;
 };
 
+/**
+ * @brief 飬һĶ
+ * @note  Object3D::SpatialReorder ɣͬһĶڿռڣ԰޳
+*/
+struct MeshChunk
+{
+	int nFirstPolygon;		/** @brief һε± */
+	int nPolygonsNum;		/** @brief  */
+	int nFirstIndex;		/** @brief һεĵһеλ */
+	int nFirstVertex;		/** @brief ӵеĵһ㣨㰴״ʹõ˳ţ״ڴ˿ʹõĶһΣ */
+	int nVerticesNum;		/** @brief ӵеĶ */
+	int nFirstShared;		/** @brief õġ֮ǰĿĶڹбеλ */
+	int nSharedNum;			/** @brief õġ֮ǰĿĶ */
+	Rectangle3D bounds;		/** @brief ̬İΧ */
+};
+
 /**
  * @brief 
 */
@@ -97,6 +490,8 @@ struct Zoom
 	double y;	/** @brief y  */
 };
 
+class Texture;
+
 /**
  * @brief 3D 
 */
@@ -106,8 +501,13 @@ private:
 
 	void init()
 	{
-		pPoints = new Point3D[POLYGON_MAX_SIDES];
+		pPoints = AllocArray<Point3D>(POLYGON_MAX_SIDES, memory_polygon);
 		memset(pPoints, 0, sizeof Point3D * POLYGON_MAX_SIDES);
+		pColors = AllocArray<Color>(POLYGON_MAX_SIDES, memory_polygon);
+		for (int i = 0; i < POLYGON_MAX_SIDES; i++)
+			pColors[i] = -1;
+		pTexCoords = NULL;
+		pTexture = NULL;
 		nPointsNum = 0;
 		color = 0;
 	}
@@ -124,12 +524,13 @@ public:
 	 * @param[in] p : 
 	 * @param[in] n : 
 	 * @param[in] c : ɫ
-	 * @attention ó󶥵
+	 * @attention 󶥵ĶᱻԣĶʹ Object3D::AddPolygon ǻ
 	 * @see POLYGON_MAX_SIDES
 	*/
 	Polygon3D(const Point3D* p, int n, Color c)
 	{
 		init();
+		n = std::min(std::max(n, 0), POLYGON_MAX_SIDES);
 		for (int i = 0; i < n; i++)
 			pPoints[i] = p[i];
 		nPointsNum = n;
@@ -172,16 +573,67 @@ public:
 		return min + (max - min) / 2;
 	}
 
+	/**
+	 * @brief ȡĳɫûɫʱضɫ
+	*/
+	Color GetPointColor(int i)
+	{
+		return pColors[i] >= 0 ? pColors[i] : color;
+	}
+
+	/**
+	 * @brief ж϶Ƿ˶ɫ
+	*/
+	bool HasPointColors()
+	{
+		for (int i = 0; i < nPointsNum; i++)
+			if (pColors[i] >= 0)
+				return true;
+		return false;
+	}
+
+	/**
+	 * @brief 
+	 * @param[in] pTex : Ϊ NULL ʾȡ
+	 * @param[in] pCoords : ֻ꣨ʹ u, v붥ͬ
+	 * @attention ָֻ룬Ҫʹô˶εĳڼһֱЧ
+	*/
+	void SetTexture(Texture* pTex, const Point2D* pCoords = NULL)
+	{
+		pTexture = pTex;
+		if (!pTex)
+		{
+			FreeArray(pTexCoords);
+			pTexCoords = NULL;
+			return;
+		}
+		if (!pTexCoords)
+			pTexCoords = AllocArray<TexCoord>(POLYGON_MAX_SIDES, memory_polygon);
+		for (int i = 0; i < POLYGON_MAX_SIDES; i++)
+		{
+			pTexCoords[i] = { 0,0,1 };
+			if (pCoords && i < nPointsNum)
+				pTexCoords[i] = { pCoords[i].x,pCoords[i].y,1 };
+		}
+	}
+
 	/**
 	 * @brief ݣͷڴ
 	*/
 	void clear()
 	{
-		if (pPoints) delete[] pPoints;
+		FreeArray(pPoints);
+		FreeArray(pColors);
+		FreeArray(pTexCoords);
 		pPoints = NULL;
+		pColors = NULL;
+		pTexCoords = NULL;
 	}
 
 	Point3D* pPoints;	/** @brief ζ */
+	Color* pColors;		/** @brief ɫΪʾʹöɫжɫʱɫڶֵGouraud */
+	TexCoord* pTexCoords;	/** @brief ꣬ûʱΪ NULL */
+	Texture* pTexture;		/** @brief ʱɫΪɫɫʱٳɫ */
 	int nPointsNum;		/** @brief ζ */
 	Color color;		/** @brief ɫ */
 };
@@ -220,9 +672,25 @@ inline Polygon3D* CopyPolygons(Polygon3D* pDst, Polygon3D* pSrc, int num)
 		for (int j = 0; j < pSrc[i].nPointsNum; j++)
 		{
 			pDst[i].pPoints[j] = pSrc[i].pPoints[j];
+			pDst[i].pColors[j] = pSrc[i].pColors[j];
 		}
 		pDst[i].nPointsNum = pSrc[i].nPointsNum;
 		pDst[i].color = pSrc[i].color;
+
+		// ֻʱ
+		pDst[i].pTexture = pSrc[i].pTexture;
+		if (pSrc[i].pTexCoords)
+		{
+			if (!pDst[i].pTexCoords)
+				pDst[i].pTexCoords = AllocArray<TexCoord>(POLYGON_MAX_SIDES, memory_polygon);
+			for (int j = 0; j < pSrc[i].nPointsNum; j++)
+				pDst[i].pTexCoords[j] = pSrc[i].pTexCoords[j];
+		}
+		else if (pDst[i].pTexCoords)
+		{
+			FreeArray(pDst[i].pTexCoords);
+			pDst[i].pTexCoords = NULL;
+		}
 	}
 	return pDst;
 }
@@ -239,6 +707,19 @@ struct Attitude3D
 	double r;	/** @brief  x ת */
 };
 
+/**
+ * @brief Ԫʾ 3D ת
+ * @note λԪ (w, x, y, z) = (cos(t/2), n * sin(t/2)) ʾƵλ n ת t ǡ
+ *			תĸֻһԪ˷ۻҲŷǵ
+ */
+struct Quaternion3D
+{
+	double w;	/** @brief ʵ */
+	double x;	/** @brief 鲿 x */
+	double y;	/** @brief 鲿 y */
+	double z;	/** @brief 鲿 z */
+};
+
 /**
  * @brief ת˳
 */
@@ -249,6 +730,77 @@ enum RotateOrder { rotate_x, rotate_y, rotate_z };
 */
 int m_defaultRotateOrder[3] = { rotate_z,rotate_y,rotate_x };
 
+/**
+ * @brief 
+ * @note ȾʱֻȡԿöȾͬһ
+*/
+struct Camera3D
+{
+	Point3D pPosition;			/** @brief  */
+	Quaternion3D orientation;	/** @brief ̬ϵϵתŷǵת ConvertCameraAttitudeToQuaternion */
+	int nViewportWidth;		/** @brief ӿڿȣƽͶӰʱΪɼΧĿȣ͸ͶӰʱ߱ȣ */
+	int nViewportHeight;	/** @brief ӿڸ߶ȣƽͶӰʱΪɼΧĸ߶ȣ */
+	double fov;				/** @brief ͸ͶӰĴֱӳǣǶȣ */
+	double dNear;			/** @brief ü浽ľ룬 0 */
+	double dFar;			/** @brief Զü浽ľ */
+
+	bool bPerspectiveProjection;	/** @brief Ƿʹ͸ͶӰ */
+};
+
+/**
+ * @brief Ⱦģʽ
+*/
+enum RenderMode
+{
+	render_fill,		/** @brief Σͬʱƶ */
+	render_wireframe	/** @brief ֻ߿ÿظıֻһΣ */
+};
+
+/**
+ * @brief ɫģʽ
+*/
+enum ShadeMode
+{
+	shade_none,		/** @brief գֱʹöκͶɫ */
+	shade_flat,		/** @brief ÿΰ淨߼һιգͬɫ */
+	shade_gouraud	/** @brief ÿظĶ㰴㷨߼һιգɫڹդʱֵ */
+};
+
+/**
+ * @brief ģʽӵ͵
+ * @see Scence3D::SetAntiAliasMode
+*/
+enum AntiAliasMode
+{
+	antialias_none,		/** @brief ݣûж⿪ */
+	antialias_fxaa,		/** @brief FXAAȱԵءֱֻйأԼΪÿһ 3x3 ȱȽϣ
+									ԵرԵ 2 * FXAA_SEARCH_STEPS أʱÿ 4 ֽڡϸС΢ģ */
+	antialias_msaa2x,	/** @brief 2 زÿ 2 ǲɫÿֻһΡÿ 8 ֽڣ
+									дԼΪ 2 һ뱳һϳ */
+	antialias_msaa4x	/** @brief 4 زת񣩣ÿ 4 ǲÿ 16 ֽڣ
+									дԼΪ 4 һ뱳һϳɡԵ */
+};
+
+/**
+ * @brief Դ
+*/
+enum LightType
+{
+	light_directional,	/** @brief ƽй */
+	light_point			/** @brief Դ */
+};
+
+/**
+ * @brief Դ
+*/
+struct Light3D
+{
+	LightType type;		/** @brief Դ */
+	Point3D vec;		/** @brief ƽйΪķ򣬵ԴΪԴλ */
+	Color color;		/** @brief ɫ */
+	double intensity;	/** @brief ǿ */
+};
+
 //////// ʵ
 
 /**
@@ -358,1114 +910,10994 @@ inline Point3D Rotate3D(Point3D p, double a, double e, double r, Point3D pOrigin
 }
 
 /**
- * @brief μת
- * @param[in] pPolygons : μ
- * @param[in] num : 
- * @param[in] atiCamera : ̬
- * @param[in] pCamera : λ
- * @return תĶμ
+ * @brief 3x3 
 */
-inline Polygon3D* RotateToCamera(Polygon3D* pPolygons, int num, Attitude3D atiCamera, Point3D pCamera)
+struct Matrix3D
 {
-	Polygon3D* pRotated = new Polygon3D[num];
-	CopyPolygons(pRotated,pPolygons,num);
+	double m[3][3];
+};
 
-	for (int i = 0; i < num; i++)
+/**
+ * @brief ȡ Rotate3D Чת
+ * @param[in] a :  z תǶ
+ * @param[in] e :  y תǶ
+ * @param[in] r :  x תǶ
+ * @param[in] pOrder : ת˳
+ * @return ת
+ * @note תԱ任ֱתõС
+ *			ĵͬһ̬תʱ TransformPoint3D 㣬Աÿ㶼Ǻ
+*/
+inline Matrix3D GetRotateMatrix(double a, double e, double r, const int pOrder[3] = m_defaultRotateOrder)
+{
+	Point3D pAxis[3] = {
+		Rotate3D({ 1,0,0 }, a, e, r, { 0,0,0 }, pOrder),
+		Rotate3D({ 0,1,0 }, a, e, r, { 0,0,0 }, pOrder),
+		Rotate3D({ 0,0,1 }, a, e, r, { 0,0,0 }, pOrder)
+	};
+	Matrix3D mat;
+	for (int i = 0; i < 3; i++)
 	{
-		for (int j = 0; j < pRotated[i].nPointsNum; j++)
-		{
-			pRotated[i].pPoints[j] = Rotate3D(pRotated[i].pPoints[j], -atiCamera.a, -atiCamera.e, -atiCamera.r, pCamera);
-		}
+		mat.m[0][i] = pAxis[i].x;
+		mat.m[1][i] = pAxis[i].y;
+		mat.m[2][i] = pAxis[i].z;
 	}
-	return pRotated;
+	return mat;
 }
 
 /**
- * @brief μתϵ
- * @param[in] pPolygons : ϵ
- * @param[in] num : 
- * @param[in] pOrigin : µϵԭھϵеλ
- * @return תϵĶμ
+ * @brief þ任 3D 
 */
-inline Polygon3D* ConvertCoordinateSystem(Polygon3D* pPolygons, int num, Point3D pOrigin)
+inline Point3D TransformPoint3D(const Matrix3D& mat, Point3D p)
 {
-	Polygon3D* pConverted = new Polygon3D[num];
-	CopyPolygons(pConverted, pPolygons, num);
+	return {
+		mat.m[0][0] * p.x + mat.m[0][1] * p.y + mat.m[0][2] * p.z,
+		mat.m[1][0] * p.x + mat.m[1][1] * p.y + mat.m[1][2] * p.z,
+		mat.m[2][0] * p.x + mat.m[2][1] * p.y + mat.m[2][2] * p.z
+	};
+}
 
-	for (int i = 0; i < num; i++)
-	{
-		for (int j = 0; j < pConverted[i].nPointsNum; j++)
-		{
-			pConverted[i].pPoints[j].x -= pOrigin.x;
-			pConverted[i].pPoints[j].y -= pOrigin.y;
-			pConverted[i].pPoints[j].z -= pOrigin.z;
+/**
+ * @brief һ
+ * @return صλԭ
+*/
+inline Point3D Normalize3D(Point3D p)
+{
+	double len = sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+	if (len <= 0) return p;
+	return { p.x / len,p.y / len,p.z / len };
+}
+
+/**
+ * @brief εķߣNewell 
+ * @param[in] pPoints : ζ
+ * @param[in] num : 
+ * @return δһķߣΪʱ
+ * @note ԲϸĶҲܵõȶĽ
+*/
+inline Point3D GetPolygonNormal(const Point3D* pPoints, int num)
+{
+	Point3D n = { 0,0,0 };
+	if (num < 3) return n;
+	for (int i = 0; i < num; i++)
+	{
+		const Point3D& a = pPoints[i];
+		const Point3D& b = pPoints[(i + 1) % num];
+		n.x += (a.y - b.y) * (a.z + b.z);
+		n.y += (a.z - b.z) * (a.x + b.x);
+		n.z += (a.x - b.x) * (a.y + b.y);
+	}
+	return n;
+}
+
+/**
+ * @brief  3D ͶӰӽƽƽ
+ * @param[in] pPoints : ζ
+ * @param[in] num : 
+ * @param[out] pProjected : ͶӰ 2D 㣬Ϊ num
+ * @return ͶӰεķʱΪ 1˳ʱΪ -1Ϊ 0 ʱΪ 0
+ * @note ȥ߾ֵķͶӰεİ͹Ͷ˳򶼲
+*/
+inline int ProjectPolygonToPlane2D(const Point3D* pPoints, int num, Point2D* pProjected)
+{
+	Point3D n = GetPolygonNormal(pPoints, num);
+	double ax = fabs(n.x), ay = fabs(n.y), az = fabs(n.z);
+	int axis = ax >= ay && ax >= az ? 0 : (ay >= az ? 1 : 2);
+	for (int i = 0; i < num; i++)
+	{
+		const Point3D& p = pPoints[i];
+		pProjected[i] = axis == 0 ? Point2D{ p.y,p.z } : (axis == 1 ? Point2D{ p.z,p.x } : Point2D{ p.x,p.y });
+	}
+
+	double area = 0;
+	for (int i = 0; i < num; i++)
+	{
+		const Point2D& a = pProjected[i];
+		const Point2D& b = pProjected[(i + 1) % num];
+		area += a.x * b.y - b.x * a.y;
+	}
+	return area > 0 ? 1 : (area < 0 ? -1 : 0);
+}
+
+/**
+ * @brief ж 3D ǷΪ͹
+ * @note ڶƽжϣĸʱ͹
+*/
+inline bool IsConvexPolygon3D(const Point3D* pPoints, int num)
+{
+	if (num < 4) return true;
+	Point2D pStack[POLYGON_MAX_SIDES];
+	Point2D* p = num <= POLYGON_MAX_SIDES ? pStack : AllocArray<Point2D>(num, memory_polygon);
+	int orient = ProjectPolygonToPlane2D(pPoints, num, p);
+
+	bool bConvex = true;
+	for (int i = 0; i < num && bConvex; i++)
+	{
+		const Point2D& a = p[i];
+		const Point2D& b = p[(i + 1) % num];
+		const Point2D& c = p[(i + 2) % num];
+		double cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+		bConvex = cross * orient >= 0;
+	}
+
+	if (p != pStack) FreeArray(p);
+	return bConvex;
+}
+
+/**
+ * @brief ǻз
+ * @param[in] pPoints : ζ㣬
+ * @param[in] num : 
+ * @param[out] pTriangles : εĶ±꣬ÿΪһΣΪ (num - 2) * 3
+ * @return  num - 2ʱ 0
+ * @note ڶƽ²͹ǣ䣩ְ֧ΣԭεĶ˳ͬ
+ *			ཻΪ 0 ĶҲ num - 2 Σοص
+*/
+inline int TriangulatePolygon3D(const Point3D* pPoints, int num, int* pTriangles)
+{
+	if (num < 3) return 0;
+
+	Point2D pStack[POLYGON_MAX_SIDES];
+	int pStackLinks[POLYGON_MAX_SIDES * 2];
+	bool bSmall = num <= POLYGON_MAX_SIDES;
+	Point2D* p = bSmall ? pStack : AllocArray<Point2D>(num, memory_polygon);
+	int* pPrev = bSmall ? pStackLinks : AllocArray<int>((size_t)num * 2, memory_polygon);
+	int* pNext = pPrev + num;
+
+	int orient = ProjectPolygonToPlane2D(pPoints, num, p);
+	auto cross = [p, orient](int a, int b, int c) -> double {
+		return ((p[b].x - p[a].x) * (p[c].y - p[a].y) - (p[b].y - p[a].y) * (p[c].x - p[a].x)) * orient;
+	};
+
+	for (int i = 0; i < num; i++)
+	{
+		pPrev[i] = (i + num - 1) % num;
+		pNext[i] = (i + 1) % num;
+	}
+
+	int count = 0;
+	int i = 0;
+	for (int nRemaining = num, nFailed = 0; nRemaining > 3;)
+	{
+		int a = pPrev[i], c = pNext[i];
+
+		// ͹ǣʣµĶ㶼ڣζغϵĳ⣩
+		bool bEar = orient != 0 && cross(a, i, c) > 0;
+		for (int k = pNext[c]; k != a && bEar; k = pNext[k])
+		{
+			if ((p[k].x == p[a].x && p[k].y == p[a].y) || (p[k].x == p[i].x && p[k].y == p[i].y) || (p[k].x == p[c].x && p[k].y == p[c].y))
+				continue;
+			if (cross(a, i, k) >= 0 && cross(i, c, k) >= 0 && cross(c, a, k) >= 0)
+				bEar = false;
+		}
+
+		// תһȦûжʱ˻ཻĶΣֱµǰ
+		if (bEar || nFailed >= nRemaining)
+		{
+			pTriangles[count * 3] = a;
+			pTriangles[count * 3 + 1] = i;
+			pTriangles[count * 3 + 2] = c;
+			count++;
+			pNext[a] = c;
+			pPrev[c] = a;
+			nRemaining--;
+			nFailed = 0;
+			i = a;
+		}
+		else
+		{
+			nFailed++;
+			i = c;
 		}
 	}
-	return pConverted;
+	pTriangles[count * 3] = pPrev[i];
+	pTriangles[count * 3 + 1] = i;
+	pTriangles[count * 3 + 2] = pNext[i];
+	count++;
+
+	if (!bSmall)
+	{
+		FreeArray(p);
+		FreeArray(pPrev);
+	}
+	return count;
 }
 
 /**
- * @brief μϼ͸ͶӰЧ
- * @param[in] pPolygons : μ
- * @param[in] num : 
- * @param[in] nFocal : 
- * @return ͸ͶӰĶμ
- * @attention ͸ĵϵԭ
- * @note ӿĵвü
+ * @brief ϲλͬĶ
+ * @param[in] pPoints : 
+ * @param[in] num : 
+ * @param[out] pUnique : ȥغĶ㣨״γֵ˳򣩣Ϊ num
+ * @param[out] pRemap : ÿȥغе±꣬Ϊ num
+ * @return ȥغĶ
+ * @note ʹÿѰַϣĶֵȽϣ-0.0  0.0 Ϊͬ
 */
-inline Polygon3D* GetPerspectiveProjectionPolygons(Polygon3D* pPolygons, int num, int nFocal)
+inline int WeldVertices(const Point3D* pPoints, int num, Point3D* pUnique, int* pRemap)
 {
-	Polygon3D* pProjection = new Polygon3D[num];
-	CopyPolygons(pProjection, pPolygons, num);
+	if (num <= 0) return 0;
 
+	int nTableSize = 1;
+	while (nTableSize < num * 2) nTableSize <<= 1;
+	int* pTable = AllocArray<int>(nTableSize, memory_mesh);
+	for (int i = 0; i < nTableSize; i++) pTable[i] = -1;
+
+	int nUniqueNum = 0;
 	for (int i = 0; i < num; i++)
 	{
-		for (int j = 0; j < pProjection[i].nPointsNum; j++)
+		Point3D p = pPoints[i];
+		p = { p.x + 0.0,p.y + 0.0,p.z + 0.0 };	// -0.0 תΪ 0.0
+		unsigned long long bits[3];
+		memcpy(bits, &p, sizeof bits);
+		unsigned long long h = (bits[0] * 0x9E3779B97F4A7C15ull) ^ (bits[1] * 0xC2B2AE3D27D4EB4Full) ^ (bits[2] * 0x165667B19E3779F9ull);
+		int slot = (int)((h ^ (h >> 29)) & (nTableSize - 1));
+		while (pTable[slot] >= 0)
 		{
-			double zoom = (nFocal - pPolygons[i].pPoints[j].z) / nFocal;
-			pProjection[i].pPoints[j].x *= zoom;
-			pProjection[i].pPoints[j].y *= zoom;
+			const Point3D& q = pUnique[pTable[slot]];
+			if (q.x == p.x && q.y == p.y && q.z == p.z)
+				break;
+			slot = (slot + 1) & (nTableSize - 1);
+		}
+		if (pTable[slot] < 0)
+		{
+			pTable[slot] = nUniqueNum;
+			pUnique[nUniqueNum++] = p;
 		}
+		pRemap[i] = pTable[slot];
 	}
-	return pProjection;
+	FreeArray(pTable);
+	return nUniqueNum;
 }
 
 /**
- * @brief ü NDC μ
- * @param[in] pPolygons : NDC μ
- * @param[in] num : 
- * @param[in] nFocal : 
- * @param[out] out_count : زü
- * @return زüĶμ
+ * @brief ƽδʣACMR
+ * @param[in] pIndices : Ķ±꣬˳
+ * @param[in] pSizes : ĶΪ NULL ʾ
+ * @param[in] nFacesNum : 
+ * @param[in] nVerticesNum : 
+ * @param[in] nCacheSize : ģ FIFO 㻺С
+ * @return ذ˳ʱδеĶn ΰ n - 2 μƣ
+ * @note ÿζҪ任ʱΪ 3ӽ 0.5
 */
-inline Polygon3D* CropNDCPolygons(Polygon3D* pPolygons, int num, int nFocal, int* out_count)
+inline double GetACMR(const int* pIndices, const int* pSizes, int nFacesNum, int nVerticesNum, int nCacheSize = VERTEX_CACHE_SIZE)
 {
+	if (nFacesNum <= 0 || nVerticesNum <= 0) return 0;
 
-	/////////// ʱһȽϼ򵥴ֱж
-	/////////// ֻӿĲü (x[-1 ~ 1]  y [-1 ~ 1]  z[0 ~ f])
-	/////////// Ҫĳɶνж
+	// 뻺ʱ䣬δм뵱ǰʱ֮СڻСʱڻ
+	long long* pStamp = AllocArray<long long>(nVerticesNum, memory_mesh);
+	for (int i = 0; i < nVerticesNum; i++)
+		pStamp[i] = -(long long)nCacheSize;
 
-	Polygon3D* pCrop = new Polygon3D[num];
+	long long nMisses = 0, nTriangles = 0;
+	for (int f = 0, first = 0; f < nFacesNum; f++)
+	{
+		int n = pSizes ? pSizes[f] : 3;
+		for (int j = 0; j < n; j++)
+		{
+			int v = pIndices[first + j];
+			if (nMisses - pStamp[v] >= nCacheSize)
+				pStamp[v] = nMisses++;
+		}
+		nTriangles += std::max(n - 2, 1);
+		first += n;
+	}
 
-	int count = 0;
-	for (int i = 0; i < num; i++)
+	FreeArray(pStamp);
+	return (double)nMisses / nTriangles;
+}
+
+/**
+ * @brief Ϊ˶㻺ľֲ˳Forsyth 㷨
+ * @param[in] pIndices : Ķ±꣬˳
+ * @param[in] pSizes : ĶΪ NULL ʾΣÿĶó POLYGON_MAX_SIDES
+ * @param[in] nFacesNum : 
+ * @param[in] nVerticesNum : 
+ * @param[out] pOrder : µ˳ԭ±꣩Ϊ nFacesNum
+ * @note ģһ VERTEX_CACHE_SIZE С LRU 棬ķڻеλúͻʣٸδ
+ *			ÿ̰ĵߵ档ֻлжڵҪ·ԸӶȽӽ
+*/
+inline void OptimizeVertexCache(const int* pIndices, const int* pSizes, int nFacesNum, int nVerticesNum, int* pOrder)
+{
+	if (nFacesNum <= 0) return;
+
+	auto score = [](int pos, int remaining) -> float {
+		if (remaining <= 0) return -1;
+		float s = 0;
+		if (pos >= 0)
+			s = pos < 3 ? 0.75f : powf(1 - (float)(pos - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+		return s + 2.0f / sqrtf((float)remaining);
+	};
+
+	// ĵһ
+	int* pFirst = AllocArray<int>(nFacesNum + 1, memory_mesh);
+	pFirst[0] = 0;
+	for (int f = 0; f < nFacesNum; f++)
+		pFirst[f + 1] = pFirst[f] + (pSizes ? pSizes[f] : 3);
+
+	// ڵ
+	int* pRemaining = AllocArray<int>(nVerticesNum, memory_mesh);
+	int* pAdjFirst = AllocArray<int>(nVerticesNum + 1, memory_mesh);
+	int* pAdj = AllocArray<int>(pFirst[nFacesNum] + 1, memory_mesh);
+	memset(pRemaining, 0, sizeof(int) * nVerticesNum);
+	for (int i = 0; i < pFirst[nFacesNum]; i++)
+		pRemaining[pIndices[i]]++;
+	pAdjFirst[0] = 0;
+	for (int v = 0; v < nVerticesNum; v++)
+		pAdjFirst[v + 1] = pAdjFirst[v] + pRemaining[v];
+	int* pCursor = AllocArray<int>(nVerticesNum, memory_mesh);
+	memcpy(pCursor, pAdjFirst, sizeof(int) * nVerticesNum);
+	for (int f = 0; f < nFacesNum; f++)
+		for (int i = pFirst[f]; i < pFirst[f + 1]; i++)
+			pAdj[pCursor[pIndices[i]]++] = f;
+	FreeArray(pCursor);
+
+	int* pCachePos = AllocArray<int>(nVerticesNum, memory_mesh);
+	float* pVertexScore = AllocArray<float>(nVerticesNum, memory_mesh);
+	for (int v = 0; v < nVerticesNum; v++)
 	{
-		int crop_count = 0;
-		for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+		pCachePos[v] = -1;
+		pVertexScore[v] = score(-1, pRemaining[v]);
+	}
+
+	float* pFaceScore = AllocArray<float>(nFacesNum, memory_mesh);
+	bool* pEmitted = AllocArray<bool>(nFacesNum, memory_mesh);
+	int best = 0;
+	for (int f = 0; f < nFacesNum; f++)
+	{
+		pEmitted[f] = false;
+		pFaceScore[f] = 0;
+		for (int i = pFirst[f]; i < pFirst[f + 1]; i++)
+			pFaceScore[f] += pVertexScore[pIndices[i]];
+		if (pFaceScore[f] > pFaceScore[best])
+			best = f;
+	}
+
+	int pCache[VERTEX_CACHE_SIZE + POLYGON_MAX_SIDES];
+	int nCacheNum = 0;
+	int nNextUnemitted = 0;
+	for (int n = 0; n < nFacesNum; n++)
+	{
+		// еĶ㶼ûʣʱԭ˳ȡһδ
+		if (best < 0)
 		{
-			// ͳһγӿڵĵĸ
-			if (pPolygons[i].pPoints[j].x < -1 || pPolygons[i].pPoints[j].x > 1 ||
-				pPolygons[i].pPoints[j].y < -1 || pPolygons[i].pPoints[j].y > 1 ||
-				pPolygons[i].pPoints[j].z < 0 || pPolygons[i].pPoints[j].z > nFocal)
-			{
-				crop_count++;
-			}
+			while (pEmitted[nNextUnemitted]) nNextUnemitted++;
+			best = nNextUnemitted;
+		}
+		pOrder[n] = best;
+		pEmitted[best] = true;
 
-			// һӿھͿԱ
-			else
+		// ĶƵǰ
+		int pNewCache[VERTEX_CACHE_SIZE + POLYGON_MAX_SIDES];
+		int nNewNum = 0;
+		for (int i = pFirst[best]; i < pFirst[best + 1]; i++)
+		{
+			int v = pIndices[i];
+			pRemaining[v]--;
+			bool bExists = false;
+			for (int k = 0; k < nNewNum && !bExists; k++)
+				bExists = pNewCache[k] == v;
+			if (!bExists)
+				pNewCache[nNewNum++] = v;
+		}
+		int nFaceVertices = nNewNum;
+		for (int k = 0; k < nCacheNum; k++)
+		{
+			bool bExists = false;
+			for (int j = 0; j < nFaceVertices && !bExists; j++)
+				bExists = pNewCache[j] == pCache[k];
+			if (!bExists)
+				pNewCache[nNewNum++] = pCache[k];
+		}
+
+		// »УձģķԼڵķ
+		for (int k = 0; k < nNewNum; k++)
+		{
+			int v = pNewCache[k];
+			int pos = k < VERTEX_CACHE_SIZE ? k : -1;
+			pCachePos[v] = pos;
+			float s = score(pos, pRemaining[v]);
+			float delta = s - pVertexScore[v];
+			pVertexScore[v] = s;
+			if (delta == 0) continue;
+			for (int a = pAdjFirst[v]; a < pAdjFirst[v + 1]; a++)
+				pFaceScore[pAdj[a]] += delta;
+		}
+		nCacheNum = std::min(nNewNum, VERTEX_CACHE_SIZE);
+		memcpy(pCache, pNewCache, sizeof(int) * nCacheNum);
+
+		// һӻжڵѡ
+		best = -1;
+		float fBest = -FLT_MAX;
+		for (int k = 0; k < nCacheNum; k++)
+		{
+			int v = pCache[k];
+			for (int a = pAdjFirst[v]; a < pAdjFirst[v + 1]; a++)
 			{
-				break;
+				int f = pAdj[a];
+				if (!pEmitted[f] && pFaceScore[f] > fBest)
+				{
+					fBest = pFaceScore[f];
+					best = f;
+				}
 			}
 		}
+	}
 
-		// е㶼ӿڵ²ű˶Σ򱻲ü
-		if (crop_count < pPolygons[i].nPointsNum)
+	FreeArray(pFirst);
+	FreeArray(pRemaining);
+	FreeArray(pAdjFirst);
+	FreeArray(pAdj);
+	FreeArray(pCachePos);
+	FreeArray(pVertexScore);
+	FreeArray(pFaceScore);
+	FreeArray(pEmitted);
+}
+
+/**
+ * @brief ռ
+*/
+enum SpaceCurve
+{
+	curve_morton,		/** @brief MortonZ ߣ */
+	curve_hilbert		/** @brief Hilbert ߣڱĵڣֲԸ */
+};
+
+/**
+ * @brief ά Morton 
+ * @param[in] x, y, z : ꣬ȡ 10 λ
+ * @return  30 λ룬ĸλ
+*/
+inline unsigned int GetMortonCode3D(unsigned int x, unsigned int y, unsigned int z)
+{
+	auto spread = [](unsigned int v) -> unsigned int {
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	};
+	return (spread(x) << 2) | (spread(y) << 1) | spread(z);
+}
+
+/**
+ * @brief ά Hilbert 
+ * @param[in] x, y, z : ꣬ȡ 10 λ
+ * @return  30 λ룬 1024^3  Hilbert ϵ
+ * @note ʹ Skilling ת㷨Ȱ任Ϊ Hilbert תʽٽλ
+*/
+inline unsigned int GetHilbertCode3D(unsigned int x, unsigned int y, unsigned int z)
+{
+	const int bits = 10;
+	unsigned int X[3] = { x & 0x3ff,y & 0x3ff,z & 0x3ff };
+
+	for (unsigned int Q = 1u << (bits - 1); Q > 1; Q >>= 1)
+	{
+		unsigned int P = Q - 1;
+		for (int i = 0; i < 3; i++)
 		{
-			CopyPolygons(&pCrop[count], &pPolygons[i], 1);	
-			count ++;
+			if (X[i] & Q)
+			{
+				X[0] ^= P;
+			}
+			else
+			{
+				unsigned int t = (X[0] ^ X[i]) & P;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
 		}
 	}
 
-	// 
-	Polygon3D* pReserve = new Polygon3D[count];
-	CopyPolygons(pReserve, pCrop, count);
+	// 
+	X[1] ^= X[0];
+	X[2] ^= X[1];
+	unsigned int t = 0;
+	for (unsigned int Q = 1u << (bits - 1); Q > 1; Q >>= 1)
+		if (X[2] & Q)
+			t ^= Q - 1;
+	for (int i = 0; i < 3; i++)
+		X[i] ^= t;
 
-	// ͷŴ
-	DeletePolygons(pCrop, num);
+	unsigned int code = 0;
+	for (int b = bits - 1; b >= 0; b--)
+		for (int i = 0; i < 3; i++)
+			code = (code << 1) | ((X[i] >> b) & 1);
+	return code;
+}
 
-	*out_count = count;
-	return pReserve;
+/**
+ * @brief ռ
+ * @param[in] pPoints : 
+ * @param[in] num : 
+ * @param[out] pOrder : ˳ԭ±꣩Ϊ num
+ * @param[in] curve : ʹõĿռ
+ * @note ڰΧΪ 1024^3 񣬱ͬĵ㱣ԭ˳
+*/
+inline void SortBySpaceCurve(const Point3D* pPoints, int num, int* pOrder, SpaceCurve curve = curve_hilbert)
+{
+	if (num <= 0) return;
+
+	Point3D min = pPoints[0], max = pPoints[0];
+	for (int i = 1; i < num; i++)
+	{
+		min = { std::min(min.x,pPoints[i].x),std::min(min.y,pPoints[i].y),std::min(min.z,pPoints[i].z) };
+		max = { std::max(max.x,pPoints[i].x),std::max(max.y,pPoints[i].y),std::max(max.z,pPoints[i].z) };
+	}
+
+	// ʹͬһţֿ״
+	double size = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z);
+	double scale = size > 0 ? 1023 / size : 0;
+
+	// ڸ 32 λ±ڵ 32 λȻȶ
+	unsigned long long* pKeys = AllocArray<unsigned long long>(num, memory_mesh);
+	for (int i = 0; i < num; i++)
+	{
+		unsigned int x = (unsigned int)((pPoints[i].x - min.x) * scale);
+		unsigned int y = (unsigned int)((pPoints[i].y - min.y) * scale);
+		unsigned int z = (unsigned int)((pPoints[i].z - min.z) * scale);
+		unsigned int code = curve == curve_hilbert ? GetHilbertCode3D(x, y, z) : GetMortonCode3D(x, y, z);
+		pKeys[i] = ((unsigned long long)code << 32) | (unsigned int)i;
+	}
+	std::sort(pKeys, pKeys + num);
+	for (int i = 0; i < num; i++)
+		pOrder[i] = (int)(pKeys[i] & 0xffffffff);
+	FreeArray(pKeys);
 }
 
-//////// ͼ豸
+/**
+ * @brief 
+*/
+struct Point4D
+{
+	double x;
+	double y;
+	double z;
+	double w;
+};
 
 /**
- * @brief ʼͼ豸
- * @param[in] w : ͼ豸
- * @param[in] w : ͼ豸
- * @param[in] flag : ԣĬΪ 0
+ * @brief Ԫ
+ * @return  a * b b ת a ת
 */
-inline void InitDrawingDevice(int w, int h, int flag = 0)
+inline Quaternion3D MultiplyQuaternion(const Quaternion3D& a, const Quaternion3D& b)
 {
-	// easyx
-	initgraph(w, h, flag);
-	//setorigin(w / 4, h / 4);
+	return {
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w
+	};
 }
 
 /**
- * @brief	رջͼ豸
+ * @brief Ԫ
+ * @note λԪĹ棬ʾת
 */
-inline void CloseDrawingDevice()
+inline Quaternion3D GetConjugateQuaternion(const Quaternion3D& q)
 {
-	// easyx
-	closegraph();
+	return { q.w,-q.x,-q.y,-q.z };
 }
 
 /**
- * @brief ȡͼ豸
+ * @brief Ԫһ
+ * @note ˺ۻĸʹԪƫ뵥λȣÿθϺһɱֵȶԪصλԪ
 */
-inline int GetDrawingDeviceWidth()
+inline Quaternion3D NormalizeQuaternion(const Quaternion3D& q)
 {
-	return getwidth();
+	double len = sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+	if (len <= 0) return { 1,0,0,0 };
+	return { q.w / len,q.x / len,q.y / len,q.z / len };
 }
 
 /**
- * @brief ȡͼ豸߶
+ * @brief ȡתԪ
+ * @param[in] axis : תᣨҪǵλ
+ * @param[in] angle : תǶȣԭʱʱΪ
+ * @return صλԪתΪʱصλԪת
 */
-inline int GetDrawingDeviceHeight()
+inline Quaternion3D GetAxisAngleQuaternion(Point3D axis, double angle)
 {
-	return getheight();
+	double len = sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+	if (len <= 0) return { 1,0,0,0 };
+	double t = ConvertToRadian(angle) / 2;
+	double s = sin(t) / len;
+	return { cos(t),axis.x * s,axis.y * s,axis.z * s };
 }
 
 /**
- * @brief Ƶ
- * @param[in] x : λ
- * @param[in] y : λ
- * @param[in] c : ɫ
+ * @brief ȡ Rotate3D_X / Rotate3D_Y / Rotate3D_Z ЧԪ
+ * @param[in] axis : תᣨRotateOrder
+ * @param[in] angle : תǶ
+ * @note Rotate3D_Y  xoz ƽʱת y ˳ʱ룬 y ʱǶȡ
 */
-inline void DrawPixel(int x, int y, Color c)
+inline Quaternion3D GetRotateQuaternion(int axis, double angle)
 {
-	if (c < 0) return;
-
-	// easyx 
-	// ֱӲԴ滭
-	if (x >= 0 && y >= 0 && x < getwidth() && y < getheight())
-		GetImageBuffer()[y * getwidth() + x] = BGR((COLORREF)c);
+	switch (axis)
+	{
+	case rotate_x: return GetAxisAngleQuaternion({ 1,0,0 }, angle);
+	case rotate_y: return GetAxisAngleQuaternion({ 0,1,0 }, -angle);
+	case rotate_z: return GetAxisAngleQuaternion({ 0,0,1 }, angle);
+	}
+	return { 1,0,0,0 };
 }
 
 /**
- * @brief Ƶ
- * @param[in] p : λ
- * @param[in] c : ɫ
+ * @brief Ԫת 3D 
+ * @param[in] q : λԪ
+ * @param[in] p : Ҫת꣨ԭת
 */
-inline void DrawPixel(Point2D p, Color c)
+inline Point3D RotateByQuaternion(const Quaternion3D& q, Point3D p)
 {
-	DrawPixel((int)p.x, (int)p.y, c);
+	// p' = p + w * t + v x t t = 2 * (v x p)
+	Point3D t = {
+		2 * (q.y * p.z - q.z * p.y),
+		2 * (q.z * p.x - q.x * p.z),
+		2 * (q.x * p.y - q.y * p.x)
+	};
+	return {
+		p.x + q.w * t.x + q.y * t.z - q.z * t.y,
+		p.y + q.w * t.y + q.z * t.x - q.x * t.z,
+		p.z + q.w * t.z + q.x * t.y - q.y * t.x
+	};
 }
 
 /**
- * @brief  3D  NDC  תΪ 3D Ļ
- * @param[in] p : ԭ
- * @param[in] zoom : 
- * @return תĻ
- * @note ĬϹ۲Ϊ xoy
+ * @brief ȡԪЧת
+ * @param[in] q : λԪ
+ * @note ĵͬһתʱÿֻ֡תһΣ֮ÿ TransformPoint3D 㣬ҪǺ
 */
-inline Point3D ConvertNDC3DToScreenPoint(Point3D p, Zoom zoom = { 1,1 })
+inline Matrix3D GetQuaternionMatrix(const Quaternion3D& q)
 {
-	return { (p.x * zoom.x + 1) * GetDrawingDeviceWidth(),(1 - p.y * zoom.y) * GetDrawingDeviceHeight() };
+	double xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	double xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	double wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	Matrix3D mat = { {
+		{ 1 - 2 * (yy + zz),2 * (xy - wz),2 * (xz + wy) },
+		{ 2 * (xy + wz),1 - 2 * (xx + zz),2 * (yz - wx) },
+		{ 2 * (xz - wy),2 * (yz + wx),1 - 2 * (xx + yy) }
+	} };
+	return mat;
 }
 
 /**
- * @brief 
- * @param[in] p : 3D 
- * @param[in] offset_x : ͼ x ƫ
- * @param[in] offset_y : ͼ y ƫ
- * @param[in] zoom : ͼ
- * @param[in] grid : ɫΪʾ
- * @attention ֻȡε x,y ƵĻ
+ * @brief ԪԲֵ
+ * @param[in] a : ʼתλԪ
+ * @param[in] b : ֹתλԪ
+ * @param[in] t : ֵϵ0 ʱΪ a1 ʱΪ b
+ * @return صλԪؽ϶̵ĻֵٶȺ㶨
+ * @note תǳӽʱԲֵٹһԽӽ 0  sin ֵ
 */
-inline void DrawFillPolygon(Polygon3D p, int offset_x = 0, int offset_y = 0, Zoom zoom = { 1,1 }, Color grid = -1)
+inline Quaternion3D SlerpQuaternion(const Quaternion3D& a, Quaternion3D b, double t)
 {
-	if (p.nPointsNum <= 0) return;
+	double cos_t = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+	if (cos_t < 0)
+	{
+		b = { -b.w,-b.x,-b.y,-b.z };
+		cos_t = -cos_t;
+	}
 
-	POINT* pPoints = new POINT[p.nPointsNum];
-	for (int j = 0; j < p.nPointsNum; j++)
+	double ka = 1 - t, kb = t;
+	if (cos_t < 0.9995)
 	{
-		Point3D pp = ConvertNDC3DToScreenPoint(p.pPoints[j], zoom);
-		pPoints[j] = { (long)(pp.x) + offset_x,(long)(pp.y) + offset_y };
+		double theta = acos(cos_t);
+		double s = sin(theta);
+		ka = sin((1 - t) * theta) / s;
+		kb = sin(t * theta) / s;
 	}
+	return NormalizeQuaternion({ a.w * ka + b.w * kb,a.x * ka + b.x * kb,a.y * ka + b.y * kb,a.z * ka + b.z * kb });
+}
 
-	//// easyx 
+/**
+ * @brief ŷ̬תΪԪ
+ * @param[in] ati : ̬
+ * @param[in] pOrder : ת˳
+ * @return  Rotate3D(p, ati.a, ati.e, ati.r, { 0,0,0 }, pOrder) ЧĵλԪ
+*/
+inline Quaternion3D ConvertAttitudeToQuaternion(Attitude3D ati, const int pOrder[3] = m_defaultRotateOrder)
+{
+	Quaternion3D q = { 1,0,0,0 };
+	for (int i = 0; i < 3; i++)
+	{
+		double angle = pOrder[i] == rotate_x ? ati.r : pOrder[i] == rotate_y ? ati.e : ati.a;
+		q = MultiplyQuaternion(GetRotateQuaternion(pOrder[i], angle), q);
+	}
+	return q;
+}
 
-	// ɫҪ	
-	if (p.color >= 0)
+/**
+ * @brief ԪתΪŷ̬
+ * @param[in] q : λԪ
+ * @param[in] pOrder : ת˳
+ * @return ذת˳ q Ч̬мһתĽǶ [-90, 90] ֮
+ * @note мһתΪ 90 ȣʱһתĽǶȡ 0
+ * @attention ת˳ x, y, z һ
+*/
+inline Attitude3D ConvertQuaternionToAttitude(const Quaternion3D& q, const int pOrder[3] = m_defaultRotateOrder)
+{
+	// ϵı׼תʾR = R_k(c) * R_j(b) * R_i(a)i, j, k Ϊת
+	Matrix3D mat = GetQuaternionMatrix(q);
+	int i = pOrder[0], j = pOrder[1], k = pOrder[2];
+	double s = (j - i + 3) % 3 == 1 ? 1 : -1;		// ˳ǷΪ x, y, z ż
+
+	double a, b, c;
+	double cos_b = sqrt(mat.m[k][j] * mat.m[k][j] + mat.m[k][k] * mat.m[k][k]);
+	b = atan2(-s * mat.m[k][i], cos_b);
+	if (cos_b > 1e-9)
+	{
+		a = atan2(s * mat.m[k][j], mat.m[k][k]);
+		c = atan2(s * mat.m[j][i], mat.m[i][i]);
+	}
+	else
+	{
+		a = atan2(-s * mat.m[j][k], mat.m[j][j]);
+		c = 0;
+	}
+
+	double angles[3];
+	angles[i] = a;
+	angles[j] = b;
+	angles[k] = c;
+	const double deg = 180.0 / 3.1415926535;
+	return { angles[rotate_z] * deg,-angles[rotate_y] * deg,angles[rotate_x] * deg };
+}
+
+/**
+ * @brief ŷ̬תΪԪ
+ * @param[in] ati : ̬
+ * @return ĳ򣨴ϵϵת
+ * @note ŷǰ Rotate3D(p, -a, -e, -r) תϵ
+*/
+inline Quaternion3D ConvertCameraAttitudeToQuaternion(Attitude3D ati)
+{
+	return GetConjugateQuaternion(ConvertAttitudeToQuaternion({ -ati.a,-ati.e,-ati.r }));
+}
+
+/**
+ * @brief ĳתΪŷ̬
+ * @param[in] q : 
+ * @return ̬ ConvertCameraAttitudeToQuaternion 
+*/
+inline Attitude3D ConvertQuaternionToCameraAttitude(const Quaternion3D& q)
+{
+	Attitude3D ati = ConvertQuaternionToAttitude(GetConjugateQuaternion(q));
+	return { -ati.a,-ati.e,-ati.r };
+}
+
+/**
+ * @brief 4x4 ʽp' = M * p
+*/
+struct Matrix4D
+{
+	double m[4][4];
+};
+
+/**
+ * @brief 
+ * @return  a * b b ı任 a ı任
+*/
+inline Matrix4D MultiplyMatrix4D(const Matrix4D& a, const Matrix4D& b)
+{
+	Matrix4D r;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+	return r;
+}
+
+/**
+ * @brief þ任 3D ꣨w ȡ 1
+ * @return 
+*/
+inline Point4D TransformPoint4D(const Matrix4D& mat, Point3D p)
+{
+	return {
+		mat.m[0][0] * p.x + mat.m[0][1] * p.y + mat.m[0][2] * p.z + mat.m[0][3],
+		mat.m[1][0] * p.x + mat.m[1][1] * p.y + mat.m[1][2] * p.z + mat.m[1][3],
+		mat.m[2][0] * p.x + mat.m[2][1] * p.y + mat.m[2][2] * p.z + mat.m[2][3],
+		mat.m[3][0] * p.x + mat.m[3][1] * p.y + mat.m[3][2] * p.z + mat.m[3][3]
+	};
+}
+
+/**
+ * @brief ȡ۲󣺰任ϵԭ㣬 +z 
+ * @param[in] cam : 
+*/
+inline Matrix4D GetViewMatrix(const Camera3D& cam)
+{
+	Matrix3D rot = GetQuaternionMatrix(GetConjugateQuaternion(cam.orientation));
+	Point3D t = TransformPoint3D(rot, cam.pPosition);
+	Matrix4D mat = { {
+		{ rot.m[0][0],rot.m[0][1],rot.m[0][2],-t.x },
+		{ rot.m[1][0],rot.m[1][1],rot.m[1][2],-t.y },
+		{ rot.m[2][0],rot.m[2][1],rot.m[2][2],-t.z },
+		{ 0,0,0,1 }
+	} };
+	return mat;
+}
+
+/**
+ * @brief ȡͶӰ󣺰ϵ任üռ
+ * @param[in] cam : 
+ * @note ͸ͶӰʹñ׼͸Ӿw ϵµȡ
+ *			ƽͶӰʱӿڿӳ䵽 [-1, 1]w Ϊ 1
+ *			߶ [dNear, dFar] ӳ䵽 [0, w]Բü 0 <= z <= w
+ *			γ z  [0, 1] ֮䣬ȵ
+*/
+inline Matrix4D GetProjectionMatrix(const Camera3D& cam)
+{
+	double n = cam.dNear, f = cam.dFar;
+	Matrix4D mat = {};
+	if (cam.bPerspectiveProjection)
+	{
+		double sy = 1 / tan(ConvertToRadian(cam.fov) / 2);
+		double aspect = (double)cam.nViewportWidth / cam.nViewportHeight;
+		mat.m[0][0] = sy / aspect;
+		mat.m[1][1] = sy;
+		mat.m[2][2] = f / (f - n);
+		mat.m[2][3] = -n * f / (f - n);
+		mat.m[3][2] = 1;
+	}
+	else
+	{
+		mat.m[0][0] = 2.0 / cam.nViewportWidth;
+		mat.m[1][1] = 2.0 / cam.nViewportHeight;
+		mat.m[2][2] = 1 / (f - n);
+		mat.m[2][3] = -n / (f - n);
+		mat.m[3][3] = 1;
+	}
+	return mat;
+}
+
+/**
+ * @brief ȡ NDC ĳ
+ * @param[in] cam : 
+ * @param[in] ndc : NDC  x, y
+ * @param[out] pOrigin : ع㣨꣩
+ * @param[out] pDir : ع߷꣩
+ * @note ϵе z Ϊ 1ǵλԹ߲ t õϵµȣ
+ *			ɼΧ [dNear, dFar]͸ͶӰĹߴλóƽͶӰĹߴƽϳ
+*/
+inline void GetCameraRay(const Camera3D& cam, Point2D ndc, Point3D* pOrigin, Point3D* pDir)
+{
+	Matrix3D rot = GetQuaternionMatrix(GetConjugateQuaternion(cam.orientation));
+	Point3D o = { 0,0,0 }, d = { 0,0,1 };
+	if (cam.bPerspectiveProjection)
+	{
+		double sy = 1 / tan(ConvertToRadian(cam.fov) / 2);
+		double aspect = (double)cam.nViewportWidth / cam.nViewportHeight;
+		d = { ndc.x * aspect / sy,ndc.y / sy,1 };
+	}
+	else
+	{
+		o = { ndc.x * cam.nViewportWidth / 2,ndc.y * cam.nViewportHeight / 2,0 };
+	}
+
+	// תת
+	auto inverse = [&rot](Point3D p) -> Point3D {
+		return {
+			rot.m[0][0] * p.x + rot.m[1][0] * p.y + rot.m[2][0] * p.z,
+			rot.m[0][1] * p.x + rot.m[1][1] * p.y + rot.m[2][1] * p.z,
+			rot.m[0][2] * p.x + rot.m[1][2] * p.y + rot.m[2][2] * p.z
+		};
+	};
+	o = inverse(o);
+	*pOrigin = { o.x + cam.pPosition.x,o.y + cam.pPosition.y,o.z + cam.pPosition.z };
+	*pDir = inverse(d);
+}
+
+/**
+ * @brief üռеĵ׶
+ * @return λ 0~5 αʾ x = -w, x = w, y = -w, y = w, z = 0, z = w 
+*/
+inline int GetClipOutcode(const Point4D& h)
+{
+	return (h.x < -h.w) | (h.x > h.w) << 1 | (h.y < -h.w) << 2 | (h.y > h.w) << 3 | (h.z < 0) << 4 | (h.z > h.w) << 5;
+}
+
+/**
+ * @brief ڲüռýԶüü
+ * @param[in, out] h : 㣨üռ䣩鳤Ϊ POLYGON_MAX_SIDES
+ * @param[in, out] pColors : ɫ h һһӦ
+ * @param[in, out] pCoords : ꣬ h һһӦ
+ * @param[in] num : 
+ * @param[in] outcode : İλֻеĽԶüλ16  32Ҫü
+ * @return زüĶαȫõ򶥵ʱ 0
+ * @note ʹ Sutherland-Hodgman ɫֵ֮߶Σ2 㣩ֻüһߡ
+*/
+inline int ClipPolygonZ(Point4D* h, Color* pColors, TexCoord* pCoords, int num, int outcode)
+{
+	//  z >= 0  w - z >= 0 ü
+	for (int plane = 0; plane < 2; plane++)
+	{
+		if (!(outcode & (16 << plane))) continue;
+		auto dist = [plane](const Point4D& v) { return plane == 0 ? v.z : v.w - v.z; };
+
+		Point4D h2[POLYGON_MAX_SIDES];
+		Color pColors2[POLYGON_MAX_SIDES];
+		TexCoord pCoords2[POLYGON_MAX_SIDES];
+		int num2 = 0;
+
+		// ߶ֻһߣĩ˵㵥
+		int nEdges = num == 2 ? 1 : num;
+		for (int i = 0; i < nEdges; i++)
+		{
+			int j = (i + 1) % num;
+			double di = dist(h[i]), dj = dist(h[j]);
+			if (di >= 0)
+			{
+				if (num2 >= POLYGON_MAX_SIDES) return 0;
+				h2[num2] = h[i];
+				pColors2[num2] = pColors[i];
+				pCoords2[num2] = pCoords[i];
+				num2++;
+			}
+			if ((di >= 0) != (dj >= 0))
+			{
+				if (num2 >= POLYGON_MAX_SIDES) return 0;
+				double t = di / (di - dj);
+				auto lerp = [t](double a, double b) { return a + (b - a) * t; };
+				h2[num2] = { lerp(h[i].x,h[j].x),lerp(h[i].y,h[j].y),lerp(h[i].z,h[j].z),lerp(h[i].w,h[j].w) };
+				pCoords2[num2] = { lerp(pCoords[i].u,pCoords[j].u),lerp(pCoords[i].v,pCoords[j].v),lerp(pCoords[i].q,pCoords[j].q) };
+				Color ci = pColors[i], cj = pColors[j];
+				if (ci >= 0 && cj >= 0)
+					pColors2[num2] = RGB((int)lerp(GetRValue(ci), GetRValue(cj)), (int)lerp(GetGValue(ci), GetGValue(cj)), (int)lerp(GetBValue(ci), GetBValue(cj)));
+				else
+					pColors2[num2] = ci >= 0 ? ci : cj;
+				num2++;
+			}
+		}
+		if (num == 2 && dist(h[1]) >= 0)
+		{
+			h2[num2] = h[1];
+			pColors2[num2] = pColors[1];
+			pCoords2[num2] = pCoords[1];
+			num2++;
+		}
+		if (num2 == 0) return 0;
+
+		num = num2;
+		for (int i = 0; i < num; i++)
+		{
+			h[i] = h2[i];
+			pColors[i] = pColors2[i];
+			pCoords[i] = pCoords2[i];
+		}
+	}
+	return num;
+}
+
+/**
+ * @brief α任üռ䣬üγ
+ * @param[in, out] p : Σ꣩ʱΪ NDC 
+ * @param[in] mat : ۲ͶӰ
+ * @return ׶ʱ false
+ * @note ȫ׶ĳĶֱ޳ԶüĶ ClipPolygonZ ü
+ *			x, y 򲻲üɹդʱĻΧͬʱ 1/w͸У
+*/
+inline bool ProjectPolygon(Polygon3D* p, const Matrix4D& mat)
+{
+	int num = p->nPointsNum;
+	if (num <= 0) return false;
+
+	Point4D h[POLYGON_MAX_SIDES];
+	int out_and = 0x3f, out_or = 0;
+	for (int i = 0; i < num; i++)
+	{
+		h[i] = TransformPoint4D(mat, p->pPoints[i]);
+		int code = GetClipOutcode(h[i]);
+		out_and &= code;
+		out_or |= code;
+	}
+	if (out_and) return false;
+
+	Color pColors[POLYGON_MAX_SIDES];
+	TexCoord pCoords[POLYGON_MAX_SIDES];
+	for (int i = 0; i < num; i++)
+	{
+		pColors[i] = p->pColors[i];
+		pCoords[i] = p->pTexCoords ? p->pTexCoords[i] : TexCoord{ 0,0,1 };
+	}
+	// Զü
+	if (out_or & (16 | 32))
+	{
+		num = ClipPolygonZ(h, pColors, pCoords, num, out_or);
+		if (num == 0) return false;
+	}
+
+	// γ
+	for (int i = 0; i < num; i++)
+	{
+		if (h[i].w <= 0) return false;
+		double iw = 1 / h[i].w;
+		p->pPoints[i] = { h[i].x * iw,h[i].y * iw,h[i].z * iw };
+		p->pColors[i] = pColors[i];
+		if (p->pTexCoords)
+			p->pTexCoords[i] = { pCoords[i].u * iw,pCoords[i].v * iw,pCoords[i].q * iw };
+	}
+	p->nPointsNum = num;
+	return true;
+}
+
+/**
+ * @brief μת
+ * @param[in] pPolygons : μ
+ * @param[in] num : 
+ * @param[in] atiCamera : ̬
+ * @param[in] pCamera : λ
+ * @return תĶμ
+*/
+inline Polygon3D* RotateToCamera(Polygon3D* pPolygons, int num, Attitude3D atiCamera, Point3D pCamera)
+{
+	Polygon3D* pRotated = new Polygon3D[num];
+	CopyPolygons(pRotated,pPolygons,num);
+
+	for (int i = 0; i < num; i++)
+	{
+		for (int j = 0; j < pRotated[i].nPointsNum; j++)
+		{
+			pRotated[i].pPoints[j] = Rotate3D(pRotated[i].pPoints[j], -atiCamera.a, -atiCamera.e, -atiCamera.r, pCamera);
+		}
+	}
+	return pRotated;
+}
+
+/**
+ * @brief μתϵ
+ * @param[in] pPolygons : ϵ
+ * @param[in] num : 
+ * @param[in] pOrigin : µϵԭھϵеλ
+ * @return תϵĶμ
+*/
+inline Polygon3D* ConvertCoordinateSystem(Polygon3D* pPolygons, int num, Point3D pOrigin)
+{
+	Polygon3D* pConverted = new Polygon3D[num];
+	CopyPolygons(pConverted, pPolygons, num);
+
+	for (int i = 0; i < num; i++)
+	{
+		for (int j = 0; j < pConverted[i].nPointsNum; j++)
+		{
+			pConverted[i].pPoints[j].x -= pOrigin.x;
+			pConverted[i].pPoints[j].y -= pOrigin.y;
+			pConverted[i].pPoints[j].z -= pOrigin.z;
+		}
+	}
+	return pConverted;
+}
+
+/**
+ * @brief μϼ͸ͶӰЧ
+ * @param[in] pPolygons : μ
+ * @param[in] num : 
+ * @param[in] nFocal : 
+ * @return ͸ͶӰĶμ
+ * @attention ͸ĵϵԭ
+ * @note ӿĵвü
+ *			ϵԱ仯͸ӳȾѸ GetProjectionMatrix  ProjectPolygon
+*/
+inline Polygon3D* GetPerspectiveProjectionPolygons(Polygon3D* pPolygons, int num, int nFocal)
+{
+	Polygon3D* pProjection = new Polygon3D[num];
+	CopyPolygons(pProjection, pPolygons, num);
+
+	for (int i = 0; i < num; i++)
+	{
+		for (int j = 0; j < pProjection[i].nPointsNum; j++)
+		{
+			double zoom = (nFocal - pPolygons[i].pPoints[j].z) / nFocal;
+			pProjection[i].pPoints[j].x *= zoom;
+			pProjection[i].pPoints[j].y *= zoom;
+
+			// һͬţդʱٳʵ͸У
+			if (pProjection[i].pTexCoords)
+			{
+				pProjection[i].pTexCoords[j].u *= zoom;
+				pProjection[i].pTexCoords[j].v *= zoom;
+				pProjection[i].pTexCoords[j].q *= zoom;
+			}
+		}
+	}
+	return pProjection;
+}
+
+/**
+ * @brief ü NDC μ
+ * @param[in] pPolygons : NDC μ
+ * @param[in] num : 
+ * @param[in] nFocal : 
+ * @param[out] out_count : زü
+ * @return زüĶμ
+*/
+inline Polygon3D* CropNDCPolygons(Polygon3D* pPolygons, int num, int nFocal, int* out_count)
+{
+
+	/////////// ʱһȽϼ򵥴ֱж
+	/////////// ֻӿĲü (x[-1 ~ 1]  y [-1 ~ 1]  z[0 ~ f])
+	/////////// Ҫĳɶνж
+
+	Polygon3D* pCrop = new Polygon3D[num];
+
+	int count = 0;
+	for (int i = 0; i < num; i++)
+	{
+		int crop_count = 0;
+		for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+		{
+			// ͳһγӿڵĵĸ
+			if (pPolygons[i].pPoints[j].x < -1 || pPolygons[i].pPoints[j].x > 1 ||
+				pPolygons[i].pPoints[j].y < -1 || pPolygons[i].pPoints[j].y > 1 ||
+				pPolygons[i].pPoints[j].z < 0 || pPolygons[i].pPoints[j].z > nFocal)
+			{
+				crop_count++;
+			}
+
+			// һӿھͿԱ
+			else
+			{
+				break;
+			}
+		}
+
+		// е㶼ӿڵ²ű˶Σ򱻲ü
+		if (crop_count < pPolygons[i].nPointsNum)
+		{
+			CopyPolygons(&pCrop[count], &pPolygons[i], 1);	
+			count ++;
+		}
+	}
+
+	// 
+	Polygon3D* pReserve = new Polygon3D[count];
+	CopyPolygons(pReserve, pCrop, count);
+
+	// ͷŴ
+	DeletePolygons(pCrop, num);
+
+	*out_count = count;
+	return pReserve;
+}
+
+//////// ͼ豸
+
+/**
+ * @brief ʼͼ豸
+ * @param[in] w : ͼ豸
+ * @param[in] w : ͼ豸
+ * @param[in] flag : ԣĬΪ 0
+*/
+inline void InitDrawingDevice(int w, int h, int flag = 0)
+{
+	// easyx
+	initgraph(w, h, flag);
+	//setorigin(w / 4, h / 4);
+}
+
+/**
+ * @brief	رջͼ豸
+*/
+inline void CloseDrawingDevice()
+{
+	// easyx
+	closegraph();
+}
+
+/**
+ * @brief ȡͼ豸
+*/
+inline int GetDrawingDeviceWidth()
+{
+	return getwidth();
+}
+
+/**
+ * @brief ȡͼ豸߶
+*/
+inline int GetDrawingDeviceHeight()
+{
+	return getheight();
+}
+
+/**
+ * @brief Ƶ
+ * @param[in] x : λ
+ * @param[in] y : λ
+ * @param[in] c : ɫ
+*/
+inline void DrawPixel(int x, int y, Color c)
+{
+	if (c < 0) return;
+
+	// easyx 
+	// ֱӲԴ滭
+	if (x >= 0 && y >= 0 && x < getwidth() && y < getheight())
+		GetImageBuffer()[y * getwidth() + x] = BGR((COLORREF)c);
+}
+
+/**
+ * @brief Ƶ
+ * @param[in] p : λ
+ * @param[in] c : ɫ
+*/
+inline void DrawPixel(Point2D p, Color c)
+{
+	DrawPixel((int)p.x, (int)p.y, c);
+}
+
+/**
+ * @brief  3D  NDC  תΪ 3D Ļ
+ * @param[in] p : ԭ
+ * @param[in] zoom : 
+ * @return תĻ
+ * @note ĬϹ۲Ϊ xoy
+*/
+inline Point3D ConvertNDC3DToScreenPoint(Point3D p, Zoom zoom = { 1,1 })
+{
+	return { (p.x * zoom.x + 1) * GetDrawingDeviceWidth(),(1 - p.y * zoom.y) * GetDrawingDeviceHeight(),0 };
+}
+
+
+//////// 
+
+/**
+ * @brief 
+ * @note ʱ mipmap 2x2 ʽ˲ÿһ㶼 TEXTURE_TILE_BITS СĿд洢
+ *			ڰУ֮ҲС˫ԲĸԼصĲͬһڡ
+ *			ظʽ֡ͬ0x00RRGGBB
+*/
+class Texture
+{
+private:
+
+	DWORD* pData;							/** @brief в */
+	int nLevelsNum;							/** @brief mipmap  */
+	int pWidth[TEXTURE_MAX_LEVELS];			/** @brief  */
+	int pHeight[TEXTURE_MAX_LEVELS];		/** @brief ߶ */
+	int pTilesX[TEXTURE_MAX_LEVELS];		/** @brief ÿеĿ */
+	size_t pOffset[TEXTURE_MAX_LEVELS];		/** @brief еʼλ */
+
+	/**
+	 * @brief ĳеλ
+	*/
+	size_t GetTexelIndex(int level, int x, int y) const
+	{
+		const int bits = TEXTURE_TILE_BITS, mask = (1 << bits) - 1;
+		size_t tile = (size_t)(y >> bits) * pTilesX[level] + (x >> bits);
+		return pOffset[level] + (tile << (bits * 2)) + ((y & mask) << bits) + (x & mask);
+	}
+
+	/**
+	 * @brief ظƽ̵ [0, n)
+	*/
+	static int Wrap(int x, int n)
+	{
+		x %= n;
+		return x < 0 ? x + n : x;
+	}
+
+public:
+
+	Texture()
+	{
+		pData = NULL;
+		nLevelsNum = 0;
+	}
+
+	~Texture()
+	{
+		Clear();
+	}
+
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	/**
+	 * @brief 鴴
+	 * @param[in] pSrc : 飨0x00RRGGBB
+	 * @param[in] w : 
+	 * @param[in] h : ߶
+	 * @param[in] pitch : ÿеΪ 0 ʱڿ
+	 * @return Ƿ񴴽ɹ
+	*/
+	bool Create(const DWORD* pSrc, int w, int h, int pitch = 0)
+	{
+		Clear();
+		if (!pSrc || w <= 0 || h <= 0) return false;
+		if (pitch <= 0) pitch = w;
+
+		const int tile = 1 << TEXTURE_TILE_BITS;
+
+		// ߴ
+		size_t total = 0;
+		for (int lw = w, lh = h; nLevelsNum < TEXTURE_MAX_LEVELS; nLevelsNum++)
+		{
+			pWidth[nLevelsNum] = lw;
+			pHeight[nLevelsNum] = lh;
+			pTilesX[nLevelsNum] = (lw + tile - 1) / tile;
+			pOffset[nLevelsNum] = total;
+			total += (size_t)pTilesX[nLevelsNum] * ((lh + tile - 1) / tile) * tile * tile;
+			if (lw == 1 && lh == 1)
+			{
+				nLevelsNum++;
+				break;
+			}
+			lw = std::max(lw / 2, 1);
+			lh = std::max(lh / 2, 1);
+		}
+		pData = AllocArray<DWORD>(total, memory_texture);
+		memset(pData, 0, sizeof DWORD * total);
+
+		// Сһ㱣Ի
+		DWORD* pLevel = AllocArray<DWORD>((size_t)w * h, memory_texture);
+		for (int y = 0; y < h; y++)
+			memcpy(pLevel + (size_t)y * w, pSrc + (size_t)y * pitch, sizeof DWORD * w);
+
+		for (int level = 0; level < nLevelsNum; level++)
+		{
+			int lw = pWidth[level], lh = pHeight[level];
+			for (int y = 0; y < lh; y++)
+				for (int x = 0; x < lw; x++)
+					pData[GetTexelIndex(level, x, y)] = pLevel[(size_t)y * lw + x];
+
+			if (level + 1 >= nLevelsNum) break;
+
+			int nw = pWidth[level + 1], nh = pHeight[level + 1];
+			DWORD* pNext = AllocArray<DWORD>((size_t)nw * nh, memory_texture);
+			for (int y = 0; y < nh; y++)
+			{
+				int y0 = std::min(y * 2, lh - 1), y1 = std::min(y * 2 + 1, lh - 1);
+				for (int x = 0; x < nw; x++)
+				{
+					int x0 = std::min(x * 2, lw - 1), x1 = std::min(x * 2 + 1, lw - 1);
+					DWORD c[4] = { pLevel[(size_t)y0 * lw + x0],pLevel[(size_t)y0 * lw + x1],pLevel[(size_t)y1 * lw + x0],pLevel[(size_t)y1 * lw + x1] };
+					DWORD r = 0, g = 0, b = 0;
+					for (int k = 0; k < 4; k++)
+					{
+						r += (c[k] >> 16) & 0xFF;
+						g += (c[k] >> 8) & 0xFF;
+						b += c[k] & 0xFF;
+					}
+					pNext[(size_t)y * nw + x] = (((r + 2) / 4) << 16) | (((g + 2) / 4) << 8) | ((b + 2) / 4);
+				}
+			}
+			FreeArray(pLevel);
+			pLevel = pNext;
+		}
+		FreeArray(pLevel);
+		return true;
+	}
+
+	/**
+	 * @brief ͼļʹ EasyX  loadimage֧ bmp, jpg, png ȸʽ
+	 * @param[in] strFile : ļ·
+	 * @return Ƿسɹ
+	*/
+	bool Load(LPCTSTR strFile)
+	{
+		IMAGE img;
+		loadimage(&img, strFile);
+		if (img.getwidth() <= 0 || img.getheight() <= 0)
+			return false;
+		return Create(GetImageBuffer(&img), img.getwidth(), img.getheight());
+	}
+
+	/**
+	 * @brief ͷ
+	*/
+	void Clear()
+	{
+		FreeArray(pData);
+		pData = NULL;
+		nLevelsNum = 0;
+	}
+
+	/**
+	 * @brief ȡ mipmap Ϊ 0 ʾΪ
+	*/
+	int GetLevelsNum() const
+	{
+		return nLevelsNum;
+	}
+
+	/**
+	 * @brief ȡռõڴ棨ֽڣ mipmap ͷֿ鲹Ĳ
+	*/
+	size_t GetMemoryUsage() const
+	{
+		const int tile = 1 << TEXTURE_TILE_BITS;
+		size_t total = 0;
+		for (int level = 0; level < nLevelsNum; level++)
+			total += (size_t)pTilesX[level] * ((pHeight[level] + tile - 1) / tile) * tile * tile;
+		return total * sizeof(DWORD);
+	}
+
+	/**
+	 * @brief ȡĳĿ
+	*/
+	int GetWidth(int level = 0) const
+	{
+		return pWidth[level];
+	}
+
+	/**
+	 * @brief ȡĳĸ߶
+	*/
+	int GetHeight(int level = 0) const
+	{
+		return pHeight[level];
+	}
+
+	/**
+	 * @brief ȡأ곬Χʱظƽ
+	*/
+	DWORD GetTexel(int level, int x, int y) const
+	{
+		return pData[GetTexelIndex(level, Wrap(x, pWidth[level]), Wrap(y, pHeight[level]))];
+	}
+
+	/**
+	 * @brief ˫Բ
+	 * @param[in] u, v : 
+	 * @param[in] level : mipmap 㣬ΧʱȡĲ
+	 * @return زõɫ0x00RRGGBB
+	*/
+	DWORD Sample(double u, double v, int level = 0) const
+	{
+		level = std::min(std::max(level, 0), nLevelsNum - 1);
+		int w = pWidth[level], h = pHeight[level];
+
+		//  (i + 0.5) / w 
+		double x = u * w - 0.5, y = v * h - 0.5;
+		double fx = floor(x), fy = floor(y);
+		int x0 = Wrap((int)(long long)fx, w), y0 = Wrap((int)(long long)fy, h);
+		int x1 = x0 + 1 < w ? x0 + 1 : 0, y1 = y0 + 1 < h ? y0 + 1 : 0;
+		int wx = (int)((x - fx) * 256), wy = (int)((y - fy) * 256);
+
+		DWORD c00 = pData[GetTexelIndex(level, x0, y0)], c10 = pData[GetTexelIndex(level, x1, y0)];
+		DWORD c01 = pData[GetTexelIndex(level, x0, y1)], c11 = pData[GetTexelIndex(level, x1, y1)];
+
+		// һδ 0x00FF00FF У 0x0000FF00 
+		auto lerp = [](DWORD a, DWORD b, int t) -> DWORD {
+			DWORD rb = (((a & 0xFF00FF) * (256 - t) + (b & 0xFF00FF) * t) >> 8) & 0xFF00FF;
+			DWORD g = (((a & 0xFF00) * (256 - t) + (b & 0xFF00) * t) >> 8) & 0xFF00;
+			return rb | g;
+		};
+		return lerp(lerp(c00, c10, wx), lerp(c01, c11, wx), wy);
+	}
+};
+
+//////// ͼ
+
+/**
+ * @brief ֡
+ * @note ظʽ EasyX Դ棨GetImageBufferͬ 0x00RRGGBB
+ *			ԼȿԼڴ棬Ҳֱӹҽӵ EasyX Դϻơ
+*/
+class FrameBuffer
+{
+private:
+
+	DWORD* pBuffer;		/** @brief  */
+	int nWidth;			/** @brief  */
+	int nHeight;		/** @brief ߶ */
+	int nPitch;			/** @brief ÿеɴڿȣ */
+	bool bOwner;		/** @brief Ƿɱ */
+
+	DWORD* pSamples;	/** @brief زʱ 1 ԺĲƽ棨ÿ nPitch أûжزʱΪ NULL */
+	int nSamples;		/** @brief ÿصĲ */
+
+	void release()
+	{
+		if (bOwner) FreeArray(pBuffer);
+		FreeArray(pSamples);
+		pBuffer = NULL;
+		pSamples = NULL;
+		nSamples = 1;
+		bOwner = false;
+	}
+
+public:
+
+	FrameBuffer()
+	{
+		pBuffer = NULL;
+		nWidth = nHeight = nPitch = 0;
+		bOwner = false;
+		pSamples = NULL;
+		nSamples = 1;
+	}
+
+	FrameBuffer(int w, int h) : FrameBuffer()
+	{
+		Create(w, h);
+	}
+
+	FrameBuffer(const FrameBuffer&) = delete;
+	FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+	~FrameBuffer()
+	{
+		release();
+	}
+
+	/**
+	 * @brief ָС֡
+	 * @note Сʱ·ڴ棬Էÿ֡
+	 * @return Ƿɹ
+	*/
+	bool Create(int w, int h)
+	{
+		if (w <= 0 || h <= 0) return false;
+		if (bOwner && w == nWidth && h == nHeight) return true;
+		release();
+		pBuffer = AllocArray<DWORD>((size_t)w * h, memory_framebuffer);
+		memset(pBuffer, 0, sizeof(DWORD) * w * h);
+		nWidth = nPitch = w;
+		nHeight = h;
+		bOwner = true;
+		return true;
+	}
+
+	/**
+	 * @brief ҽӵⲿݣͷţ
+	 * @param[in] p : 
+	 * @param[in] w : 
+	 * @param[in] h : ߶
+	 * @param[in] pitch : ÿеΪ 0 ʱڿ
+	*/
+	void Attach(DWORD* p, int w, int h, int pitch = 0)
+	{
+		release();
+		pBuffer = p;
+		nWidth = w;
+		nHeight = h;
+		nPitch = pitch > 0 ? pitch : w;
+	}
+
+	/**
+	 * @brief ҽӵһ֡򣨹ݣͷţ
+	 * @param[in] pParent : ֡
+	 * @param[in] x : Ͻڸ֡е x 
+	 * @param[in] y : Ͻڸ֡е y 
+	 * @param[in] w : 
+	 * @param[in] h : ߶
+	 * @return ᱻü֡巶ΧڣüΪʱ false
+	 * @note еĻͼԽı߽磬Իصڶ߳ͬʱ
+	*/
+	bool AttachSubRegion(const FrameBuffer* pParent, int x, int y, int w, int h)
+	{
+		int x1 = std::min(x + w, pParent->GetWidth()), y1 = std::min(y + h, pParent->GetHeight());
+		x = std::max(x, 0);
+		y = std::max(y, 0);
+		if (!pParent->GetBuffer() || x1 <= x || y1 <= y)
+		{
+			release();
+			nWidth = nHeight = nPitch = 0;
+			return false;
+		}
+		Attach(pParent->GetLine(y) + x, x1 - x, y1 - y, pParent->GetPitch());
+		return true;
+	}
+
+	/**
+	 * @brief ҽӵ EasyX ǰͼ豸Դ
+	*/
+	void AttachDrawingDevice()
+	{
+		Attach(GetImageBuffer(GetWorkingImage()), getwidth(), getheight());
+	}
+
+	/**
+	 * @brief ĳɫ֡壨в
+	*/
+	void Clear(Color c)
+	{
+		if (!pBuffer) return;
+		DWORD dw = BGR((COLORREF)(c < 0 ? 0 : c));
+		for (int s = 0; s < nSamples; s++)
+		{
+			for (int y = 0; y < nHeight; y++)
+			{
+				std::fill(GetSampleLine(s, y), GetSampleLine(s, y) + nWidth, dw);
+			}
+		}
+	}
+
+	/**
+	 * @brief ÿصĲزݣ
+	 * @param[in] n : ֻ 12  4Ϊ 1 ʱͷŲƽ
+	 * @return ǷɹʧʱΪ 1
+	 * @note  0 ֡屾أÿռһͬСƽ棬·ƽ渴Ƶ 0 
+	 *			жʱΰֱжϸǣɫÿֻһΣ RasterizeTriangleSamples
+	 *			㡢߶κͰдв ResolveSamples ϳɡ
+	 *			ʱ·ڴ棻֡·¹ҽʱƽһͷš
+	*/
+	bool SetSamplesNum(int n)
+	{
+		if (n == nSamples) return true;
+		FreeArray(pSamples);
+		pSamples = NULL;
+		nSamples = 1;
+		if (n == 1) return true;
+		if ((n != 2 && n != 4) || !pBuffer) return false;
+
+		pSamples = AllocArray<DWORD>((size_t)(n - 1) * nPitch * nHeight, memory_framebuffer);
+		nSamples = n;
+		for (int s = 1; s < n; s++)
+		{
+			for (int y = 0; y < nHeight; y++)
+				memcpy(GetSampleLine(s, y), GetLine(y), sizeof(DWORD) * nWidth);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief ȡÿصĲ
+	*/
+	int GetSamplesNum() const { return nSamples; }
+
+	/**
+	 * @brief ȡĳƽĳһе׵ַ 0  GetLine
+	*/
+	DWORD* GetSampleLine(int s, int y) const
+	{
+		return s == 0 ? GetLine(y) : pSamples + ((size_t)(s - 1) * nHeight + y) * nPitch;
+	}
+
+	/**
+	 * @brief һ֡ͼƵвزǰ뱳
+	 * @param[in] pSrc : Դ֡壬СӦ뱾ֲ֡ͬ
+	*/
+	void LoadSamples(const FrameBuffer* pSrc)
+	{
+		int w = std::min(nWidth, pSrc->GetWidth()), h = std::min(nHeight, pSrc->GetHeight());
+		for (int s = 0; s < nSamples; s++)
+		{
+			for (int y = 0; y < h; y++)
+				memcpy(GetSampleLine(s, y), pSrc->GetLine(y), sizeof(DWORD) * w);
+		}
+	}
+
+	/**
+	 * @brief ѸƽɫдĿ֡壨زĺϳɣ
+	 * @param[in] pDst : Ŀ֡壬Ǳ֡壨ʱǵ 0 
+	 * @note ðֽȡƽ룩ķϳɣSSE2 ÿδ 4 أ4 ʱƽƽ
+	 *			ɫͬʱ䣬ڲزΪϳɶıɫ
+	*/
+	void ResolveSamples(FrameBuffer* pDst) const
+	{
+		int w = std::min(nWidth, pDst->GetWidth()), h = std::min(nHeight, pDst->GetHeight());
+		for (int y = 0; y < h; y++)
+		{
+			const DWORD* p0 = GetSampleLine(0, y);
+			const DWORD* p1 = GetSampleLine(nSamples > 1 ? 1 : 0, y);
+			const DWORD* p2 = GetSampleLine(nSamples > 2 ? 2 : 0, y);
+			const DWORD* p3 = GetSampleLine(nSamples > 2 ? 3 : 0, y);
+			DWORD* pOut = pDst->GetLine(y);
+			if (nSamples == 1)
+			{
+				if (pOut != p0)
+					memcpy(pOut, p0, sizeof(DWORD) * w);
+				continue;
+			}
+
+			int x = 0;
+#ifdef HD3D_SSE2
+			for (; x + 4 <= w; x += 4)
+			{
+				__m128i v = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(p0 + x)), _mm_loadu_si128((const __m128i*)(p1 + x)));
+				if (nSamples == 4)
+					v = _mm_avg_epu8(v, _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(p2 + x)), _mm_loadu_si128((const __m128i*)(p3 + x))));
+				_mm_storeu_si128((__m128i*)(pOut + x), v);
+			}
+#endif
+			for (; x < w; x++)
+			{
+				DWORD c = AverageColor(p0[x], p1[x]);
+				pOut[x] = nSamples == 4 ? AverageColor(c, AverageColor(p2[x], p3[x])) : c;
+			}
+		}
+	}
+
+	/**
+	 * @brief ֽԴʽɫƽֵ룬 _mm_avg_epu8 ͬ
+	*/
+	static DWORD AverageColor(DWORD a, DWORD b)
+	{
+		return (a | b) - (((a ^ b) & 0xFEFEFEFE) >> 1);
+	}
+
+	DWORD* GetBuffer() const { return pBuffer; }
+	int GetWidth() const { return nWidth; }
+	int GetHeight() const { return nHeight; }
+	int GetPitch() const { return nPitch; }
+
+	/**
+	 * @brief ȡĳһе׵ַ
+	*/
+	DWORD* GetLine(int y) const { return pBuffer + (size_t)y * nPitch; }
+
+	/**
+	 * @brief ȡɫCOLORREF ʽ
+	*/
+	Color GetPixel(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= nWidth || y >= nHeight) return -1;
+		return (Color)BGR(GetLine(y)[x]);
+	}
+};
+
+/**
+ * @brief ֡ϻƵ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] x : λ
+ * @param[in] y : λ
+ * @param[in] c : ɫ
+*/
+inline void DrawPixel(FrameBuffer* pTarget, int x, int y, Color c)
+{
+	if (c < 0) return;
+	if (x >= 0 && y >= 0 && x < pTarget->GetWidth() && y < pTarget->GetHeight())
+	{
+		for (int s = 0; s < pTarget->GetSamplesNum(); s++)
+			pTarget->GetSampleLine(s, y)[x] = BGR((COLORREF)c);
+	}
+}
+
+/**
+ * @brief ĳɫһ
+ * @param[in] p : ʼ
+ * @param[in] num : 
+ * @param[in] c : Դʽɫ
+*/
+inline void FillSpan(DWORD* p, int num, DWORD c)
+{
+	int i = 0;
+#ifdef HD3D_SSE2
+	__m128i v = _mm_set1_epi32((int)c);
+	for (; i + 8 <= num; i += 8)
+	{
+		_mm_storeu_si128((__m128i*)(p + i), v);
+		_mm_storeu_si128((__m128i*)(p + i + 4), v);
+	}
+	for (; i + 4 <= num; i += 4)
+		_mm_storeu_si128((__m128i*)(p + i), v);
+#endif
+	for (; i < num; i++)
+		p[i] = c;
+}
+
+/**
+ * @brief  Liang-Barsky 㷨߶βü
+ * @param[in, out] x0, y0, x1, y1 : ߶ζ˵㣬زüĶ˵
+ * @param[in] min_x, min_y, max_x, max_y : ü
+ * @return ߶Ƿвھ
+*/
+inline bool ClipLine2D(double* x0, double* y0, double* x1, double* y1, double min_x, double min_y, double max_x, double max_y)
+{
+	double dx = *x1 - *x0, dy = *y1 - *y0;
+	double t0 = 0, t1 = 1;
+	double p[4] = { -dx,dx,-dy,dy };
+	double q[4] = { *x0 - min_x,max_x - *x0,*y0 - min_y,max_y - *y0 };
+	for (int i = 0; i < 4; i++)
+	{
+		if (p[i] == 0)
+		{
+			if (q[i] < 0) return false;
+			continue;
+		}
+		double t = q[i] / p[i];
+		if (p[i] < 0)
+		{
+			if (t > t1) return false;
+			if (t > t0) t0 = t;
+		}
+		else
+		{
+			if (t < t0) return false;
+			if (t < t1) t1 = t;
+		}
+	}
+	double ox = *x0, oy = *y0;
+	*x0 = ox + t0 * dx;
+	*y0 = oy + t0 * dy;
+	*x1 = ox + t1 * dx;
+	*y1 = oy + t1 * dy;
+	return true;
+}
+
+/**
+ * @brief Ѿ֡巶Χڵ߶
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] x0, y0 : 
+ * @param[in] x1, y1 : յ
+ * @param[in] c : Դʽɫ
+ * @attention κԽ飬˵֡
+ * @note ˮƽֱӰ䣬ఴƶָ루Bresenhamزʱ߶дв
+*/
+inline void DrawClippedLine(FrameBuffer* pTarget, int x0, int y0, int x1, int y1, DWORD c)
+{
+	if (y0 == y1)
+	{
+		if (x0 > x1) std::swap(x0, x1);
+		for (int s = 0; s < pTarget->GetSamplesNum(); s++)
+			FillSpan(pTarget->GetSampleLine(s, y0) + x0, x1 - x0 + 1, c);
+		return;
+	}
+
+	int dx = abs(x1 - x0), dy = abs(y1 - y0);
+	int step_x = x0 < x1 ? 1 : -1;
+	int step_y = y0 < y1 ? pTarget->GetPitch() : -pTarget->GetPitch();
+	for (int s = 0; s < pTarget->GetSamplesNum(); s++)
+	{
+		DWORD* p = pTarget->GetSampleLine(s, y0) + x0;
+		if (dx >= dy)
+		{
+			int err = dx / 2;
+			for (int i = 0; i <= dx; i++)
+			{
+				*p = c;
+				p += step_x;
+				err -= dy;
+				if (err < 0)
+				{
+					p += step_y;
+					err += dx;
+				}
+			}
+		}
+		else
+		{
+			int err = dy / 2;
+			for (int i = 0; i <= dy; i++)
+			{
+				*p = c;
+				p += step_y;
+				err -= dx;
+				if (err < 0)
+				{
+					p += step_x;
+					err += dy;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief ֡ϻ߶
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] x0, y0 : 
+ * @param[in] x1, y1 : յ
+ * @param[in] c : ɫ
+ * @note Ȳü֡巶ΧٻƣĲֲж
+*/
+inline void DrawLine(FrameBuffer* pTarget, int x0, int y0, int x1, int y1, Color c)
+{
+	if (c < 0) return;
+	if (x0 >= 0 && y0 >= 0 && x1 >= 0 && y1 >= 0 && x0 < pTarget->GetWidth() && x1 < pTarget->GetWidth()
+		&& y0 < pTarget->GetHeight() && y1 < pTarget->GetHeight())
+	{
+		DrawClippedLine(pTarget, x0, y0, x1, y1, BGR((COLORREF)c));
+		return;
+	}
+
+	double fx0 = x0, fy0 = y0, fx1 = x1, fy1 = y1;
+	if (ClipLine2D(&fx0, &fy0, &fx1, &fy1, 0, 0, pTarget->GetWidth() - 1, pTarget->GetHeight() - 1))
+	{
+		DrawClippedLine(pTarget, (int)floor(fx0 + 0.5), (int)floor(fy0 + 0.5), (int)floor(fx1 + 0.5), (int)floor(fy1 + 0.5), BGR((COLORREF)c));
+	}
+}
+
+/**
+ * @brief ֡ɨ 2D 
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pPoints : ζ㣨Ļ꣩
+ * @param[in] num : ó POLYGON_MAX_SIDES
+ * @param[in] c : ɫ
+ * @note Ϊģʹż԰Ҳȷ䡣زʱдв
+*/
+inline void FillPolygon2D(FrameBuffer* pTarget, const POINT* pPoints, int num, Color c)
+{
+	if (c < 0 || num < 3) return;
+	DWORD dw = BGR((COLORREF)c);
+
+	long min_y = pPoints[0].y, max_y = pPoints[0].y;
+	for (int i = 1; i < num; i++)
+	{
+		if (pPoints[i].y < min_y) min_y = pPoints[i].y;
+		else if (pPoints[i].y > max_y) max_y = pPoints[i].y;
+	}
+	if (min_y < 0) min_y = 0;
+	if (max_y > pTarget->GetHeight() - 1) max_y = pTarget->GetHeight() - 1;
+
+	double pCross[POLYGON_MAX_SIDES];
+	for (long y = min_y; y <= max_y; y++)
+	{
+		// ɨߵĽ
+		int count = 0;
+		for (int i = 0, j = num - 1; i < num; j = i++)
+		{
+			const POINT& a = pPoints[i];
+			const POINT& b = pPoints[j];
+			if ((a.y <= y) != (b.y <= y))
+			{
+				pCross[count++] = a.x + (double)(y - a.y) * (b.x - a.x) / (b.y - a.y);
+			}
+		}
+		std::sort(pCross, pCross + count);
+
+		for (int k = 0; k + 1 < count; k += 2)
+		{
+			long x0 = (long)ceil(pCross[k]);
+			long x1 = (long)floor(pCross[k + 1]);
+			if (x0 < 0) x0 = 0;
+			if (x1 > pTarget->GetWidth() - 1) x1 = pTarget->GetWidth() - 1;
+			for (int s = 0; s < pTarget->GetSamplesNum() && x0 <= x1; s++)
+			{
+				DWORD* pLine = pTarget->GetSampleLine(s, y);
+				std::fill(pLine + x0, pLine + x1 + 1, dw);
+			}
+		}
+	}
+}
+
+/**
+ * @brief ֡ϻƶ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pPoints : ζ㣨Ļ꣩
+ * @param[in] num : 
+ * @param[in] c : ɫ
+*/
+inline void DrawPolygon2D(FrameBuffer* pTarget, const POINT* pPoints, int num, Color c)
+{
+	for (int i = 0, j = num - 1; i < num; j = i++)
+	{
+		DrawLine(pTarget, pPoints[j].x, pPoints[j].y, pPoints[i].x, pPoints[i].y, c);
+	}
+}
+
+/**
+ * @brief ȡΪ
+*/
+inline long long FloorDiv(long long a, long long b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * @brief ȡΪ
+*/
+inline long long CeilDiv(long long a, long long b)
+{
+	return -FloorDiv(-a, b);
+}
+
+/**
+ * @brief εĶߺ
+ * @note Ϊ RASTER_SUBPIXEL_BITS λض궼Ϊλ
+ *			ߺ E(x,y) = A*x + B*y + C ڲΪϱϵĵڲϵĵ㲻㣨ͨ C һʵ֣
+ *			ԹߵμȲз϶Ҳظơ
+*/
+struct TriangleEdges
+{
+	long long A[3], B[3], C[3];		/** @brief ߵıߺϵ */
+	long long min_x, min_y;			/** @brief ΧеСֵ */
+	long long max_x, max_y;			/** @brief Χеֵ */
+
+	/**
+	 * @brief ζ㽨ߺ
+	 * @param[in] p0, p1, p2 : ζ㣨Ļ꣬ (x,y) Ϊ (x+0.5,y+0.5)
+	 * @return γΪ 0 ʱ false
+	*/
+	bool Setup(Point2D p0, Point2D p1, Point2D p2)
+	{
+		const long long one = 1LL << RASTER_SUBPIXEL_BITS;
+
+		// β֤ߺ
+		const double guard = (double)(1 << 24);
+		if (fabs(p0.x) > guard || fabs(p0.y) > guard || fabs(p1.x) > guard || fabs(p1.y) > guard
+			|| fabs(p2.x) > guard || fabs(p2.y) > guard)
+		{
+			return false;
+		}
+
+		long long X[3] = { llround(p0.x * one),llround(p1.x * one),llround(p2.x * one) };
+		long long Y[3] = { llround(p0.y * one),llround(p1.y * one),llround(p2.y * one) };
+
+		// ͳһΪĶ˳
+		long long area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+		if (area == 0) return false;
+		if (area < 0)
+		{
+			std::swap(X[1], X[2]);
+			std::swap(Y[1], Y[2]);
+		}
+
+		min_x = std::min(X[0], std::min(X[1], X[2]));
+		max_x = std::max(X[0], std::max(X[1], X[2]));
+		min_y = std::min(Y[0], std::min(Y[1], Y[2]));
+		max_y = std::max(Y[0], std::max(Y[1], Y[2]));
+
+		for (int i = 0; i < 3; i++)
+		{
+			int j = (i + 1) % 3;
+			long long dx = X[j] - X[i], dy = Y[j] - Y[i];
+			bool bTopLeft = dy < 0 || (dy == 0 && dx > 0);
+			A[i] = -dy;
+			B[i] = dx;
+			C[i] = dy * X[i] - dx * Y[i] - (bTopLeft ? 0 : 1);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief  i  (x,y) ıߺֵ꣩
+	*/
+	long long Edge(int i, long long x, long long y) const
+	{
+		return A[i] * x + B[i] * y + C[i];
+	}
+
+	/**
+	 * @brief һвڵ
+	 * @param[in] x0, x1 : طΧ
+	 * @param[in] y :  y ꣨أ
+	 * @param[in] dx : Ե x ƫƣأΪ 0.5 
+	 * @param[out] lo, hi :  [lo, hi]ûвʱ lo > hi
+	*/
+	void GetSpan(int x0, int x1, long long y, long long dx, long long* lo, long long* hi) const
+	{
+		const long long one = 1LL << RASTER_SUBPIXEL_BITS;
+		*lo = x0;
+		*hi = x1;
+		for (int i = 0; i < 3 && *lo <= *hi; i++)
+		{
+			long long e = Edge(i, x0 * one + dx, y);
+			long long step = A[i] * one;
+			if (step > 0) *lo = std::max(*lo, x0 + CeilDiv(-e, step));
+			else if (step < 0) *hi = std::min(*hi, x0 + FloorDiv(e, -step));
+			else if (e < 0) *hi = *lo - 1;
+		}
+	}
+};
+
+/**
+ * @brief θǵ䣨ƽ / ߺ
+ * @param[in] pTarget : Ŀ֡壨ֻȷƷΧ
+ * @param[in] p0, p1, p2 : ζ㣨Ļ꣬ (x,y) Ϊ (x+0.5,y+0.5)
+ * @param[in] fnSpan : ص void(int y, int x0, int x1)Ϊ [x0, x1]Ѿ֡巶Χ
+ * @note Ϊ㣬ߺ TriangleEdges
+ *			ʱ RASTER_BLOCK_SIZE СĿ鴦ֱ
+ *			Ŀ
+*/
+template <typename SpanFunc>
+inline void RasterizeTriangleSpans(FrameBuffer* pTarget, Point2D p0, Point2D p1, Point2D p2, SpanFunc fnSpan)
+{
+	const long long one = 1LL << RASTER_SUBPIXEL_BITS;
+	const long long half = one / 2;
+
+	TriangleEdges tri;
+	if (!tri.Setup(p0, p1, p2)) return;
+
+	// ǵطΧΰΧڣ
+	int px0 = (int)std::max(CeilDiv(tri.min_x - half, one), 0LL);
+	int px1 = (int)std::min(FloorDiv(tri.max_x - half, one), (long long)pTarget->GetWidth() - 1);
+	int py0 = (int)std::max(CeilDiv(tri.min_y - half, one), 0LL);
+	int py1 = (int)std::min(FloorDiv(tri.max_y - half, one), (long long)pTarget->GetHeight() - 1);
+	if (px0 > px1 || py0 > py1) return;
+
+	// Ĵıߺֵ
+	auto edge = [&](int i, int x, int y) {
+		return tri.Edge(i, x * one + half, y * one + half);
+	};
+
+	const int bs = RASTER_BLOCK_SIZE;
+	for (int by = py0 - py0 % bs; by <= py1; by += bs)
+	{
+		int y0 = std::max(by, py0), y1 = std::min(by + bs - 1, py1);
+		for (int bx = px0 - px0 % bs; bx <= px1; bx += bs)
+		{
+			int x0 = std::max(bx, px0), x1 = std::min(bx + bs - 1, px1);
+
+			// ߺԵģڵļֵĸ
+			bool bReject = false, bAccept = true;
+			for (int i = 0; i < 3 && !bReject; i++)
+			{
+				long long e00 = edge(i, x0, y0), e10 = edge(i, x1, y0), e01 = edge(i, x0, y1), e11 = edge(i, x1, y1);
+				long long e_min = std::min(std::min(e00, e10), std::min(e01, e11));
+				long long e_max = std::max(std::max(e00, e10), std::max(e01, e11));
+				if (e_max < 0) bReject = true;
+				if (e_min < 0) bAccept = false;
+			}
+			if (bReject) continue;
+
+			if (bAccept)
+			{
+				for (int y = y0; y <= y1; y++)
+					fnSpan(y, x0, x1);
+				continue;
+			}
+
+			// ָǣ󸲸
+			for (int y = y0; y <= y1; y++)
+			{
+				long long lo, hi;
+				tri.GetSpan(x0, x1, y * one + half, half, &lo, &hi);
+				if (lo <= hi)
+					fnSpan(y, (int)lo, (int)hi);
+			}
+		}
+	}
+}
+
+/**
+ * @brief ȡزĲλ
+ * @param[in] n : 2  4
+ * @return Ϊĵ x, y ƫƣλΪ 1/16 
+ * @note 볣 GPU ı׼λͬ2 ڶԽϣ4 Ϊת
+ *			ˮƽֱϸ 4 ͬλãԽӽˮƽֱıҲ 4 ɡ
+*/
+inline const int* GetSamplePattern(int n)
+{
+	static const int pPattern2[4] = { 4,4,-4,-4 };
+	static const int pPattern4[8] = { -2,-6,6,-2,-6,2,2,6 };
+	return n == 4 ? pPattern4 : pPattern2;
+}
+
+/**
+ * @brief زθǵ
+ * @param[in] pTarget : Ŀ֡壨ȷƷΧͲ
+ * @param[in] p0, p1, p2 : ζ㣨Ļ꣩
+ * @param[in] fnSpan : ص void(int y, int x0, int x1, const int* pLo, const int* pHi)
+ *					   pLo[s], pHi[s] Ϊ s ǵ䣨ûиʱ pLo[s] > pHi[s][x0, x1] ǵĲ
+ * @note  RasterizeTriangleSpans ʹͬıߺϹֻǰѲĻɸλã GetSamplePattern
+ *			ÿз϶ظÿֻ谴һ䣬ֿ顣
+ *			÷ [x0, x1] еֻһɫд븲ĲǶزȳʡĵط
+*/
+template <typename SpanFunc>
+inline void RasterizeTriangleSamples(FrameBuffer* pTarget, Point2D p0, Point2D p1, Point2D p2, SpanFunc fnSpan)
+{
+	const long long one = 1LL << RASTER_SUBPIXEL_BITS;
+	const long long half = one / 2;
+	const int n = pTarget->GetSamplesNum();
+
+	TriangleEdges tri;
+	if (!tri.Setup(p0, p1, p2)) return;
+
+	// ƫƣԼƫƵֵطΧ
+	const int* pPattern = GetSamplePattern(n);
+	long long ox[4], oy[4], r = 0;
+	for (int s = 0; s < n; s++)
+	{
+		ox[s] = half + pPattern[s * 2] * one / 16;
+		oy[s] = half + pPattern[s * 2 + 1] * one / 16;
+		r = std::max(r, (long long)std::max(abs(pPattern[s * 2]), abs(pPattern[s * 2 + 1])) * one / 16);
+	}
+
+	int px0 = (int)std::max(CeilDiv(tri.min_x - half - r, one), 0LL);
+	int px1 = (int)std::min(FloorDiv(tri.max_x - half + r, one), (long long)pTarget->GetWidth() - 1);
+	int py0 = (int)std::max(CeilDiv(tri.min_y - half - r, one), 0LL);
+	int py1 = (int)std::min(FloorDiv(tri.max_y - half + r, one), (long long)pTarget->GetHeight() - 1);
+	if (px0 > px1 || py0 > py1) return;
+
+	int pLo[4], pHi[4];
+	for (int y = py0; y <= py1; y++)
+	{
+		int x0 = px1 + 1, x1 = px0 - 1;
+		for (int s = 0; s < n; s++)
+		{
+			long long lo, hi;
+			tri.GetSpan(px0, px1, y * one + oy[s], ox[s], &lo, &hi);
+			pLo[s] = (int)lo;
+			pHi[s] = (int)hi;
+			if (lo <= hi)
+			{
+				x0 = std::min(x0, (int)lo);
+				x1 = std::max(x1, (int)hi);
+			}
+		}
+		if (x0 <= x1)
+			fnSpan(y, x0, x1, pLo, pHi);
+	}
+}
+
+/**
+ * @brief бθǵĲģĲ
+ * @param[in] n : 
+ * @param[in] x, y : λ
+ * @param[in] pLo, pHi : ĸ䣨 RasterizeTriangleSamples
+ * @param[out] pCentroid : رǲģĻ꣩ȫʱ
+ * @return ûвʱ false
+ * @note ֻ˲ֲأĿ⣬ɫ൱ƣϸСܴ
+ *			ǵĲһڣɫ GPU Ĳֵͬ
+*/
+inline bool GetCoveredCentroid(int n, int x, int y, const int* pLo, const int* pHi, Point2D* pCentroid)
+{
+	const int* pPattern = GetSamplePattern(n);
+	int num = 0, sx = 0, sy = 0;
+	for (int s = 0; s < n; s++)
+	{
+		if (x >= pLo[s] && x <= pHi[s])
+		{
+			num++;
+			sx += pPattern[s * 2];
+			sy += pPattern[s * 2 + 1];
+		}
+	}
+	if (num == 0) return false;
+	*pCentroid = { x + 0.5 + sx / (16.0 * num),y + 0.5 + sy / (16.0 * num) };
+	return true;
+}
+
+/**
+ * @brief һصɫд븲Ĳ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] x, y : λ
+ * @param[in] c : Դʽɫ
+ * @param[in] pLo, pHi : ĸ䣨 RasterizeTriangleSamples
+*/
+inline void StoreSamples(FrameBuffer* pTarget, int x, int y, DWORD c, const int* pLo, const int* pHi)
+{
+	for (int s = 0; s < pTarget->GetSamplesNum(); s++)
+	{
+		if (x >= pLo[s] && x <= pHi[s])
+			pTarget->GetSampleLine(s, y)[x] = c;
+	}
+}
+
+/**
+ * @brief դ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] p0, p1, p2 : ζ㣨Ļ꣩
+ * @param[in] c : ɫ
+ * @note زʱÿĸֱ䵽ԵĲƽ
+ * @see RasterizeTriangleSpans, RasterizeTriangleSamples
+*/
+inline void RasterizeTriangle(FrameBuffer* pTarget, Point2D p0, Point2D p1, Point2D p2, Color c)
+{
+	if (c < 0) return;
+
+	DWORD dw = BGR((COLORREF)c);
+	if (pTarget->GetSamplesNum() > 1)
+	{
+		RasterizeTriangleSamples(pTarget, p0, p1, p2, [&](int y, int, int, const int* pLo, const int* pHi) {
+			for (int s = 0; s < pTarget->GetSamplesNum(); s++)
+			{
+				if (pLo[s] <= pHi[s])
+					FillSpan(pTarget->GetSampleLine(s, y) + pLo[s], pHi[s] - pLo[s] + 1, dw);
+			}
+		});
+		return;
+	}
+
+	RasterizeTriangleSpans(pTarget, p0, p1, p2, [&](int y, int x0, int x1) {
+		FillSpan(pTarget->GetLine(y) + x0, x1 - x0 + 1, dw);
+	});
+}
+
+/**
+ * @brief ĻռԱ仯ԣƽ淽 v(x,y) = a + dx * x + dy * y
+*/
+struct AttributePlane
+{
+	double a;	/** @brief ԭ㴦ֵ */
+	double dx;	/** @brief x ı仯 */
+	double dy;	/** @brief y ı仯 */
+
+	/**
+	 * @brief  (x,y) ֵ
+	*/
+	double At(double x, double y) const
+	{
+		return a + dx * x + dy * y;
+	}
+};
+
+/**
+ * @brief ƽ
+ * @param[in] p0, p1, p2 : ζ㣨Ļܹ꣩
+ * @param[in] v0, v1, v2 : 㴦ֵ
+*/
+inline AttributePlane GetAttributePlane(Point2D p0, Point2D p1, Point2D p2, double v0, double v1, double v2)
+{
+	double det = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+	double d1 = v1 - v0, d2 = v2 - v0;
+	AttributePlane plane;
+	plane.dx = (d1 * (p2.y - p0.y) - d2 * (p1.y - p0.y)) / det;
+	plane.dy = (d2 * (p1.x - p0.x) - d1 * (p2.x - p0.x)) / det;
+	plane.a = v0 - plane.dx * p0.x - plane.dy * p0.y;
+	return plane;
+}
+
+/**
+ * @brief դΣɫԲֵGouraud ɫ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] p0, p1, p2 : ζ㣨Ļ꣩
+ * @param[in] c0, c1, c2 : ɫ
+ * @note ǹ뵥ɫ RasterizeTriangle ȫͬÿɫĻϵһƽ棬
+ *			 16 λСĶۼӡزʱÿֻһɫ GetCoveredCentroid
+ *			д븲ǸصĲ
+*/
+inline void RasterizeTriangle(FrameBuffer* pTarget, Point2D p0, Point2D p1, Point2D p2, Color c0, Color c1, Color c2)
+{
+	if (c0 < 0 || c1 < 0 || c2 < 0) return;
+	if (c0 == c1 && c1 == c2)
+	{
+		RasterizeTriangle(pTarget, p0, p1, p2, c0);
+		return;
+	}
+
+	double det = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+	if (det == 0) return;
+
+	// ƽ棬Դʽ 0x00RRGGBB ˳
+	AttributePlane plane[3] = {
+		GetAttributePlane(p0, p1, p2, GetRValue(c0), GetRValue(c1), GetRValue(c2)),
+		GetAttributePlane(p0, p1, p2, GetGValue(c0), GetGValue(c1), GetGValue(c2)),
+		GetAttributePlane(p0, p1, p2, GetBValue(c0), GetBValue(c1), GetBValue(c2))
+	};
+
+	const double fixed = 65536;
+	int step[3];
+	for (int i = 0; i < 3; i++)
+		step[i] = (int)llround(plane[i].dx * fixed);
+
+	//  (cx, cy) ʼؼ [x0, x1] ڵɫ fnStore(x, c) д
+	auto shade = [&](double cx, double cy, int x0, int x1, auto fnStore) {
+		int acc[3];
+		for (int i = 0; i < 3; i++)
+			acc[i] = (int)llround(plane[i].At(cx, cy) * fixed);
+
+		for (int x = x0; x <= x1; x++)
+		{
+			// Ŀ΢ΣҪضϵ [0,255]
+			int r = std::min(std::max(acc[0] >> 16, 0), 255);
+			int g = std::min(std::max(acc[1] >> 16, 0), 255);
+			int b = std::min(std::max(acc[2] >> 16, 0), 255);
+			fnStore(x, (DWORD)((r << 16) | (g << 8) | b));
+			acc[0] += step[0];
+			acc[1] += step[1];
+			acc[2] += step[2];
+		}
+	};
+
+	if (pTarget->GetSamplesNum() > 1)
+	{
+		RasterizeTriangleSamples(pTarget, p0, p1, p2, [&](int y, int x0, int x1, const int* pLo, const int* pHi) {
+			for (int x = x0; x <= x1; x++)
+			{
+				Point2D c;
+				if (GetCoveredCentroid(pTarget->GetSamplesNum(), x, y, pLo, pHi, &c))
+					shade(c.x, c.y, x, x, [&](int x, DWORD c) { StoreSamples(pTarget, x, y, c, pLo, pHi); });
+			}
+		});
+		return;
+	}
+
+	RasterizeTriangleSpans(pTarget, p0, p1, p2, [&](int y, int x0, int x1) {
+		DWORD* p = pTarget->GetLine(y);
+		shade(x0 + 0.5, y + 0.5, x0, x1, [&](int x, DWORD c) { p[x] = c; });
+	});
+}
+
+/**
+ * @brief դΣ͸У + mipmap
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pPoints : 㣨Ļ꣩
+ * @param[in] pCoords : ꣨u, v ѳ͸Ȩ q
+ * @param[in] pColors : ɫɫڶֵɫΪ NULL ʾֱʹɫ
+ * @param[in] pTexture : 
+ * @note u, v, q ĻռԵģزֵ u/q, v/q 
+ *			mipmap 㰴ÿشĻĵΪλѡȡ˫Թˡ
+ *			زʱÿֻһ GetCoveredCentroidд븲ǸصĲ
+*/
+inline void RasterizeTexturedTriangle(FrameBuffer* pTarget, const Point2D* pPoints, const TexCoord* pCoords, const Color* pColors, const Texture* pTexture)
+{
+	if (!pTexture || pTexture->GetLevelsNum() <= 0) return;
+	if (pColors && (pColors[0] < 0 || pColors[1] < 0 || pColors[2] < 0)) pColors = NULL;
+
+	const Point2D& p0 = pPoints[0];
+	const Point2D& p1 = pPoints[1];
+	const Point2D& p2 = pPoints[2];
+	double det = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+	if (det == 0) return;
+
+	AttributePlane pu = GetAttributePlane(p0, p1, p2, pCoords[0].u, pCoords[1].u, pCoords[2].u);
+	AttributePlane pv = GetAttributePlane(p0, p1, p2, pCoords[0].v, pCoords[1].v, pCoords[2].v);
+	AttributePlane pq = GetAttributePlane(p0, p1, p2, pCoords[0].q, pCoords[1].q, pCoords[2].q);
+
+	AttributePlane pc[3] = {};
+	if (pColors)
+	{
+		pc[0] = GetAttributePlane(p0, p1, p2, GetRValue(pColors[0]), GetRValue(pColors[1]), GetRValue(pColors[2]));
+		pc[1] = GetAttributePlane(p0, p1, p2, GetGValue(pColors[0]), GetGValue(pColors[1]), GetGValue(pColors[2]));
+		pc[2] = GetAttributePlane(p0, p1, p2, GetBValue(pColors[0]), GetBValue(pColors[1]), GetBValue(pColors[2]));
+	}
+
+	const double tw = pTexture->GetWidth(), th = pTexture->GetHeight();
+	const int nMaxLevel = pTexture->GetLevelsNum() - 1;
+
+	//  (cx, cy) ʼز [x0, x1] ڵ fnStore(x, c) д
+	auto shade = [&](double cx, double cy, int x0, int x1, auto fnStore) {
+		double U = pu.At(cx, cy), V = pv.At(cx, cy), Q = pq.At(cx, cy);
+		double C[3] = { pc[0].At(cx, cy),pc[1].At(cx, cy),pc[2].At(cx, cy) };
+
+		for (int x = x0; x <= x1; x++)
+		{
+			if (Q > 0)
+			{
+				double iq = 1 / Q;
+				double u = U * iq, v = V * iq;
+
+				// ؿռеĵd(U/Q) = (dU - u * dQ) / Q
+				double dudx = (pu.dx - u * pq.dx) * iq * tw, dvdx = (pv.dx - v * pq.dx) * iq * th;
+				double dudy = (pu.dy - u * pq.dy) * iq * tw, dvdy = (pv.dy - v * pq.dy) * iq * th;
+				double rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+				int level = rho2 > 1 ? std::min((ilogb(rho2) + 1) >> 1, nMaxLevel) : 0;
+
+				DWORD c = pTexture->Sample(u, v, level);
+				if (pColors)
+				{
+					int r = std::min(std::max((int)C[0], 0), 255) + 1;
+					int g = std::min(std::max((int)C[1], 0), 255) + 1;
+					int b = std::min(std::max((int)C[2], 0), 255) + 1;
+					c = ((((c >> 16) & 0xFF) * r >> 8) << 16) | ((((c >> 8) & 0xFF) * g >> 8) << 8) | ((c & 0xFF) * b >> 8);
+				}
+				fnStore(x, c);
+			}
+			U += pu.dx;
+			V += pv.dx;
+			Q += pq.dx;
+			C[0] += pc[0].dx;
+			C[1] += pc[1].dx;
+			C[2] += pc[2].dx;
+		}
+	};
+
+	if (pTarget->GetSamplesNum() > 1)
+	{
+		RasterizeTriangleSamples(pTarget, p0, p1, p2, [&](int y, int x0, int x1, const int* pLo, const int* pHi) {
+			for (int x = x0; x <= x1; x++)
+			{
+				Point2D c;
+				if (GetCoveredCentroid(pTarget->GetSamplesNum(), x, y, pLo, pHi, &c))
+					shade(c.x, c.y, x, x, [&](int x, DWORD c) { StoreSamples(pTarget, x, y, c, pLo, pHi); });
+			}
+		});
+		return;
+	}
+
+	RasterizeTriangleSpans(pTarget, p0, p1, p2, [&](int y, int x0, int x1) {
+		DWORD* p = pTarget->GetLine(y);
+		shade(x0 + 0.5, y + 0.5, x0, x1, [&](int x, DWORD c) { p[x] = c; });
+	});
+}
+
+/**
+ * @brief ж 2D ǷΪ͹
+*/
+inline bool IsConvexPolygon2D(const Point2D* pPoints, int num)
+{
+	int sign = 0;
+	for (int i = 0; i < num; i++)
+	{
+		const Point2D& a = pPoints[i];
+		const Point2D& b = pPoints[(i + 1) % num];
+		const Point2D& c = pPoints[(i + 2) % num];
+		double cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+		if (cross != 0)
+		{
+			int s = cross > 0 ? 1 : -1;
+			if (sign == 0) sign = s;
+			else if (s != sign) return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief դ͹
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pPoints : ζ㣨Ļ꣩
+ * @param[in] num : 
+ * @param[in] c : ɫ
+ * @note ԵһΪĲΪȣڲĹͬѭϹ򣬲ظ
+*/
+inline void RasterizeConvexPolygon(FrameBuffer* pTarget, const Point2D* pPoints, int num, Color c)
+{
+	for (int i = 1; i + 1 < num; i++)
+	{
+		RasterizeTriangle(pTarget, pPoints[0], pPoints[i], pPoints[i + 1], c);
+	}
+}
+
+/**
+ * @brief դ͹Σɫڶֵ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pPoints : ζ㣨Ļ꣩
+ * @param[in] pColors : ɫ
+ * @param[in] num : 
+*/
+inline void RasterizeConvexPolygon(FrameBuffer* pTarget, const Point2D* pPoints, const Color* pColors, int num)
+{
+	for (int i = 1; i + 1 < num; i++)
+	{
+		RasterizeTriangle(pTarget, pPoints[0], pPoints[i], pPoints[i + 1], pColors[0], pColors[i], pColors[i + 1]);
+	}
+}
+
+/**
+ * @brief  3D  NDC  תΪ 3D Ļ
+ * @param[in] p : ԭ
+ * @param[in] zoom : 
+ * @param[in] w : Ļ
+ * @param[in] h : Ļ߶
+ * @return תĻ
+*/
+inline Point3D ConvertNDC3DToScreenPoint(Point3D p, Zoom zoom, int w, int h)
+{
+	return { (p.x * zoom.x + 1) * w,(1 - p.y * zoom.y) * h,p.z };
+}
+
+/**
+ * @brief ĻתΪ NDC ꣨ConvertNDC3DToScreenPoint 任
+ * @param[in] p : Ļ
+ * @param[in] zoom : 
+ * @param[in] w : Ļ
+ * @param[in] h : Ļ߶
+ * @return  NDC  x, y
+*/
+inline Point2D ConvertScreenPointToNDC2D(Point2D p, Zoom zoom, int w, int h)
+{
+	return { (p.x / w - 1) / zoom.x,(1 - p.y / h) / zoom.y };
+}
+
+/**
+ * @brief ȾеĶ
+*/
+struct RenderVertex
+{
+	Point3D p;		/** @brief NDC  */
+	Color color;	/** @brief ɫΪʾʹͼԪɫ */
+	TexCoord uv;	/** @brief ꣨u, v, q ѳ 1/w */
+};
+
+/**
+ * @brief ֡ϻһͼԪ㡢߶λΣ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pVertices : 飨NDC ꣩
+ * @param[in] num : 
+ * @param[in] color : ͼԪɫΪʾ䣨ʱȻ䣩
+ * @param[in] pTexture : Ϊ NULL ʾ
+ * @param[in] offset_x : ͼ x ƫ
+ * @param[in] offset_y : ͼ y ƫ
+ * @param[in] zoom : ͼ
+ * @param[in] grid : ɫΪʾ
+ * @note ж㶼ɫʱκ͹εɫڶֵʹöɫƽֵ䡣
+ *			͹ʹ͸Уӳ䡣
+*/
+inline void DrawPrimitive(FrameBuffer* pTarget, const RenderVertex* pVertices, int num, Color color, const Texture* pTexture,
+	int offset_x = 0, int offset_y = 0, Zoom zoom = { 1,1 }, Color grid = -1)
+{
+	if (num <= 0) return;
+
+	// ɫж㶼ɫʱŲֵ
+	Color pColors[POLYGON_MAX_SIDES];
+	bool bGouraud = false;
+	for (int j = 0; j < num; j++)
+		if (pVertices[j].color >= 0)
+			bGouraud = true;
+	int sum[3] = { 0 };
+	for (int j = 0; j < num && bGouraud; j++)
+	{
+		pColors[j] = pVertices[j].color >= 0 ? pVertices[j].color : color;
+		if (pColors[j] < 0)
+		{
+			bGouraud = false;
+			break;
+		}
+		sum[0] += GetRValue(pColors[j]);
+		sum[1] += GetGValue(pColors[j]);
+		sum[2] += GetBValue(pColors[j]);
+	}
+	if (bGouraud)
+	{
+		color = RGB(sum[0] / num, sum[1] / num, sum[2] / num);
+	}
+
+	Point2D pScreen[POLYGON_MAX_SIDES];
+	POINT pPoints[POLYGON_MAX_SIDES];
+	for (int j = 0; j < num; j++)
+	{
+		Point3D pp = ConvertNDC3DToScreenPoint(pVertices[j].p, zoom, pTarget->GetWidth(), pTarget->GetHeight());
+		pScreen[j] = { pp.x + offset_x,pp.y + offset_y };
+		pPoints[j] = { (long)(pp.x) + offset_x,(long)(pp.y) + offset_y };
+	}
+
+	// ͹ΣɫԶɫɫûʱֱʹɫ
+	bool bTextured = pTexture && pTexture->GetLevelsNum() > 0 && num >= 3 && IsConvexPolygon2D(pScreen, num);
+	if (bTextured)
+	{
+		bool bModulate = bGouraud || color >= 0;
+		for (int j = 0; j < num && !bGouraud; j++)
+			pColors[j] = color;
+
+		for (int i = 1; i + 1 < num; i++)
+		{
+			Point2D tri[3] = { pScreen[0],pScreen[i],pScreen[i + 1] };
+			TexCoord uv[3] = { pVertices[0].uv,pVertices[i].uv,pVertices[i + 1].uv };
+			Color col[3] = { pColors[0],pColors[i],pColors[i + 1] };
+			RasterizeTexturedTriangle(pTarget, tri, uv, bModulate ? col : NULL, pTexture);
+		}
+	}
+	else if (color >= 0)
+	{
+		if (num == 1)
+		{
+			DrawPixel(pTarget, pPoints[0].x, pPoints[0].y, color);
+			return;
+		}
+		else if (num == 2)
+		{
+			DrawLine(pTarget, pPoints[0].x, pPoints[0].y, pPoints[1].x, pPoints[1].y, grid >= 0 ? grid : color);
+			return;
+		}
+
+		// κ͹ؾȵĹդʹɨ
+		if (bGouraud && num == 3)
+			RasterizeTriangle(pTarget, pScreen[0], pScreen[1], pScreen[2], pColors[0], pColors[1], pColors[2]);
+		else if (num == 3)
+			RasterizeTriangle(pTarget, pScreen[0], pScreen[1], pScreen[2], color);
+		else if (IsConvexPolygon2D(pScreen, num))
+		{
+			if (bGouraud)
+				RasterizeConvexPolygon(pTarget, pScreen, pColors, num);
+			else
+				RasterizeConvexPolygon(pTarget, pScreen, num, color);
+		}
+		else
+			FillPolygon2D(pTarget, pPoints, num, color);
+	}
+
+	if (grid >= 0 && num > 1)
+	{
+		DrawPolygon2D(pTarget, pPoints, num, grid);
+	}
+}
+
+/**
+ * @brief ֡ϻ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] p : 3D ΣNDC ꣩
+ * @param[in] offset_x : ͼ x ƫ
+ * @param[in] offset_y : ͼ y ƫ
+ * @param[in] zoom : ͼ
+ * @param[in] grid : ɫΪʾ
+ * @note ЧƵ EasyX 豸 DrawFillPolygon ͬ EasyX Ļͼ״̬Զ̵߳á
+ * @see DrawPrimitive
+*/
+inline void DrawFillPolygon(FrameBuffer* pTarget, Polygon3D p, int offset_x = 0, int offset_y = 0, Zoom zoom = { 1,1 }, Color grid = -1)
+{
+	RenderVertex pVertices[POLYGON_MAX_SIDES];
+	for (int j = 0; j < p.nPointsNum; j++)
+	{
+		pVertices[j].p = p.pPoints[j];
+		pVertices[j].color = p.pColors[j];
+		pVertices[j].uv = p.pTexCoords ? p.pTexCoords[j] : TexCoord{ 0,0,1 };
+	}
+	DrawPrimitive(pTarget, pVertices, p.nPointsNum, p.color, p.pTexCoords ? p.pTexture : NULL, offset_x, offset_y, zoom, grid);
+}
+
+/**
+ * @brief 
+ * @param[in] p : 3D 
+ * @param[in] offset_x : ͼ x ƫ
+ * @param[in] offset_y : ͼ y ƫ
+ * @param[in] zoom : ͼ
+ * @param[in] grid : ɫΪʾ
+ * @attention ֻȡε x,y ƵĻ
+*/
+inline void DrawFillPolygon(Polygon3D p, int offset_x = 0, int offset_y = 0, Zoom zoom = { 1,1 }, Color grid = -1)
+{
+	FrameBuffer fb;
+	fb.AttachDrawingDevice();
+	DrawFillPolygon(&fb, p, offset_x, offset_y, zoom, grid);
+}
+
+/**
+ * @brief Դʽɫȣ0~255
+*/
+inline int GetLuma(DWORD c)
+{
+	return (int)((((c >> 16) & 0xFF) * 77 + ((c >> 8) & 0xFF) * 150 + (c & 0xFF) * 29) >> 8);
+}
+
+/**
+ * @brief ֡ FXAA ĺ
+ * @param[in, out] pTarget : Ŀ֡
+ * @param[in] pScratch : ʱ֡壨ᱻ·ΪĿͬСظʹͬһԱÿ֡ڴ
+ * @note ȰͼƵʱ壬ȴÿؿеֽֻ֮ʱ塢ֻдĿ꣬
+ *			Խ봦˳޹ءÿأ
+ *			1. ҵȶԱȶȵֵ FXAA_EDGE_THRESHOLD_SHIFTFXAA_EDGE_THRESHOLD_MINֱ󲿷
+ *			2.  3x3 ĶײжϱԵˮƽֱģȡԵһݶȽϴأ
+ *			3. رԵ FXAA_SEARCH_STEPS ҵԵ˵㣬Ͻ˵ľ
+ *			   ƽľݱҲܵõĹɣ
+ *			4. ٰƽȵĲػϸСĹء
+ *			нϴĻԵһԻϡ
+ *			һȦز
+*/
+inline void ApplyFXAA(FrameBuffer* pTarget, FrameBuffer* pScratch)
+{
+	const int w = pTarget->GetWidth(), h = pTarget->GetHeight();
+	if (w < 3 || h < 3 || !pScratch->Create(w, h)) return;
+	pScratch->SetSamplesNum(1);
+
+	for (int y = 0; y < h; y++)
+	{
+		const DWORD* pIn = pTarget->GetLine(y);
+		DWORD* pOut = pScratch->GetLine(y);
+		int x = 0;
+#ifdef HD3D_SSE2
+		// ÿȨصĳ˻ͶС 65536 32 λͨĵ 16 λ
+		const __m128i mask = _mm_set1_epi32(0xFF), rgb = _mm_set1_epi32(0xFFFFFF);
+		for (; x + 4 <= w; x += 4)
+		{
+			__m128i c = _mm_loadu_si128((const __m128i*)(pIn + x));
+			__m128i l = _mm_add_epi32(_mm_add_epi32(
+				_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(c, 16), mask), _mm_set1_epi32(77)),
+				_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(c, 8), mask), _mm_set1_epi32(150))),
+				_mm_mullo_epi16(_mm_and_si128(c, mask), _mm_set1_epi32(29)));
+			_mm_storeu_si128((__m128i*)(pOut + x), _mm_or_si128(_mm_and_si128(c, rgb), _mm_slli_epi32(_mm_srli_epi32(l, 8), 24)));
+		}
+#endif
+		for (; x < w; x++)
+			pOut[x] = (pIn[x] & 0xFFFFFF) | ((DWORD)GetLuma(pIn[x]) << 24);
+	}
+
+	auto luma = [&](int x, int y) {
+		return (int)(pScratch->GetLine(y)[x] >> 24);
+	};
+
+	for (int y = 1; y < h - 1; y++)
+	{
+		const DWORD* pUp = pScratch->GetLine(y - 1);
+		const DWORD* pMid = pScratch->GetLine(y);
+		const DWORD* pDown = pScratch->GetLine(y + 1);
+		DWORD* pOut = pTarget->GetLine(y);
+		for (int x = 1; x < w - 1; x++)
+		{
+#ifdef HD3D_SSE2
+			// ÿμ 4 صĶԱȶȣֵʱ 32 λͨĵ 8 λ 16 λıȽϣ
+			if (x + 4 <= w - 1)
+			{
+				__m128i m = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(pMid + x)), 24);
+				__m128i n = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(pUp + x)), 24);
+				__m128i s = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(pDown + x)), 24);
+				__m128i l = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(pMid + x - 1)), 24);
+				__m128i r = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(pMid + x + 1)), 24);
+				__m128i vMax = _mm_max_epi16(_mm_max_epi16(_mm_max_epi16(n, s), _mm_max_epi16(l, r)), m);
+				__m128i vMin = _mm_min_epi16(_mm_min_epi16(_mm_min_epi16(n, s), _mm_min_epi16(l, r)), m);
+				__m128i vThreshold = _mm_max_epi16(_mm_srli_epi32(vMax, FXAA_EDGE_THRESHOLD_SHIFT), _mm_set1_epi32(FXAA_EDGE_THRESHOLD_MIN));
+				if (_mm_movemask_epi8(_mm_cmplt_epi32(_mm_sub_epi32(vMax, vMin), vThreshold)) == 0xFFFF)
+				{
+					x += 3;
+					continue;
+				}
+			}
+#endif
+			int lM = pMid[x] >> 24, lN = pUp[x] >> 24, lS = pDown[x] >> 24, lW = pMid[x - 1] >> 24, lE = pMid[x + 1] >> 24;
+			int lMax = std::max(std::max(std::max(lN, lS), std::max(lW, lE)), lM);
+			int lMin = std::min(std::min(std::min(lN, lS), std::min(lW, lE)), lM);
+			int range = lMax - lMin;
+			if (range < std::max(FXAA_EDGE_THRESHOLD_MIN, lMax >> FXAA_EDGE_THRESHOLD_SHIFT))
+				continue;
+
+			int lNW = pUp[x - 1] >> 24, lNE = pUp[x + 1] >> 24, lSW = pDown[x - 1] >> 24, lSE = pDown[x + 1] >> 24;
+
+			// ԵֱĶײִ˵ˮƽԵ
+			int edgeH = abs(lNW - 2 * lW + lSW) + 2 * abs(lN - 2 * lM + lS) + abs(lNE - 2 * lE + lSE);
+			int edgeV = abs(lNW - 2 * lN + lNE) + 2 * abs(lW - 2 * lM + lE) + abs(lSW - 2 * lS + lSE);
+			bool bHorz = edgeH >= edgeV;
+
+			// ԵһأݶȽϴһࣩ
+			int l1 = bHorz ? lN : lW, l2 = bHorz ? lS : lE;
+			bool bNeg = abs(l1 - lM) >= abs(l2 - lM);
+			int lSide = bNeg ? l1 : l2;
+			int side_x = bHorz ? 0 : (bNeg ? -1 : 1), side_y = bHorz ? (bNeg ? -1 : 1) : 0;
+			int dir_x = bHorz ? 1 : 0, dir_y = bHorz ? 0 : 1;
+			double lEdge = (lM + lSide) * 0.5;
+			double gradient = abs(lSide - lM) * 0.25;
+
+			// رԵҶ˵㣺Եȵƽֵƫ lEdge ݶȵ 1/4 ʱΪԵ
+			int pDist[2] = { FXAA_SEARCH_STEPS + 1,FXAA_SEARCH_STEPS + 1 };
+			double pEnd[2] = { lEdge,lEdge };
+			for (int k = 0; k < 2; k++)
+			{
+				int sign = k == 0 ? -1 : 1;
+				for (int d = 1; d <= FXAA_SEARCH_STEPS; d++)
+				{
+					int px = x + sign * d * dir_x, py = y + sign * d * dir_y;
+					if (px < 0 || py < 0 || px >= w || py >= h || px + side_x < 0 || py + side_y < 0
+						|| px + side_x >= w || py + side_y >= h)
+					{
+						break;
+					}
+					double l = (luma(px, py) + luma(px + side_x, py + side_y)) * 0.5;
+					if (fabs(l - lEdge) >= gradient)
+					{
+						pDist[k] = d;
+						pEnd[k] = l;
+						break;
+					}
+				}
+			}
+
+			// ϽĶ˵ԽԽࣻ˵㴦ȵı仯һʱ˵ڱԵһ࣬
+			int k = pDist[0] < pDist[1] ? 0 : 1;
+			double blendEdge = 0;
+			if ((pEnd[k] - lEdge < 0) != (lM - lEdge < 0))
+				blendEdge = 0.5 - (double)pDist[k] / (pDist[0] + pDist[1]);
+
+			// ػ
+			double lAvg = (2 * (lN + lS + lW + lE) + lNW + lNE + lSW + lSE) / 12.0;
+			double sub = std::min(fabs(lAvg - lM) / range, 1.0);
+			sub = (3 - 2 * sub) * sub * sub;
+			double blendSub = sub * sub * 0.75;
+
+			int t = (int)(std::max(blendEdge, blendSub) * 256);
+			if (t <= 0) continue;
+
+			DWORD c0 = pMid[x] & 0xFFFFFF, c1 = pScratch->GetLine(y + side_y)[x + side_x] & 0xFFFFFF;
+			int r0 = (c0 >> 16) & 0xFF, g0 = (c0 >> 8) & 0xFF, b0 = c0 & 0xFF;
+			int r = r0 + ((((int)(c1 >> 16) & 0xFF) - r0) * t >> 8);
+			int g = g0 + ((((int)(c1 >> 8) & 0xFF) - g0) * t >> 8);
+			int b = b0 + ((((int)c1 & 0xFF) - b0) * t >> 8);
+			pOut[x] = (DWORD)((r << 16) | (g << 8) | b);
+		}
+	}
+}
+
+/**
+ * @brief һ֡ͼŵһ֡
+ * @param[in] pSrc : Դ֡
+ * @param[out] pDst : Ŀ֡壬߲ܹ
+ * @param[in] bBilinear : Ƿ˫Բֵȡ
+ * @note ߵĶ룬Ŀ (x,y) ӦԴͼе ((x+0.5)*sw/dw-0.5, (y+0.5)*sh/dh-0.5) 16 λСĶۼӡ
+ *			˫ԲֵԴͼÿһˮƽֵһΣһͬʱֵ
+ *			ŴʱһڵĶĿйãֱУSSE2 ÿδ 4 ء
+ *			Ŀ갴 256 ؿˮƽֵĽջϣڴ档
+*/
+inline void ResampleFrameBuffer(const FrameBuffer* pSrc, FrameBuffer* pDst, bool bBilinear)
+{
+	const int sw = pSrc->GetWidth(), sh = pSrc->GetHeight(), dw = pDst->GetWidth(), dh = pDst->GetHeight();
+	if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+
+	const long long step_x = ((long long)sw << 16) / dw, step_y = ((long long)sh << 16) / dh;
+	const long long start_x = step_x / 2 - 32768, start_y = step_y / 2 - 32768;
+
+	if (!bBilinear)
+	{
+		for (int y = 0; y < dh; y++)
+		{
+			DWORD* pOut = pDst->GetLine(y);
+			const DWORD* pIn = pSrc->GetLine(std::min(std::max((int)((start_y + step_y * y + 32768) >> 16), 0), sh - 1));
+			long long u = start_x + 32768;
+			for (int x = 0; x < dw; x++, u += step_x)
+				pOut[x] = pIn[std::min(std::max((int)(u >> 16), 0), sw - 1)];
+		}
+		return;
+	}
+
+	// ɫ 0~256 Ȩ t ֵ
+	auto lerp = [](DWORD a, DWORD b, DWORD t) {
+		DWORD rb = ((a & 0xFF00FF) * (256 - t) + (b & 0xFF00FF) * t) >> 8;
+		DWORD g = ((a & 0xFF00) * (256 - t) + (b & 0xFF00) * t) >> 8;
+		return (rb & 0xFF00FF) | (g & 0xFF00);
+	};
+
+	const int nStrip = 256;
+	DWORD pRowBuffers[2][nStrip];
+	int pColumns[nStrip][2];
+	DWORD pWeights[nStrip];
+	for (int sx = 0; sx < dw; sx += nStrip)
+	{
+		int n = std::min(nStrip, dw - sx);
+
+		// ÿһжӦԴغȨ
+		long long u = start_x + step_x * sx;
+		for (int x = 0; x < n; x++, u += step_x)
+		{
+			long long uc = std::min(std::max(u, 0LL), ((long long)sw - 1) << 16);
+			pColumns[x][0] = (int)(uc >> 16);
+			pColumns[x][1] = std::min(pColumns[x][0] + 1, sw - 1);
+			pWeights[x] = (DWORD)(uc >> 8) & 0xFF;
+		}
+
+		// Դͼ k ڱˮƽֵĽ
+		auto expand = [&](int k, DWORD* pRow) {
+			const DWORD* pIn = pSrc->GetLine(k);
+			for (int x = 0; x < n; x++)
+				pRow[x] = lerp(pIn[pColumns[x][0]], pIn[pColumns[x][1]], pWeights[x]);
+		};
+
+		DWORD* pRow0 = pRowBuffers[0];
+		DWORD* pRow1 = pRowBuffers[1];
+		int nCached = -2;	// pRow0pRow1 ǵ nCachednCached + 1 Уѽضϵͼڣ
+		for (int y = 0; y < dh; y++)
+		{
+			long long v = std::min(std::max(start_y + step_y * y, 0LL), ((long long)sh - 1) << 16);
+			int y0 = (int)(v >> 16);
+			if (y0 != nCached)
+			{
+				if (y0 == nCached + 1)
+					std::swap(pRow0, pRow1);
+				else
+					expand(y0, pRow0);
+				expand(std::min(y0 + 1, sh - 1), pRow1);
+				nCached = y0;
+			}
+
+			DWORD ty = (DWORD)(v >> 8) & 0xFF;
+			DWORD* pOut = pDst->GetLine(y) + sx;
+			if (ty == 0)
+			{
+				memcpy(pOut, pRow0, sizeof(DWORD) * n);
+				continue;
+			}
+
+			int x = 0;
+#ifdef HD3D_SSE2
+			// չΪ 16 λȨˣa * (256 - t) + b * t  65280
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i wa = _mm_set1_epi16((short)(256 - ty)), wb = _mm_set1_epi16((short)ty);
+			for (; x + 4 <= n; x += 4)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(pRow0 + x)), b = _mm_loadu_si128((const __m128i*)(pRow1 + x));
+				__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), wa), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wb)), 8);
+				__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), wa), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), wb)), 8);
+				_mm_storeu_si128((__m128i*)(pOut + x), _mm_packus_epi16(lo, hi));
+			}
+#endif
+			for (; x < n; x++)
+				pOut[x] = lerp(pRow0[x], pRow1[x], ty);
+		}
+	}
+}
+
+//////// 
+
+/**
+ * @brief ղ
+*/
+struct LightingParams
+{
+	const Light3D* pLights;	/** @brief Դ */
+	int nLightsNum;			/** @brief Դ */
+	Color ambient;			/** @brief ɫ */
+	double specular;		/** @brief ߹ǿȣBlinn-PhongΪ 0 ʱֻ */
+	int shininess;			/** @brief ߹ָ */
+	Point3D pEye;			/** @brief ۲㣨λã */
+};
+
+/**
+ * @brief һĹս
+ * @note ɫ = ɫ *  + 255 * ߹⣬ֱ
+*/
+struct VertexLighting
+{
+	float diffuse[3];	/** @brief ϵ⣩RGB ˳ */
+	float specular[3];	/** @brief ߹ϵRGB ˳ */
+};
+
+/**
+ * @brief 㵥ĹգLambert  + Blinn ߹⣩
+ * @param[in] p : λ
+ * @param[in] n : 㵥λߣʾգϵΪ 1޸߹⣩
+ * @param[in] params : ղ
+ * @return عս
+ * @note ˫գ߱۲ʱȡ
+*/
+inline VertexLighting LightVertex(Point3D p, Point3D n, const LightingParams& params)
+{
+	VertexLighting out = {};
+	if (n.x == 0 && n.y == 0 && n.z == 0)
+	{
+		out.diffuse[0] = out.diffuse[1] = out.diffuse[2] = 1;
+		return out;
+	}
+
+	Point3D v = Normalize3D({ params.pEye.x - p.x,params.pEye.y - p.y,params.pEye.z - p.z });
+	if (n.x * v.x + n.y * v.y + n.z * v.z < 0)
+		n = { -n.x,-n.y,-n.z };
+
+	double d[3] = { GetRValue(params.ambient) / 255.0,GetGValue(params.ambient) / 255.0,GetBValue(params.ambient) / 255.0 };
+	double sp[3] = { 0,0,0 };
+	for (int i = 0; i < params.nLightsNum; i++)
+	{
+		const Light3D& light = params.pLights[i];
+		Point3D l = light.type == light_directional ?
+			Normalize3D({ -light.vec.x,-light.vec.y,-light.vec.z }) :
+			Normalize3D({ light.vec.x - p.x,light.vec.y - p.y,light.vec.z - p.z });
+		double ndl = n.x * l.x + n.y * l.y + n.z * l.z;
+		if (ndl <= 0) continue;
+
+		double lc[3] = {
+			GetRValue(light.color) / 255.0 * light.intensity,
+			GetGValue(light.color) / 255.0 * light.intensity,
+			GetBValue(light.color) / 255.0 * light.intensity
+		};
+		double s = 0;
+		if (params.specular > 0)
+		{
+			Point3D h = Normalize3D({ l.x + v.x,l.y + v.y,l.z + v.z });
+			double ndh = std::max(n.x * h.x + n.y * h.y + n.z * h.z, 0.0);
+			s = params.specular * pow(ndh, params.shininess);
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			d[k] += lc[k] * ndl;
+			sp[k] += lc[k] * s;
+		}
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		out.diffuse[k] = (float)d[k];
+		out.specular[k] = (float)sp[k];
+	}
+	return out;
+}
+
+/**
+ * @brief 㶥
+ * @param[in] pPoints : λ
+ * @param[in] pNormals : 㵥λ
+ * @param[in] num : 
+ * @param[in] params : ղ
+ * @param[out] pOut : ս飬Ϊ num
+ * @note ֧ SSE2 ʱÿμĸ㣺ȰλúͷתΪȵ SoA ʽ
+ *			ٶÿԴһ·е Lambert / Blinn 㣬߹ָƽݡ
+ *			ʣ಻ĸĶ LightVertex 㡣
+*/
+inline void LightVertices(const Point3D* pPoints, const Point3D* pNormals, int num, const LightingParams& params, VertexLighting* pOut)
+{
+	int i = 0;
+
+#ifdef HD3D_SSE2
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 ex = _mm_set1_ps((float)params.pEye.x), ey = _mm_set1_ps((float)params.pEye.y), ez = _mm_set1_ps((float)params.pEye.z);
+	const __m128 ks = _mm_set1_ps((float)params.specular);
+	const float ambient[3] = { GetRValue(params.ambient) / 255.f,GetGValue(params.ambient) / 255.f,GetBValue(params.ambient) / 255.f };
+
+	auto dot = [](__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+	};
+
+	// ΪһΪ
+	auto normalize = [&](__m128& x, __m128& y, __m128& z) {
+		__m128 len2 = dot(x, y, z, x, y, z);
+		__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len2));
+		inv = _mm_and_ps(inv, _mm_cmpgt_ps(len2, zero));
+		x = _mm_mul_ps(x, inv);
+		y = _mm_mul_ps(y, inv);
+		z = _mm_mul_ps(z, inv);
+	};
+
+	for (; i + 4 <= num; i += 4)
+	{
+		const Point3D* p = pPoints + i;
+		const Point3D* n = pNormals + i;
+		__m128 px = _mm_set_ps((float)p[3].x, (float)p[2].x, (float)p[1].x, (float)p[0].x);
+		__m128 py = _mm_set_ps((float)p[3].y, (float)p[2].y, (float)p[1].y, (float)p[0].y);
+		__m128 pz = _mm_set_ps((float)p[3].z, (float)p[2].z, (float)p[1].z, (float)p[0].z);
+		__m128 nx = _mm_set_ps((float)n[3].x, (float)n[2].x, (float)n[1].x, (float)n[0].x);
+		__m128 ny = _mm_set_ps((float)n[3].y, (float)n[2].y, (float)n[1].y, (float)n[0].y);
+		__m128 nz = _mm_set_ps((float)n[3].z, (float)n[2].z, (float)n[1].z, (float)n[0].z);
+
+		__m128 unlit = _mm_cmpeq_ps(dot(nx, ny, nz, nx, ny, nz), zero);
+
+		__m128 vx = _mm_sub_ps(ex, px), vy = _mm_sub_ps(ey, py), vz = _mm_sub_ps(ez, pz);
+		normalize(vx, vy, vz);
+
+		// ˫գ߱۲ʱȡ
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot(nx, ny, nz, vx, vy, vz), zero), sign);
+		nx = _mm_xor_ps(nx, flip);
+		ny = _mm_xor_ps(ny, flip);
+		nz = _mm_xor_ps(nz, flip);
+
+		__m128 d[3] = { _mm_set1_ps(ambient[0]),_mm_set1_ps(ambient[1]),_mm_set1_ps(ambient[2]) };
+		__m128 sp[3] = { zero,zero,zero };
+
+		for (int j = 0; j < params.nLightsNum; j++)
+		{
+			const Light3D& light = params.pLights[j];
+			__m128 lx, ly, lz;
+			if (light.type == light_directional)
+			{
+				Point3D l = Normalize3D({ -light.vec.x,-light.vec.y,-light.vec.z });
+				lx = _mm_set1_ps((float)l.x);
+				ly = _mm_set1_ps((float)l.y);
+				lz = _mm_set1_ps((float)l.z);
+			}
+			else
+			{
+				lx = _mm_sub_ps(_mm_set1_ps((float)light.vec.x), px);
+				ly = _mm_sub_ps(_mm_set1_ps((float)light.vec.y), py);
+				lz = _mm_sub_ps(_mm_set1_ps((float)light.vec.z), pz);
+				normalize(lx, ly, lz);
+			}
+
+			__m128 ndl = _mm_max_ps(dot(nx, ny, nz, lx, ly, lz), zero);
+			__m128 s = zero;
+			if (params.specular > 0)
+			{
+				__m128 hx = _mm_add_ps(lx, vx), hy = _mm_add_ps(ly, vy), hz = _mm_add_ps(lz, vz);
+				normalize(hx, hy, hz);
+				__m128 base = _mm_max_ps(dot(nx, ny, nz, hx, hy, hz), zero);
+				s = one;
+				for (int e = params.shininess; e > 0; e >>= 1)
+				{
+					if (e & 1) s = _mm_mul_ps(s, base);
+					base = _mm_mul_ps(base, base);
+				}
+				s = _mm_and_ps(_mm_mul_ps(s, ks), _mm_cmpgt_ps(ndl, zero));
+			}
+
+			float lc[3] = {
+				(float)(GetRValue(light.color) / 255.0 * light.intensity),
+				(float)(GetGValue(light.color) / 255.0 * light.intensity),
+				(float)(GetBValue(light.color) / 255.0 * light.intensity)
+			};
+			for (int k = 0; k < 3; k++)
+			{
+				__m128 c = _mm_set1_ps(lc[k]);
+				d[k] = _mm_add_ps(d[k], _mm_mul_ps(c, ndl));
+				sp[k] = _mm_add_ps(sp[k], _mm_mul_ps(c, s));
+			}
+		}
+
+		// ûзߵĶ㲻
+		float fd[3][4], fs[3][4];
+		for (int k = 0; k < 3; k++)
+		{
+			_mm_storeu_ps(fd[k], _mm_or_ps(_mm_and_ps(unlit, one), _mm_andnot_ps(unlit, d[k])));
+			_mm_storeu_ps(fs[k], _mm_andnot_ps(unlit, sp[k]));
+		}
+		for (int m = 0; m < 4; m++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				pOut[i + m].diffuse[k] = fd[k][m];
+				pOut[i + m].specular[k] = fs[k][m];
+			}
+		}
+	}
+#endif
+
+	for (; i < num; i++)
+	{
+		pOut[i] = LightVertex(pPoints[i], pNormals[i], params);
+	}
+}
+
+/**
+ * @brief ùսɫ
+ * @param[in] c : ɫ
+ * @param[in] l : ս
+ * @return صƺɫɫΪʱԭ
+*/
+inline Color ShadeColor(Color c, const VertexLighting& l)
+{
+	if (c < 0) return c;
+	int rgb[3] = { GetRValue(c),GetGValue(c),GetBValue(c) };
+	for (int k = 0; k < 3; k++)
+	{
+		int v = (int)(rgb[k] * l.diffuse[k] + 255 * l.specular[k] + 0.5f);
+		rgb[k] = std::min(std::max(v, 0), 255);
+	}
+	return RGB(rgb[0], rgb[1], rgb[2]);
+}
+
+//////// Ⱦ
+
+/**
+ * @brief Ȼ壨Hi-Zڵ޳
+ * @note  NDC Χ [-1, 1] x [-1, 1] 0 Ϊ HIZ_SIZE x HIZ_SIZE Ԫ
+ *			ÿһ߳룬ÿԪ串ǷΧԶȣNDC z
+ *			Ȱڵդ 0 㣬ȡֵɽʱڰΧֻ 2x2 ԪҵĲϱȽϣ
+ *			ÿβֻȡٵĵԪ
+*/
+class DepthPyramid
+{
+private:
+
+	float* pData;					/** @brief вȣ */
+	int pOffsets[HIZ_SIZE_BITS + 1];	/** @brief  pData еʼ± */
+	bool bEmpty;					/** @brief Ƿûκڵ */
+
+public:
+
+	DepthPyramid()
+	{
+		int nTotal = 0;
+		for (int level = 0; level <= HIZ_SIZE_BITS; level++)
+		{
+			pOffsets[level] = nTotal;
+			int n = HIZ_SIZE >> level;
+			nTotal += n * n;
+		}
+		pData = AllocArray<float>(nTotal, memory_render);
+		Clear();
+	}
+
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+	~DepthPyramid()
+	{
+		FreeArray(pData);
+	}
+
+	/**
+	 * @brief ΪԶ
+	*/
+	void Clear()
+	{
+		std::fill(pData, pData + HIZ_SIZE * HIZ_SIZE, 1.0f);
+		bEmpty = true;
+	}
+
+	/**
+	 * @brief һڵιդ 0 
+	 * @param[in] a, b, c : ζ㣨NDC ꣩
+	 * @note ԪĲȡƽڵԪڵԶֵȷǱص
+	*/
+	void RasterizeTriangle(Point3D a, Point3D b, Point3D c)
+	{
+		const double half = HIZ_SIZE / 2.0;
+		double x[3] = { (a.x + 1) * half,(b.x + 1) * half,(c.x + 1) * half };
+		double y[3] = { (1 - a.y) * half,(1 - b.y) * half,(1 - c.y) * half };
+		double z[3] = { a.z,b.z,c.z };
+
+		double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0) return;
+
+		// ƽ z = z0 + dzdx * (x - x0) + dzdy * (y - y0)
+		double dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		double dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+		double slope = (fabs(dzdx) + fabs(dzdy)) / 2;
+
+		int x0 = std::max((int)floor(std::min({ x[0],x[1],x[2] })), 0);
+		int x1 = std::min((int)ceil(std::max({ x[0],x[1],x[2] })), HIZ_SIZE);
+		int y0 = std::max((int)floor(std::min({ y[0],y[1],y[2] })), 0);
+		int y1 = std::min((int)ceil(std::max({ y[0],y[1],y[2] })), HIZ_SIZE);
+		double sign = area > 0 ? 1 : -1;
+
+		for (int j = y0; j < y1; j++)
+		{
+			double py = j + 0.5;
+			for (int i = x0; i < x1; i++)
+			{
+				double px = i + 0.5;
+				bool bInside = true;
+				for (int k = 0; k < 3 && bInside; k++)
+				{
+					int l = (k + 1) % 3;
+					double e = (x[l] - x[k]) * (py - y[k]) - (y[l] - y[k]) * (px - x[k]);
+					bInside = e * sign >= 0;
+				}
+				if (!bInside) continue;
+
+				float d = (float)std::min(std::max(z[0] + dzdx * (px - x[0]) + dzdy * (py - y[0]) + slope, 0.0), 1.0);
+				float& dst = pData[j * HIZ_SIZE + i];
+				if (d < dst)
+				{
+					dst = d;
+					bEmpty = false;
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief ɵ 0 ɸ
+	 * @note  0 һ 3x3 Զֵ˲ڵһԪ
+	 *			ԪĲɵĸ
+	*/
+	void Build()
+	{
+		if (bEmpty) return;
+
+		float* pTemp = AllocArray<float>(HIZ_SIZE * HIZ_SIZE, memory_render);
+		for (int j = 0; j < HIZ_SIZE; j++)
+		{
+			for (int i = 0; i < HIZ_SIZE; i++)
+			{
+				float d = 0;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int u = i + dx, v = j + dy;
+						d = u < 0 || v < 0 || u >= HIZ_SIZE || v >= HIZ_SIZE ? 1.0f : std::max(d, pData[v * HIZ_SIZE + u]);
+						if (d >= 1) break;
+					}
+				}
+				pTemp[j * HIZ_SIZE + i] = d;
+			}
+		}
+		memcpy(pData, pTemp, sizeof(float) * HIZ_SIZE * HIZ_SIZE);
+		FreeArray(pTemp);
+
+		for (int level = 1; level <= HIZ_SIZE_BITS; level++)
+		{
+			const float* pSrc = pData + pOffsets[level - 1];
+			float* pLevel = pData + pOffsets[level];
+			int n = HIZ_SIZE >> level;
+			for (int j = 0; j < n; j++)
+			{
+				for (int i = 0; i < n; i++)
+				{
+					const float* s = pSrc + (j * 2) * (n * 2) + i * 2;
+					pLevel[j * n + i] = std::max(std::max(s[0], s[1]), std::max(s[n * 2], s[n * 2 + 1]));
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief жһĳǷܿɼ
+	 * @param[in] min_x, min_y, max_x, max_y : ΧNDC ꣩
+	 * @param[in] z : ȣNDC z
+	 * @return κһڵȱ z Զʱ true
+	*/
+	bool IsVisible(double min_x, double min_y, double max_x, double max_y, double z) const
+	{
+		if (bEmpty) return true;
+
+		const double half = HIZ_SIZE / 2.0;
+		int x0 = std::min(std::max((int)floor((min_x + 1) * half), 0), HIZ_SIZE - 1);
+		int x1 = std::min(std::max((int)floor((max_x + 1) * half), 0), HIZ_SIZE - 1);
+		int y0 = std::min(std::max((int)floor((1 - max_y) * half), 0), HIZ_SIZE - 1);
+		int y1 = std::min(std::max((int)floor((1 - min_y) * half), 0), HIZ_SIZE - 1);
+
+		// ѡֻ 2x2 ԪҵĲ
+		int level = 0;
+		while (level < HIZ_SIZE_BITS && std::max(x1 - x0, y1 - y0) >> level > 1)
+			level++;
+
+		const float* pLevel = pData + pOffsets[level];
+		int n = HIZ_SIZE >> level;
+		for (int j = y0 >> level; j <= y1 >> level; j++)
+			for (int i = x0 >> level; i <= x1 >> level; i++)
+				if (z <= pLevel[j * n + i])
+					return true;
+		return false;
+	}
+};
+
+/**
+ * @brief ȾеͼԪ
+*/
+struct RenderItem
+{
+	int nFirst;			/** @brief һڶже± */
+	int nPointsNum;		/** @brief  */
+	Color color;		/** @brief ͼԪɫ */
+	Texture* pTexture;	/** @brief Ϊ NULL ʾ */
+	double depth;		/** @brief z εģ */
+};
+
+/**
+ * @brief Ⱦһ֡ĸ׶Σ RenderQueue::GetStageTime
+*/
+enum RenderStage
+{
+	render_stage_build,		/** @brief 任޳üգдȾУ߿ģʽΪȫƣ */
+	render_stage_sort,		/** @brief ͼԪ */
+	render_stage_draw,		/** @brief դͿ */
+	render_stage_resample,	/** @brief ֱ̬ʵţ뱳ͷŴ */
+	render_stages_num		/** @brief ׶ */
+};
+
+class Scence3D;
+
+/**
+ * @brief Ⱦ
+ * @note ÿ֡ҪƵͼԪͶӰ NDCдУ󰴴Զ˳ơ
+ *			ʱѷĿռ䣬ͬһظʹʱÿ֡ٷڴ档
+ *			вڶ̼߳乲߳Ⱦʱÿ߳ʹøԵĶС
+*/
+class RenderQueue
+{
+private:
+
+	friend class Scence3D;
+
+	RenderVertex* pVertices;	/** @brief ͼԪĶ㣬ͼԪ˳ */
+	int nVerticesNum;			/** @brief  */
+	int nVerticesCapacity;		/** @brief  */
+
+	RenderItem* pItems;			/** @brief ͼԪ */
+	int nItemsNum;				/** @brief ͼԪ */
+	int nItemsCapacity;			/** @brief ͼԪ */
+
+	//// ʱʹõʱռ䣬Ķ
+
+	Point4D* pClipVertices;		/** @brief Ĳüռ */
+	Point3D* pProjected;		/** @brief  NDC  */
+	double* pInvW;				/** @brief  1/w */
+	unsigned char* pOutcodes;	/** @brief  */
+	VertexLighting* pLighting;	/** @brief εĹ */
+	Point3D* pCenters;			/** @brief ģƽɫ */
+	Point3D* pNormals;			/** @brief ηߣƽɫ */
+	int nScratchCapacity;		/** @brief ʱռ */
+
+	DepthPyramid hiz;			/** @brief ڵ޳ʹõĲȻ */
+	FrameBuffer fbAntiAlias;	/** @brief ʹõĶزʱ */
+	int nCulledNum;				/** @brief ޳ */
+	int nCulledChunksNum;		/** @brief ޳ */
+
+	//// ֱ̬ʣ Scence3D::SetDynamicResolution
+
+	double pStageTimes[render_stages_num];	/** @brief һ֡׶εĺʱ룩 */
+	FrameBuffer fbScaled;		/** @brief ͷֱʱڲ壬С䣬СķֱʹϽǵ */
+	double fResolutionScale;	/** @brief һ֡ķֱű */
+	double fFixedCost;			/** @brief ƽֱ޹صĺʱ룩Ϊʾûм¼ */
+	double fPixelCost;			/** @brief ƽÿڲصĺʱ룩 */
+	double fResampleCost;		/** @brief ƽ󽵵ͷֱʱŵĺʱ룩Ϊʾûм¼ */
+
+	/**
+	 * @brief һ֡׶εĺʱ·ֱű
+	 * @param[in] fTargetTime : Ŀ֡ʱ䣨룩
+	 * @param[in] fMinScale : Сű
+	 * @param[in] nPixels : һ֡ڲ
+	 * @param[in] nFullPixels : 
+	 * @note һ֡ĺʱΪֱ޹صĲ֣򣩡ڲȵĲ֣ƣͽͷֱʱеţ
+	 *			ָƶƽȫֱԤƲʱֱӻصȫֱʣʱûŵĿѾʱҪ 10% 
+	 *			۳ŵĺʱԤƺʱĿ֡ʱű DYNAMIC_RESOLUTION_STEPS ֵ
+	 *			ҪʱĵλҪʱٸ߳һÿֻ֡һ֮
+	*/
+	void UpdateResolutionScale(double fTargetTime, double fMinScale, int nPixels, int nFullPixels)
+	{
+		auto smooth = [](double* pValue, double v) {
+			*pValue = *pValue < 0 ? v : *pValue + (v - *pValue) * DYNAMIC_RESOLUTION_SMOOTHING;
+		};
+		double pixel = pStageTimes[render_stage_draw] / std::max(nPixels, 1);
+		if (fFixedCost < 0)
+			fPixelCost = pixel;
+		else
+			smooth(&fPixelCost, pixel);
+		smooth(&fFixedCost, pStageTimes[render_stage_build] + pStageTimes[render_stage_sort]);
+		if (pStageTimes[render_stage_resample] > 0)
+			smooth(&fResampleCost, pStageTimes[render_stage_resample]);
+
+		fMinScale = std::min(std::max(fMinScale, 1.0 / DYNAMIC_RESOLUTION_STEPS), 1.0);
+		double fFullCost = fFixedCost + fPixelCost * nFullPixels;
+		if (fFullCost <= fTargetTime * (fResolutionScale < 1 ? 0.9 : 1))
+		{
+			fResolutionScale = 1;
+			return;
+		}
+
+		double budget = fTargetTime - fFixedCost - std::max(fResampleCost, 0.0);
+		double scale = budget <= 0 || fPixelCost <= 0 ? fMinScale : sqrt(budget / (fPixelCost * std::max(nFullPixels, 1)));
+		scale = floor(std::min(scale, 1.0) * DYNAMIC_RESOLUTION_STEPS) / DYNAMIC_RESOLUTION_STEPS;
+		scale = std::max(std::min(scale, 1 - 1.0 / DYNAMIC_RESOLUTION_STEPS), fMinScale);
+
+		const double step = 1.0 / DYNAMIC_RESOLUTION_STEPS;
+		if (scale < fResolutionScale)
+			fResolutionScale = scale;
+		else if (scale > fResolutionScale + step * 1.5)
+			fResolutionScale = std::min(fResolutionScale + step, 1.0);
+		fResolutionScale = std::min(std::max(fResolutionScale, fMinScale), 1.0);
+	}
+
+	/**
+	 * @brief ȷʱռ n Ԫ
+	*/
+	void ReserveScratch(int n)
+	{
+		if (n <= nScratchCapacity) return;
+		ClearScratch();
+		nScratchCapacity = n;
+		pClipVertices = AllocArray<Point4D>(n, memory_render);
+		pProjected = AllocArray<Point3D>(n, memory_render);
+		pInvW = AllocArray<double>(n, memory_render);
+		pOutcodes = AllocArray<unsigned char>(n, memory_render);
+		pLighting = AllocArray<VertexLighting>(n, memory_render);
+		pCenters = AllocArray<Point3D>(n, memory_render);
+		pNormals = AllocArray<Point3D>(n, memory_render);
+	}
+
+	/**
+	 * @brief ͷʱռ
+	*/
+	void ClearScratch()
+	{
+		FreeArray(pClipVertices);
+		FreeArray(pProjected);
+		FreeArray(pInvW);
+		FreeArray(pOutcodes);
+		FreeArray(pLighting);
+		FreeArray(pCenters);
+		FreeArray(pNormals);
+		pClipVertices = NULL;
+		pProjected = NULL;
+		pInvW = NULL;
+		pOutcodes = NULL;
+		pLighting = NULL;
+		pCenters = pNormals = NULL;
+		nScratchCapacity = 0;
+	}
+
+public:
+
+	RenderQueue()
+	{
+		pVertices = NULL;
+		pItems = NULL;
+		nVerticesNum = nVerticesCapacity = 0;
+		nItemsNum = nItemsCapacity = 0;
+		pClipVertices = NULL;
+		pProjected = NULL;
+		pInvW = NULL;
+		pOutcodes = NULL;
+		pLighting = NULL;
+		pCenters = pNormals = NULL;
+		nScratchCapacity = 0;
+		nCulledNum = 0;
+		nCulledChunksNum = 0;
+		for (int i = 0; i < render_stages_num; i++)
+			pStageTimes[i] = 0;
+		fResolutionScale = 1;
+		fFixedCost = -1;
+		fPixelCost = 0;
+		fResampleCost = -1;
+	}
+
+	RenderQueue(const RenderQueue&) = delete;
+	RenderQueue& operator=(const RenderQueue&) = delete;
+
+	~RenderQueue()
+	{
+		FreeArray(pVertices);
+		FreeArray(pItems);
+		ClearScratch();
+	}
+
+	/**
+	 * @brief նУѷĿռ䣩
+	*/
+	void Clear()
+	{
+		nVerticesNum = 0;
+		nItemsNum = 0;
+		nCulledNum = 0;
+		nCulledChunksNum = 0;
+	}
+
+	/**
+	 * @brief ĩβһͼԪ
+	 * @param[in] p : 㣨NDC ꣩
+	 * @param[in] num : 
+	 * @param[in] color : ͼԪɫ
+	 * @param[in] pTexture : Ϊ NULL ʾ
+	*/
+	void PushItem(const RenderVertex* p, int num, Color color, Texture* pTexture)
+	{
+		if (num <= 0) return;
+
+		if (nVerticesNum + num > nVerticesCapacity)
+		{
+			int nCapacity = std::max(nVerticesCapacity * 2, nVerticesNum + num);
+			RenderVertex* pNew = AllocArray<RenderVertex>(nCapacity, memory_render);
+			if (nVerticesNum > 0)
+				memcpy(pNew, pVertices, sizeof(RenderVertex) * nVerticesNum);
+			FreeArray(pVertices);
+			pVertices = pNew;
+			nVerticesCapacity = nCapacity;
+		}
+		if (nItemsNum + 1 > nItemsCapacity)
+		{
+			int nCapacity = std::max(nItemsCapacity * 2, 64);
+			RenderItem* pNew = AllocArray<RenderItem>(nCapacity, memory_render);
+			if (nItemsNum > 0)
+				memcpy(pNew, pItems, sizeof(RenderItem) * nItemsNum);
+			FreeArray(pItems);
+			pItems = pNew;
+			nItemsCapacity = nCapacity;
+		}
+
+		double min = p[0].p.z, max = p[0].p.z;
+		for (int i = 0; i < num; i++)
+		{
+			pVertices[nVerticesNum + i] = p[i];
+			min = std::min(min, p[i].p.z);
+			max = std::max(max, p[i].p.z);
+		}
+		pItems[nItemsNum++] = { nVerticesNum,num,color,pTexture,min + (max - min) / 2 };
+		nVerticesNum += num;
+	}
+
+	/**
+	 * @brief  z εͼԪ
+	 * @note ֻƶͼԪƶ
+	*/
+	void Sort()
+	{
+		std::sort(pItems, pItems + nItemsNum, [](const RenderItem& a, const RenderItem& b) {
+			return a.depth < b.depth;
+		});
+	}
+
+	/**
+	 * @brief ӺǰԶƶеͼԪ
+	 * @param[in] pTarget : Ŀ֡
+	 * @param[in] x : ͼ֡ x 
+	 * @param[in] y : ͼ֡ y 
+	 * @param[in] zoom : ͼ
+	 * @param[in] grid : ɫΪʾ
+	 * @param[in] aa : ģʽ
+	 * @attention Ҫȵ Sort
+	 * @note زʱȰĿͼеĶزΪлƺٺϳɻĿꣻ
+	 *			䲻ʱݡFXAA ȫͼԪĿ괦һ顣
+	 *			еĻСʱظʹá
+	*/
+	void Draw(FrameBuffer* pTarget, int x = 0, int y = 0, Zoom zoom = { 1,1 }, Color grid = -1, AntiAliasMode aa = antialias_none)
+	{
+		FrameBuffer* pDraw = pTarget;
+		if (aa == antialias_msaa2x || aa == antialias_msaa4x)
+		{
+			if (fbAntiAlias.Create(pTarget->GetWidth(), pTarget->GetHeight()) && fbAntiAlias.SetSamplesNum(aa == antialias_msaa4x ? 4 : 2))
+			{
+				fbAntiAlias.LoadSamples(pTarget);
+				pDraw = &fbAntiAlias;
+			}
+		}
+
+		for (int i = nItemsNum - 1; i >= 0; i--)
+		{
+			const RenderItem& item = pItems[i];
+			DrawPrimitive(pDraw, pVertices + item.nFirst, item.nPointsNum, item.color, item.pTexture, x, y, zoom, grid);
+		}
+
+		if (pDraw != pTarget)
+			fbAntiAlias.ResolveSamples(pTarget);
+		else if (aa == antialias_fxaa)
+			ApplyFXAA(pTarget, &fbAntiAlias);
+	}
+
+	/**
+	 * @brief ȡеͼԪ
+	*/
+	int GetItemsNum() const
+	{
+		return nItemsNum;
+	}
+
+	/**
+	 * @brief ȡռõڴ棨ֽڣѷ
+	 * @note ظʹʱֻҲȾһ֡ʱռķֵ
+	*/
+	size_t GetMemoryUsage() const
+	{
+		return sizeof(RenderQueue) + sizeof(RenderVertex) * nVerticesCapacity + sizeof(RenderItem) * nItemsCapacity
+			+ (sizeof(Point4D) + sizeof(Point3D) * 3 + sizeof(double) + sizeof(unsigned char) + sizeof(VertexLighting)) * nScratchCapacity
+			+ sizeof(float) * HIZ_SIZE * HIZ_SIZE * 4 / 3
+			+ sizeof(DWORD) * fbAntiAlias.GetPitch() * fbAntiAlias.GetHeight() * fbAntiAlias.GetSamplesNum()
+			+ sizeof(DWORD) * fbScaled.GetPitch() * fbScaled.GetHeight();
+	}
+
+	/**
+	 * @brief ȡʱ޳׶ڵ
+	*/
+	int GetCulledNum() const
+	{
+		return nCulledNum;
+	}
+
+	/**
+	 * @brief ȡʱڿɼб޳ Object3D::SpatialReorder
+	*/
+	int GetCulledChunksNum() const
+	{
+		return nCulledChunksNum;
+	}
+
+	/**
+	 * @brief ȡô˶Ⱦһ֡ĳ׶εĺʱ룩
+	*/
+	double GetStageTime(RenderStage stage) const
+	{
+		return pStageTimes[stage];
+	}
+
+	/**
+	 * @brief ȡô˶Ⱦһ֡ʱķֱű Scence3D::SetDynamicResolutionûпֱ̬ʱΪ 1
+	*/
+	double GetResolutionScale() const
+	{
+		return fResolutionScale;
+	}
+
+	/**
+	 * @brief ȡеͼԪ
+	 * @attention ʹ GetItemsNum ȡͼԪصɶйҪͷ
+	*/
+	const RenderItem* GetItems() const
+	{
+		return pItems;
+	}
+
+	/**
+	 * @brief ȡеĶ
+	 * @note ͼԪĶ RenderItem::nFirst ʼ
+	*/
+	const RenderVertex* GetVertices() const
+	{
+		return pVertices;
+	}
+};
+
+//////// 
+
+/**
+ * @brief 볡Ľ
+*/
+struct RayHit3D
+{
+	double t;		/** @brief 㴦Ĺ߲Ϊ o + t * d */
+	double u;		/** @brief ꣺ = (1 - u - v) * p0 + u * p1 + v * p2 */
+	double v;		/** @brief  */
+	int nObject;	/** @brief ±꣬Ϊ -1 ʾûн */
+	int nPolygon;	/** @brief ± */
+
+	/**
+	 * @brief ڶе±
+	 * @note ΰǻ k ε p0, p1, p2 Ƕεĵ 0, k + 1, k + 2 
+	*/
+	int nTriangle;
+
+	int nPrimitive;	/** @brief  BVH е±꣨ BVH3D::GetPrimitive */
+};
+
+/**
+ * @brief BVH еΣʹõݣ
+*/
+struct BVHTriangle
+{
+	float v0[3];	/** @brief һ */
+	float e1[3];	/** @brief ڶһ */
+	float e2[3];	/** @brief һ */
+};
+
+/**
+ * @brief BVH еεԴɫʹõݣݷֿţ
+*/
+struct BVHPrimitive
+{
+	int nObject;		/** @brief ± */
+	int nPolygon;		/** @brief ± */
+	int nTriangle;		/** @brief ڶе±꣨ RayHit3D */
+	int nFirstIndex;	/** @brief εһ飨Object3D::GetIndicesе± */
+};
+
+/**
+ * @brief BVH ڵ
+ * @note ÿڵ 32 ֽڣӽڵڴ
+*/
+struct BVHNode
+{
+	float min[3];	/** @brief ΧС */
+	int nIndex;		/** @brief ҶӽڵΪһε±꣬ڲڵΪӽڵ±꣨ӽڵ */
+	float max[3];	/** @brief Χ */
+	int nCount;		/** @brief ҶӽڵΪ 0ڲڵΪ -1 -  */
+};
+
+/**
+ * @brief ɵĹ߰SoA ʽ
+ * @note ͬһڵĹ߷Ӧͬصߣʱͬһ·
+ *			ʹõĹ߰ tmax ΪС tmin ɡ
+*/
+struct RayPacket4
+{
+	float ox[4], oy[4], oz[4];	/** @brief  */
+	float dx[4], dy[4], dz[4];	/** @brief 򣨲ǵλ */
+	float tmin[4];				/** @brief ߲ */
+	float tmax[4];				/** @brief ߲ */
+};
+
+/**
+ * @brief εĲΰΧУBounding Volume Hierarchy
+ * @note ʹ÷Ͱ SAHʽԶ½ڵζ˳š
+ *			ֻڶ߳ͬʱ󽻡
+*/
+class BVH3D
+{
+private:
+
+	BVHNode* pNodes;			/** @brief ڵ㣬0 Ϊڵ */
+	int nNodesNum;				/** @brief ڵ */
+	BVHTriangle* pTriangles;	/** @brief ΣҶӽڵ˳ */
+	BVHPrimitive* pPrimitives;	/** @brief εԴ pTriangles һһӦ */
+	int nTrianglesNum;			/** @brief  */
+
+	/**
+	 * @brief ĵ㣨õ˻ NaN
+	*/
+	static float SafeInverse(float x)
+	{
+		return 1 / (fabsf(x) > 1e-20f ? x : (x < 0 ? -1e-20f : 1e-20f));
+	}
+
+	/**
+	 * @brief Χ󽻣slab 
+	*/
+	static bool IntersectBox(const BVHNode& node, const float o[3], const float inv[3], float tmin, float tmax)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			float t0 = (node.min[k] - o[k]) * inv[k], t1 = (node.max[k] - o[k]) * inv[k];
+			if (t0 > t1) std::swap(t0, t1);
+			tmin = std::max(tmin, t0);
+			tmax = std::min(tmax, t1);
+		}
+		return tmin <= tmax;
+	}
+
+	/**
+	 * @brief 󽻣Moller-Trumbore ޳棩
+	 * @param[in, out] t : 뵱ǰĽ㣬иĽʱµĽ
+	*/
+	static bool IntersectTriangle(const BVHTriangle& tri, const float o[3], const float d[3], float tmin, float* t, float* u, float* v)
+	{
+		const float* e1 = tri.e1, * e2 = tri.e2;
+		float p[3] = { d[1] * e2[2] - d[2] * e2[1],d[2] * e2[0] - d[0] * e2[2],d[0] * e2[1] - d[1] * e2[0] };
+		float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (det == 0) return false;
+		float inv = 1 / det;
+		float s[3] = { o[0] - tri.v0[0],o[1] - tri.v0[1],o[2] - tri.v0[2] };
+		float uu = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+		if (uu < 0 || uu > 1) return false;
+		float q[3] = { s[1] * e1[2] - s[2] * e1[1],s[2] * e1[0] - s[0] * e1[2],s[0] * e1[1] - s[1] * e1[0] };
+		float vv = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+		if (vv < 0 || uu + vv > 1) return false;
+		float tt = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+		if (tt < tmin || tt >= *t) return false;
+		*t = tt;
+		*u = uu;
+		*v = vv;
+		return true;
+	}
+
+	/**
+	 * @brief  BVH
+	 * @param[in] bAny : Ϊ true ʱҵһͷأӰԣ
+	 * @return ģһ±꣬ûнʱ -1
+	*/
+	int Traverse(Point3D ro, Point3D rd, double tmin, double tmax, bool bAny, float* t, float* u, float* v) const
+	{
+		if (nNodesNum <= 0) return -1;
+
+		float o[3] = { (float)ro.x,(float)ro.y,(float)ro.z };
+		float d[3] = { (float)rd.x,(float)rd.y,(float)rd.z };
+		float inv[3] = { SafeInverse(d[0]),SafeInverse(d[1]),SafeInverse(d[2]) };
+		float t0 = (float)tmin;
+		*t = (float)tmax;
+		int hit = -1;
+
+		int stack[BVH_MAX_DEPTH * 2];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			const BVHNode& node = pNodes[stack[--top]];
+			if (!IntersectBox(node, o, inv, t0, *t)) continue;
+
+			if (node.nCount > 0)
+			{
+				for (int i = node.nIndex; i < node.nIndex + node.nCount; i++)
+				{
+					if (IntersectTriangle(pTriangles[i], o, d, t0, t, u, v))
+					{
+						hit = i;
+						if (bAny) return hit;
+					}
+				}
+			}
+			else
+			{
+				// ȷʹ߷ϽϽӽڵ
+				int axis = -1 - node.nCount;
+				int near_child = node.nIndex + (d[axis] < 0);
+				stack[top++] = node.nIndex + (d[axis] >= 0);
+				stack[top++] = near_child;
+			}
+		}
+		return hit;
+	}
+
+public:
+
+	BVH3D()
+	{
+		pNodes = NULL;
+		pTriangles = NULL;
+		pPrimitives = NULL;
+		nNodesNum = nTrianglesNum = 0;
+	}
+
+	BVH3D(const BVH3D&) = delete;
+	BVH3D& operator=(const BVH3D&) = delete;
+
+	~BVH3D()
+	{
+		Clear();
+	}
+
+	/**
+	 * @brief ͷ BVH
+	*/
+	void Clear()
+	{
+		FreeArray(pNodes);
+		FreeArray(pTriangles);
+		FreeArray(pPrimitives);
+		pNodes = NULL;
+		pTriangles = NULL;
+		pPrimitives = NULL;
+		nNodesNum = nTrianglesNum = 0;
+	}
+
+	/**
+	 * @brief  BVH
+	 * @param[in] pPoints : ζ㣬ÿΪһ
+	 * @param[in] pSource : εԴ󽻽ԭ
+	 * @param[in] num : 
+	 * @return Ϊ 0 ʱ false
+	 * @note ÿڵϷֱķֵ BVH_SAH_BINS Ͱѡ SAH СĻ֣
+	 *			ֱֲΪҶӽڵ㻮ʱֹͣӶΪ O(n log n)
+	*/
+	bool Build(const Point3D* pPoints, const BVHPrimitive* pSource, int num)
+	{
+		Clear();
+		if (num <= 0) return false;
+
+		struct Box
+		{
+			float min[3], max[3];
+			void Reset()
+			{
+				min[0] = min[1] = min[2] = FLT_MAX;
+				max[0] = max[1] = max[2] = -FLT_MAX;
+			}
+			void Grow(const Box& b)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					min[k] = std::min(min[k], b.min[k]);
+					max[k] = std::max(max[k], b.max[k]);
+				}
+			}
+			float Area() const
+			{
+				if (min[0] > max[0]) return 0;
+				float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+				return 2 * (x * y + y * z + z * x);
+			}
+		};
+		struct Task
+		{
+			int node, begin, end, depth;
+		};
+
+		Box* pBoxes = AllocArray<Box>(num, memory_bvh);
+		float* pCenters = AllocArray<float>((size_t)num * 3, memory_bvh);
+		int* pOrder = AllocArray<int>(num, memory_bvh);
+		for (int i = 0; i < num; i++)
+		{
+			const Point3D* p = pPoints + (size_t)i * 3;
+			pBoxes[i].Reset();
+			for (int j = 0; j < 3; j++)
+			{
+				float c[3] = { (float)p[j].x,(float)p[j].y,(float)p[j].z };
+				for (int k = 0; k < 3; k++)
+				{
+					pBoxes[i].min[k] = std::min(pBoxes[i].min[k], c[k]);
+					pBoxes[i].max[k] = std::max(pBoxes[i].max[k], c[k]);
+				}
+			}
+			for (int k = 0; k < 3; k++)
+				pCenters[i * 3 + k] = (pBoxes[i].min[k] + pBoxes[i].max[k]) / 2;
+			pOrder[i] = i;
+		}
+
+		// Ľڵ 2n - 1
+		pNodes = AllocArray<BVHNode>((size_t)num * 2, memory_bvh);
+		nNodesNum = 1;
+		Task* pStack = AllocArray<Task>(num + 1, memory_bvh);
+		int top = 0;
+		pStack[top++] = { 0,0,num,0 };
+
+		while (top > 0)
+		{
+			Task task = pStack[--top];
+			BVHNode& node = pNodes[task.node];
+			int count = task.end - task.begin;
+
+			Box box, center;
+			box.Reset();
+			center.Reset();
+			for (int i = task.begin; i < task.end; i++)
+			{
+				box.Grow(pBoxes[pOrder[i]]);
+				const float* c = pCenters + pOrder[i] * 3;
+				center.Grow({ { c[0],c[1],c[2] },{ c[0],c[1],c[2] } });
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				node.min[k] = box.min[k];
+				node.max[k] = box.max[k];
+			}
+			node.nIndex = task.begin;
+			node.nCount = count;
+			if (count <= BVH_LEAF_SIZE) continue;
+
+			// Ͱ SAH =  + ӽڵıԱڵı
+			float best = FLT_MAX;
+			int nBestAxis = -1, nBestBin = -1;
+			for (int axis = 0; axis < 3 && task.depth < BVH_MAX_DEPTH; axis++)
+			{
+				float lo = center.min[axis], extent = center.max[axis] - lo;
+				if (extent <= 0) continue;
+				float scale = BVH_SAH_BINS / extent;
+
+				Box bins[BVH_SAH_BINS];
+				int counts[BVH_SAH_BINS] = { 0 };
+				for (int b = 0; b < BVH_SAH_BINS; b++)
+					bins[b].Reset();
+				for (int i = task.begin; i < task.end; i++)
+				{
+					int b = std::min((int)((pCenters[pOrder[i] * 3 + axis] - lo) * scale), BVH_SAH_BINS - 1);
+					bins[b].Grow(pBoxes[pOrder[i]]);
+					counts[b]++;
+				}
+
+				// ۼҲı
+				float pRightArea[BVH_SAH_BINS];
+				int pRightCount[BVH_SAH_BINS];
+				Box right;
+				right.Reset();
+				for (int b = BVH_SAH_BINS - 1, n = 0; b > 0; b--)
+				{
+					right.Grow(bins[b]);
+					n += counts[b];
+					pRightArea[b] = right.Area();
+					pRightCount[b] = n;
+				}
+
+				Box left;
+				left.Reset();
+				for (int b = 0, n = 0; b < BVH_SAH_BINS - 1; b++)
+				{
+					left.Grow(bins[b]);
+					n += counts[b];
+					if (n == 0 || pRightCount[b + 1] == 0) continue;
+					float cost = left.Area() * n + pRightArea[b + 1] * pRightCount[b + 1];
+					if (cost < best)
+					{
+						best = cost;
+						nBestAxis = axis;
+						nBestBin = b;
+					}
+				}
+			}
+
+			int mid;
+			if (nBestAxis >= 0)
+			{
+				// ֲ粻ʱΪҶӽڵ㣨ιʱȻ֣
+				float area = box.Area();
+				if (area + best >= area * count && count <= BVH_LEAF_SIZE * 4)
+					continue;
+
+				float lo = center.min[nBestAxis], scale = BVH_SAH_BINS / (center.max[nBestAxis] - lo);
+				mid = (int)(std::partition(pOrder + task.begin, pOrder + task.end, [&](int i) {
+					return std::min((int)((pCenters[i * 3 + nBestAxis] - lo) * scale), BVH_SAH_BINS - 1) <= nBestBin;
+				}) - pOrder);
+			}
+			else
+			{
+				// Ȼغϣᰴ԰뻮
+				int axis = 0;
+				for (int k = 1; k < 3; k++)
+					if (box.max[k] - box.min[k] > box.max[axis] - box.min[axis])
+						axis = k;
+				nBestAxis = axis;
+				mid = task.begin + count / 2;
+				std::nth_element(pOrder + task.begin, pOrder + mid, pOrder + task.end, [&](int a, int b) {
+					return pCenters[a * 3 + axis] < pCenters[b * 3 + axis];
+				});
+			}
+
+			node.nIndex = nNodesNum;
+			node.nCount = -1 - nBestAxis;
+			nNodesNum += 2;
+			pStack[top++] = { node.nIndex + 1,mid,task.end,task.depth + 1 };
+			pStack[top++] = { node.nIndex,task.begin,mid,task.depth + 1 };
+		}
+
+		// ΰҶӽڵ˳
+		nTrianglesNum = num;
+		pTriangles = AllocArray<BVHTriangle>(num, memory_bvh);
+		pPrimitives = AllocArray<BVHPrimitive>(num, memory_bvh);
+		for (int i = 0; i < num; i++)
+		{
+			const Point3D* p = pPoints + (size_t)pOrder[i] * 3;
+			BVHTriangle& tri = pTriangles[i];
+			tri.v0[0] = (float)p[0].x;
+			tri.v0[1] = (float)p[0].y;
+			tri.v0[2] = (float)p[0].z;
+			tri.e1[0] = (float)(p[1].x - p[0].x);
+			tri.e1[1] = (float)(p[1].y - p[0].y);
+			tri.e1[2] = (float)(p[1].z - p[0].z);
+			tri.e2[0] = (float)(p[2].x - p[0].x);
+			tri.e2[1] = (float)(p[2].y - p[0].y);
+			tri.e2[2] = (float)(p[2].z - p[0].z);
+			pPrimitives[i] = pSource[pOrder[i]];
+		}
+
+		FreeArray(pBoxes);
+		FreeArray(pCenters);
+		FreeArray(pOrder);
+		FreeArray(pStack);
+		return true;
+	}
+
+	/**
+	 * @brief ߵ
+	 * @param[in] o : 
+	 * @param[in] d : ߷򣨲ǵλ
+	 * @param[in] tmin : ߲
+	 * @param[in] tmax : ߲
+	 * @param[out] pHit : ؽ㣬ûнʱ nObject Ϊ -1
+	 * @return Ƿн
+	*/
+	bool Intersect(Point3D o, Point3D d, double tmin, double tmax, RayHit3D* pHit) const
+	{
+		float t, u, v;
+		int i = Traverse(o, d, tmin, tmax, false, &t, &u, &v);
+		pHit->nObject = -1;
+		if (i < 0) return false;
+		*pHit = { t,u,v,pPrimitives[i].nObject,pPrimitives[i].nPolygon,pPrimitives[i].nTriangle,i };
+		return true;
+	}
+
+	/**
+	 * @brief жϹڲΧǷڵ
+	 * @note ҵһͷأ Intersect 죬Ӱͻڱ
+	*/
+	bool Occluded(Point3D o, Point3D d, double tmin, double tmax) const
+	{
+		float t, u, v;
+		return Traverse(o, d, tmin, tmax, true, &t, &u, &v) >= 0;
+	}
+
+	/**
+	 * @brief ͬʱߵ
+	 * @param[in] rays : ߰
+	 * @param[out] pHits : ߵĽ
+	 * @note ֧ SSE2 ʱ߹ͬ BVHΧкζ·е SIMD ָԣ
+	 *			ֻҪһڵཻͽڵ㣬Թ߷ԽһԽ졣֧ʱ Intersect
+	*/
+	void Intersect4(const RayPacket4& rays, RayHit3D pHits[4]) const
+	{
+		for (int i = 0; i < 4; i++)
+			pHits[i].nObject = -1;
+		if (nNodesNum <= 0) return;
+
+#ifdef HD3D_SSE2
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+		__m128 ox = _mm_loadu_ps(rays.ox), oy = _mm_loadu_ps(rays.oy), oz = _mm_loadu_ps(rays.oz);
+		__m128 dx = _mm_loadu_ps(rays.dx), dy = _mm_loadu_ps(rays.dy), dz = _mm_loadu_ps(rays.dz);
+		float inv[3][4];
+		for (int i = 0; i < 4; i++)
+		{
+			inv[0][i] = SafeInverse(rays.dx[i]);
+			inv[1][i] = SafeInverse(rays.dy[i]);
+			inv[2][i] = SafeInverse(rays.dz[i]);
+		}
+		__m128 ix = _mm_loadu_ps(inv[0]), iy = _mm_loadu_ps(inv[1]), iz = _mm_loadu_ps(inv[2]);
+		__m128 t0 = _mm_loadu_ps(rays.tmin), best = _mm_loadu_ps(rays.tmax);
+		__m128 hu = zero, hv = zero;
+		__m128i id = _mm_set1_epi32(-1);
+
+		// һߵķӽڵķ˳
+		bool pNegative[3] = { rays.dx[0] < 0,rays.dy[0] < 0,rays.dz[0] < 0 };
+
+		auto select = [](__m128 mask, __m128 a, __m128 b) {
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		};
+
+		int stack[BVH_MAX_DEPTH * 2];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			const BVHNode& node = pNodes[stack[--top]];
+
+			__m128 ax = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[0]), ox), ix);
+			__m128 bx = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[0]), ox), ix);
+			__m128 ay = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[1]), oy), iy);
+			__m128 by = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[1]), oy), iy);
+			__m128 az = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[2]), oz), iz);
+			__m128 bz = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[2]), oz), iz);
+			__m128 tn = _mm_max_ps(_mm_max_ps(_mm_min_ps(ax, bx), _mm_min_ps(ay, by)), _mm_max_ps(_mm_min_ps(az, bz), t0));
+			__m128 tf = _mm_min_ps(_mm_min_ps(_mm_max_ps(ax, bx), _mm_max_ps(ay, by)), _mm_min_ps(_mm_max_ps(az, bz), best));
+			if (!_mm_movemask_ps(_mm_cmple_ps(tn, tf))) continue;
+
+			if (node.nCount <= 0)
+			{
+				int axis = -1 - node.nCount;
+				stack[top++] = node.nIndex + !pNegative[axis];
+				stack[top++] = node.nIndex + pNegative[axis];
+				continue;
+			}
+
+			for (int i = node.nIndex; i < node.nIndex + node.nCount; i++)
+			{
+				const BVHTriangle& tri = pTriangles[i];
+				__m128 e1x = _mm_set1_ps(tri.e1[0]), e1y = _mm_set1_ps(tri.e1[1]), e1z = _mm_set1_ps(tri.e1[2]);
+				__m128 e2x = _mm_set1_ps(tri.e2[0]), e2y = _mm_set1_ps(tri.e2[1]), e2z = _mm_set1_ps(tri.e2[2]);
+
+				__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				__m128 idet = _mm_div_ps(one, det);
+
+				__m128 sx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0[0]));
+				__m128 sy = _mm_sub_ps(oy, _mm_set1_ps(tri.v0[1]));
+				__m128 sz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0[2]));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), idet);
+
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), idet);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), idet);
+
+				__m128 mask = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_cmpge_ps(u, zero));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, t0), _mm_cmplt_ps(t, best)));
+				if (!_mm_movemask_ps(mask)) continue;
+
+				best = select(mask, t, best);
+				hu = select(mask, u, hu);
+				hv = select(mask, v, hv);
+				id = _mm_castps_si128(select(mask, _mm_castsi128_ps(_mm_set1_epi32(i)), _mm_castsi128_ps(id)));
+			}
+		}
+
+		float t[4], u[4], v[4];
+		int index[4];
+		_mm_storeu_ps(t, best);
+		_mm_storeu_ps(u, hu);
+		_mm_storeu_ps(v, hv);
+		_mm_storeu_si128((__m128i*)index, id);
+		for (int i = 0; i < 4; i++)
+		{
+			if (index[i] < 0) continue;
+			const BVHPrimitive& src = pPrimitives[index[i]];
+			pHits[i] = { t[i],u[i],v[i],src.nObject,src.nPolygon,src.nTriangle,index[i] };
+		}
+#else
+		for (int i = 0; i < 4; i++)
+		{
+			if (rays.tmax[i] < rays.tmin[i]) continue;
+			Intersect({ rays.ox[i],rays.oy[i],rays.oz[i] }, { rays.dx[i],rays.dy[i],rays.dz[i] }, rays.tmin[i], rays.tmax[i], &pHits[i]);
+		}
+#endif
+	}
+
+	/**
+	 * @brief ȡ
+	*/
+	int GetTrianglesNum() const
+	{
+		return nTrianglesNum;
+	}
+
+	/**
+	 * @brief ȡεԴ
+	 * @param[in] i :  BVH е±꣨RayHit3D::nPrimitive
+	*/
+	const BVHPrimitive& GetPrimitive(int i) const
+	{
+		return pPrimitives[i];
+	}
+
+	/**
+	 * @brief ȡڵ
+	*/
+	int GetNodesNum() const
+	{
+		return nNodesNum;
+	}
+
+	/**
+	 * @brief ȡ BVH ռõڴ棨ֽڣ
+	 * @note ڵ鰴
+	*/
+	size_t GetMemoryUsage() const
+	{
+		return (sizeof(BVHNode) * 2 + sizeof(BVHTriangle) + sizeof(BVHPrimitive)) * (size_t)nTrianglesNum;
+	}
+
+	/**
+	 * @brief ȡ BVH İΧУBVH Ϊʱȫ
+	*/
+	Rectangle3D GetBounds() const
+	{
+		if (nNodesNum <= 0) return {};
+		const BVHNode& root = pNodes[0];
+		return { root.min[0],root.min[1],root.min[2],root.max[0],root.max[1],root.max[2] };
+	}
+};
+
+//////// ඨ
+
+/**
+ * @brief 3D 
+*/
+class Object3D
+{
+private:
+
+	Polygon3D* pPolygons;			/** @brief Ķ */
+	Polygon3D* pRotatedPolygons;	/** @brief ̬Ķ */
+	int nPolygonsNum;				/** @brief Ķ */
+
+	Point3D pCenter;			/** @brief ĵ */
+	Quaternion3D orientation;	/** @brief ̬ĵת */
+	int rotate_order[3];		/** @brief ת˳ֻŷ̬໥ת */
+
+	//// 棺ɶɣηɾʱؽ
+
+	Point3D* pVertices;			/** @brief ȥغĶ */
+	Point3D* pRotatedVertices;	/** @brief ̬Ķ */
+	Point3D* pNormals;			/** @brief 㷨ߣλɹ˶Ķεķ߰Ȩ͵õ */
+	Point3D* pRotatedNormals;	/** @brief ̬Ķ㷨 */
+	int nVerticesNum;			/** @brief  */
+	int* pIndices;				/** @brief εĸڶе±꣬˳УΪ GetPointsNum() */
+	int* pEdges;				/** @brief ȥغıߣÿԪΪһ˶± */
+	int nEdgesNum;				/** @brief ߵ */
+
+	MeshChunk* pChunks;			/** @brief 飬ûнпռʱΪ NULL */
+	int nChunksNum;				/** @brief  */
+	int* pSharedVertices;		/** @brief ֮ǰĿ鹲õĶ±꣬˳ */
+	int nSharedVerticesNum;		/** @brief б */
+
+	unsigned int nVersion;		/** @brief 汾ţÿ¼ΪȫΨһֵ */
+	Rectangle3D rectBounds;		/** @brief ̬İΧУһ */
+	bool bOccluder;				/** @brief ǷΪڵ壨 Scence3D::EnableOcclusionCulling */
+
+	/**
+	 * @brief ͷ
+	*/
+	void ClearIndex()
+	{
+		FreeArray(pVertices);
+		FreeArray(pRotatedVertices);
+		FreeArray(pNormals);
+		FreeArray(pRotatedNormals);
+		FreeArray(pIndices);
+		FreeArray(pEdges);
+		pVertices = pRotatedVertices = pNormals = pRotatedNormals = NULL;
+		pIndices = pEdges = NULL;
+		nVerticesNum = nEdgesNum = 0;
+	}
+
+	/**
+	 * @brief ͷ
+	*/
+	void ClearChunks()
+	{
+		FreeArray(pChunks);
+		FreeArray(pSharedVertices);
+		pChunks = NULL;
+		pSharedVertices = NULL;
+		nChunksNum = nSharedVerticesNum = 0;
+	}
+
+	/**
+	 * @brief еλáӵеĶ͹б
+	*/
+	void UpdateChunkRanges()
+	{
+		FreeArray(pSharedVertices);
+		pSharedVertices = NULL;
+		nSharedVerticesNum = 0;
+		if (!pChunks || !pIndices) return;
+
+		pSharedVertices = AllocArray<int>(GetPointsNum(), memory_mesh);
+		int* pStamp = AllocArray<int>(nVerticesNum, memory_mesh);
+		for (int i = 0; i < nVerticesNum; i++)
+			pStamp[i] = -1;
+
+		for (int c = 0, index = 0, i = 0, nOwned = 0; c < nChunksNum; c++)
+		{
+			MeshChunk& chunk = pChunks[c];
+			chunk.nFirstIndex = index;
+			chunk.nFirstVertex = nOwned;
+			chunk.nFirstShared = nSharedVerticesNum;
+			for (; i < chunk.nFirstPolygon + chunk.nPolygonsNum; i++)
+			{
+				for (int j = 0; j < pPolygons[i].nPointsNum; j++, index++)
+				{
+					int v = pIndices[index];
+					if (v >= chunk.nFirstVertex)
+					{
+						nOwned = std::max(nOwned, v + 1);
+					}
+					else if (pStamp[v] != c)
+					{
+						pStamp[v] = c;
+						pSharedVertices[nSharedVerticesNum++] = v;
+					}
+				}
+			}
+			chunk.nVerticesNum = nOwned - chunk.nFirstVertex;
+			chunk.nSharedNum = nSharedVerticesNum - chunk.nFirstShared;
+		}
+		FreeArray(pStamp);
+	}
+
+	/**
+	 * @brief 仯Ѱ汾ŸΪȫΨһֵBVH ȻݴжǷ仯
+	*/
+	void UpdateVersion()
+	{
+		static std::atomic<unsigned int> nLastVersion(0);
+		nVersion = ++nLastVersion;
+	}
+
+	/**
+	 * @brief ƽƺ͸İΧУƽƲı״Ҫ±㣩
+	 * @param[in] dx, dy, dz : ƽ
+	*/
+	void OffsetBounds(double dx, double dy, double dz)
+	{
+		if (nVerticesNum <= 0) return;
+		auto offset = [=](Rectangle3D* r) {
+			*r = { r->min_x + dx,r->min_y + dy,r->min_z + dz,r->max_x + dx,r->max_y + dy,r->max_z + dz };
+		};
+		offset(&rectBounds);
+		for (int c = 0; c < nChunksNum; c++)
+			offset(&pChunks[c].bounds);
+	}
+
+	/**
+	 * @brief µ˳жΣ̬ĶΣ
+	 * @param[in] pOrder : ˳ÿλöӦԭ±
+	 * @note Polygon3D ûڲṹһƶɣҪƶݡúҪؽ
+	*/
+	void PermutePolygons(const int* pOrder)
+	{
+		char* pTemp = AllocArray<char>(sizeof(Polygon3D) * nPolygonsNum, memory_mesh);
+		Polygon3D* pArrays[2] = { pPolygons,pRotatedPolygons };
+		for (Polygon3D* p : pArrays)
+		{
+			memcpy(pTemp, p, sizeof(Polygon3D) * nPolygonsNum);
+			for (int i = 0; i < nPolygonsNum; i++)
+				memcpy(p + i, pTemp + sizeof(Polygon3D) * pOrder[i], sizeof(Polygon3D));
+		}
+		FreeArray(pTemp);
+	}
+
+	/**
+	 * @brief ؽ棺ϲλͬĶ㣬вظı
+	 * @note ͬһߵĶΣڲıߣֻ¼һΣ߿ʱÿֻһ
+	*/
+	void UpdateIndex()
+	{
+		ClearIndex();
+
+		int nPointsNum = GetPointsNum();
+		if (nPointsNum <= 0) return;
+
+		pVertices = AllocArray<Point3D>(nPointsNum, memory_mesh);
+		pIndices = AllocArray<int>(nPointsNum, memory_mesh);
+
+		// ϲ
+		Point3D* pCorners = AllocArray<Point3D>(nPointsNum, memory_mesh);
+		for (int i = 0, index = 0; i < nPolygonsNum; i++)
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+				pCorners[index++] = pPolygons[i].pPoints[j];
+		nVerticesNum = WeldVertices(pCorners, nPointsNum, pVertices, pIndices);
+		FreeArray(pCorners);
+
+		UpdateTopology();
+	}
+
+	/**
+	 * @brief ȥغĶظıߺͶ㷨ߣ̬õ
+	*/
+	void UpdateTopology()
+	{
+		int nPointsNum = GetPointsNum();
+
+		// ռбߣС±ڸ 32 λȥ
+		unsigned long long* pKeys = AllocArray<unsigned long long>(nPointsNum, memory_mesh);
+		int nKeysNum = 0;
+		for (int i = 0, first = 0; i < nPolygonsNum; first += pPolygons[i].nPointsNum, i++)
+		{
+			int n = pPolygons[i].nPointsNum;
+			int nSides = n == 2 ? 1 : (n < 2 ? 0 : n);
+			for (int j = 0; j < nSides; j++)
+			{
+				unsigned int a = pIndices[first + j], b = pIndices[first + (j + 1) % n];
+				if (a == b) continue;
+				if (a > b) std::swap(a, b);
+				pKeys[nKeysNum++] = ((unsigned long long)a << 32) | b;
+			}
+		}
+		std::sort(pKeys, pKeys + nKeysNum);
+		nKeysNum = (int)(std::unique(pKeys, pKeys + nKeysNum) - pKeys);
+
+		pEdges = AllocArray<int>(nKeysNum * 2 + 1, memory_mesh);
+		for (int i = 0; i < nKeysNum; i++)
+		{
+			pEdges[i * 2] = (int)(pKeys[i] >> 32);
+			pEdges[i * 2 + 1] = (int)(pKeys[i] & 0xFFFFFFFF);
+		}
+		nEdgesNum = nKeysNum;
+		FreeArray(pKeys);
+
+		// 㷨ߣε Newell ߳ȣֱۼӼΪȨ
+		pNormals = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+		memset(pNormals, 0, sizeof Point3D * nVerticesNum);
+		for (int i = 0, first = 0; i < nPolygonsNum; first += pPolygons[i].nPointsNum, i++)
+		{
+			Point3D n = GetPolygonNormal(pPolygons[i].pPoints, pPolygons[i].nPointsNum);
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			{
+				Point3D& v = pNormals[pIndices[first + j]];
+				v.x += n.x;
+				v.y += n.y;
+				v.z += n.z;
+			}
+		}
+		for (int i = 0; i < nVerticesNum; i++)
+			pNormals[i] = Normalize3D(pNormals[i]);
+
+		pRotatedVertices = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+		pRotatedNormals = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+
+		UpdateChunkRanges();
+	}
+
+	/**
+	 * @brief	ĵλ
+	*/
+	void UpdateCenterPoint()
+	{
+		Rectangle3D r = GetRectangle(false);
+
+		pCenter = {
+			(r.max_x - r.min_x) / 2 + r.min_x,
+			(r.max_y - r.min_y) / 2 + r.min_y,
+			(r.max_z - r.min_z) / 2 + r.min_z
+		};
+	}
+
+	/**
+	 * @brief ת鳤
+	 * @param[in] nOldNum : ԭתĳ
+	 * @attention ԭе
+	*/
+	void UpdateRotatedPointsArrayLength(int nOldNum)
+	{
+		Polygon3D* newArray = new Polygon3D[nPolygonsNum];
+		DeletePolygons(pRotatedPolygons, nOldNum);
+		pRotatedPolygons = newArray;
+	}
+
+	/**
+	 * @brief жӶʱǷҪΪ
+	*/
+	static bool NeedTriangulate(Polygon3D& p, bool bTriangulateAll)
+	{
+		return p.nPointsNum > 3 && (bTriangulateAll || !IsConvexPolygon3D(p.pPoints, p.nPointsNum));
+	}
+
+	/**
+	 * @brief ѶβΪΣдѹĶ
+	 * @return 
+	*/
+	static int TriangulatePolygon(Polygon3D& src, Polygon3D* pDst)
+	{
+		int pTriangles[(POLYGON_MAX_SIDES - 2) * 3];
+		int count = TriangulatePolygon3D(src.pPoints, src.nPointsNum, pTriangles);
+		for (int i = 0; i < count; i++)
+		{
+			Polygon3D& dst = pDst[i];
+			if (src.pTexCoords && !dst.pTexCoords)
+				dst.pTexCoords = AllocArray<TexCoord>(POLYGON_MAX_SIDES, memory_polygon);
+			for (int j = 0; j < 3; j++)
+			{
+				int k = pTriangles[i * 3 + j];
+				dst.pPoints[j] = src.pPoints[k];
+				dst.pColors[j] = src.pColors[k];
+				if (src.pTexCoords) dst.pTexCoords[j] = src.pTexCoords[k];
+			}
+			dst.nPointsNum = 3;
+			dst.color = src.color;
+			dst.pTexture = src.pTexture;
+		}
+		return count;
+	}
+
+	/**
+	 * @brief Ԫ
+	 * @param[in] nOldNum : ǰĶ
+	 * @attention Ԫʱô˺
+	*/
+	void UpdateArray(int nOldNum)
+	{
+		UpdateCenterPoint();
+		UpdateRotatedPointsArrayLength(nOldNum);
+		ClearChunks();
+		UpdateIndex();
+		UpdateRotatedPoints();
+	}
+
+public:
+
+	Object3D()
+	{
+		pPolygons = NULL;
+		pRotatedPolygons = NULL;
+		nPolygonsNum = 0;
+		orientation = { 1,0,0,0 };
+		pCenter = { 0,0,0 };
+		rotate_order[0] = rotate_z;
+		rotate_order[1] = rotate_y;
+		rotate_order[2] = rotate_x;
+
+		pVertices = NULL;
+		pRotatedVertices = NULL;
+		pNormals = NULL;
+		pRotatedNormals = NULL;
+		nVerticesNum = 0;
+		pIndices = NULL;
+		pEdges = NULL;
+		nEdgesNum = 0;
+		pChunks = NULL;
+		nChunksNum = 0;
+		pSharedVertices = NULL;
+		nSharedVerticesNum = 0;
+		nVersion = 0;
+		rectBounds = {};
+		bOccluder = false;
+	}
+
+	~Object3D()
+	{
+		ClearIndex();
+		ClearChunks();
+
+		Polygon3D* p = NULL;
+		for (int i = 0; i < 2; i++)
+		{
+			if (i == 0) p = pPolygons;
+			else p = pRotatedPolygons;
+			DeletePolygons(p, nPolygonsNum);
+		}
+	}
+
+	/**
+	 * @brief ת˳
+	 * @note ̬Ԫ棬ת˳ֻ SetAttitude / GetAttitude νŷǣ
+	 *			Ӧ SetAttitude ֮ǰ
+	*/
+	void SetRotateOrder(int pOrder[3])
+	{
+		for (int i = 0; i < 3; i++)
+			rotate_order[i] = pOrder[i];
+	}
+
+	/**
+	 * @brief ȡת˳
+	*/
+	int* GetRotateOrder()
+	{
+		return rotate_order;
+	}
+
+	/**
+	 * @brief ȡе
+	*/
+	int GetPointsNum()
+	{
+		int num = 0;
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			num += pPolygons[i].nPointsNum;
+		}
+		return num;
+	}
+
+	/**
+	 * @brief ȡжε
+	*/
+	int GetPolygonsNum()
+	{
+		return nPolygonsNum;
+	}
+
+	/**
+	 * @brief ȡе
+	 * @param[in] rotated : Ƿȡתĵ
+	 * @attention  GetPointsNum ȡ
+	*/
+	ColorPoint3D* GetPoints(bool rotated = true)
+	{
+		Polygon3D* polygons = pPolygons;
+		if (rotated) polygons = pRotatedPolygons;
+		ColorPoint3D* p = new ColorPoint3D[GetPointsNum()];
+		for (int i = 0, index = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < polygons[i].nPointsNum; j++)
+			{
+				p[index] = ToColorPoint3D(polygons[i].pPoints[j]);
+				p[index].color = polygons[i].GetPointColor(j);
+				index++;
+			}
+		}
+		return p;
+	}
+
+	/**
+	 * @brief ȡеж
+	 * @param[in] rotated : ǷȡתĶ
+	 * @attention  GetPolygonsNum ȡε
+	*/
+	Polygon3D* GetPolygons(bool rotated = true)
+	{
+		if (rotated)
+		{
+			return pRotatedPolygons;
+		}
+		else
+		{
+			return pPolygons;
+		}
+	}
+
+	/**
+	 * @brief ȡȥغĶ
+	*/
+	int GetVerticesNum()
+	{
+		return nVerticesNum;
+	}
+
+	/**
+	 * @brief ȡȥغĶ
+	 * @param[in] rotated : ǷȡתĶ
+	 * @attention ʹ GetVerticesNum ȡصҪͷ
+	*/
+	Point3D* GetVertices(bool rotated = true)
+	{
+		return rotated ? pRotatedVertices : pVertices;
+	}
+
+	/**
+	 * @brief ȡȥغĶķ
+	 * @param[in] rotated : Ƿȡתķ
+	 * @attention  GetVertices صһһӦصҪͷ
+	 * @note κζεĶ㣨ĵ߶ΣΪ
+	*/
+	Point3D* GetNormals(bool rotated = true)
+	{
+		return rotated ? pRotatedNormals : pNormals;
+	}
+
+	/**
+	 * @brief ȡζڶе±
+	 * @note ˳У i ε±ǰ i εĶ֮Ϳʼ
+	*/
+	int* GetIndices()
+	{
+		return pIndices;
+	}
+
+	/**
+	 * @brief ȡвظıߵ
+	*/
+	int GetEdgesNum()
+	{
+		return nEdgesNum;
+	}
+
+	/**
+	 * @brief ȡռõڴ棨ֽڣ
+	 * @param[out] pPolygonBytes : ضݣԭʼκͼ̬ĶݣռõֽΪ NULL
+	 * @param[out] pMeshBytes : 棨㡢ߡߣռõֽΪ NULL
+	 * @return ֽ屾
+	 * @note ÿ۱٣䶥ɫ
+	*/
+	size_t GetMemoryUsage(size_t* pPolygonBytes = NULL, size_t* pMeshBytes = NULL)
+	{
+		size_t nPolygonBytes = 0;
+		Polygon3D* pArrays[2] = { pPolygons,pRotatedPolygons };
+		for (Polygon3D* p : pArrays)
+		{
+			if (!p) continue;
+			for (int i = 0; i < nPolygonsNum; i++)
+			{
+				nPolygonBytes += sizeof(Polygon3D);
+				if (p[i].pPoints) nPolygonBytes += sizeof(Point3D) * POLYGON_MAX_SIDES;
+				if (p[i].pColors) nPolygonBytes += sizeof(Color) * POLYGON_MAX_SIDES;
+				if (p[i].pTexCoords) nPolygonBytes += sizeof(TexCoord) * POLYGON_MAX_SIDES;
+			}
+		}
+		size_t nMeshBytes = sizeof(Point3D) * 4 * nVerticesNum + sizeof(int) * (pIndices ? GetPointsNum() : 0)
+			+ sizeof(int) * (pEdges ? nEdgesNum * 2 + 1 : 0) + sizeof(MeshChunk) * nChunksNum + sizeof(int) * (pSharedVertices ? GetPointsNum() : 0);
+
+		if (pPolygonBytes) *pPolygonBytes = nPolygonBytes;
+		if (pMeshBytes) *pMeshBytes = nMeshBytes;
+		return sizeof(Object3D) + nPolygonBytes + nMeshBytes;
+	}
+
+	/**
+	 * @brief ȡвظı
+	 * @return ÿԪΪһ˶±꣨Ӧ GetVertices ص飩
+	*/
+	int* GetEdges()
+	{
+		return pEdges;
+	}
+
+	/**
+	 * @brief ȡ尴ǰ˳ʱƽδʣACMR
+	 * @param[in] nCacheSize : ģĶ㻺С
+	 * @see HD3D::GetACMR
+	*/
+	double GetACMR(int nCacheSize = VERTEX_CACHE_SIZE)
+	{
+		if (!pIndices) return 0;
+		int* pSizes = AllocArray<int>(nPolygonsNum, memory_mesh);
+		for (int i = 0; i < nPolygonsNum; i++)
+			pSizes[i] = pPolygons[i].nPointsNum;
+		double acmr = HD3D::GetACMR(pIndices, pSizes, nPolygonsNum, nVerticesNum, nCacheSize);
+		FreeArray(pSizes);
+		return acmr;
+	}
+
+	/**
+	 * @brief 㻺ŻжΣʹڵĶξö㣬ٰ״ʹõ˳±Ŷ
+	 * @note ֻıε˳򣬲ı״һΣ֮任ͻʱ˳ʶ顣
+	 *			Ѿпռŵֻÿڲţ鱣ֲ䡣
+	 *			ÿĶ±껻ɿڵ±꣨ǿӵеĶ㣬ǹ㣩ŻֻĴСйء
+	 *			˳ģⶥ㻺棨ǰĿĻ״̬ŻδûмٵĿ鱣ԭ˳
+	 *			δûмʱκθı
+	 * @see HD3D::OptimizeVertexCache
+	*/
+	void OptimizeVertexCache()
+	{
+		if (!pIndices || nPolygonsNum <= 1) return;
+		if (pChunks && !pSharedVertices) return;
+
+		int nPointsNum = GetPointsNum();
+		int* pSizes = AllocArray<int>(nPolygonsNum, memory_mesh);
+		int* pOrder = AllocArray<int>(nPolygonsNum, memory_mesh);
+		int* pLocal = AllocArray<int>(nVerticesNum, memory_mesh);
+		int* pLocalIndices = AllocArray<int>(nPointsNum, memory_mesh);
+		int* pFirst = AllocArray<int>(nPolygonsNum + 1, memory_mesh);
+		pFirst[0] = 0;
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			pSizes[i] = pPolygons[i].nPointsNum;
+			pFirst[i + 1] = pFirst[i] + pSizes[i];
+		}
+
+		// ģ FIFO 㻺棨 HD3D::GetACMR ͬذ pOrder ˳ƿڶʱδеĶ
+		int pCache[VERTEX_CACHE_SIZE], pTrial[VERTEX_CACHE_SIZE], pOriginal[VERTEX_CACHE_SIZE];
+		int nCacheNum = 0, nCacheHead = 0, nOriginalNum = 0, nOriginalHead = 0;
+		long long nTotalMisses = 0, nOriginalMisses = 0;
+		auto simulate = [&](int first, int nFaces, const int* pFaceOrder, int* pState, int* pNum, int* pHead) {
+			int nMisses = 0;
+			for (int i = 0; i < nFaces; i++)
+			{
+				int f = first + (pFaceOrder ? pFaceOrder[i] : i);
+				for (int j = pFirst[f]; j < pFirst[f + 1]; j++)
+				{
+					int v = pIndices[j];
+					bool bHit = false;
+					for (int k = 0; k < *pNum && !bHit; k++)
+						bHit = pState[k] == v;
+					if (bHit) continue;
+					nMisses++;
+					if (*pNum < VERTEX_CACHE_SIZE)
+						pState[(*pNum)++] = v;
+					else
+					{
+						pState[*pHead] = v;
+						*pHead = (*pHead + 1) % VERTEX_CACHE_SIZE;
+					}
+				}
+			}
+			return nMisses;
+		};
+
+		MeshChunk whole = { 0,nPolygonsNum,0,0,nVerticesNum,0,0,{} };
+		MeshChunk* p = pChunks ? pChunks : &whole;
+		int num = pChunks ? nChunksNum : 1;
+		for (int c = 0; c < num; c++)
+		{
+			const MeshChunk& chunk = p[c];
+			int first = chunk.nFirstPolygon;
+			int nFaces = chunk.nPolygonsNum;
+			int nIndices = pFirst[first + nFaces] - pFirst[first];
+			int nLocalNum = chunk.nVerticesNum + chunk.nSharedNum;
+			for (int k = 0; k < chunk.nVerticesNum; k++)
+				pLocal[chunk.nFirstVertex + k] = k;
+			for (int k = 0; k < chunk.nSharedNum; k++)
+				pLocal[pSharedVertices[chunk.nFirstShared + k]] = chunk.nVerticesNum + k;
+			for (int i = 0; i < nIndices; i++)
+				pLocalIndices[i] = pLocal[pIndices[chunk.nFirstIndex + i]];
+
+			HD3D::OptimizeVertexCache(pLocalIndices, pSizes + first, nFaces, nLocalNum, pOrder + first);
+
+			// ǰĿµĻ״̬ʼȽ¾˳δϺõ˳֮Ļ״̬
+			int nTrialNum = nCacheNum, nTrialHead = nCacheHead;
+			memcpy(pTrial, pCache, sizeof(int) * nCacheNum);
+			int nNewMisses = simulate(first, nFaces, pOrder + first, pTrial, &nTrialNum, &nTrialHead);
+			int nOldMisses = simulate(first, nFaces, NULL, pCache, &nCacheNum, &nCacheHead);
+			bool bBetter = nNewMisses < nOldMisses;
+			nTotalMisses += bBetter ? nNewMisses : nOldMisses;
+			nOriginalMisses += simulate(first, nFaces, NULL, pOriginal, &nOriginalNum, &nOriginalHead);
+			if (bBetter)
+			{
+				memcpy(pCache, pTrial, sizeof(int) * nTrialNum);
+				nCacheNum = nTrialNum;
+				nCacheHead = nTrialHead;
+			}
+			for (int i = 0; i < nFaces; i++)
+				pOrder[first + i] = bBetter ? pOrder[first + i] + first : first + i;
+		}
+		bool bImproved = nTotalMisses < nOriginalMisses;
+		if (bImproved)
+			PermutePolygons(pOrder);
+
+		FreeArray(pSizes);
+		FreeArray(pOrder);
+		FreeArray(pLocal);
+		FreeArray(pLocalIndices);
+		FreeArray(pFirst);
+		if (!bImproved) return;
+
+		// 水˳ؽ㰴״ʹõ˳
+		UpdateIndex();
+		UpdateRotatedPoints();
+	}
+
+	/**
+	 * @brief ռţڿռϵ˳жΣǷΪ
+	 * @param[in] nChunkSize : ÿĶ
+	 * @param[in] curve : ʹõĿռ
+	 * @note ź󶥵㰴״ʹõ˳ţͬһĶκͶڴ
+	 *			ʱÿԼİΧе׶޳ڵ޳ɼĿ
+	 *			ʺϵƣÿһΣͽϴɾκʧЧҪµ
+	*/
+	void SpatialReorder(int nChunkSize = MESH_CHUNK_SIZE, SpaceCurve curve = curve_hilbert)
+	{
+		if (nPolygonsNum <= 0 || nChunkSize <= 0) return;
+
+		Point3D* pCenters = AllocArray<Point3D>(nPolygonsNum, memory_mesh);
+		int* pOrder = AllocArray<int>(nPolygonsNum, memory_mesh);
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			Point3D c = { 0,0,0 };
+			int n = pPolygons[i].nPointsNum;
+			for (int j = 0; j < n; j++)
+			{
+				c.x += pPolygons[i].pPoints[j].x;
+				c.y += pPolygons[i].pPoints[j].y;
+				c.z += pPolygons[i].pPoints[j].z;
+			}
+			if (n > 0)
+				c = { c.x / n,c.y / n,c.z / n };
+			pCenters[i] = c;
+		}
+		SortBySpaceCurve(pCenters, nPolygonsNum, pOrder, curve);
+		PermutePolygons(pOrder);
+		FreeArray(pCenters);
+		FreeArray(pOrder);
+
+		ClearChunks();
+		nChunksNum = (nPolygonsNum + nChunkSize - 1) / nChunkSize;
+		pChunks = AllocArray<MeshChunk>(nChunksNum, memory_mesh);
+		for (int c = 0; c < nChunksNum; c++)
+		{
+			pChunks[c] = {};
+			pChunks[c].nFirstPolygon = c * nChunkSize;
+			pChunks[c].nPolygonsNum = std::min(nChunkSize, nPolygonsNum - c * nChunkSize);
+		}
+
+		UpdateIndex();
+		UpdateRotatedPoints();
+	}
+
+	/**
+	 * @brief 
+	 * @param[in] p : 飬ֻʹ nFirstPolygon  nPolygonsNum밴˳жΣΪ NULL ʾȡֿ
+	 * @param[in] num : 
+	 * @return βƥʱ false޸
+	 * @note ڸѾйռŵ壨 Scence3D::AddObject
+	*/
+	bool SetChunks(const MeshChunk* p, int num)
+	{
+		if (!p || num <= 0)
+		{
+			ClearChunks();
+			return true;
+		}
+		for (int c = 0, next = 0; c < num; c++)
+		{
+			if (p[c].nFirstPolygon != next || p[c].nPolygonsNum < 0)
+				return false;
+			next += p[c].nPolygonsNum;
+			if (c == num - 1 && next != nPolygonsNum)
+				return false;
+		}
+
+		ClearChunks();
+		nChunksNum = num;
+		pChunks = AllocArray<MeshChunk>(num, memory_mesh);
+		for (int c = 0; c < num; c++)
+		{
+			pChunks[c] = {};
+			pChunks[c].nFirstPolygon = p[c].nFirstPolygon;
+			pChunks[c].nPolygonsNum = p[c].nPolygonsNum;
+		}
+		if (pIndices)
+		{
+			UpdateChunkRanges();
+			UpdateRotatedPoints();
+		}
+		return true;
+	}
+
+	/**
+	 * @brief ȡ
+	 * @return ûнпռʱ NULL
+	 * @attention ʹ GetChunksNum ȡصҪͷ
+	*/
+	MeshChunk* GetChunks()
+	{
+		return pChunks;
+	}
+
+	/**
+	 * @brief ȡ
+	*/
+	int GetChunksNum()
+	{
+		return nChunksNum;
+	}
+
+	/**
+	 * @brief ȡ֮ǰĿ鹲õĶ㣨 MeshChunk::nFirstShared
+	 * @attention صҪͷ
+	*/
+	int* GetSharedVertices()
+	{
+		return pSharedVertices;
+	}
+
+	/**
+	 * @brief ȡĵ
+	*/
+	Point3D GetCenterPoint()
+	{
+		return pCenter;
+	}
+
+	/**
+	 * @brief ȡλãЧ GetCenterPoint ͬ
+	*/
+	Point3D GetPosition()
+	{
+		return GetCenterPoint();
+	}
+
+	/**
+	 * @brief ƶ嵽ĳλã
+	*/
+	void MoveTo(Point3D pNew)
+	{
+		double offset_x = pNew.x - pCenter.x;
+		double offset_y = pNew.y - pCenter.y;
+		double offset_z = pNew.z - pCenter.z;
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			{
+				pPolygons[i].pPoints[j].x += offset_x;
+				pPolygons[i].pPoints[j].y += offset_y;
+				pPolygons[i].pPoints[j].z += offset_z;
+
+				pRotatedPolygons[i].pPoints[j].x += offset_x;
+				pRotatedPolygons[i].pPoints[j].y += offset_y;
+				pRotatedPolygons[i].pPoints[j].z += offset_z;
+			}
+		}
+		for (int i = 0; i < nVerticesNum; i++)
+		{
+			pVertices[i].x += offset_x;
+			pVertices[i].y += offset_y;
+			pVertices[i].z += offset_z;
+
+			pRotatedVertices[i].x += offset_x;
+			pRotatedVertices[i].y += offset_y;
+			pRotatedVertices[i].z += offset_z;
+		}
+
+		pCenter = pNew;
+		OffsetBounds(offset_x, offset_y, offset_z);
+		UpdateVersion();
+	}
+
+	/**
+	 * @brief  x ᷽ƶ
+	*/
+	void MoveX(double n)
+	{
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			{
+				pPolygons[i].pPoints[j].x += n;
+				pRotatedPolygons[i].pPoints[j].x += n;
+			}
+		}
+		for (int i = 0; i < nVerticesNum; i++)
+		{
+			pVertices[i].x += n;
+			pRotatedVertices[i].x += n;
+		}
+
+		pCenter.x += n;
+		OffsetBounds(n, 0, 0);
+		UpdateVersion();
+	}
+
+	/**
+	 * @brief  y ᷽ƶ
+	*/
+	void MoveY(double n)
+	{
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			{
+				pPolygons[i].pPoints[j].y += n;
+				pRotatedPolygons[i].pPoints[j].y += n;
+			}
+		}
+		for (int i = 0; i < nVerticesNum; i++)
+		{
+			pVertices[i].y += n;
+			pRotatedVertices[i].y += n;
+		}
+
+		pCenter.y += n;
+		OffsetBounds(0, n, 0);
+		UpdateVersion();
+	}
+
+	/**
+	 * @brief  z ᷽ƶ
+	*/
+	void MoveZ(double n)
+	{
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			{
+				pPolygons[i].pPoints[j].z += n;
+				pRotatedPolygons[i].pPoints[j].z += n;
+			}
+		}
+		for (int i = 0; i < nVerticesNum; i++)
+		{
+			pVertices[i].z += n;
+			pRotatedVertices[i].z += n;
+		}
+
+		pCenter.z += n;
+		OffsetBounds(0, 0, n);
+		UpdateVersion();
+	}
+
+	/**
+	 * @brief ͬʱλãĵ㣩̬
+	 * @param[in] pos : µĵλ
+	 * @param[in] q : µ̬
+	 * @note Ч MoveToSetOrientation  UpdateRotatedPoints ͬԭʼֻƽһ飬
+	 *			ֻ̬һ顣ÿ֡´Ķ Animator3D
+	*/
+	void SetTransform(Point3D pos, Quaternion3D q)
+	{
+		double offset_x = pos.x - pCenter.x;
+		double offset_y = pos.y - pCenter.y;
+		double offset_z = pos.z - pCenter.z;
+		if (offset_x != 0 || offset_y != 0 || offset_z != 0)
+		{
+			for (int i = 0; i < nPolygonsNum; i++)
+			{
+				for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+				{
+					pPolygons[i].pPoints[j].x += offset_x;
+					pPolygons[i].pPoints[j].y += offset_y;
+					pPolygons[i].pPoints[j].z += offset_z;
+				}
+			}
+			for (int i = 0; i < nVerticesNum; i++)
+			{
+				pVertices[i].x += offset_x;
+				pVertices[i].y += offset_y;
+				pVertices[i].z += offset_z;
+			}
+			pCenter = pos;
+		}
+		orientation = NormalizeQuaternion(q);
+		UpdateRotatedPoints();
+	}
+
+	/**
+	 * @brief ̬
+	 * @param[in] ati : ŷ̬ת˳
+	*/
+	void SetAttitude(Attitude3D ati)
+	{
+		orientation = ConvertAttitudeToQuaternion(ati, rotate_order);
+	}
+
+	/**
+	 * @brief ȡ̬
+	 * @return ذת˳뵱ǰ̬ЧŷǣһʱĽǶͬ
+	*/
+	Attitude3D GetAttitude()
+	{
+		return ConvertQuaternionToAttitude(orientation, rotate_order);
+	}
+
+	/**
+	 * @brief Ԫ̬
+	*/
+	void SetOrientation(Quaternion3D q)
+	{
+		orientation = NormalizeQuaternion(q);
+	}
+
+	/**
+	 * @brief Ԫȡ̬
+	*/
+	Quaternion3D GetOrientation()
+	{
+		return orientation;
+	}
+
+	/**
+	 * @brief ڵǰ̬ٵһת
+	 * @param[in] q : תϵᣬΪԭ㣩
+	*/
+	void Rotate(Quaternion3D q)
+	{
+		orientation = NormalizeQuaternion(MultiplyQuaternion(q, orientation));
+	}
+
+	/**
+	 * @brief ϵ x ̬תͬ Rotate3D_X
+	 * @note ֱӸϵ̬Ԫϣ
+	*/
+	void RotateX(double angle)
+	{
+		Rotate(GetRotateQuaternion(rotate_x, angle));
+	}
+
+	/**
+	 * @brief ϵ y ̬תͬ Rotate3D_Y
+	*/
+	void RotateY(double angle)
+	{
+		Rotate(GetRotateQuaternion(rotate_y, angle));
+	}
+
+	/**
+	 * @brief ϵ z ̬תͬ Rotate3D_Z
+	*/
+	void RotateZ(double angle)
+	{
+		Rotate(GetRotateQuaternion(rotate_z, angle));
+	}
+
+	/**
+	 * @brief ȡάα߿
+	 * @param[in] bRotated : ǷȡѾתı߿
+	 * @return ߿
+	*/
+	Rectangle3D GetRectangle(bool bRotated = true)
+	{
+		Rectangle3D r = {};
+		Polygon3D* p = pPolygons;
+		if(bRotated && pRotatedPolygons)
+			p = pRotatedPolygons;
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < p[i].nPointsNum; j++)
+			{
+				// init
+				if (i + j == 0)
+				{
+					r.min_x = r.max_x = p[i].pPoints[j].x;
+					r.min_y = r.max_y = p[i].pPoints[j].y;
+					r.min_z = r.max_z = p[i].pPoints[j].z;
+					continue;
+				}
+
+				if (p[i].pPoints[j].x < r.min_x)
+					r.min_x = p[i].pPoints[j].x;
+				else if (p[i].pPoints[j].x > r.max_x)
+					r.max_x = p[i].pPoints[j].x;
+
+				if (p[i].pPoints[j].y < r.min_y)
+					r.min_y = p[i].pPoints[j].y;
+				else if (p[i].pPoints[j].y > r.max_y)
+					r.max_y = p[i].pPoints[j].y;
+
+				if (p[i].pPoints[j].z < r.min_z)
+					r.min_z = p[i].pPoints[j].z;
+				else if (p[i].pPoints[j].z > r.max_z)
+					r.max_z = p[i].pPoints[j].z;
+			}
+		}
+		return r;
+	}
+
+	/**
+	 * @brief ת飬̬
+	 * @attention û̬󲻻µ꣬Ҫֶ
+	 *			˺м㡣
+	*/
+	void UpdateRotatedPoints()
+	{
+		// ̬ÿֻתһΪÿ㲻ټǺ
+		Matrix3D mat = GetQuaternionMatrix(orientation);
+		auto rotate = [&mat, this](Point3D p) -> Point3D {
+			Point3D r = TransformPoint3D(mat, { p.x - pCenter.x,p.y - pCenter.y,p.z - pCenter.z });
+			return { r.x + pCenter.x,r.y + pCenter.y,r.z + pCenter.z };
+		};
+
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			CopyPolygons(&pRotatedPolygons[i], &pPolygons[i], 1);
+			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			{
+				pRotatedPolygons[i].pPoints[j] = rotate(pPolygons[i].pPoints[j]);
+			}
+		}
+		for (int i = 0; i < nVerticesNum; i++)
+		{
+			pRotatedVertices[i] = rotate(pVertices[i]);
+			pRotatedNormals[i] = TransformPoint3D(mat, pNormals[i]);
+		}
+
+		rectBounds = {};
+		for (int i = 0; i < nVerticesNum; i++)
+		{
+			const Point3D& p = pRotatedVertices[i];
+			if (i == 0)
+			{
+				rectBounds = { p.x,p.y,p.z,p.x,p.y,p.z };
+				continue;
+			}
+			rectBounds.min_x = std::min(rectBounds.min_x, p.x);
+			rectBounds.min_y = std::min(rectBounds.min_y, p.y);
+			rectBounds.min_z = std::min(rectBounds.min_z, p.z);
+			rectBounds.max_x = std::max(rectBounds.max_x, p.x);
+			rectBounds.max_y = std::max(rectBounds.max_y, p.y);
+			rectBounds.max_z = std::max(rectBounds.max_z, p.z);
+		}
+
+		for (int c = 0; c < nChunksNum; c++)
+		{
+			MeshChunk& chunk = pChunks[c];
+			chunk.bounds = {};
+			int nIndicesNum = 0;
+			for (int i = chunk.nFirstPolygon; i < chunk.nFirstPolygon + chunk.nPolygonsNum; i++)
+				nIndicesNum += pPolygons[i].nPointsNum;
+			for (int k = 0; k < nIndicesNum; k++)
+			{
+				const Point3D& p = pRotatedVertices[pIndices[chunk.nFirstIndex + k]];
+				if (k == 0)
+				{
+					chunk.bounds = { p.x,p.y,p.z,p.x,p.y,p.z };
+					continue;
+				}
+				chunk.bounds.min_x = std::min(chunk.bounds.min_x, p.x);
+				chunk.bounds.min_y = std::min(chunk.bounds.min_y, p.y);
+				chunk.bounds.min_z = std::min(chunk.bounds.min_z, p.z);
+				chunk.bounds.max_x = std::max(chunk.bounds.max_x, p.x);
+				chunk.bounds.max_y = std::max(chunk.bounds.max_y, p.y);
+				chunk.bounds.max_z = std::max(chunk.bounds.max_z, p.z);
+			}
+		}
+
+		UpdateVersion();
+	}
+
+	/**
+	 * @brief ȡ̬İΧ
+	 * @note  GetRectangle() ͬ UpdateRotatedPoints ԤãҪ
+	*/
+	Rectangle3D GetBounds()
+	{
+		return rectBounds;
+	}
+
+	/**
+	 * @brief ǷΪڵ
+	 * @note ڵ޳ʱڵ崦дȻ壻
+	 *			ʺϰǽڡȴ򵥵Ϊڵ塣ڵ屾ᱻ޳
+	*/
+	void SetOccluder(bool occluder)
+	{
+		bOccluder = occluder;
+	}
+
+	/**
+	 * @brief жǷΪڵ
+	*/
+	bool IsOccluder()
+	{
+		return bOccluder;
+	}
+
+	/**
+	 * @brief ȡİ汾
+	 * @note ÿε UpdateRotatedPointsɾΣ󶼻ΪһµġΨһֵ
+	 *			жϸɵĻ棨糡 BVHǷҪ
+	*/
+	unsigned int GetVersion()
+	{
+		return nVersion;
+	}
+
+	/**
+	 * @brief 滻ȫ
+	 * @param[in] pMeshVertices : 飬ӦѾȥأ WeldVerticesλͬĶ㲻Ṳ÷
+	 * @param[in] pMeshColors : ɫΪ NULL ʾûжɫ
+	 * @param[in] nMeshVerticesNum : 
+	 * @param[in] pTriangles : ÿԪΪһε±
+	 * @param[in] nTrianglesNum : 
+	 * @param[in] color : εɫжɫʱΪ -1 
+	 * @return ±Խʱ false޸
+	 * @note  AddPolygons ֱͬд棬ٰϲһ飻
+	 *			ûбõĶᱻȥඥ㰴״ʹõ˳šģͣ ReadMeshFileʹ
+	*/
+	bool SetMesh(const Point3D* pMeshVertices, const Color* pMeshColors, int nMeshVerticesNum, const int* pTriangles, int nTrianglesNum, Color color = WHITE)
+	{
+		if (nTrianglesNum < 0 || (nTrianglesNum > 0 && (!pMeshVertices || !pTriangles))) return false;
+		for (int i = 0; i < nTrianglesNum * 3; i++)
+			if (pTriangles[i] < 0 || pTriangles[i] >= nMeshVerticesNum)
+				return false;
+
+		int nOldNum = nPolygonsNum;
+		DeletePolygons(pPolygons, nPolygonsNum);
+		nPolygonsNum = nTrianglesNum;
+		pPolygons = new Polygon3D[nPolygonsNum];
+		for (int i = 0; i < nTrianglesNum; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				int v = pTriangles[i * 3 + j];
+				pPolygons[i].pPoints[j] = pMeshVertices[v];
+				if (pMeshColors) pPolygons[i].pColors[j] = pMeshColors[v];
+			}
+			pPolygons[i].nPointsNum = 3;
+			pPolygons[i].color = pMeshColors ? -1 : color;
+		}
+
+		UpdateCenterPoint();
+		UpdateRotatedPointsArrayLength(nOldNum);
+		ClearChunks();
+		ClearIndex();
+
+		if (nTrianglesNum > 0)
+		{
+			int* pRemap = AllocArray<int>(nMeshVerticesNum, memory_mesh);
+			for (int i = 0; i < nMeshVerticesNum; i++)
+				pRemap[i] = -1;
+			pVertices = AllocArray<Point3D>(nMeshVerticesNum, memory_mesh);
+			pIndices = AllocArray<int>(nTrianglesNum * 3, memory_mesh);
+			for (int i = 0; i < nTrianglesNum * 3; i++)
+			{
+				int v = pTriangles[i];
+				if (pRemap[v] < 0)
+				{
+					pRemap[v] = nVerticesNum;
+					pVertices[nVerticesNum++] = pMeshVertices[v];
+				}
+				pIndices[i] = pRemap[v];
+			}
+			FreeArray(pRemap);
+			UpdateTopology();
+		}
+		UpdateRotatedPoints();
+		return true;
+	}
+
+	/**
+	 * @brief һ彻񣨶Ρ桢ͰΧУ
+	 * @param[in, out] obj : һ
+	 * @note ָֻ룬ƶΡ̬ת˳ڵԭУ
+	 *			̬ͬʱ̬һ𽻻尴Լ̬¼㣬
+	 *			obj Ҫ UpdateRotatedPoints ̬
+	 *			ڰ߳нõȾ壨 MeshStreamer
+	*/
+	void SwapMesh(Object3D& obj)
+	{
+		std::swap(pPolygons, obj.pPolygons);
+		std::swap(pRotatedPolygons, obj.pRotatedPolygons);
+		std::swap(nPolygonsNum, obj.nPolygonsNum);
+		std::swap(pCenter, obj.pCenter);
+		std::swap(pVertices, obj.pVertices);
+		std::swap(pRotatedVertices, obj.pRotatedVertices);
+		std::swap(pNormals, obj.pNormals);
+		std::swap(pRotatedNormals, obj.pRotatedNormals);
+		std::swap(nVerticesNum, obj.nVerticesNum);
+		std::swap(pIndices, obj.pIndices);
+		std::swap(pEdges, obj.pEdges);
+		std::swap(nEdgesNum, obj.nEdgesNum);
+		std::swap(pChunks, obj.pChunks);
+		std::swap(nChunksNum, obj.nChunksNum);
+		std::swap(pSharedVertices, obj.pSharedVertices);
+		std::swap(nSharedVerticesNum, obj.nSharedVerticesNum);
+		std::swap(nVersion, obj.nVersion);
+		std::swap(rectBounds, obj.rectBounds);
+
+		const Quaternion3D& q = obj.orientation;
+		if (orientation.w != q.w || orientation.x != q.x || orientation.y != q.y || orientation.z != q.z)
+			UpdateRotatedPoints();
+	}
+
+	/**
+	 * @brief ӹѾõĶ棬滻ȫ
+	 * @param[in] pNew : 飨new Polygon3D[num] 䣩ɹʱӹܣҪͷ
+	 * @param[in] num : 
+	 * @param[in] pMeshVertices : ȥغĶ
+	 * @param[in] pMeshNormals : 㷨
+	 * @param[in] nMeshVerticesNum : 
+	 * @param[in] pMeshIndices : εĸڶе±꣬ΪжεĶ֮
+	 * @param[in] pMeshEdges : ظıߣÿԪΪһ˶±
+	 * @param[in] nMeshEdgesNum : ߵ
+	 * @param[in] pMeshChunks : 飬ֻʹ nFirstPolygon  nPolygonsNumΪ NULL ʾֿ
+	 * @param[in] nMeshChunksNum : 
+	 * @return ±Խβƥʱ false޸ģpNew ɵͷ
+	 * @note 㡢ߡͱֱӸƣٺϲ㡢ߺͷߣ嵱ǰ̬ꡣ
+	 *			ЩӦһ GetVertices(false)GetNormals(false)GetIndicesGetEdges  GetChunks
+	 *			ڻָգ LoadScenceSnapshot
+	*/
+	bool AttachMesh(Polygon3D* pNew, int num, const Point3D* pMeshVertices, const Point3D* pMeshNormals, int nMeshVerticesNum,
+		const int* pMeshIndices, const int* pMeshEdges, int nMeshEdgesNum, const MeshChunk* pMeshChunks = NULL, int nMeshChunksNum = 0)
+	{
+		if (num < 0 || (num > 0 && !pNew) || nMeshVerticesNum < 0 || nMeshEdgesNum < 0) return false;
+		int nPointsNum = 0;
+		for (int i = 0; i < num; i++)
+		{
+			if (pNew[i].nPointsNum < 0 || pNew[i].nPointsNum > POLYGON_MAX_SIDES) return false;
+			nPointsNum += pNew[i].nPointsNum;
+		}
+		if (nPointsNum > 0 && (!pMeshVertices || !pMeshNormals || !pMeshIndices || (nMeshEdgesNum > 0 && !pMeshEdges))) return false;
+		for (int i = 0; i < nPointsNum; i++)
+			if (pMeshIndices[i] < 0 || pMeshIndices[i] >= nMeshVerticesNum)
+				return false;
+		for (int i = 0; i < nMeshEdgesNum * 2; i++)
+			if (pMeshEdges[i] < 0 || pMeshEdges[i] >= nMeshVerticesNum)
+				return false;
+		if (pMeshChunks && nMeshChunksNum > 0)
+		{
+			for (int c = 0, next = 0; c < nMeshChunksNum; c++)
+			{
+				if (pMeshChunks[c].nFirstPolygon != next || pMeshChunks[c].nPolygonsNum < 0)
+					return false;
+				next += pMeshChunks[c].nPolygonsNum;
+				if (c == nMeshChunksNum - 1 && next != num)
+					return false;
+			}
+		}
+
+		int nOldNum = nPolygonsNum;
+		DeletePolygons(pPolygons, nPolygonsNum);
+		pPolygons = pNew;
+		nPolygonsNum = num;
+
+		UpdateCenterPoint();
+		UpdateRotatedPointsArrayLength(nOldNum);
+		ClearChunks();
+		ClearIndex();
+
+		if (nPointsNum > 0)
+		{
+			nVerticesNum = nMeshVerticesNum;
+			pVertices = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+			pNormals = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+			pRotatedVertices = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+			pRotatedNormals = AllocArray<Point3D>(nVerticesNum, memory_mesh);
+			memcpy(pVertices, pMeshVertices, sizeof(Point3D) * nVerticesNum);
+			memcpy(pNormals, pMeshNormals, sizeof(Point3D) * nVerticesNum);
+			pIndices = AllocArray<int>(nPointsNum, memory_mesh);
+			memcpy(pIndices, pMeshIndices, sizeof(int) * nPointsNum);
+			nEdgesNum = nMeshEdgesNum;
+			pEdges = AllocArray<int>(nEdgesNum * 2 + 1, memory_mesh);
+			if (nEdgesNum > 0)
+				memcpy(pEdges, pMeshEdges, sizeof(int) * nEdgesNum * 2);
+		}
+		if (pMeshChunks && nMeshChunksNum > 0)
+		{
+			nChunksNum = nMeshChunksNum;
+			pChunks = AllocArray<MeshChunk>(nChunksNum, memory_mesh);
+			for (int c = 0; c < nChunksNum; c++)
+			{
+				pChunks[c] = {};
+				pChunks[c].nFirstPolygon = pMeshChunks[c].nFirstPolygon;
+				pChunks[c].nPolygonsNum = pMeshChunks[c].nPolygonsNum;
+			}
+			UpdateChunkRanges();
+		}
+		UpdateRotatedPoints();
+		return true;
+	}
+
+	/**
+	 * @brief ӵ
+	 * @attention ˺ԵΪλӣÿ㶼Ϊһβ
+	 * @param[in] pNew : Ҫӵĵ
+	 * @param[in] num : Ҫӵĵ
+	 * @return ӵģеĵһʧܷ -1
+	*/
+	int AddPoints(ColorPoint3D* pNew, int num)
+	{
+		if (num <= 0 || !pNew)	return -1;
+
+		Polygon3D* newArray = new Polygon3D[nPolygonsNum + num];
+		CopyPolygons(newArray, pPolygons, nPolygonsNum);
+
+		for (int i = nPolygonsNum, j = 0; j < num; i++, j++)
+		{
+			newArray[i].pPoints[0] = pNew[j];
+			newArray[i].nPointsNum = 1;
+			newArray[i].color = pNew[j].color;
+		}
+
+		DeletePolygons(pPolygons, nPolygonsNum);
+
+		pPolygons = newArray;
+		nPolygonsNum += num;
+
+		UpdateArray(nPolygonsNum - num);
+
+		return nPolygonsNum - num;
+	}
+
+	/**
+	 * @brief Ӷ
+	 * @param[in] pNew : ҪӵĶε
+	 * @param[in] num : ҪӵĶε
+	 * @param[in] bTriangulateAll : ǷжĶζΪ
+	 * @return ӵģеĵһʧܷ -1
+	 * @note ǱΪΣ TriangulatePolygon3Dֳαԭεɫɫ꣬
+	 *			еĶܱӵĶ
+	*/
+	int AddPolygons(Polygon3D* pNew, int num, bool bTriangulateAll = false)
+	{
+		if (num <= 0 || !pNew)	return -1;
+
+		// ֺĶ
+		int nAddNum = 0;
+		for (int i = 0; i < num; i++)
+			nAddNum += NeedTriangulate(pNew[i], bTriangulateAll) ? pNew[i].nPointsNum - 2 : 1;
+
+		Polygon3D* newArray = new Polygon3D[nPolygonsNum + nAddNum];
+		CopyPolygons(newArray, pPolygons, nPolygonsNum);
+		for (int i = 0, j = nPolygonsNum; i < num; i++)
+		{
+			if (NeedTriangulate(pNew[i], bTriangulateAll))
+				j += TriangulatePolygon(pNew[i], newArray + j);
+			else
+				CopyPolygons(newArray + j++, pNew + i, 1);
+		}
+
+		DeletePolygons(pPolygons, nPolygonsNum);
+
+		pPolygons = newArray;
+		nPolygonsNum += nAddNum;
+
+		UpdateArray(nPolygonsNum - nAddNum);
+
+		return nPolygonsNum - nAddNum;
+	}
+
+	/**
+	 * @brief һĶ
+	 * @param[in] pPoints : ζ
+	 * @param[in] num : Գ POLYGON_MAX_SIDES
+	 * @param[in] color : ɫ
+	 * @param[in] bTriangulateAll : ǷǲΪ
+	 * @return ӵģеĵһʧܷ -1
+	 * @note  POLYGON_MAX_SIDES ǰʱΪ
+	*/
+	int AddPolygon(const Point3D* pPoints, int num, Color color, bool bTriangulateAll = false)
+	{
+		if (num <= 0 || !pPoints) return -1;
+		if (num <= POLYGON_MAX_SIDES)
+		{
+			Polygon3D p(pPoints, num, color);
+			int index = AddPolygons(&p, 1, bTriangulateAll);
+			p.clear();
+			return index;
+		}
+
+		int* pTriangles = AllocArray<int>((size_t)(num - 2) * 3, memory_polygon);
+		int count = TriangulatePolygon3D(pPoints, num, pTriangles);
+		Polygon3D* pNew = new Polygon3D[count];
+		for (int i = 0; i < count; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				pNew[i].pPoints[j] = pPoints[pTriangles[i * 3 + j]];
+			pNew[i].nPointsNum = 3;
+			pNew[i].color = color;
+		}
+		FreeArray(pTriangles);
+
+		int index = AddPolygons(pNew, count);
+		DeletePolygons(pNew, count);
+		return index;
+	}
+
+	/**
+	 * @brief ɾеĳ
+	 * @param[in] p : Ҫɾĵ
+	*/
+	void DeletePolygon(int index)
+	{
+		Polygon3D* newArray = new Polygon3D[nPolygonsNum - 1];
+		for (int i = 0, j = 0; j < nPolygonsNum; i++, j++)
+		{
+			if (j != index)
+			{
+				CopyPolygons(&newArray[i], &pPolygons[j], 1);
+			}
+			else
+			{
+				i--;
+			}
+		}
+
+		DeletePolygons(pPolygons, nPolygonsNum);
+
+		pPolygons = newArray;
+		nPolygonsNum--;
+
+		UpdateArray(nPolygonsNum + 1);
+	}
+
+};
+
+
+/**
+ * @brief 3D 
+*/
+class Scence3D
+{
+
+private:
+	Object3D* pObjects;	/** @brief ڵ弯 */
+	int nObjectsNum;	/** @brief ڵ */
+
+	Camera3D camera;	/** @brief  */
+	RenderMode mode;	/** @brief Ⱦģʽ */
+
+	Light3D* pLights;	/** @brief ڵĹԴ */
+	int nLightsNum;		/** @brief ڵĹԴ */
+	Color ambient;		/** @brief ɫ */
+	ShadeMode shade;	/** @brief ɫģʽ */
+	double specular;	/** @brief ߹ǿ */
+	int shininess;		/** @brief ߹ָ */
+
+	BVH3D bvh;					/** @brief ε BVH UpdateBVH ؽ */
+	unsigned int* pBVHVersions;	/** @brief  BVH ʱİ汾 */
+	int nBVHObjectsNum;			/** @brief  BVH ʱΪ -1 ʾûн */
+
+	bool bOcclusionCulling;		/** @brief Ƿڵ޳ */
+	AntiAliasMode antialias;	/** @brief ģʽ */
+	double fTargetFrameTime;	/** @brief ֱ̬ʵĿ֡ʱ䣨룩Ϊ 0 ʾ */
+	double fMinResolutionScale;	/** @brief ֱ̬ʵСű */
+
+	/**
+	 * @brief ѳĶα任üͶӰдȾ
+	 * @param[out] pQueue : ȾУȱգͼԪδ
+	 * @param[in] cam : 
+	 * @note ÿֻһ飺ȥض任һβ룬ȫ׶ĳĶֱ޳
+	 *			ԶüĶڲüռüֱʹԤȳõ NDC ꡣ
+	 *			ϵ¼㣺Gouraud ģʽÿȥضֻһΣƽɫģʽ°εĺ淨߼㣬
+	 *			жɫĶԶɫƽֵΪɫ
+	 *			̲ƳеĶΣֱдĶ顣
+	*/
+	void BuildRenderQueue(RenderQueue* pQueue, const Camera3D& cam)
+	{
+		pQueue->Clear();
+
+		Matrix4D mat = MultiplyMatrix4D(GetProjectionMatrix(cam), GetViewMatrix(cam));
+		LightingParams params = { pLights,nLightsNum,ambient,specular,shininess,cam.pPosition };
+
+		if (!bOcclusionCulling)
+		{
+			for (int i = 0; i < nObjectsNum; i++)
+			{
+				if (IsBoxVisible(pObjects[i].GetBounds(), mat, NULL))
+					EmitObject(pQueue, i, mat, params, NULL);
+				else
+					pQueue->nCulledNum++;
+			}
+			return;
+		}
+
+		// ڵдУٰǵͼԪդȻ
+		DepthPyramid* pHiZ = &pQueue->hiz;
+		pHiZ->Clear();
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			if (pObjects[i].IsOccluder() && IsBoxVisible(pObjects[i].GetBounds(), mat, NULL))
+				EmitObject(pQueue, i, mat, params, NULL);
+		}
+		for (int i = 0; i < pQueue->nItemsNum; i++)
+		{
+			const RenderItem& item = pQueue->pItems[i];
+			const RenderVertex* v = pQueue->pVertices + item.nFirst;
+			if (item.nPointsNum < 3) continue;
+
+			// ֻлᱻĶβڵ
+			bool bFilled = true;
+			for (int k = 0; k < item.nPointsNum; k++)
+				if (v[k].color < 0)
+					bFilled = false;
+			if (!bFilled && item.color < 0 && !item.pTexture) continue;
+
+			Point2D p[POLYGON_MAX_SIDES];
+			for (int k = 0; k < item.nPointsNum; k++)
+				p[k] = { v[k].p.x,v[k].p.y };
+			if (!IsConvexPolygon2D(p, item.nPointsNum)) continue;
+			for (int k = 1; k + 1 < item.nPointsNum; k++)
+				pHiZ->RasterizeTriangle(v[0].p, v[k].p, v[k + 1].p);
+		}
+		pHiZ->Build();
+
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			if (pObjects[i].IsOccluder()) continue;
+			if (IsBoxVisible(pObjects[i].GetBounds(), mat, pHiZ))
+				EmitObject(pQueue, i, mat, params, pHiZ);
+			else
+				pQueue->nCulledNum++;
+		}
+	}
+
+	/**
+	 * @brief жϵµİΧǷܿɼ
+	 * @param[in] r : Χ
+	 * @param[in] mat : ۲ͶӰ
+	 * @param[in] pHiZ : Ȼ壬Ϊ NULL ʱֻжǷ׶
+	 * @note Χеİ˸㶼׶ĳʱɼüʱΪɼ
+	*/
+	bool IsBoxVisible(const Rectangle3D& r, const Matrix4D& mat, const DepthPyramid* pHiZ)
+	{
+		int out_and = 0x3f;
+		bool bCrossNear = false;
+		double min_x = 1, min_y = 1, min_z = 1, max_x = -1, max_y = -1;
+		for (int k = 0; k < 8; k++)
+		{
+			Point3D p = { k & 1 ? r.max_x : r.min_x,k & 2 ? r.max_y : r.min_y,k & 4 ? r.max_z : r.min_z };
+			Point4D h = TransformPoint4D(mat, p);
+			out_and &= GetClipOutcode(h);
+			if (h.z < 0 || h.w <= 0)
+			{
+				bCrossNear = true;
+				continue;
+			}
+			min_x = std::min(min_x, h.x / h.w);
+			min_y = std::min(min_y, h.y / h.w);
+			max_x = std::max(max_x, h.x / h.w);
+			max_y = std::max(max_y, h.y / h.w);
+			min_z = std::min(min_z, h.z / h.w);
+		}
+		if (out_and) return false;
+		if (!pHiZ || bCrossNear) return true;
+		return pHiZ->IsVisible(min_x, min_y, max_x, max_y, min_z);
+	}
+
+	/**
+	 * @brief һĶα任üͶӰдȾУ BuildRenderQueue
+	 * @param[in] pHiZ : Ȼ壬Ϊ NULL ʱֻ׶޳
+	 * @note йռŵжϿɼԣֻ任ɼĶͶ
+	*/
+	void EmitObject(RenderQueue* pQueue, int i, const Matrix4D& mat, const LightingParams& params, const DepthPyramid* pHiZ)
+	{
+		int num = pObjects[i].GetPolygonsNum();
+		int nVerticesNum = pObjects[i].GetVerticesNum();
+		if (num <= 0 || nVerticesNum <= 0) return;
+
+		Polygon3D* p = pObjects[i].GetPolygons();
+		Point3D* pVertices = pObjects[i].GetVertices();
+		int* pIndices = pObjects[i].GetIndices();
+
+		pQueue->ReserveScratch(std::max(num, nVerticesNum));
+		Point4D* pClip = pQueue->pClipVertices;
+		Point3D* pProjected = pQueue->pProjected;
+		double* pInvW = pQueue->pInvW;
+		unsigned char* pOutcodes = pQueue->pOutcodes;
+		VertexLighting* pLighting = pQueue->pLighting;
+
+		// ûзֿΪһ
+		MeshChunk whole = { 0,num,0,0,nVerticesNum,0,0,{} };
+		const int* pShared = pObjects[i].GetSharedVertices();
+		const MeshChunk* pChunks = pObjects[i].GetChunks();
+		int nChunksNum = pObjects[i].GetChunksNum();
+		if (!pChunks)
+		{
+			pChunks = &whole;
+			nChunksNum = 1;
+		}
+
+		for (int nChunk = 0; nChunk < nChunksNum; nChunk++)
+		{
+			const MeshChunk& chunk = pChunks[nChunk];
+			if (pChunks != &whole && !IsBoxVisible(chunk.bounds, mat, pHiZ))
+			{
+				pQueue->nCulledChunksNum++;
+				continue;
+			}
+			int first = chunk.nFirstPolygon, last = chunk.nFirstPolygon + chunk.nPolygonsNum;
+
+			// ÿȥضֻ任һΣ֮ǰĿ鹲õĶĿܱ޳ˣٱ任һ
+			for (int k = -chunk.nSharedNum; k < chunk.nVerticesNum; k++)
+			{
+				int j = k < 0 ? pShared[chunk.nFirstShared - k - 1] : chunk.nFirstVertex + k;
+				Point4D h = TransformPoint4D(mat, pVertices[j]);
+				pClip[j] = h;
+				pOutcodes[j] = (unsigned char)GetClipOutcode(h);
+				if (h.w > 0)
+				{
+					pInvW[j] = 1 / h.w;
+					pProjected[j] = { h.x * pInvW[j],h.y * pInvW[j],h.z * pInvW[j] };
+				}
+				else
+				{
+					// ߲ü·ü w <= 0 Ķʱ޳
+					pOutcodes[j] |= 16;
+				}
+			}
+
+			if (shade == shade_gouraud)
+			{
+				Point3D* pNormals = pObjects[i].GetNormals();
+				for (int k = 0; k < chunk.nSharedNum; k++)
+				{
+					int j = pShared[chunk.nFirstShared + k];
+					LightVertices(pVertices + j, pNormals + j, 1, params, pLighting + j);
+				}
+				LightVertices(pVertices + chunk.nFirstVertex, pNormals + chunk.nFirstVertex, chunk.nVerticesNum,
+					params, pLighting + chunk.nFirstVertex);
+			}
+			else if (shade == shade_flat)
+			{
+				for (int j = first, index = chunk.nFirstIndex; j < last; index += p[j].nPointsNum, j++)
+				{
+					Point3D pPoints[POLYGON_MAX_SIDES];
+					Point3D c = { 0,0,0 };
+					int n = p[j].nPointsNum;
+					for (int k = 0; k < n; k++)
+					{
+						pPoints[k] = pVertices[pIndices[index + k]];
+						c.x += pPoints[k].x;
+						c.y += pPoints[k].y;
+						c.z += pPoints[k].z;
+					}
+					if (n > 0)
+						c = { c.x / n,c.y / n,c.z / n };
+					pQueue->pCenters[j] = c;
+					pQueue->pNormals[j] = Normalize3D(GetPolygonNormal(pPoints, n));
+				}
+				LightVertices(pQueue->pCenters + first, pQueue->pNormals + first, chunk.nPolygonsNum, params, pLighting + first);
+			}
+
+			for (int j = first, index = chunk.nFirstIndex; j < last; index += p[j].nPointsNum, j++)
+			{
+				int n = p[j].nPointsNum;
+				const int* pIndex = pIndices + index;
+				if (n <= 0) continue;
+
+				int out_and = 0x3f, out_or = 0;
+				for (int k = 0; k < n; k++)
+				{
+					out_and &= pOutcodes[pIndex[k]];
+					out_or |= pOutcodes[pIndex[k]];
+				}
+				if (out_and) continue;
+
+				Color color = p[j].color;
+				Color pColors[POLYGON_MAX_SIDES];
+				if (shade == shade_gouraud)
+				{
+					for (int k = 0; k < n; k++)
+						pColors[k] = ShadeColor(p[j].GetPointColor(k), pLighting[pIndex[k]]);
+				}
+				else if (shade == shade_flat)
+				{
+					// жɫʱԶɫƽֵΪɫ
+					if (p[j].HasPointColors())
+					{
+						int sum[3] = { 0 }, count = 0;
+						for (int k = 0; k < n; k++)
+						{
+							Color c = p[j].GetPointColor(k);
+							if (c < 0) continue;
+							sum[0] += GetRValue(c);
+							sum[1] += GetGValue(c);
+							sum[2] += GetBValue(c);
+							count++;
+						}
+						color = RGB(sum[0] / count, sum[1] / count, sum[2] / count);
+					}
+					color = ShadeColor(color, pLighting[j]);
+					for (int k = 0; k < n; k++)
+						pColors[k] = -1;
+				}
+				else
+				{
+					for (int k = 0; k < n; k++)
+						pColors[k] = p[j].pColors[k];
+				}
+
+				RenderVertex v[POLYGON_MAX_SIDES];
+				if (out_or & (16 | 32))
+				{
+					Point4D h[POLYGON_MAX_SIDES];
+					TexCoord pCoords[POLYGON_MAX_SIDES];
+					for (int k = 0; k < n; k++)
+					{
+						h[k] = pClip[pIndex[k]];
+						pCoords[k] = p[j].pTexCoords ? p[j].pTexCoords[k] : TexCoord{ 0,0,1 };
+					}
+					n = ClipPolygonZ(h, pColors, pCoords, n, out_or);
+
+					bool bVisible = n > 0;
+					for (int k = 0; k < n && bVisible; k++)
+					{
+						if (h[k].w <= 0)
+						{
+							bVisible = false;
+							break;
+						}
+						double iw = 1 / h[k].w;
+						v[k].p = { h[k].x * iw,h[k].y * iw,h[k].z * iw };
+						v[k].color = pColors[k];
+						v[k].uv = { pCoords[k].u * iw,pCoords[k].v * iw,pCoords[k].q * iw };
+					}
+					if (!bVisible) continue;
+				}
+				else
+				{
+					for (int k = 0; k < n; k++)
+					{
+						double iw = pInvW[pIndex[k]];
+						v[k].p = pProjected[pIndex[k]];
+						v[k].color = pColors[k];
+						v[k].uv = p[j].pTexCoords ? TexCoord{ p[j].pTexCoords[k].u * iw,p[j].pTexCoords[k].v * iw,p[j].pTexCoords[k].q * iw } : TexCoord{ 0,0,1 };
+					}
+				}
+
+				pQueue->PushItem(v, n, color, p[j].pTexCoords ? p[j].pTexture : NULL);
+			}
+		}
+	}
+
+	/**
+	 * @brief Ⱦģʽһ֡ڶм¼׶εĺʱ
+	 * @param[in] pTarget : Ŀ֡
+	 * @param[in] x, y, zoom, grid : ͬ Render
+	 * @param[in] cam : 
+	 * @param[in] pQueue : Ⱦ
+	*/
+	void DrawFrame(FrameBuffer* pTarget, int x, int y, Zoom zoom, Color grid, const Camera3D& cam, RenderQueue* pQueue)
+	{
+		auto t = std::chrono::steady_clock::now();
+		auto lap = [&](RenderStage stage) {
+			auto now = std::chrono::steady_clock::now();
+			pQueue->pStageTimes[stage] += std::chrono::duration<double>(now - t).count();
+			t = now;
+		};
+
+		if (mode == render_wireframe)
+		{
+			RenderWireframe(pTarget, x, y, zoom, grid >= 0 ? grid : WHITE, cam);
+			lap(render_stage_build);
+			return;
+		}
+
+		BuildRenderQueue(pQueue, cam);
+		lap(render_stage_build);
+		if (pQueue->GetItemsNum() <= 0)
+			return;
+
+		//  z 
+		pQueue->Sort();
+		lap(render_stage_sort);
+		pQueue->Draw(pTarget, x, y, zoom, grid, antialias);
+		lap(render_stage_draw);
+	}
+
+	/**
+	 * @brief ߿ģʽƳ
+	 * @note ÿȥضֻ任һΣٰΨһб߶Ρ
+	 *			߶ڲüռ䰴ԶüüͶӰٲü֡ڣȻòԽĻߺơ
+	*/
+	void RenderWireframe(FrameBuffer* pTarget, int x, int y, Zoom zoom, Color color, const Camera3D& cam)
+	{
+		Matrix4D mat = MultiplyMatrix4D(GetProjectionMatrix(cam), GetViewMatrix(cam));
+		double w = pTarget->GetWidth(), h = pTarget->GetHeight();
+		DWORD dw = BGR((COLORREF)color);
+
+		// γתΪ±꣨ (x,y)  [x,x+1)Լȥ 0.5 룩
+		auto project = [&](Point4D p) -> Point2D {
+			return { (p.x / p.w * zoom.x + 1) * w + x - 0.5,(1 - p.y / p.w * zoom.y) * h + y - 0.5 };
+		};
+
+		int nCapacity = 0;
+		Point4D* pClip = NULL;
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			int nVerticesNum = pObjects[i].GetVerticesNum();
+			int nEdgesNum = pObjects[i].GetEdgesNum();
+			if (nEdgesNum <= 0) continue;
+
+			if (nVerticesNum > nCapacity)
+			{
+				FreeArray(pClip);
+				nCapacity = nVerticesNum;
+				pClip = AllocArray<Point4D>(nCapacity, memory_render);
+			}
+
+			// 任üռ
+			Point3D* pVertices = pObjects[i].GetVertices();
+			for (int j = 0; j < nVerticesNum; j++)
+			{
+				pClip[j] = TransformPoint4D(mat, pVertices[j]);
+			}
+
+			int* pEdges = pObjects[i].GetEdges();
+			for (int j = 0; j < nEdgesNum; j++)
+			{
+				Point4D a = pClip[pEdges[j * 2]];
+				Point4D b = pClip[pEdges[j * 2 + 1]];
+
+				//  z >= 0  w - z >= 0 ü
+				double t0 = 0, t1 = 1;
+				bool bVisible = true;
+				for (int plane = 0; plane < 2 && bVisible; plane++)
+				{
+					double da = plane == 0 ? a.z : a.w - a.z;
+					double db = plane == 0 ? b.z : b.w - b.z;
+					if (da < 0 && db < 0) bVisible = false;
+					else if (da < 0) t0 = std::max(t0, da / (da - db));
+					else if (db < 0) t1 = std::min(t1, da / (da - db));
+				}
+				if (!bVisible || t0 > t1) continue;
+
+				Point4D d = { b.x - a.x,b.y - a.y,b.z - a.z,b.w - a.w };
+				Point4D a2 = { a.x + d.x * t0,a.y + d.y * t0,a.z + d.z * t0,a.w + d.w * t0 };
+				Point4D b2 = { a.x + d.x * t1,a.y + d.y * t1,a.z + d.z * t1,a.w + d.w * t1 };
+				if (a2.w <= 0 || b2.w <= 0) continue;
+
+				Point2D pa = project(a2), pb = project(b2);
+				if (ClipLine2D(&pa.x, &pa.y, &pb.x, &pb.y, 0, 0, w - 1, h - 1))
+				{
+					DrawClippedLine(pTarget, (int)floor(pa.x + 0.5), (int)floor(pa.y + 0.5), (int)floor(pb.x + 0.5), (int)floor(pb.y + 0.5), dw);
+				}
+			}
+		}
+		FreeArray(pClip);
+	}
+
+public:
+
+	Scence3D()
+	{
+		pObjects = NULL;
+		nObjectsNum = 0;
+
+		camera.pPosition = { 0,0,0 };
+		camera.orientation = { 1,0,0,0 };
+
+		camera.nViewportWidth = 640;
+		camera.nViewportHeight = 480;
+		camera.fov = 60;
+		camera.dNear = 1;
+		camera.dFar = 10000;
+
+		camera.bPerspectiveProjection = true;
+
+		mode = render_fill;
+
+		pLights = NULL;
+		nLightsNum = 0;
+		ambient = RGB(64, 64, 64);
+		shade = shade_none;
+		specular = 0.3;
+		shininess = 32;
+
+		pBVHVersions = NULL;
+		nBVHObjectsNum = -1;
+		bOcclusionCulling = false;
+		antialias = antialias_none;
+		fTargetFrameTime = 0;
+		fMinResolutionScale = 0.5;
+	}
+
+	~Scence3D()
+	{
+		FreeArray(pObjects);
+		FreeArray(pLights);
+		FreeArray(pBVHVersions);
+	}
+
+	/**
+	 * @brief λ
+	*/
+	void SetCameraPosition(Point3D p)
+	{
+		camera.pPosition = p;
+	}
+
+	/**
+	 * @brief ȡλ
+	*/
+	Point3D GetCameraPosition()
+	{
+		return camera.pPosition;
+	}
+
+	/**
+	 * @brief ƶЧ SetCameraPosition ͬ
+	*/
+	void MoveCameraTo(Point3D p)
+	{
+		SetCameraPosition(p);
+	}
+
+	/**
+	 * @brief  x ᷽ƶ
+	*/
+	void MoveCameraX(double n)
+	{
+		camera.pPosition.x += n;
+	}
+
+	/**
+	 * @brief  y ᷽ƶ
+	*/
+	void MoveCameraY(double n)
+	{
+		camera.pPosition.y += n;
+	}
+
+	/**
+	 * @brief  z ᷽ƶ
+	*/
+	void MoveCameraZ(double n)
+	{
+		camera.pPosition.z += n;
+	}
+
+	/**
+	 * @brief ̬
+	*/
+	void SetCameraAttitude(Attitude3D ati)
+	{
+		camera.orientation = ConvertCameraAttitudeToQuaternion(ati);
+	}
+
+	/**
+	 * @brief ȡ̬
+	 * @return 뵱ǰЧŷǣһʱĽǶͬ
+	*/
+	Attitude3D GetCameraAttitude()
+	{
+		return ConvertQuaternionToCameraAttitude(camera.orientation);
+	}
+
+	/**
+	 * @brief Ԫ򣨴ϵϵת
+	*/
+	void SetCameraOrientation(Quaternion3D q)
+	{
+		camera.orientation = NormalizeQuaternion(q);
+	}
+
+	/**
+	 * @brief Ԫȡ
+	*/
+	Quaternion3D GetCameraOrientation()
+	{
+		return camera.orientation;
+	}
+
+	/**
+	 * @brief  x ת
+	*/
+	void RotateCameraX(double angle)
+	{
+		camera.orientation = NormalizeQuaternion(MultiplyQuaternion(camera.orientation, GetRotateQuaternion(rotate_x, angle)));
+	}
+
+	/**
+	 * @brief  y תƫ
+	*/
+	void RotateCameraY(double angle)
+	{
+		camera.orientation = NormalizeQuaternion(MultiplyQuaternion(camera.orientation, GetRotateQuaternion(rotate_y, angle)));
+	}
+
+	/**
+	 * @brief  z תת
+	*/
+	void RotateCameraZ(double angle)
+	{
+		camera.orientation = NormalizeQuaternion(MultiplyQuaternion(camera.orientation, GetRotateQuaternion(rotate_z, angle)));
+	}
+
+	/**
+	 * @brief ӿڴС
+	*/
+	void SetCameraViewportSize(int w, int h)
+	{
+		camera.nViewportWidth = w;
+		camera.nViewportHeight = h;
+	}
+
+	/**
+	 * @brief ȡӿڴС
+	 * @param[out]	w : ӿڿ
+	 * @param[out]	h : ӿڸ߶
+	*/
+	void GetCameraViewportSize(int* w, int* h)
+	{
+		*w = camera.nViewportWidth;
+		*h = camera.nViewportHeight;
+	}
+
+	/**
+	 * @brief 
+	 * @note Ϊλӿڸ߶һӳǣΪദƽͶӰʱһ
+	*/
+	void SetCameraFocalLength(int f)
+	{
+		if (f <= 0) return;
+		camera.fov = atan(camera.nViewportHeight / 2.0 / f) * 2 * 180.0 / 3.1415926535;
+	}
+
+	/**
+	 * @brief ȡ
+	*/
+	int GetCameraFocalLength()
+	{
+		return (int)(camera.nViewportHeight / 2.0 / tan(ConvertToRadian(camera.fov) / 2) + 0.5);
+	}
+
+	/**
+	 * @brief ĴֱӳǣǶȣ
+	*/
+	void SetCameraFOV(double fov)
+	{
+		camera.fov = fov;
+	}
+
+	/**
+	 * @brief ȡĴֱӳǣǶȣ
+	*/
+	double GetCameraFOV()
+	{
+		return camera.fov;
+	}
+
+	/**
+	 * @brief ĽԶü
+	 * @param[in] n : ü浽ľ룬 0
+	 * @param[in] f : Զü浽ľ룬 n
+	*/
+	void SetCameraClipPlanes(double n, double f)
+	{
+		camera.dNear = n;
+		camera.dFar = f;
+	}
+
+	/**
+	 * @brief ȡĽԶü
+	 * @param[out] n : ü浽ľ
+	 * @param[out] f : Զü浽ľ
+	*/
+	void GetCameraClipPlanes(double* n, double* f)
+	{
+		*n = camera.dNear;
+		*f = camera.dFar;
+	}
+
+	/**
+	 * @brief ͸ͶӰĿ
+	 * @param b : Ƿ͸ͶӰ
+	*/
+	void EnablePerspectiveProjection(bool b = true)
+	{
+		camera.bPerspectiveProjection = b;
+	}
+
+	/**
+	 * @brief ȡ͸ͶӰ״̬
+	*/
+	bool GetPerspectiveProjectionState()
+	{
+		return camera.bPerspectiveProjection;
+	}
+
+	/**
+	 * @brief ڵ޳Ŀ
+	 * @param b : Ƿڵ޳
+	 * @note ȾʱȰѱΪڵ壨 Object3D::SetOccluderդȻ壬
+	 *		 İΧбڵȫסʱֱٽж任͹դ
+	 * @attention ڵӦѡ͹ɵ壨ǽ棩޳˶ٶ
+	*/
+	void EnableOcclusionCulling(bool b = true)
+	{
+		bOcclusionCulling = b;
+	}
+
+	/**
+	 * @brief ȡڵ޳״̬
+	*/
+	bool GetOcclusionCullingState()
+	{
+		return bOcclusionCulling;
+	}
+
+	/**
+	 * @brief ģʽ¹դĿģʽ
+	 * @param[in] aa : ģʽĬΪ antialias_none
+	 * @note ģʽĿ 640x480 Ϊ
+	 *			antialias_fxaa 볡Ӷ޹أÿ̶֡һȫʱԼ 1.2 MB
+	 *			antialias_msaa2x / antialias_msaa4x Ŀÿ֡һ뱳һϳɣ
+	 *			Լ 2.5 MB / 4.9 MBεĸжϺд밴ӣɫÿֻһΡ
+	 *			ȾУȾʱͬһоͲÿ֡·䡣
+	 *			߿ģʽ͹׷ٲܴӰ졣
+	*/
+	void SetAntiAliasMode(AntiAliasMode aa)
+	{
+		antialias = aa;
+	}
+
+	/**
+	 * @brief ȡģʽ
+	*/
+	AntiAliasMode GetAntiAliasMode()
+	{
+		return antialias;
+	}
+
+	/**
+	 * @brief öֱ̬
+	 * @param[in] fTargetTime : Ŀ֡ʱ䣨룩Ϊ 0 ʱرնֱ̬
+	 * @param[in] fMinScale : Сűÿ򣩣ĬΪ 0.5
+	 * @note Render Ⱦм¼ĸ׶κʱƽ󣩹һ֡ĺʱ
+	 *			Ŀ֡ʱʱԽϵ͵ķֱʻƵеڲ壬˫ԷŴ RenderQueue::UpdateResolutionScale
+	 *			ֻйդĺʱֱʱ仯ԹбͳʱĳֻܽС
+	 *			״̬ȾУȾʱҪͬһУÿӿڸһʱԶڡ
+	*/
+	void SetDynamicResolution(double fTargetTime, double fMinScale = 0.5)
+	{
+		fTargetFrameTime = std::max(fTargetTime, 0.0);
+		fMinResolutionScale = fMinScale;
+	}
+
+	/**
+	 * @brief ȡֱ̬ʵĿ֡ʱ䣨룩Ϊ 0 ʾûп
+	*/
+	double GetDynamicResolutionTarget()
+	{
+		return fTargetFrameTime;
+	}
+
+	/**
+	 * @brief Ⱦģʽ
+	*/
+	void SetRenderMode(RenderMode m)
+	{
+		mode = m;
+	}
+
+	/**
+	 * @brief ȡȾģʽ
+	*/
+	RenderMode GetRenderMode()
+	{
+		return mode;
+	}
+
+	/**
+	 * @brief ùɫģʽ
+	*/
+	void SetShadeMode(ShadeMode m)
+	{
+		shade = m;
+	}
+
+	/**
+	 * @brief ȡɫģʽ
+	*/
+	ShadeMode GetShadeMode()
+	{
+		return shade;
+	}
+
+	/**
+	 * @brief ûɫ
+	*/
+	void SetAmbientLight(Color c)
+	{
+		ambient = c;
+	}
+
+	/**
+	 * @brief ȡɫ
+	*/
+	Color GetAmbientLight()
+	{
+		return ambient;
+	}
+
+	/**
+	 * @brief ø߹
+	 * @param[in] strength : ߹ǿȣΪ 0 ʱ߹
+	 * @param[in] exponent : ߹ָԽ߹Խ
+	*/
+	void SetSpecular(double strength, int exponent)
+	{
+		specular = strength;
+		shininess = exponent;
+	}
+
+	/**
+	 * @brief ȡ߹
+	 * @param[out] pExponent : ظ߹ָΪ NULL
+	 * @return ظ߹ǿ
+	*/
+	double GetSpecular(int* pExponent = NULL)
+	{
+		if (pExponent)
+			*pExponent = shininess;
+		return specular;
+	}
+
+	/**
+	 * @brief ڳӹԴ
+	 * @param[in] light : ҪӵĹԴ
+	 * @return ӵĹԴе
+	*/
+	int AddLight(Light3D light)
+	{
+		Light3D* newLights = AllocArray<Light3D>(nLightsNum + 1, memory_scene);
+		for (int i = 0; i < nLightsNum; i++)
+			newLights[i] = pLights[i];
+		newLights[nLightsNum] = light;
+
+		FreeArray(pLights);
+		pLights = newLights;
+		nLightsNum++;
+		return nLightsNum - 1;
+	}
+
+	/**
+	 * @brief ɾеĹԴ
+	 * @param[in] index : ҪɾĹԴ
+	*/
+	void DeleteLight(int index)
+	{
+		if (index < 0 || index >= nLightsNum) return;
+		for (int i = index; i + 1 < nLightsNum; i++)
+			pLights[i] = pLights[i + 1];
+		nLightsNum--;
+	}
+
+	/**
+	 * @brief ȡйԴļ
+	*/
+	Light3D* GetLights()
+	{
+		return pLights;
+	}
+
+	/**
+	 * @brief ȡйԴ
+	*/
+	int GetLightsNum()
+	{
+		return nLightsNum;
+	}
+
+	/**
+	 * @brief ȡռõڴ棨ֽڣ
+	 * @param[out] pObjectBytes : ÿռõֽ Object3D::GetMemoryUsage鳤ΪΪ NULL
+	 * @return ֽ塢Դ BVH
+	 * @note õܱã Texture::GetMemoryUsage
+	*/
+	size_t GetMemoryUsage(size_t* pObjectBytes = NULL)
+	{
+		size_t total = sizeof(Scence3D) + sizeof(Light3D) * nLightsNum + bvh.GetMemoryUsage();
+		if (pBVHVersions) total += sizeof(unsigned int) * (nBVHObjectsNum + 1);
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			size_t n = pObjects[i].GetMemoryUsage();
+			if (pObjectBytes) pObjectBytes[i] = n;
+			total += n;
+		}
+		return total;
+	}
+
+	/**
+	 * @brief ȡε BVHб仯ʱؽ
+	 * @return  BVH꣬ת꣩
+	 * @note ΰǻֻᱻƵĶΣ㣬ɫж㶼ɫ
+	 *			Ƿ仯 Object3D::GetVersion жϣ޸Ҫ UpdateRotatedPoints
+	 * @attention ؽʱ޸ĳ߳ʹǰһ߳еô˺ֻ֮߳ȡص BVH
+	*/
+	const BVH3D* UpdateBVH()
+	{
+		bool bChanged = nBVHObjectsNum != nObjectsNum;
+		for (int i = 0; i < nObjectsNum && !bChanged; i++)
+			if (pBVHVersions[i] != pObjects[i].GetVersion())
+				bChanged = true;
+		if (!bChanged)
+			return &bvh;
+
+		FreeArray(pBVHVersions);
+		pBVHVersions = AllocArray<unsigned int>(nObjectsNum + 1, memory_bvh);
+		nBVHObjectsNum = nObjectsNum;
+
+		auto filled = [](Polygon3D& p) {
+			if (p.nPointsNum < 3) return false;
+			if (p.color >= 0 || (p.pTexture && p.pTexCoords)) return true;
+			for (int k = 0; k < p.nPointsNum; k++)
+				if (p.pColors[k] < 0)
+					return false;
+			return true;
+		};
+
+		int num = 0;
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			pBVHVersions[i] = pObjects[i].GetVersion();
+			Polygon3D* p = pObjects[i].GetPolygons();
+			for (int j = 0; j < pObjects[i].GetPolygonsNum(); j++)
+				if (filled(p[j]))
+					num += p[j].nPointsNum - 2;
+		}
+
+		Point3D* pPoints = AllocArray<Point3D>((size_t)num * 3 + 1, memory_bvh);
+		BVHPrimitive* pSource = AllocArray<BVHPrimitive>(num + 1, memory_bvh);
+		int index = 0;
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			Polygon3D* p = pObjects[i].GetPolygons();
+			for (int j = 0, first = 0; j < pObjects[i].GetPolygonsNum(); first += p[j].nPointsNum, j++)
+			{
+				if (!filled(p[j])) continue;
+				for (int k = 0; k + 2 < p[j].nPointsNum; k++, index++)
+				{
+					pPoints[index * 3] = p[j].pPoints[0];
+					pPoints[index * 3 + 1] = p[j].pPoints[k + 1];
+					pPoints[index * 3 + 2] = p[j].pPoints[k + 2];
+					pSource[index] = { i,j,k,first };
+				}
+			}
+		}
+
+		if (num > 0)
+			bvh.Build(pPoints, pSource, num);
+		else
+			bvh.Clear();
+
+		FreeArray(pPoints);
+		FreeArray(pSource);
+		return &bvh;
+	}
+
+	/**
+	 * @brief ȫ
+	*/
+	void SetCamera(Camera3D cam)
+	{
+		camera = cam;
+	}
+
+	/**
+	 * @brief ȡȫ
+	*/
+	Camera3D GetCamera()
+	{
+		return camera;
+	}
+
+	/**
+	 * @brief ڳ
+	 * @param[in] obj : Ҫӵ
+	 * @return ӵе
+	*/
+	int AddObject(Object3D& obj)
+	{
+		Object3D* newObjects = AllocArray<Object3D>(nObjectsNum + 1, memory_scene);
+		for (int i = 0; i < nObjectsNum; i++)
+		{
+			newObjects[i].AddPolygons(pObjects[i].GetPolygons(), pObjects[i].GetPolygonsNum());
+			newObjects[i].SetRotateOrder(pObjects[i].GetRotateOrder());
+			newObjects[i].SetOrientation(pObjects[i].GetOrientation());
+			newObjects[i].SetOccluder(pObjects[i].IsOccluder());
+			newObjects[i].SetChunks(pObjects[i].GetChunks(), pObjects[i].GetChunksNum());
+		}
+
+		newObjects[nObjectsNum].AddPolygons(obj.GetPolygons(), obj.GetPolygonsNum());
+		newObjects[nObjectsNum].SetRotateOrder(obj.GetRotateOrder());
+		newObjects[nObjectsNum].SetOrientation(obj.GetOrientation());
+		newObjects[nObjectsNum].SetOccluder(obj.IsOccluder());
+		newObjects[nObjectsNum].SetChunks(obj.GetChunks(), obj.GetChunksNum());
+
+		FreeArray(pObjects);
+		pObjects = newObjects;
+		nObjectsNum++;
+		return nObjectsNum - 1;
+	}
+
+	/**
+	 * @brief ճе壬ָĿ
+	 * @param[in] num : 
+	 * @return µ飬ɳֱ䣨 LoadScenceSnapshot
+	 * @note  AddObject ȣҪȽٸһ
+	*/
+	Object3D* ResetObjects(int num)
+	{
+		FreeArray(pObjects);
+		pObjects = num > 0 ? AllocArray<Object3D>(num, memory_scene) : NULL;
+		nObjectsNum = num > 0 ? num : 0;
+		return pObjects;
+	}
+
+	/**
+	 * @brief ɾе
+	 * @param[in] pObj : Ҫɾ
+	*/
+	void DeleteObject(int index)
+	{
+		Object3D* newObjects = AllocArray<Object3D>(nObjectsNum - 1, memory_scene);
+		for (int i = 0, j = 0; j < nObjectsNum; i++, j++)
+		{
+			if (j != index)
+			{
+				newObjects[i] = pObjects[j];
+			}
+			else
+			{
+				i--;
+			}
+		}
+		FreeArray(pObjects);
+		pObjects = newObjects;
+		nObjectsNum--;
+	}
+
+	/**
+	 * @brief ȡļ
+	*/
+	Object3D* GetObjects()
+	{
+		return pObjects;
+	}
+
+	/**
+	 * @brief ȡ
+	*/
+	int GetObjectsNum()
+	{
+		return nObjectsNum;
+	}
+
+	/**
+	 * @brief ȡеĶεܺ
+	*/
+	int GetAllPolygonsNum()
+	{
+		int index = 0;
+		for (int i = 0; i < nObjectsNum; i++)
+			index += pObjects[i].GetPolygonsNum();
+		return index;
+	}
+
+	/**
+	 * @brief ȡĶεļ
+	*/
+	Polygon3D* GetAllPolygons()
+	{
+		Polygon3D* p = new Polygon3D[GetAllPolygonsNum()];
+		for (int i = 0, index = 0; i < nObjectsNum; i++)
+		{
+			Polygon3D* pp = pObjects[i].GetPolygons();
+			int num = pObjects[i].GetPolygonsNum();
+			CopyPolygons(p + index, pp, num);
+			index += num;
+		}
+		return p;
+	}
+
+	/**
+	 * @brief ȡӿϵµĶμϣƽͶӰ
+	 * @param[out] count : ض
+	 * @param[in] pCam : ʹõΪ NULL ʱʹó
+	*/
+	Polygon3D* GetViewportPolygons(int* count = NULL, const Camera3D* pCam = NULL)
+	{
+		const Camera3D& cam = pCam ? *pCam : camera;
+		(void)count;
+		int nAllPolygonsNum = GetAllPolygonsNum();
+		if (nAllPolygonsNum <= 0) return NULL;
+
+		Polygon3D* pAllPolygons = GetAllPolygons();
+		Polygon3D* pRotated = NULL;
+		Polygon3D* pConverted = NULL;
+
+		// ӿڵԭ
+		Point3D pOriginViewport = { cam.pPosition.x - cam.nViewportWidth / 2,cam.pPosition.y - cam.nViewportHeight / 2,cam.pPosition.z };
+
+		// תӽǣƽƣ
+		pRotated = RotateToCamera(pAllPolygons, nAllPolygonsNum, ConvertQuaternionToCameraAttitude(cam.orientation), cam.pPosition);
+
+		// ƽƵӿϵ
+		pConverted = ConvertCoordinateSystem(pRotated, nAllPolygonsNum, pOriginViewport);
+
+		DeletePolygons(pAllPolygons, nAllPolygonsNum);
+		DeletePolygons(pRotated, nAllPolygonsNum);
+		
+		return pConverted;
+	}
+
+	/**
+	 * @brief ȡ GetViewportPolygons صĶμϵı׼豸꣨NDCʽĶμ
+	 * @param[in] pCam : ʹõΪ NULL ʱʹó
+	*/
+	Polygon3D* GetViewportNDCPolygons(const Camera3D* pCam = NULL)
+	{
+		const Camera3D& cam = pCam ? *pCam : camera;
+		int nPolygonsNum = GetAllPolygonsNum();
+		if (nPolygonsNum <= 0) return NULL;
+		Polygon3D* pPolygons = GetViewportPolygons(NULL, &cam);
+		Polygon3D* pConverted = ConvertCoordinateSystem(pPolygons, nPolygonsNum, { cam.nViewportWidth / 2.0,cam.nViewportHeight / 2.0,0 });
+
+		for (int i = 0; i < nPolygonsNum; i++)
+		{
+			for (int j = 0; j < pConverted[i].nPointsNum; j++)
+			{
+				pConverted[i].pPoints[j].x /= cam.nViewportWidth / 2.0;
+				pConverted[i].pPoints[j].y /= cam.nViewportHeight / 2.0;
+			}
+		}
+
+		DeletePolygons(pPolygons, nPolygonsNum);
+		
+		return pConverted;
+	}
+
+	/**
+	 * @brief ʰȡĻĳ㴦
+	 * @param[in] sx : Ļ x Render Ŀ֡壩
+	 * @param[in] sy : Ļ y
+	 * @param[in] w : Render Ŀ֡
+	 * @param[in] h : Render Ŀ֡߶
+	 * @param[in] x :  Render ͬ x 
+	 * @param[in] y :  Render ͬ y 
+	 * @param[in] zoom :  Render ͬ
+	 * @param[out] pHit : ؽ㣺±ꡢ±ꡢ꣬t Ϊϵµ
+	 * @param[in] pCam : ʹõΪ NULL ʱʹó
+	 * @return Ƿʰȡ
+	 * @note ķߣڳ BVH Ľ㣬ֻ O(log n) ڵ㡣
+	 *			仯һʰȡʱؽ BVH UpdateBVH
+	*/
+	bool Pick(int sx, int sy, int w, int h, int x, int y, Zoom zoom, RayHit3D* pHit, const Camera3D* pCam = NULL)
+	{
+		const Camera3D& cam = pCam ? *pCam : camera;
+		Point2D ndc = ConvertScreenPointToNDC2D({ sx + 0.5 - x,sy + 0.5 - y }, zoom, w, h);
+		Point3D o, d;
+		GetCameraRay(cam, ndc, &o, &d);
+		return UpdateBVH()->Intersect(o, d, cam.dNear, cam.dFar, pHit);
+	}
+
+	/**
+	 * @brief ʰȡͼ豸ĳ㴦壨ͬ Render ƵĻİ汾
+	 * @see Pick
+	*/
+	bool Pick(int sx, int sy, int x, int y, Zoom zoom, RayHit3D* pHit)
+	{
+		return Pick(sx, sy, GetDrawingDeviceWidth(), GetDrawingDeviceHeight(), x, y, zoom, pHit);
+	}
+
+	/**
+	 * @brief ȡҪȾĶμ
+	 * @param[out] count : ҪȾĶ
+	 * @param[in] pCam : ʹõΪ NULL ʱʹó
+	 * @return ȾΧڵĶμϣNDC ꣩Ѱ z 
+	 * @note ʹô˺ԻȡҪƵ豸Ķμϡ
+	 *			 BuildRenderQueue ɵȾתȾʱֱʹöУپ˺
+	*/
+	Polygon3D* GetRenderPolygons(int* count, const Camera3D* pCam = NULL)
+	{
+		RenderQueue queue;
+		BuildRenderQueue(&queue, pCam ? *pCam : camera);
+		queue.Sort();
+
+		*count = queue.GetItemsNum();
+		if (*count <= 0) return NULL;
+
+		Polygon3D* pPolygons = new Polygon3D[*count];
+		for (int i = 0; i < *count; i++)
+		{
+			const RenderItem& item = queue.GetItems()[i];
+			const RenderVertex* v = queue.GetVertices() + item.nFirst;
+			pPolygons[i].nPointsNum = item.nPointsNum;
+			pPolygons[i].color = item.color;
+			pPolygons[i].pTexture = item.pTexture;
+			if (item.pTexture)
+				pPolygons[i].pTexCoords = AllocArray<TexCoord>(POLYGON_MAX_SIDES, memory_polygon);
+			for (int j = 0; j < item.nPointsNum; j++)
+			{
+				pPolygons[i].pPoints[j] = v[j].p;
+				pPolygons[i].pColors[j] = v[j].color;
+				if (item.pTexture)
+					pPolygons[i].pTexCoords[j] = v[j].uv;
+			}
+		}
+		return pPolygons;
+	}
+
+	/**
+	 * @brief ƳĻ
+	 * @param[in] x : ͼĻ x 
+	 * @param[in] y : ͼĻ y 
+	 * @param[in] zoom : ͼ
+	 * @param[in] grid : ɫΪʾ
+	 * @param[in] pQueue : ʹõȾУΪ NULL ʱʹʱ
+	 * @return ػƺʱλ룩
+	*/
+	double Render(int x = 0, int y = 0, Zoom zoom = { 1,1 }, Color grid = -1, RenderQueue* pQueue = NULL)
+	{
+		FrameBuffer fb;
+		fb.AttachDrawingDevice();
+		return Render(&fb, x, y, zoom, grid, NULL, pQueue);
+	}
+
+	/**
+	 * @brief Ƴ֡
+	 * @param[in] pTarget : Ŀ֡
+	 * @param[in] x : ͼ֡ x 
+	 * @param[in] y : ͼ֡ y 
+	 * @param[in] zoom : ͼ
+	 * @param[in] grid : ɫΪʾ߿ģʽΪ߿ɫΪʱʹðɫ
+	 * @param[in] pCam : ʹõΪ NULL ʱʹó
+	 * @param[in] pQueue : ʹõȾУΪ NULL ʱʹʱ
+	 * @return ػƺʱλ룩
+	 * @note ˺޸ĳҲʹ EasyX Ļͼ״̬Կڶ߳òͬͬʱãÿ߳ʹøԵĶУ
+	 *			ȾʱͬһУԱÿ֡·ڴ档׶εĺʱ¼ڶУ RenderQueue::GetStageTime
+	 *			ֱ̬ʱ SetDynamicResolutionԽϵ͵ķֱʻƣٷŴ֡塣
+	*/
+	double Render(FrameBuffer* pTarget, int x = 0, int y = 0, Zoom zoom = { 1,1 }, Color grid = -1, const Camera3D* pCam = NULL, RenderQueue* pQueue = NULL)
+	{
+		auto t = std::chrono::steady_clock::now();
+
+		RenderQueue queue;
+		if (!pQueue)
+			pQueue = &queue;
+		for (int i = 0; i < render_stages_num; i++)
+			pQueue->pStageTimes[i] = 0;
+
+		// ֱ̬ʣڲ뵱ǰͼΪƺٷŴ
+		int w = pTarget->GetWidth(), h = pTarget->GetHeight();
+		double scale = fTargetFrameTime > 0 ? pQueue->fResolutionScale : 1;
+		int sw = std::max((int)ceil(w * scale), 1), sh = std::max((int)ceil(h * scale), 1);
+		FrameBuffer fbScaled;
+		FrameBuffer* pDraw = pTarget;
+		if ((sw < w || sh < h) && pQueue->fbScaled.Create(w, h) && fbScaled.AttachSubRegion(&pQueue->fbScaled, 0, 0, sw, sh))
+		{
+			auto t_resample = std::chrono::steady_clock::now();
+			ResampleFrameBuffer(pTarget, &fbScaled, false);
+			pQueue->pStageTimes[render_stage_resample] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t_resample).count();
+			pDraw = &fbScaled;
+			x = (int)lround(x * (double)sw / w);
+			y = (int)lround(y * (double)sh / h);
+		}
+		else
+		{
+			sw = w;
+			sh = h;
+		}
+
+		DrawFrame(pDraw, x, y, zoom, grid, pCam ? *pCam : camera, pQueue);
+
+		if (pDraw != pTarget)
+		{
+			auto t_resample = std::chrono::steady_clock::now();
+			ResampleFrameBuffer(pDraw, pTarget, true);
+			pQueue->pStageTimes[render_stage_resample] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t_resample).count();
+		}
+		if (fTargetFrameTime > 0)
+			pQueue->UpdateResolutionScale(fTargetFrameTime, fMinResolutionScale, sw * sh, w * h);
+
+		double cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+		if (cost <= 0)
+			cost = MIN_TIME_COST;
+
+		return cost;
+	}
+
+};
+
+//////// ӿȾ
+
+/**
+ * @brief ӿڣĳĳȾ֡һ
+*/
+struct Viewport3D
+{
+	Scence3D* pScence;			/** @brief ҪȾĳ */
+	const Camera3D* pCamera;	/** @brief ʹõΪ NULL ʱʹó */
+	FrameBuffer* pTarget;		/** @brief Ŀ֡ */
+	int left;					/** @brief ӿĿ֡е x  */
+	int top;					/** @brief ӿĿ֡е y  */
+	int width;					/** @brief ӿȣΪ 0 ʱʹĿ֡Ŀ */
+	int height;					/** @brief ӿ߶ȣΪ 0 ʱʹĿ֡ĸ߶ */
+	int x;						/** @brief ͼӿڵ x ꣨ͬ Scence3D::Render */
+	int y;						/** @brief ͼӿڵ y ꣨ͬ Scence3D::Render */
+	Zoom zoom;					/** @brief ͼ */
+	Color grid;					/** @brief ɫΪʾ */
+	Color bk;					/** @brief ɫΪʾӿ */
+	RenderQueue* pQueue;		/** @brief ʹõȾУΪ NULL ʱʹȾ̵߳ʱ */
+	double cost;				/** @brief شӿڵĻƺʱλ룩 */
+};
+
+/**
+ * @brief ߳Ⱦӿڣ
+ * @param[in, out] pViewports : ӿ飬Ⱦдӿڵĺʱ
+ * @param[in] num : ӿ
+ * @param[in] nThreads : ߳Ϊ 0 ʱʹȫ CPU ģӿ
+ * @return ܺʱλ룩
+ * @note ÿӿһ߳Ⱦӿڿʹͬһеֻȡ
+ *			ӿڻƵԼڣͬһ֡ϵӿӦص
+ *			ӿڵ߱Ӧӿһ£ͼᱻ졣
+ * @attention Ⱦڼ䲻޸ĳָȾеӿ֮䲻ùͬһ
+*/
+inline double RenderViewports(Viewport3D* pViewports, int num, int nThreads = 0)
+{
+	if (num <= 0) return MIN_TIME_COST;
+
+	if (nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads <= 0) nThreads = 1;
+	if (nThreads > num) nThreads = num;
+
+	auto t = std::chrono::steady_clock::now();
+
+	std::atomic<int> nNext(0);
+	auto worker = [&]() {
+		RenderQueue queue;
+		FrameBuffer region;
+		for (int i = nNext++; i < num; i = nNext++)
+		{
+			Viewport3D& v = pViewports[i];
+			v.cost = MIN_TIME_COST;
+			if (!v.pScence || !v.pTarget) continue;
+
+			int w = v.width > 0 ? v.width : v.pTarget->GetWidth();
+			int h = v.height > 0 ? v.height : v.pTarget->GetHeight();
+			if (!region.AttachSubRegion(v.pTarget, v.left, v.top, w, h)) continue;
+
+			if (v.bk >= 0)
+				region.Clear(v.bk);
+			v.cost = v.pScence->Render(&region, v.x, v.y, v.zoom, v.grid, v.pCamera, v.pQueue ? v.pQueue : &queue);
+		}
+	};
+
+	std::thread* pWorkers = new std::thread[nThreads - 1];
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i] = std::thread(worker);
+	worker();
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i].join();
+	delete[] pWorkers;
+
+	double cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+	if (cost <= 0)
+		cost = MIN_TIME_COST;
+
+	return cost;
+}
+
+//////// ׷
+
+/**
+ * @brief ׷ٵ
+*/
+struct RayTraceSettings
+{
+	int x;				/** @brief ͼ x ꣨ͬ Scence3D::Render */
+	int y;				/** @brief ͼ y ꣨ͬ Scence3D::Render */
+	Zoom zoom;			/** @brief ͼ */
+	Color bk;			/** @brief ɫΪʾû */
+	bool bShadows;		/** @brief ǷӰ */
+	int nAOSamples;		/** @brief ÿصĻڱβΪ 0 ʱ㻷ڱ */
+	double dAODistance;	/** @brief ڱεķΧΪ 0 ʱʹóΧжԽ߳ȵ 1/10 */
+	int nThreads;		/** @brief ߳Ϊ 0 ʱʹȫ CPU  */
+};
+
+/**
+ * @brief ߽ɫ
+ * @param[in] pScence : 
+ * @param[in] pBVH :  BVH
+ * @param[in] hit : 
+ * @param[in] o : 
+ * @param[in] d : ߷
+ * @param[in] pSettings : ׷
+ * @param[in] params : ղ
+ * @param[in] eps : μطߵƫཻ
+ * @param[in] dAODistance : ڱεķΧ
+ * @param[in] seed : 
+ * @return ɫ0x00RRGGBB
+ * @note  LightVertex ʹͬĹģͣLambert  + Blinn ߹⣬˫棩ÿԴӰߣ
+ *			԰ҷֲİδڵıΪ Gouraud ģʽʱʹòֵĶ㷨ߣʹ淨ߡ
+*/
+inline DWORD ShadeRayHit(Scence3D* pScence, const BVH3D* pBVH, const RayHit3D& hit, Point3D o, Point3D d,
+	const RayTraceSettings* pSettings, const LightingParams& params, double eps, double dAODistance, unsigned int seed)
+{
+	Object3D& obj = pScence->GetObjects()[hit.nObject];
+	Polygon3D& poly = obj.GetPolygons()[hit.nPolygon];
+	const int k[3] = { 0,hit.nTriangle + 1,hit.nTriangle + 2 };
+	const double w[3] = { 1 - hit.u - hit.v,hit.u,hit.v };
+
+	auto dot = [](Point3D a, Point3D b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+	auto mad = [](Point3D a, Point3D b, double s) -> Point3D { return { a.x + b.x * s,a.y + b.y * s,a.z + b.z * s }; };
+
+	Point3D p = mad(o, d, hit.t);
+	Point3D a = poly.pPoints[k[0]], b = poly.pPoints[k[1]], c = poly.pPoints[k[2]];
+	Point3D e1 = { b.x - a.x,b.y - a.y,b.z - a.z }, e2 = { c.x - a.x,c.y - a.y,c.z - a.z };
+	Point3D ng = Normalize3D({ e1.y * e2.z - e1.z * e2.y,e1.z * e2.x - e1.x * e2.z,e1.x * e2.y - e1.y * e2.x });
+	if (dot(ng, d) > 0)
+		ng = { -ng.x,-ng.y,-ng.z };
+
+	Point3D n = ng;
+	if (pScence->GetShadeMode() == shade_gouraud)
+	{
+		const int* pIndices = obj.GetIndices() + pBVH->GetPrimitive(hit.nPrimitive).nFirstIndex;
+		const Point3D* pNormals = obj.GetNormals();
+		Point3D s = { 0,0,0 };
+		for (int i = 0; i < 3; i++)
+			s = mad(s, pNormals[pIndices[k[i]]], w[i]);
+		if (s.x != 0 || s.y != 0 || s.z != 0)
+		{
+			n = Normalize3D(s);
+			if (dot(n, ng) < 0)
+				n = { -n.x,-n.y,-n.z };
+		}
+	}
+
+	// ɫж㶼ɫʱֵʹöɫʱɫ
+	double base[3] = { 1,1,1 };
+	bool bColored = true;
+	for (int i = 0; i < 3; i++)
+		if (poly.GetPointColor(k[i]) < 0)
+			bColored = false;
+	if (bColored)
+	{
+		base[0] = base[1] = base[2] = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			Color ci = poly.GetPointColor(k[i]);
+			base[0] += GetRValue(ci) / 255.0 * w[i];
+			base[1] += GetGValue(ci) / 255.0 * w[i];
+			base[2] += GetBValue(ci) / 255.0 * w[i];
+		}
+	}
+	if (poly.pTexture && poly.pTexCoords && poly.pTexture->GetLevelsNum() > 0)
+	{
+		double u = 0, v = 0, q = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			u += poly.pTexCoords[k[i]].u * w[i];
+			v += poly.pTexCoords[k[i]].v * w[i];
+			q += poly.pTexCoords[k[i]].q * w[i];
+		}
+		if (q > 0)
+		{
+			DWORD texel = poly.pTexture->Sample(u / q, v / q);
+			base[0] *= ((texel >> 16) & 0xFF) / 255.0;
+			base[1] *= ((texel >> 8) & 0xFF) / 255.0;
+			base[2] *= (texel & 0xFF) / 255.0;
+		}
+	}
+
+	// μߴӽ淨΢ƫƺ
+	Point3D origin = mad(p, ng, eps);
+	Point3D view = Normalize3D({ -d.x,-d.y,-d.z });
+
+	double diffuse[3] = { 0,0,0 }, specular[3] = { 0,0,0 };
+	for (int i = 0; i < params.nLightsNum; i++)
+	{
+		const Light3D& light = params.pLights[i];
+		Point3D l;
+		double dist = FLT_MAX;
+		if (light.type == light_directional)
+		{
+			l = Normalize3D({ -light.vec.x,-light.vec.y,-light.vec.z });
+		}
+		else
+		{
+			l = { light.vec.x - p.x,light.vec.y - p.y,light.vec.z - p.z };
+			dist = sqrt(dot(l, l));
+			l = Normalize3D(l);
+		}
+		double ndl = dot(n, l);
+		if (ndl <= 0 || dot(ng, l) <= 0) continue;
+		if (pSettings->bShadows && pBVH->Occluded(origin, l, 0, dist)) continue;
+
+		double lc[3] = {
+			GetRValue(light.color) / 255.0 * light.intensity,
+			GetGValue(light.color) / 255.0 * light.intensity,
+			GetBValue(light.color) / 255.0 * light.intensity
+		};
+		double s = 0;
+		if (params.specular > 0)
+		{
+			Point3D h = Normalize3D({ l.x + view.x,l.y + view.y,l.z + view.z });
+			s = params.specular * pow(std::max(dot(n, h), 0.0), params.shininess);
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			diffuse[j] += lc[j] * ndl;
+			specular[j] += lc[j] * s;
+		}
+	}
+
+	// ڱΣڷ߷İڰҷֲ
+	double ao = 1;
+	if (pSettings->nAOSamples > 0)
+	{
+		auto random = [&seed]() {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return (seed >> 8) * (1.0 / 16777216);
+		};
+
+		// ԷΪ z 
+		Point3D tx = fabs(ng.x) > 0.5 ? Point3D{ 0,1,0 } : Point3D{ 1,0,0 };
+		tx = Normalize3D({ tx.y * ng.z - tx.z * ng.y,tx.z * ng.x - tx.x * ng.z,tx.x * ng.y - tx.y * ng.x });
+		Point3D ty = { ng.y * tx.z - ng.z * tx.y,ng.z * tx.x - ng.x * tx.z,ng.x * tx.y - ng.y * tx.x };
+
+		int nVisible = 0;
+		for (int i = 0; i < pSettings->nAOSamples; i++)
+		{
+			double r = sqrt(random()), phi = 2 * 3.1415926535 * random();
+			double sx = r * cos(phi), sy = r * sin(phi), sz = sqrt(std::max(0.0, 1 - r * r));
+			Point3D dir = mad(mad({ ng.x * sz,ng.y * sz,ng.z * sz }, tx, sx), ty, sy);
+			if (!pBVH->Occluded(origin, dir, 0, dAODistance))
+				nVisible++;
+		}
+		ao = (double)nVisible / pSettings->nAOSamples;
+	}
+
+	int rgb[3];
+	double ambient[3] = { GetRValue(params.ambient) / 255.0,GetGValue(params.ambient) / 255.0,GetBValue(params.ambient) / 255.0 };
+	for (int j = 0; j < 3; j++)
+	{
+		double v = base[j] * (ambient[j] * ao + diffuse[j]) + specular[j];
+		rgb[j] = std::min(std::max((int)(v * 255 + 0.5), 0), 255);
+	}
+	return (DWORD)(rgb[0] << 16 | rgb[1] << 8 | rgb[2]);
+}
+
+/**
+ * @brief ù׷Ⱦ֡
+ * @param[in] pScence : ҪȾĳ
+ * @param[in] pTarget : Ŀ֡
+ * @param[in] pCam : ʹõΪ NULL ʱʹó
+ * @param[in] pSettings : ׷
+ * @return ػƺʱλ룩Ҫʱؽ BVH ʱ
+ * @note ͼ RAYTRACE_TILE_SIZE Сֿ飬ÿ߳ȷֵһĿ飬̵߳Ķβȡ
+ *			ԸʱʱҲкġÿ 2x2 صһ߰ͬ BVH
+ *			դʹͬĻӳ䣬ͬĲλ Render Ľһ¡
+ *			ûйԴʱʹһƽй⡣ֻΣ߶β׷١
+ * @attention Ⱦڼ䲻޸ĳ
+*/
+inline double RayTraceScence(Scence3D* pScence, FrameBuffer* pTarget, const Camera3D* pCam, const RayTraceSettings* pSettings)
+{
+	auto t = std::chrono::steady_clock::now();
+
+	const Camera3D cam = pCam ? *pCam : pScence->GetCamera();
+	const BVH3D* pBVH = pScence->UpdateBVH();
+	const int w = pTarget->GetWidth(), h = pTarget->GetHeight();
+	if (w <= 0 || h <= 0) return MIN_TIME_COST;
+
+	Rectangle3D r = pBVH->GetBounds();
+	double diagonal = sqrt((r.max_x - r.min_x) * (r.max_x - r.min_x) + (r.max_y - r.min_y) * (r.max_y - r.min_y) + (r.max_z - r.min_z) * (r.max_z - r.min_z));
+	double eps = diagonal * 1e-4 + 1e-6;
+	double dAODistance = pSettings->dAODistance > 0 ? pSettings->dAODistance : diagonal / 10;
+
+	// ղûйԴʱʹͷ
+	Light3D headlight = { light_directional,{ 0,0,1 },WHITE,1 };
+	Point3D pCenterOrigin;
+	GetCameraRay(cam, { 0,0 }, &pCenterOrigin, &headlight.vec);
+	int nShininess = 0;
+	double specular = pScence->GetSpecular(&nShininess);
+	LightingParams params = { pScence->GetLights(),pScence->GetLightsNum(),pScence->GetAmbientLight(),specular,nShininess,cam.pPosition };
+	if (params.nLightsNum <= 0)
+	{
+		params.pLights = &headlight;
+		params.nLightsNum = 1;
+	}
+
+	const int nTilesX = (w + RAYTRACE_TILE_SIZE - 1) / RAYTRACE_TILE_SIZE;
+	const int nTilesY = (h + RAYTRACE_TILE_SIZE - 1) / RAYTRACE_TILE_SIZE;
+	const int nTiles = nTilesX * nTilesY;
+	int nThreads = pSettings->nThreads;
+	if (nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads <= 0) nThreads = 1;
+	if (nThreads > nTiles) nThreads = nTiles;
+
+	// ÿ̵߳Ŀ [begin, end)ԼӶȡ̴߳Ӷβȡ
+	struct TileQueue
+	{
+		std::mutex lock;
+		int begin, end;
+	};
+	TileQueue* pQueues = new TileQueue[nThreads];
+	for (int i = 0; i < nThreads; i++)
+	{
+		pQueues[i].begin = (int)((long long)nTiles * i / nThreads);
+		pQueues[i].end = (int)((long long)nTiles * (i + 1) / nThreads);
+	}
+	auto take = [&](int self) -> int {
+		for (int i = 0; i < nThreads; i++)
+		{
+			TileQueue& q = pQueues[(self + i) % nThreads];
+			std::lock_guard<std::mutex> guard(q.lock);
+			if (q.begin < q.end)
+				return i == 0 ? q.begin++ : --q.end;
+		}
+		return -1;
+	};
+
+	const DWORD bk = pSettings->bk >= 0 ? BGR((COLORREF)pSettings->bk) : 0;
+	auto worker = [&](int self) {
+		for (int tile = take(self); tile >= 0; tile = take(self))
+		{
+			int x0 = tile % nTilesX * RAYTRACE_TILE_SIZE, y0 = tile / nTilesX * RAYTRACE_TILE_SIZE;
+			int x1 = std::min(x0 + RAYTRACE_TILE_SIZE, w), y1 = std::min(y0 + RAYTRACE_TILE_SIZE, h);
+			for (int y = y0; y < y1; y += 2)
+			{
+				for (int x = x0; x < x1; x += 2)
+				{
+					// 2x2 һ߰
+					RayPacket4 rays;
+					Point3D o[4], d[4];
+					for (int i = 0; i < 4; i++)
+					{
+						int px = x + (i & 1), py = y + (i >> 1);
+						Point2D ndc = ConvertScreenPointToNDC2D({ px + 0.5 - pSettings->x,py + 0.5 - pSettings->y }, pSettings->zoom, w, h);
+						GetCameraRay(cam, ndc, &o[i], &d[i]);
+						rays.ox[i] = (float)o[i].x;
+						rays.oy[i] = (float)o[i].y;
+						rays.oz[i] = (float)o[i].z;
+						rays.dx[i] = (float)d[i].x;
+						rays.dy[i] = (float)d[i].y;
+						rays.dz[i] = (float)d[i].z;
+						rays.tmin[i] = (float)cam.dNear;
+						rays.tmax[i] = px < x1 && py < y1 ? (float)cam.dFar : -1;
+					}
+
+					RayHit3D pHits[4];
+					pBVH->Intersect4(rays, pHits);
+					for (int i = 0; i < 4; i++)
+					{
+						int px = x + (i & 1), py = y + (i >> 1);
+						if (px >= x1 || py >= y1) continue;
+						if (pHits[i].nObject >= 0)
+						{
+							unsigned int seed = (unsigned int)(py * w + px) * 2654435761u + 1;
+							pTarget->GetLine(py)[px] = ShadeRayHit(pScence, pBVH, pHits[i], o[i], d[i], pSettings, params, eps, dAODistance, seed);
+						}
+						else if (pSettings->bk >= 0)
+						{
+							pTarget->GetLine(py)[px] = bk;
+						}
+					}
+				}
+			}
+		}
+	};
+
+	std::thread* pWorkers = new std::thread[nThreads - 1];
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i] = std::thread(worker, i + 1);
+	worker(0);
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i].join();
+	delete[] pWorkers;
+	delete[] pQueues;
+
+	double cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+	if (cost <= 0)
+		cost = MIN_TIME_COST;
+
+	return cost;
+}
+
+//////// ģ͵
+
+/**
+ * @brief 
+ * @note  ReadMeshFile Ⱥ䣬 AllocArray 䣬ʹ FreeMesh ͷš
+ *			Ѿȥأֱӽ Object3D::SetMesh
+*/
+struct MeshData
+{
+	Point3D* pVertices;		/** @brief  */
+	Color* pColors;			/** @brief ɫļûɫʱΪ NULL */
+	int nVerticesNum;		/** @brief  */
+	int* pTriangles;		/** @brief ÿԪΪһε± */
+	int nTrianglesNum;		/** @brief  */
+};
+
+/**
+ * @brief ģ͵ͳϢ
+*/
+struct MeshImportStats
+{
+	size_t nFileBytes;		/** @brief ļСֽڣ */
+	int nRawVerticesNum;	/** @brief ȥǰĶSTL ÿζĶ㣩 */
+	double fParseTime;		/** @brief ʱ룩ȥغǻ */
+	double fTotalTime;		/** @brief ܺʱ룩򿪺ӳļ */
+};
+
+/**
+ * @brief ͷŵ
+*/
+inline void FreeMesh(MeshData* pMesh)
+{
+	FreeArray(pMesh->pVertices);
+	FreeArray(pMesh->pColors);
+	FreeArray(pMesh->pTriangles);
+	*pMesh = {};
+}
+
+/**
+ * @brief ֻڴӳļ
+ * @note ļӳ䵽ڴУɲϵͳ룬ʱҪٰļƵ
+*/
+class MappedFile
+{
+private:
+
+	HANDLE hFile;
+	HANDLE hMapping;
+	const char* pData;
+	size_t nSize;
+
+public:
+
+	MappedFile()
+	{
+		hFile = INVALID_HANDLE_VALUE;
+		hMapping = NULL;
+		pData = NULL;
+		nSize = 0;
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	/**
+	 * @brief 򿪲ӳļ
+	 * @return ʧʱ falseļԴ򿪣 GetData  NULL
+	*/
+	bool Open(const char* strFile)
+	{
+		Close();
+		hFile = CreateFileA(strFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (hFile == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(hFile, &size))
+		{
+			Close();
+			return false;
+		}
+		nSize = (size_t)size.QuadPart;
+		if (nSize == 0)
+			return true;
+
+		hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping)
+			pData = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (!pData)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * @brief رļ
+	*/
+	void Close()
+	{
+		if (pData) UnmapViewOfFile(pData);
+		if (hMapping) CloseHandle(hMapping);
+		if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+		hFile = INVALID_HANDLE_VALUE;
+		hMapping = NULL;
+		pData = NULL;
+		nSize = 0;
+	}
+
+	/**
+	 * @brief ȡļ
+	*/
+	const char* GetData() const
+	{
+		return pData;
+	}
+
+	/**
+	 * @brief ȡļСֽڣ
+	*/
+	size_t GetSize() const
+	{
+		return nSize;
+	}
+};
+
+/**
+ * @brief ģʱʹõĿ
+ * @note ʱÿԪضڴ
+*/
+template<class T>
+struct MeshBuffer
+{
+	T* p = NULL;
+	int num = 0;
+	int capacity = 0;
+
+	MeshBuffer() = default;
+	MeshBuffer(const MeshBuffer&) = delete;
+	MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+	~MeshBuffer()
+	{
+		FreeArray(p);
+	}
+
+	/**
+	 * @brief ȷΪ nԪ֪ʱԤȷ䣬ʱĸƣ
+	 * @return ʧʱ falseԭеԪز
+	*/
+	bool Reserve(int n)
+	{
+		if (n <= capacity) return true;
+		T* pNew = TryAllocArray<T>(n, memory_mesh);
+		if (!pNew) return false;
+		if (num > 0) memcpy(pNew, p, sizeof(T) * num);
+		FreeArray(p);
+		p = pNew;
+		capacity = n;
+		return true;
+	}
+
+	/**
+	 * @brief ĩβ n Ԫزǵĵַ
+	 * @return ʧʱ NULL
+	*/
+	T* Grow(int n)
+	{
+		if (num + n > capacity && !Reserve(std::max(std::max(capacity * 2, num + n), 64)))
+			return NULL;
+		num += n;
+		return p + num - n;
+	}
+
+	/**
+	 * @brief ĩβһԪ
+	 * @return ʧʱ false
+	*/
+	bool Push(const T& v)
+	{
+		T* q = Grow(1);
+		if (!q) return false;
+		*q = v;
+		return true;
+	}
+
+	/**
+	 * @brief ȡ飨֮ɵͷţ
+	*/
+	T* Detach()
+	{
+		T* r = p;
+		p = NULL;
+		num = capacity = 0;
+		return r;
+	}
+};
+
+/**
+ * @brief ոƱУ
+*/
+inline const char* SkipBlank(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+	return p;
+}
+
+/**
+ * @brief пհַУ
+*/
+inline const char* SkipSpace(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+	return p;
+}
+
+/**
+ * @brief һеĿͷ
+*/
+inline const char* SkipLine(const char* p, const char* end)
+{
+	const char* q = (const char*)memchr(p, '\n', end - p);
+	return q ? q + 1 : end;
+}
+
+/**
+ * @brief öִ߳ num ÿһ task(i)
+ * @param[in] nThreads : ߳Ϊ 0 ʱʹкģ
+ * @note ԭӼȡõ߳ҲִУȫɺŷ
+*/
+template<class F>
+inline void RunParallel(int num, int nThreads, const F& task)
+{
+	if (num <= 0) return;
+	if (nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads <= 0) nThreads = 1;
+	if (nThreads > num) nThreads = num;
+
+	std::atomic<int> nNext(0);
+	auto worker = [&]() {
+		for (int i = nNext++; i < num; i = nNext++)
+			task(i);
+	};
+
+	std::thread* pWorkers = new std::thread[nThreads - 1];
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i] = std::thread(worker);
+	worker();
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i].join();
+	delete[] pWorkers;
+}
+
+/**
+ * @brief 㲢нһıʱֳɵĿ
+ * @param[in] nSize : ıСֽڣ
+ * @param[in] nThreads : ߳Ϊ 0 ʱʹкģ
+ * @note Ϊ߳ 4 ƽĺʱÿ鲻С PARSE_CHUNK_MIN_SIZE
+*/
+inline int GetTextChunksNum(size_t nSize, int nThreads)
+{
+	if (nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads <= 1) return 1;
+	size_t n = std::min(nSize / PARSE_CHUNK_MIN_SIZE, (size_t)nThreads * 4);
+	return n > 1 ? (int)n : 1;
+}
+
+/**
+ * @brief ıзΪ n 
+ * @param[out] pBounds : ı߽磨n + 1  i Ϊ [pBounds[i], pBounds[i + 1])
+ * @note һ⣬ÿ鶼׿ʼһвᱻֵУΪգ
+*/
+inline void SplitTextLines(const char* p, const char* end, int n, const char** pBounds)
+{
+	pBounds[0] = p;
+	for (int i = 1; i < n; i++)
+	{
+		const char* q = p + (size_t)(end - p) * i / n;
+		pBounds[i] = q > pBounds[i - 1] ? SkipLine(q - 1, end) : pBounds[i - 1];
+	}
+	pBounds[n] = end;
+}
+
+/**
+ * @brief ʮ
+ * @param[in, out] p : λãɹʱƵ֮
+ * @return ûʱ false
+*/
+inline bool ParseInteger(const char*& p, const char* end, long long* pValue)
+{
+	const char* q = p;
+	bool bNegative = false;
+	if (q < end && (*q == '-' || *q == '+'))
+		bNegative = *q++ == '-';
+	if (q >= end || *q < '0' || *q > '9')
+		return false;
+	long long v = 0;
+	while (q < end && *q >= '0' && *q <= '9')
+		v = v * 10 + (*q++ - '0');
+	*pValue = bNegative ? -v : v;
+	p = q;
+	return true;
+}
+
+/**
+ * @brief ʮʵ֧Сָ
+ * @param[in, out] p : λãɹʱƵ֮
+ * @return ûʱ false
+ * @note ãҲҪ '\0' βЧȡ 19 λ㹻ģ
+*/
+inline bool ParseReal(const char*& p, const char* end, double* pValue)
+{
+	static const double pPowers[] = {
+		1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+		1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22
+	};
+
+	const char* q = p;
+	bool bNegative = false;
+	if (q < end && (*q == '-' || *q == '+'))
+		bNegative = *q++ == '-';
+
+	unsigned long long mantissa = 0;
+	int nDigits = 0, exponent = 0;
+	bool bAny = false;
+	for (; q < end && *q >= '0' && *q <= '9'; q++, bAny = true)
+	{
+		if (nDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*q - '0');
+			if (mantissa) nDigits++;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+	if (q < end && *q == '.')
+	{
+		for (q++; q < end && *q >= '0' && *q <= '9'; q++, bAny = true)
+		{
+			if (nDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*q - '0');
+				if (mantissa) nDigits++;
+				exponent--;
+			}
+		}
+	}
+	if (!bAny)
+		return false;
+
+	if (q < end && (*q == 'e' || *q == 'E'))
+	{
+		const char* r = q + 1;
+		long long e = 0;
+		if (ParseInteger(r, end, &e))
+		{
+			exponent += (int)std::max(std::min(e, 1000ll), -1000ll);
+			q = r;
+		}
+	}
+
+	double v = (double)mantissa;
+	if (exponent < 0)
+		v = exponent >= -22 ? v / pPowers[-exponent] : v * pow(10.0, exponent);
+	else if (exponent > 0)
+		v = exponent <= 22 ? v * pPowers[exponent] : v * pow(10.0, exponent);
+	*pValue = bNegative ? -v : v;
+	p = q;
+	return true;
+}
+
+inline bool ParseNumber(const char*& p, const char* end, double* pValue)
+{
+	return ParseReal(p, end, pValue);
+}
+
+inline bool ParseNumber(const char*& p, const char* end, int* pValue)
+{
+	long long v = 0;
+	if (!ParseInteger(p, end, &v) || v < INT_MIN || v > INT_MAX)
+		return false;
+	*pValue = (int)v;
+	return true;
+}
+
+/**
+ * @brief нһԿհ׷ָ
+ * @param[in] p, end : ıΧֺֻͿհ
+ * @param[in] nThreads : ߳Ϊ 0 ʱʹкģ
+ * @param[out] pValues : ְԭ˳ĩβ
+ * @return вֵݻڴ治ʱ false
+ * @note ıзֿ飬ԼУ󰴿˳ϲ뵥߳̽ͬ
+*/
+template<class T>
+inline bool ParseNumbersParallel(const char* p, const char* end, int nThreads, MeshBuffer<T>* pValues)
+{
+	int n = GetTextChunksNum(end - p, nThreads);
+	const char** pBounds = new const char*[n + 1];
+	SplitTextLines(p, end, n, pBounds);
+
+	MeshBuffer<T>* pChunks = new MeshBuffer<T>[n];
+	bool* pErrors = new bool[n];
+	RunParallel(n, nThreads, [&](int i) {
+		const char* q = SkipSpace(pBounds[i], pBounds[i + 1]);
+		const char* e = pBounds[i + 1];
+		MeshBuffer<T>& values = pChunks[i];
+		values.Reserve((int)std::min((size_t)(e - q) / 8 + 16, (size_t)INT_MAX / 2));
+		pErrors[i] = false;
+		while (q < e)
+		{
+			T* v = values.Grow(1);
+			if (!v || !ParseNumber(q, e, v) || (q < e && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n'))
+			{
+				pErrors[i] = true;
+				break;
+			}
+			q = SkipSpace(q, e);
+		}
+	});
+
+	bool bOK = true;
+	int num = 0;
+	for (int i = 0; i < n; i++)
+	{
+		bOK = bOK && !pErrors[i];
+		num += pChunks[i].num;
+	}
+	if (bOK)
+	{
+		bOK = pValues->Reserve(pValues->num + num);
+		for (int i = 0; i < n && bOK; i++)
+			if (pChunks[i].num > 0)
+				memcpy(pValues->Grow(pChunks[i].num), pChunks[i].p, sizeof(T) * pChunks[i].num);
+	}
+
+	delete[] pChunks;
+	delete[] pErrors;
+	delete[] pBounds;
+	return bOK;
+}
+
+/**
+ * @brief һΪΣ
+ * @param[in] pCorners : Ķ±
+ * @param[in] n : Ķ
+ * @param[in] pPoints : ѾȡĶ
+ * @param[in] nPointsNum : ѾȡĶ
+ * @param[out] pTriangles : 
+ * @param[out] pTemp : ʱռ
+ * @return ±Խڴ治ʱ false汻
+*/
+inline bool AddMeshFace(const int* pCorners, int n, const Point3D* pPoints, int nPointsNum, MeshBuffer<int>* pTriangles, MeshBuffer<Point3D>* pTemp)
+{
+	for (int i = 0; i < n; i++)
+		if (pCorners[i] < 0 || pCorners[i] >= nPointsNum)
+			return false;
+	if (n < 3)
+		return true;
+
+	int* t = pTriangles->Grow((n - 2) * 3);
+	if (!t)
+		return false;
+	if (n == 3)
+	{
+		t[0] = pCorners[0];
+		t[1] = pCorners[1];
+		t[2] = pCorners[2];
+		return true;
+	}
+
+	pTemp->num = 0;
+	Point3D* p = pTemp->Grow(n);
+	if (!p)
+		return false;
+	for (int i = 0; i < n; i++)
+		p[i] = pPoints[pCorners[i]];
+	TriangulatePolygon3D(p, n, t);
+	for (int i = 0; i < (n - 2) * 3; i++)
+		t[i] = pCorners[t[i]];
+	return true;
+}
+
+/**
+ * @brief Ŷ㡢ȥأɵ
+ * @param[in] pPoints : ȡĶ㣨ᱻţ
+ * @param[in] pColors : ȡĶɫΪ NULL
+ * @param[in] pTriangles : ΣᱻдΪȥغ±꣩ȥغ˻αȥ
+ * @param[out] pMesh : 
+*/
+inline void FinishMesh(MeshBuffer<Point3D>* pPoints, MeshBuffer<Color>* pColors, MeshBuffer<int>* pTriangles, double scale, MeshData* pMesh)
+{
+	int num = pPoints->num;
+	for (int i = 0; i < num; i++)
+		pPoints->p[i] = { pPoints->p[i].x * scale,pPoints->p[i].y * scale,pPoints->p[i].z * scale };
+
+	Point3D* pUnique = AllocArray<Point3D>(num, memory_mesh);
+	int* pRemap = AllocArray<int>(num, memory_mesh);
+	int nUniqueNum = WeldVertices(pPoints->p, num, pUnique, pRemap);
+
+	*pMesh = {};
+	pMesh->nVerticesNum = nUniqueNum;
+	pMesh->pVertices = AllocArray<Point3D>(nUniqueNum, memory_mesh);
+	memcpy(pMesh->pVertices, pUnique, sizeof(Point3D) * nUniqueNum);
+	if (pColors && pColors->num == num)
+	{
+		pMesh->pColors = AllocArray<Color>(nUniqueNum, memory_mesh);
+		for (int i = num - 1; i >= 0; i--)
+			pMesh->pColors[pRemap[i]] = pColors->p[i];
+	}
+	FreeArray(pUnique);
+
+	int nTrianglesNum = 0;
+	int* t = pTriangles->p;
+	for (int i = 0; i < pTriangles->num / 3; i++)
+	{
+		int a = pRemap[t[i * 3]], b = pRemap[t[i * 3 + 1]], c = pRemap[t[i * 3 + 2]];
+		if (a == b || b == c || a == c) continue;
+		t[nTrianglesNum * 3] = a;
+		t[nTrianglesNum * 3 + 1] = b;
+		t[nTrianglesNum * 3 + 2] = c;
+		nTrianglesNum++;
+	}
+	FreeArray(pRemap);
+	pMesh->nTrianglesNum = nTrianglesNum;
+	pMesh->pTriangles = pTriangles->Detach();
+}
+
+/**
+ * @brief PLY Ե
+*/
+enum PLYType
+{
+	ply_none,
+	ply_int8, ply_uint8, ply_int16, ply_uint16, ply_int32, ply_uint32, ply_float32, ply_float64
+};
+
+/**
+ * @brief ƻȡ PLY 
+*/
+inline PLYType GetPLYType(const char* str, int len)
+{
+	struct { const char* name; PLYType type; } pTypes[] = {
+		{ "char",ply_int8 },{ "int8",ply_int8 },{ "uchar",ply_uint8 },{ "uint8",ply_uint8 },
+		{ "short",ply_int16 },{ "int16",ply_int16 },{ "ushort",ply_uint16 },{ "uint16",ply_uint16 },
+		{ "int",ply_int32 },{ "int32",ply_int32 },{ "uint",ply_uint32 },{ "uint32",ply_uint32 },
+		{ "float",ply_float32 },{ "float32",ply_float32 },{ "double",ply_float64 },{ "float64",ply_float64 }
+	};
+	for (auto& t : pTypes)
+		if ((int)strlen(t.name) == len && memcmp(t.name, str, len) == 0)
+			return t.type;
+	return ply_none;
+}
+
+/**
+ * @brief Ӷ PLY жȡһֵ
+ * @param[in] bSwap : ǷҪֽ򣨴ļ
+*/
+inline double ReadPLYValue(const char* p, PLYType type, bool bSwap)
+{
+	static const int pSizes[] = { 0,1,1,2,2,4,4,4,8 };
+	unsigned char b[8];
+	int size = pSizes[type];
+	for (int i = 0; i < size; i++)
+		b[i] = p[bSwap ? size - 1 - i : i];
+
+	switch (type)
+	{
+	case ply_int8: return (signed char)b[0];
+	case ply_uint8: return b[0];
+	case ply_int16: { short v; memcpy(&v, b, 2); return v; }
+	case ply_uint16: { unsigned short v; memcpy(&v, b, 2); return v; }
+	case ply_int32: { int v; memcpy(&v, b, 4); return v; }
+	case ply_uint32: { unsigned int v; memcpy(&v, b, 4); return v; }
+	case ply_float32: { float v; memcpy(&v, b, 4); return v; }
+	case ply_float64: { double v; memcpy(&v, b, 8); return v; }
+	default: return 0;
+	}
+}
+
+/**
+ * @brief  PLY ļASCIIС˺ʹˣ
+ * @param[in] pData : ļ
+ * @param[in] nSize : ļС
+ * @param[in] scale : ű
+ * @param[out] pMesh : 
+ * @param[out] pRawVerticesNum : ȥǰĶΪ NULL
+ * @return ʽʱ false
+ * @note ȡ vertex Ԫص x, y, z  red, green, blueѡԼ face Ԫص vertex_indices vertex_indexб
+ *			ԪغԱᱻǻ
+*/
+inline bool ReadMeshPLY(const char* pData, size_t nSize, double scale, MeshData* pMesh, int* pRawVerticesNum = NULL)
+{
+	static const int pSizes[] = { 0,1,1,2,2,4,4,4,8 };
+	enum { role_none, role_x, role_y, role_z, role_red, role_green, role_blue, role_indices };
+	struct Property { PLYType type; PLYType count_type; int role; };
+	struct Element { bool bVertex, bFace; long long count; Property pProps[32]; int nPropsNum; };
+
+	const char* p = pData;
+	const char* end = pData + nSize;
+	if (nSize < 4 || memcmp(p, "ply", 3) != 0)
+		return false;
+
+	// ļͷ
+	Element pElements[16];
+	int nElementsNum = 0;
+	int format = -1;	// 0: ascii, 1: С, 2: 
+	for (p = SkipLine(p, end); ; p = SkipLine(p, end))
+	{
+		if (p >= end)
+			return false;
+
+		const char* pTokens[6];
+		int pLens[6];
+		int nTokensNum = 0;
+		const char* q = SkipBlank(p, end);
+		while (q < end && *q != '\n' && nTokensNum < 6)
+		{
+			pTokens[nTokensNum] = q;
+			while (q < end && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n') q++;
+			pLens[nTokensNum] = (int)(q - pTokens[nTokensNum]);
+			nTokensNum++;
+			q = SkipBlank(q, end);
+		}
+		auto is = [&](int i, const char* str) {
+			return i < nTokensNum && pLens[i] == (int)strlen(str) && memcmp(pTokens[i], str, pLens[i]) == 0;
+		};
+
+		if (is(0, "end_header"))
+		{
+			p = SkipLine(p, end);
+			break;
+		}
+		else if (is(0, "format"))
+		{
+			if (is(1, "ascii")) format = 0;
+			else if (is(1, "binary_little_endian")) format = 1;
+			else if (is(1, "binary_big_endian")) format = 2;
+			else return false;
+		}
+		else if (is(0, "element") && nTokensNum >= 3)
+		{
+			if (nElementsNum >= 16) return false;
+			Element& e = pElements[nElementsNum++];
+			e = {};
+			e.bVertex = is(1, "vertex");
+			e.bFace = is(1, "face");
+			const char* c = pTokens[2];
+			if (!ParseInteger(c, end, &e.count) || e.count < 0 || e.count > INT_MAX) return false;
+		}
+		else if (is(0, "property") && nElementsNum > 0)
+		{
+			Element& e = pElements[nElementsNum - 1];
+			if (e.nPropsNum >= 32) return false;
+			Property& prop = e.pProps[e.nPropsNum++];
+			prop = { ply_none,ply_none,role_none };
+			int name = 2;
+			if (is(1, "list") && nTokensNum >= 5)
+			{
+				prop.count_type = GetPLYType(pTokens[2], pLens[2]);
+				prop.type = GetPLYType(pTokens[3], pLens[3]);
+				if (prop.count_type == ply_none) return false;
+				name = 4;
+			}
+			else if (nTokensNum >= 3)
+			{
+				prop.type = GetPLYType(pTokens[1], pLens[1]);
+			}
+			if (prop.type == ply_none) return false;
+
+			const char* pRoles[] = { "","x","y","z","red","green","blue" };
+			for (int r = 1; r < 7; r++)
+				if (e.bVertex && prop.count_type == ply_none && is(name, pRoles[r]))
+					prop.role = r;
+			if (e.bFace && prop.count_type != ply_none && (is(name, "vertex_indices") || is(name, "vertex_index")))
+				prop.role = role_indices;
+		}
+	}
+	if (format < 0)
+		return false;
+
+	MeshBuffer<Point3D> points;
+	MeshBuffer<Color> colors;
+	MeshBuffer<int> triangles, corners;
+	MeshBuffer<Point3D> temp;
+	bool bSwap = format == 2;
+
+	// ȡһֵʱԽ
+	auto read = [&](PLYType type, double* pValue) -> bool {
+		if (format == 0)
+		{
+			p = SkipSpace(p, end);
+			return ParseReal(p, end, pValue);
+		}
+		if (end - p < pSizes[type]) return false;
+		*pValue = ReadPLYValue(p, type, bSwap);
+		p += pSizes[type];
+		return true;
+	};
+
+	for (int i = 0; i < nElementsNum; i++)
+	{
+		const Element& e = pElements[i];
+		bool bColors = false;
+		for (int k = 0; k < e.nPropsNum; k++)
+			bColors = bColors || e.pProps[k].role == role_red;
+
+		// ļͷеԪţȰÿԪصСȣΪбݵֽıΪÿһַ
+		// ʣµǷŵ£ٰԤȷ䣨水Σ
+		long long nMinBytes = 0;
+		for (int k = 0; k < e.nPropsNum; k++)
+			nMinBytes += format == 0 ? 1 : pSizes[e.pProps[k].count_type != ply_none ? e.pProps[k].count_type : e.pProps[k].type];
+		if (e.count > (end - p) / std::max(nMinBytes, 1LL))
+			return false;
+		if (e.bVertex)
+		{
+			if (points.num + e.count > INT_MAX || !points.Reserve(points.num + (int)e.count)
+				|| (bColors && !colors.Reserve(colors.num + (int)e.count)))
+				return false;
+		}
+		else if (e.bFace)
+		{
+			if (!triangles.Reserve((int)std::min(triangles.num + e.count * 3, (long long)INT_MAX)))
+				return false;
+		}
+
+		// Ŀ·С˶ơֻ float ԵĶ
+		bool bFast = e.bVertex && format == 1;
+		int stride = 0, pOffsets[4] = { -1,-1,-1,-1 };
+		for (int k = 0; k < e.nPropsNum && bFast; k++)
+		{
+			const Property& prop = e.pProps[k];
+			bFast = prop.count_type == ply_none && (prop.type == ply_float32 || prop.role == role_none);
+			if (prop.role >= role_x && prop.role <= role_z)
+				pOffsets[prop.role] = stride;
+			stride += pSizes[prop.type];
+		}
+		bFast = bFast && !bColors && pOffsets[role_x] >= 0 && pOffsets[role_y] >= 0 && pOffsets[role_z] >= 0;
+		if (bFast)
+		{
+			if ((size_t)(end - p) < (size_t)stride * e.count) return false;
+			Point3D* pPoints = points.Grow((int)e.count);
+			if (!pPoints && e.count > 0) return false;
+			for (int j = 0; j < e.count; j++, p += stride)
+			{
+				float v[3];
+				for (int k = 0; k < 3; k++)
+					memcpy(v + k, p + pOffsets[role_x + k], 4);
+				pPoints[j] = { v[0],v[1],v[2] };
+			}
+			continue;
+		}
+
+		// С˶ơֻһ uchar int ±б
+		const Property& list = e.pProps[0];
+		if (e.bFace && format == 1 && e.nPropsNum == 1 && list.role == role_indices && list.count_type == ply_uint8
+			&& (list.type == ply_int32 || list.type == ply_uint32))
+		{
+			for (int j = 0; j < e.count; j++)
+			{
+				if (p >= end) return false;
+				int n = (unsigned char)*p++;
+				if (end - p < n * 4) return false;
+				corners.num = 0;
+				int* pCorners = corners.Grow(n);
+				if (!pCorners && n > 0) return false;
+				memcpy(pCorners, p, n * 4);
+				p += n * 4;
+				if (!AddMeshFace(corners.p, n, points.p, points.num, &triangles, &temp))
+					return false;
+			}
+			continue;
+		}
+
+		for (int j = 0; j < e.count; j++)
+		{
+			double pValues[7] = { 0,0,0,0,255,255,255 };
+			corners.num = 0;
+			for (int k = 0; k < e.nPropsNum; k++)
+			{
+				const Property& prop = e.pProps[k];
+				double v = 0;
+				if (prop.count_type == ply_none)
+				{
+					if (!read(prop.type, &v)) return false;
+					if (prop.role != role_none)
+						pValues[prop.role] = (prop.type == ply_float32 || prop.type == ply_float64) && prop.role >= role_red ? v * 255 : v;
+					continue;
+				}
+
+				double count = 0;
+				if (!read(prop.count_type, &count) || count < 0) return false;
+				for (int m = 0; m < (int)count; m++)
+				{
+					if (!read(prop.type, &v)) return false;
+					if (prop.role == role_indices && !corners.Push((int)v)) return false;
+				}
+			}
+
+			if (e.bVertex)
+			{
+				if (!points.Push({ pValues[role_x],pValues[role_y],pValues[role_z] }))
+					return false;
+				if (bColors)
+				{
+					int c[3];
+					for (int m = 0; m < 3; m++)
+						c[m] = std::min(std::max((int)(pValues[role_red + m] + 0.5), 0), 255);
+					if (!colors.Push(RGB(c[0], c[1], c[2])))
+						return false;
+				}
+			}
+			else if (e.bFace)
+			{
+				if (!AddMeshFace(corners.p, corners.num, points.p, points.num, &triangles, &temp))
+					return false;
+			}
+		}
+	}
+
+	if (pRawVerticesNum) *pRawVerticesNum = points.num;
+	FinishMesh(&points, colors.num > 0 ? &colors : NULL, &triangles, scale, pMesh);
+	return true;
+}
+
+/**
+ * @brief  OBJ ļ
+ * @param[in] pData : ļ
+ * @param[in] nSize : ļС
+ * @param[in] scale : ű
+ * @param[out] pMesh : 
+ * @param[out] pRawVerticesNum : ȥǰĶΪ NULL
+ * @param[in] nThreads : ʹõ߳Ϊ 0 ʱʹкģ
+ * @return ʽȱʧĶ±Խ磩ʱ false
+ * @note ȡ v֧󸽼 0~1  r g b ɫ f֧ vv/vtv//vnv/vt/vn ͸±꣩
+ *			ꡢߡʵݱᱻǻ
+ *			ļзֿ鲢н±ںϲʱŻΪȫ±꣬뵥߳̽ͬ
+*/
+inline bool ReadMeshOBJ(const char* pData, size_t nSize, double scale, MeshData* pMesh, int* pRawVerticesNum = NULL, int nThreads = 0)
+{
+	// ÿĽĸ±ȼΪڵ±
+	struct Chunk
+	{
+		MeshBuffer<Point3D> points;
+		MeshBuffer<Color> colors;		// ڳֶɫУ֮ǰĶ㲹Ϊɫ
+		MeshBuffer<int> corners;		// Ķ±
+		MeshBuffer<int> sizes;			// ÿĶ
+		MeshBuffer<int> relatives;		// ʹø± corners Ԫصλ
+		MeshBuffer<int> triangles;
+		int nFirstVertex;				// ֮ǰĶ
+		bool bError;
+	};
+
+	int n = GetTextChunksNum(nSize, nThreads);
+	const char** pBounds = new const char*[n + 1];
+	SplitTextLines(pData, pData + nSize, n, pBounds);
+	Chunk* pChunks = new Chunk[n];
+
+	RunParallel(n, nThreads, [&](int i) {
+		Chunk& c = pChunks[i];
+		c.bError = false;
+		const char* end = pBounds[i + 1];
+		for (const char* p = pBounds[i]; p < end; p = SkipLine(p, end))
+		{
+			p = SkipBlank(p, end);
+			if (end - p < 2 || (p[1] != ' ' && p[1] != '\t'))
+				continue;
+
+			if (*p == 'v')
+			{
+				p += 2;
+				double v[6];
+				int k = 0;
+				for (; k < 6; k++)
+				{
+					p = SkipBlank(p, end);
+					if (!ParseReal(p, end, v + k))
+						break;
+				}
+				if (k < 3 || !c.points.Push({ v[0],v[1],v[2] }))
+				{
+					c.bError = true;
+					return;
+				}
+
+				if (k >= 6 && c.colors.num == 0)
+				{
+					Color* pWhite = c.colors.Grow(c.points.num - 1);
+					if (!pWhite && c.points.num > 1)
+					{
+						c.bError = true;
+						return;
+					}
+					std::fill_n(pWhite, c.points.num - 1, (Color)WHITE);
+				}
+				if (k >= 6 || c.colors.num > 0)
+				{
+					int rgb[3];
+					for (int m = 0; m < 3; m++)
+						rgb[m] = k >= 6 ? std::min(std::max((int)(v[3 + m] * 255 + 0.5), 0), 255) : 255;
+					if (!c.colors.Push(RGB(rgb[0], rgb[1], rgb[2])))
+					{
+						c.bError = true;
+						return;
+					}
+				}
+			}
+			else if (*p == 'f')
+			{
+				p += 2;
+				int num = 0;
+				for (;;)
+				{
+					p = SkipBlank(p, end);
+					long long index = 0;
+					if (!ParseInteger(p, end, &index))
+						break;
+					if ((index < 0 && !c.relatives.Push(c.corners.num))
+						|| !c.corners.Push((int)(index < 0 ? c.points.num + index : index - 1)))
+					{
+						c.bError = true;
+						return;
+					}
+					num++;
+					while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;	//  /vt/vn
+				}
+				if (!c.sizes.Push(num))
+				{
+					c.bError = true;
+					return;
+				}
+			}
+		}
+	});
+
+	// ˳ϲ
+	bool bOK = true, bColors = false;
+	int nPointsNum = 0;
+	for (int i = 0; i < n; i++)
+	{
+		bOK = bOK && !pChunks[i].bError;
+		bColors = bColors || pChunks[i].colors.num > 0;
+		pChunks[i].nFirstVertex = nPointsNum;
+		nPointsNum += pChunks[i].points.num;
+	}
+
+	MeshBuffer<Point3D> points;
+	MeshBuffer<Color> colors;
+	MeshBuffer<int> triangles;
+	if (bOK)
+		bOK = points.Reserve(nPointsNum) && (!bColors || colors.Reserve(nPointsNum));
+	for (int i = 0; i < n && bOK; i++)
+	{
+		Chunk& c = pChunks[i];
+		if (c.points.num == 0) continue;
+		Point3D* pPoints = points.Grow(c.points.num);
+		Color* pColors = bColors ? colors.Grow(c.points.num) : NULL;
+		if (!pPoints || (bColors && !pColors))
+		{
+			bOK = false;
+			break;
+		}
+		memcpy(pPoints, c.points.p, sizeof(Point3D) * c.points.num);
+		if (c.colors.num > 0)
+			memcpy(pColors, c.colors.p, sizeof(Color) * c.colors.num);
+		else if (bColors)
+			std::fill_n(pColors, c.points.num, (Color)WHITE);
+		FreeArray(c.points.Detach());	// Ѻϲǰͷ
+		FreeArray(c.colors.Detach());
+	}
+
+	if (bOK)
+	{
+		// 㸺±鲢ǻٰ˳ϲ
+		RunParallel(n, nThreads, [&](int i) {
+			Chunk& c = pChunks[i];
+			MeshBuffer<Point3D> temp;
+			for (int k = 0; k < c.relatives.num; k++)
+				c.corners.p[c.relatives.p[k]] += c.nFirstVertex;
+			c.triangles.Reserve(c.corners.num);
+			const int* pCorners = c.corners.p;
+			for (int k = 0; k < c.sizes.num && !c.bError; pCorners += c.sizes.p[k++])
+				c.bError = !AddMeshFace(pCorners, c.sizes.p[k], points.p, nPointsNum, &c.triangles, &temp);
+		});
+
+		int nTrianglesNum = 0;
+		for (int i = 0; i < n; i++)
+		{
+			bOK = bOK && !pChunks[i].bError;
+			nTrianglesNum += pChunks[i].triangles.num;
+		}
+		bOK = bOK && triangles.Reserve(nTrianglesNum);
+		for (int i = 0; i < n && bOK; i++)
+		{
+			if (pChunks[i].triangles.num == 0) continue;
+			int* t = triangles.Grow(pChunks[i].triangles.num);
+			bOK = t != NULL;
+			if (t) memcpy(t, pChunks[i].triangles.p, sizeof(int) * pChunks[i].triangles.num);
+		}
+	}
+	delete[] pChunks;
+	delete[] pBounds;
+	if (!bOK)
+		return false;
+
+	if (pRawVerticesNum) *pRawVerticesNum = points.num;
+	FinishMesh(&points, bColors ? &colors : NULL, &triangles, scale, pMesh);
+	return true;
+}
+
+/**
+ * @brief  STL ļƺ ASCII
+ * @param[in] pData : ļ
+ * @param[in] nSize : ļС
+ * @param[in] scale : ű
+ * @param[out] pMesh : 
+ * @param[out] pRawVerticesNum : ȥǰĶΪ NULL
+ * @param[in] nThreads :  ASCII ʽʹõ߳Ϊ 0 ʱʹкģ
+ * @return ʽʱ false
+ * @note ͷ¼ŵ£84 + 50 * n ļСĩβжݣ80 ֽڵͷҲ solid ͷʱ
+ *			ƽ solid ͷ ASCII ʽзֿ鲢н
+ *			ASCII ļ 80 ~ 83 ֽڶǿɼַʱһڶļŵ¡
+ *			STL ÿζĶ㣬ȥغܹöͷ
+*/
+inline bool ReadMeshSTL(const char* pData, size_t nSize, double scale, MeshData* pMesh, int* pRawVerticesNum = NULL, int nThreads = 0)
+{
+	MeshBuffer<Point3D> points;
+	MeshBuffer<int> triangles;
+
+	unsigned int count = 0;
+	if (nSize >= 84)
+		memcpy(&count, pData + 80, 4);
+	if (nSize >= 84 && count <= (unsigned int)(INT_MAX / 3) && 84 + (unsigned long long)count * 50 <= nSize)
+	{
+		Point3D* pPoints = points.Grow((int)count * 3);
+		int* t = triangles.Grow((int)count * 3);
+		if (!pPoints || !t)
+			return false;
+		const char* p = pData + 84;
+		for (int i = 0; i < (int)count * 3; i++)
+		{
+			// ÿ 50 ֽڣߡ㣨 3  float 2 ֽ
+			float v[3];
+			memcpy(v, p + (i / 3) * 50 + 12 + (i % 3) * 12, 12);
+			pPoints[i] = { v[0],v[1],v[2] };
+			t[i] = i;
+		}
+	}
+	else
+	{
+		const char* p = SkipSpace(pData, pData + nSize);
+		const char* end = pData + nSize;
+		if (end - p < 5 || memcmp(p, "solid", 5) != 0)
+			return false;
+
+		int n = GetTextChunksNum(end - p, nThreads);
+		const char** pBounds = new const char*[n + 1];
+		SplitTextLines(p, end, n, pBounds);
+		MeshBuffer<Point3D>* pChunks = new MeshBuffer<Point3D>[n];
+		bool* pErrors = new bool[n];
+		RunParallel(n, nThreads, [&](int i) {
+			const char* e = pBounds[i + 1];
+			pErrors[i] = false;
+			for (const char* q = pBounds[i]; q < e; q = SkipLine(q, e))
+			{
+				q = SkipBlank(q, e);
+				if (e - q < 7 || memcmp(q, "vertex", 6) != 0 || (q[6] != ' ' && q[6] != '\t'))
+					continue;
+				q += 7;
+				double v[3];
+				for (int k = 0; k < 3 && !pErrors[i]; k++)
+				{
+					q = SkipBlank(q, e);
+					pErrors[i] = !ParseReal(q, e, v + k);
+				}
+				pErrors[i] = pErrors[i] || !pChunks[i].Push({ v[0],v[1],v[2] });
+				if (pErrors[i])
+					return;
+			}
+		});
+
+		bool bOK = true;
+		int num = 0;
+		for (int i = 0; i < n; i++)
+		{
+			bOK = bOK && !pErrors[i];
+			num += pChunks[i].num;
+		}
+		bOK = bOK && points.Reserve(num);
+		for (int i = 0; i < n && bOK; i++)
+		{
+			if (pChunks[i].num == 0) continue;
+			Point3D* pPoints = points.Grow(pChunks[i].num);
+			bOK = pPoints != NULL;
+			if (pPoints) memcpy(pPoints, pChunks[i].p, sizeof(Point3D) * pChunks[i].num);
+		}
+		delete[] pChunks;
+		delete[] pErrors;
+		delete[] pBounds;
+		if (!bOK || points.num % 3 != 0)
+			return false;
+		int* t = triangles.Grow(points.num);
+		if (!t && points.num > 0)
+			return false;
+		for (int i = 0; i < points.num; i++)
+			t[i] = i;
+	}
+
+	if (pRawVerticesNum) *pRawVerticesNum = points.num;
+	FinishMesh(&points, NULL, &triangles, scale, pMesh);
+	return true;
+}
+
+/**
+ * @brief  ASCII ʽ VTK ļlegacy ʽ POLYDATA
+ * @param[in] pData : ļ
+ * @param[in] nSize : ļС
+ * @param[in] scale : ű
+ * @param[out] pMesh : 
+ * @param[out] pRawVerticesNum : ȥǰĶΪ NULL
+ * @param[in] nThreads : ʹõ߳Ϊ 0 ʱʹкģ
+ * @return ʽ󣨲 ASCII ʽ±Խ磩ʱ false
+ * @note ȡ POINTS  POLYGONS֧ÿԶͷľɸʽԼ 5.1  OFFSETS  CONNECTIVITY
+ *			ݶαĶλᱻǻ
+ *			ȲҳݶĸͷĹؼУٰ POINTS  POLYGONS εְзֿ鲢н
+*/
+inline bool ReadMeshVTK(const char* pData, size_t nSize, double scale, MeshData* pMesh, int* pRawVerticesNum = NULL, int nThreads = 0)
+{
+	const char* end = pData + nSize;
+	if (nSize < 5 || memcmp(pData, "# vtk", 5) != 0)
+		return false;
+	const char* pBody = SkipLine(SkipLine(pData, end), end);	// 汾ͱ
+
+	// ҳؼ
+	int n = GetTextChunksNum(end - pBody, nThreads);
+	const char** pBounds = new const char*[n + 1];
+	SplitTextLines(pBody, end, n, pBounds);
+	MeshBuffer<const char*>* pChunks = new MeshBuffer<const char*>[n];
+	bool* pErrors = new bool[n];
+	RunParallel(n, nThreads, [&](int i) {
+		const char* e = pBounds[i + 1];
+		pErrors[i] = false;
+		for (const char* q = pBounds[i]; q < e && !pErrors[i]; q = SkipLine(q, e))
+		{
+			q = SkipBlank(q, e);
+			if (q < e && ((*q >= 'A' && *q <= 'Z') || (*q >= 'a' && *q <= 'z')))
+				pErrors[i] = !pChunks[i].Push(q);
+		}
+	});
+	bool bOK = true;
+	for (int i = 0; i < n; i++)
+		bOK = bOK && !pErrors[i];
+	MeshBuffer<const char*> keys;
+	for (int i = 0; i < n && bOK; i++)
+	{
+		if (pChunks[i].num == 0) continue;
+		const char** pKeys = keys.Grow(pChunks[i].num);
+		bOK = pKeys != NULL;
+		if (pKeys) memcpy(pKeys, pChunks[i].p, sizeof(const char*) * pChunks[i].num);
+	}
+	delete[] pChunks;
+	delete[] pErrors;
+	delete[] pBounds;
+	if (!bOK)
+		return false;
+
+	// ؼ֮һؼ֮ǰǸöε
+	auto is = [&](int k, const char* str) {
+		int len = (int)strlen(str);
+		if (k >= keys.num || end - keys.p[k] < len || memcmp(keys.p[k], str, len) != 0)
+			return false;
+		char c = end - keys.p[k] > len ? keys.p[k][len] : ' ';
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	};
+	auto data = [&](int k, const char** pBegin, const char** pEnd) {
+		*pBegin = SkipLine(keys.p[k], end);
+		*pEnd = k + 1 < keys.num ? keys.p[k + 1] : end;
+	};
+	auto count = [&](int k, int index, long long* pValue) {
+		const char* q = keys.p[k];
+		for (int m = 0; m <= index; m++)
+		{
+			while (q < end && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n') q++;
+			q = SkipBlank(q, end);
+		}
+		return ParseInteger(q, end, pValue) && *pValue >= 0 && *pValue <= INT_MAX / 3;
+	};
+	if (!is(0, "ASCII"))
+		return false;
+
+	MeshBuffer<Point3D> points;
+	MeshBuffer<double> values;
+	MeshBuffer<int> indices, offsets, triangles;
+	MeshBuffer<Point3D> temp;
+	bool bPolygons = false;
+	for (int k = 0; k < keys.num; k++)
+	{
+		const char *p, *e;
+		long long num = 0, size = 0;
+		if (is(k, "POINTS") && points.num == 0)
+		{
+			data(k, &p, &e);
+			if (!count(k, 0, &num) || !ParseNumbersParallel(p, e, nThreads, &values) || values.num != num * 3)
+				return false;
+			Point3D* pPoints = points.Grow((int)num);
+			if (!pPoints && num > 0)
+				return false;
+			memcpy(pPoints, values.p, sizeof(double) * values.num);
+			FreeArray(values.Detach());
+		}
+		else if (is(k, "POLYGONS") && !bPolygons)
+		{
+			if (!count(k, 0, &num) || !count(k, 1, &size))
+				return false;
+			bPolygons = true;
+			if (is(k + 1, "OFFSETS") && is(k + 2, "CONNECTIVITY"))
+			{
+				data(k + 1, &p, &e);
+				if (!ParseNumbersParallel(p, e, nThreads, &offsets) || offsets.num != num)
+					return false;
+				data(k + 2, &p, &e);
+				if (!ParseNumbersParallel(p, e, nThreads, &indices) || indices.num != size)
+					return false;
+				k += 2;
+			}
+			else
+			{
+				data(k, &p, &e);
+				if (!ParseNumbersParallel(p, e, nThreads, &indices) || indices.num != size)
+					return false;
+			}
+		}
+	}
+
+	// ֶ
+	triangles.Reserve(indices.num);
+	if (offsets.num > 0)
+	{
+		for (int i = 0; i + 1 < offsets.num; i++)
+		{
+			int first = offsets.p[i], last = offsets.p[i + 1];
+			if (first < 0 || first > last || last > indices.num
+				|| !AddMeshFace(indices.p + first, last - first, points.p, points.num, &triangles, &temp))
+				return false;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < indices.num; )
+		{
+			int num = indices.p[i++];
+			if (num < 0 || num > indices.num - i || !AddMeshFace(indices.p + i, num, points.p, points.num, &triangles, &temp))
+				return false;
+			i += num;
+		}
+	}
+
+	if (pRawVerticesNum) *pRawVerticesNum = points.num;
+	FinishMesh(&points, NULL, &triangles, scale, pMesh);
+	return true;
+}
+
+/**
+ * @brief ȡģļչѡʽ.ply.obj.stl.vtkִСд
+ * @param[in] strFile : ļ·
+ * @param[out] pMesh : ʹú FreeMesh ͷ
+ * @param[in] scale : ű
+ * @param[out] pStats : ͳϢΪ NULL
+ * @param[in] nThreads : ıʽOBJVTKASCII STLʹõ߳Ϊ 0 ʱʹкģ
+ * @return ʧܡʽ֧֡ʽڴ治ʱ false
+ * @note ļͨڴӳȡʱΪÿַڴ棬ùϣȥء
+ *			Ŀ̣꣨߳ļڴ̻Уȥأ STLPLY  ASCII OBJPLY  150 MB/s
+ *			 PLY ÿֽڰ࣬ȥغдεĿռͨ͡
+ *			 PARSE_CHUNK_MIN_SIZE  OBJVTK  ASCII STL ļзֿ飬ɶ߳̽˳ϲ
+ *			߳޹أֵĺʱ٣ȥǵ̵߳ģ
+ *			ASCII PLY Ԫ֮ûпԶλķָǵ߳̽
+ *			ʵʺʱ pStatsʹ -i ʱ
+*/
+inline bool ReadMeshFile(const char* strFile, MeshData* pMesh, double scale = 1, MeshImportStats* pStats = NULL, int nThreads = 0)
+{
+	auto t = std::chrono::steady_clock::now();
+	*pMesh = {};
+
+	char ext[8] = { 0 };
+	const char* dot = strrchr(strFile, '.');
+	if (!dot || strlen(dot) >= sizeof ext)
+		return false;
+	for (int i = 0; dot[i]; i++)
+		ext[i] = (char)tolower((unsigned char)dot[i]);
+
+	bool (*pRead)(const char*, size_t, double, MeshData*, int*, int) = NULL;
+	if (strcmp(ext, ".ply") == 0) pRead = [](const char* p, size_t n, double s, MeshData* m, int* r, int) { return ReadMeshPLY(p, n, s, m, r); };
+	else if (strcmp(ext, ".obj") == 0) pRead = ReadMeshOBJ;
+	else if (strcmp(ext, ".stl") == 0) pRead = ReadMeshSTL;
+	else if (strcmp(ext, ".vtk") == 0) pRead = ReadMeshVTK;
+	else return false;
+
+	MappedFile file;
+	if (!file.Open(strFile))
+		return false;
+
+	auto tParse = std::chrono::steady_clock::now();
+	int nRawVerticesNum = 0;
+	if (!pRead(file.GetData() ? file.GetData() : "", file.GetSize(), scale, pMesh, &nRawVerticesNum, nThreads))
+	{
+		FreeMesh(pMesh);
+		return false;
+	}
+
+	if (pStats)
+	{
+		auto now = std::chrono::steady_clock::now();
+		pStats->nFileBytes = file.GetSize();
+		pStats->nRawVerticesNum = nRawVerticesNum;
+		pStats->fParseTime = std::chrono::duration<double>(now - tParse).count();
+		pStats->fTotalTime = std::chrono::duration<double>(now - t).count();
+	}
+	return true;
+}
+
+//////// ʽ
+
+/**
+ * @brief ʽصĽ׶
+*/
+enum StreamStage
+{
+	stream_idle,		/** @brief ûм */
+	stream_loading,		/** @brief ڶȡļûпʾ */
+	stream_coarse,		/** @brief ģ */
+	stream_partial,		/** @brief ΪȵΪģ */
+	stream_done,		/** @brief  */
+	stream_failed,		/** @brief ȡʧ */
+	stream_stages_num	/** @brief ׶ */
+};
+
+/**
+ * @brief öɴģ
+ * @param[in] pVertices : 
+ * @param[in] pColors : ɫΪ NULL
+ * @param[in] nVerticesNum : 
+ * @param[in] pTriangles : εĶ±
+ * @param[in] nTrianglesNum : 
+ * @param[in] nGrid : Χϵĸ
+ * @param[out] pPoints : ÿǿոһ㣨жƽλã
+ * @param[out] pPointColors : ƽɫpColors Ϊ NULL ʱ
+ * @param[out] pCoarseTriangles : ڲͬеΣظֻһ
+ * @note ӶԹϵȥص򣩣ĴСֻȡ nGrid
+*/
+inline void ClusterVertices(const Point3D* pVertices, const Color* pColors, int nVerticesNum, const int* pTriangles, int nTrianglesNum, int nGrid,
+	MeshBuffer<Point3D>* pPoints, MeshBuffer<Color>* pPointColors, MeshBuffer<int>* pCoarseTriangles)
+{
+	if (nVerticesNum <= 0) return;
+	nGrid = std::min(std::max(nGrid, 1), 256);
+
+	Point3D min = pVertices[0], max = pVertices[0];
+	for (int i = 1; i < nVerticesNum; i++)
+	{
+		min = { std::min(min.x,pVertices[i].x),std::min(min.y,pVertices[i].y),std::min(min.z,pVertices[i].z) };
+		max = { std::max(max.x,pVertices[i].x),std::max(max.y,pVertices[i].y),std::max(max.z,pVertices[i].z) };
+	}
+	double size = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z);
+	double scale = size > 0 ? nGrid / size : 0;
+
+	// ÿӶӦһ࣬ۼλúɫ
+	int* pCells = AllocArray<int>(nGrid * nGrid * nGrid, memory_mesh);
+	int* pCluster = AllocArray<int>(nVerticesNum, memory_mesh);
+	for (int i = 0; i < nGrid * nGrid * nGrid; i++)
+		pCells[i] = -1;
+	MeshBuffer<Point3D> sums, colorSums;
+	MeshBuffer<int> counts;
+	for (int i = 0; i < nVerticesNum; i++)
 	{
-		// 
-		if (p.nPointsNum == 1)
+		int x = std::min((int)((pVertices[i].x - min.x) * scale), nGrid - 1);
+		int y = std::min((int)((pVertices[i].y - min.y) * scale), nGrid - 1);
+		int z = std::min((int)((pVertices[i].z - min.z) * scale), nGrid - 1);
+		int& cell = pCells[(z * nGrid + y) * nGrid + x];
+		if (cell < 0)
 		{
-			DrawPixel(pPoints[0].x, pPoints[0].y, p.color);
+			cell = counts.num;
+			sums.Push({ 0,0,0 });
+			colorSums.Push({ 0,0,0 });
+			counts.Push(0);
 		}
-		else
+		pCluster[i] = cell;
+		Point3D& sum = sums.p[cell];
+		sum = { sum.x + pVertices[i].x,sum.y + pVertices[i].y,sum.z + pVertices[i].z };
+		if (pColors)
 		{
-			// ضɫ
-			if (grid >= 0)
-			{
-				setlinecolor((COLORREF)grid);
-			}
-			else
-			{
-				setlinecolor((COLORREF)p.color);
-			}
-			setfillcolor((COLORREF)p.color);
-			fillpolygon(pPoints, p.nPointsNum);
+			Point3D& c = colorSums.p[cell];
+			c = { c.x + GetRValue(pColors[i]),c.y + GetGValue(pColors[i]),c.z + GetBValue(pColors[i]) };
 		}
+		counts.p[cell]++;
 	}
+	FreeArray(pCells);
 
-	// ɫƶΣҪ
-	else
+	int nFirst = pPoints->num;
+	Point3D* p = pPoints->Grow(counts.num);
+	Color* c = pColors ? pPointColors->Grow(counts.num) : NULL;
+	for (int i = 0; i < counts.num; i++)
+	{
+		double n = counts.p[i];
+		p[i] = { sums.p[i].x / n,sums.p[i].y / n,sums.p[i].z / n };
+		if (c) c[i] = RGB((int)(colorSums.p[i].x / n + 0.5), (int)(colorSums.p[i].y / n + 0.5), (int)(colorSums.p[i].z / n + 0.5));
+	}
+
+	// λɾ±꣬С±תǰֻƷ򣩺 21 λȥ
+	MeshBuffer<unsigned long long> keys;
+	for (int i = 0; i < nTrianglesNum; i++)
 	{
-		if (grid >= 0)
+		int a = pCluster[pTriangles[i * 3]], b = pCluster[pTriangles[i * 3 + 1]], d = pCluster[pTriangles[i * 3 + 2]];
+		if (a == b || b == d || a == d) continue;
+		while (a > b || a > d)
 		{
-			setlinecolor((COLORREF)grid);
-			setfillcolor(WHITE);
-			polygon(pPoints, p.nPointsNum);
+			int t = a; a = b; b = d; d = t;
 		}
+		keys.Push(((unsigned long long)a << 42) | ((unsigned long long)b << 21) | (unsigned long long)d);
+	}
+	FreeArray(pCluster);
+	std::sort(keys.p, keys.p + keys.num);
+	int nKeysNum = (int)(std::unique(keys.p, keys.p + keys.num) - keys.p);
+	int* t = pCoarseTriangles->Grow(nKeysNum * 3);
+	for (int i = 0; i < nKeysNum; i++)
+	{
+		t[i * 3] = nFirst + (int)(keys.p[i] >> 42);
+		t[i * 3 + 1] = nFirst + (int)((keys.p[i] >> 21) & 0x1FFFFF);
+		t[i * 3 + 2] = nFirst + (int)(keys.p[i] & 0x1FFFFF);
 	}
-
-	delete[] pPoints;
 }
 
-//////// ඨ
-
 /**
- * @brief 3D 
+ * @brief ̨ʽģͣڼճȾ
+ * @note ̶̨߳ȡļ ReadMeshFileȷõĴģͣ STREAM_COARSE_GRID
+ *			ٰ Hilbert ߵ˳ȵΣԼ 1/81/41/2 ȫ
+ *			δɴģ͵βϣģʹһʼþϸ
+ *			ÿһں̨߳н壨桢ߺ飬ͬ Object3D::SpatialReorder
+ *			Ⱦ߳ÿ֡ Updateµһʱָֻ루 Object3D::SwapMeshµҲ̨߳ͷţ
+ *			Ⱦ߳мûмصĿ
+ *			̬ƶڽʱڼճתƶ壺
+ *			µһԭĵһԭĵƶ
+ * @attention ֻڵ Update ߳б޸ģڼ䲻Ҫ߳ͬʱȾ
 */
-class Object3D
+class MeshStreamer
 {
 private:
 
-	Polygon3D* pPolygons;			/** @brief Ķ */
-	Polygon3D* pRotatedPolygons;	/** @brief ̬Ķ */
-	int nPolygonsNum;				/** @brief Ķ */
-
-	Point3D pCenter;		/** @brief ĵ */
-	Attitude3D attitude;	/** @brief ̬ */
-	int rotate_order[3];	/** @brief ת˳ */
+	std::thread worker;
+	std::mutex mtx;
+	std::condition_variable cvRetired;		/** @brief µ񽻸̨߳ */
+
+	char* strFile;					/** @brief ļ· */
+	double scale;					/** @brief ű */
+	Color color;					/** @brief ûжɫʱεɫ */
+	int nThreads;					/** @brief ʹõ߳ */
+
+	Object3D* pPending;				/** @brief ѽáȴ Update  */
+	StreamStage pendingStage;		/** @brief pPending Ľ׶ */
+	int nPendingTrianglesNum;		/** @brief pPending ȵ */
+	Object3D* pRetired;				/** @brief Update µɺ̨߳ͷ */
+	Quaternion3D orientation;		/** @brief һ Update ʱ̨̬̰߳Ԥȼ */
+	Point3D pOffset;				/** @brief һ Update ʱԭĵƶ̨̰߳Ԥƶ */
+	Point3D pMeshCenter;			/** @brief 嵱ǰԭĵ㣨ƶ֮ǰ */
+	Point3D pPendingCenter;			/** @brief pPending ԭĵ */
+	Point3D pPendingOffset;			/** @brief pPending Ѿƶľ */
+	bool bClosing;					/** @brief Ƿڹر */
+
+	StreamStage stage;				/** @brief ѻĽ׶ */
+	int nTrianglesNum;				/** @brief ѻȵ */
+	int nTotalTrianglesNum;			/** @brief ģ͵ */
+	MeshImportStats stats;			/** @brief ȡļͳϢ */
+	double pStageTimes[stream_stages_num];	/** @brief  Open ׶ε񽨺õʱ䣨룩δʱΪ -1 */
+	std::chrono::steady_clock::time_point tOpen;
 
 	/**
-	 * @brief	ĵλ
+	 * @brief ͷŻµ
+	 * @param[in] bWait : Ƿȵ£ڹرգ
 	*/
-	void UpdateCenterPoint()
+	void FreeRetired(bool bWait)
 	{
-		Rectangle3D r = GetRectangle(false);
-
-		pCenter = {
-			(r.max_x - r.min_x) / 2 + r.min_x,
-			(r.max_y - r.min_y) / 2 + r.min_y,
-			(r.max_z - r.min_z) / 2 + r.min_z
-		};
+		Object3D* p;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			if (bWait)
+				cvRetired.wait(lock, [&] { return (!pPending && pRetired) || bClosing; });
+			p = pRetired;
+			pRetired = NULL;
+		}
+		FreeArray(p);
 	}
 
 	/**
-	 * @brief ת鳤
-	 * @attention ԭе
+	 * @brief һ񣬵ȴ Update 
+	 * @return ڹرʱ false
 	*/
-	void UpdateRotatedPointsArrayLength()
+	bool Publish(Object3D* pObj, StreamStage s, int nFullNum, Point3D center, Point3D offset)
 	{
-		Polygon3D* newArray = new Polygon3D[nPolygonsNum];
-		DeletePolygons(pRotatedPolygons, nPolygonsNum);
-		pRotatedPolygons = newArray;
+		Object3D* pOld;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pOld = pPending;
+			pPending = pObj;
+			pendingStage = s;
+			nPendingTrianglesNum = nFullNum;
+			pPendingCenter = center;
+			pPendingOffset = offset;
+			pStageTimes[s] = std::chrono::duration<double>(std::chrono::steady_clock::now() - tOpen).count();
+			if (bClosing) return false;
+		}
+		FreeArray(pOld);	// ûбµһ
+		FreeRetired(false);
+		return true;
 	}
 
 	/**
-	 * @brief Ԫ
-	 * @attention Ԫʱô˺
+	 * @brief ̨̣߳ȡļɴģͲ
 	*/
-	void UpdateArray()
+	void run()
 	{
-		UpdateCenterPoint();
-		UpdateRotatedPointsArrayLength();
-		UpdateRotatedPoints();
+		MeshData mesh;
+		MeshImportStats st = {};
+		if (!ReadMeshFile(strFile, &mesh, scale, &st, nThreads) || mesh.nTrianglesNum <= 0)
+		{
+			FreeMesh(&mesh);
+			std::lock_guard<std::mutex> lock(mtx);
+			stats = st;
+			pendingStage = stream_failed;
+			pStageTimes[stream_failed] = std::chrono::duration<double>(std::chrono::steady_clock::now() - tOpen).count();
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stats = st;
+			nTotalTrianglesNum = mesh.nTrianglesNum;
+		}
+
+		// Ķϴģ͵Ķ
+		int nFullNum = mesh.nTrianglesNum;
+		MeshBuffer<Point3D> points;
+		MeshBuffer<Color> colors;
+		MeshBuffer<int> coarse;
+		memcpy(points.Grow(mesh.nVerticesNum), mesh.pVertices, sizeof(Point3D) * mesh.nVerticesNum);
+		if (mesh.pColors)
+			memcpy(colors.Grow(mesh.nVerticesNum), mesh.pColors, sizeof(Color) * mesh.nVerticesNum);
+		ClusterVertices(mesh.pVertices, mesh.pColors, mesh.nVerticesNum, mesh.pTriangles, nFullNum, STREAM_COARSE_GRID, &points, &colors, &coarse);
+		int nCoarseNum = coarse.num / 3;
+
+		// ʹԵһĵͬһ˳
+		int num = nFullNum + nCoarseNum;
+		Point3D* pCenters = AllocArray<Point3D>(num, memory_mesh);
+		int* pOrder = AllocArray<int>(num, memory_mesh);
+		for (int i = 0; i < num; i++)
+		{
+			const int* t = i < nFullNum ? mesh.pTriangles + i * 3 : coarse.p + (i - nFullNum) * 3;
+			const Point3D& a = points.p[t[0]];
+			const Point3D& b = points.p[t[1]];
+			const Point3D& c = points.p[t[2]];
+			pCenters[i] = { (a.x + b.x + c.x) / 3,(a.y + b.y + c.y) / 3,(a.z + b.z + c.z) / 3 };
+		}
+		SortBySpaceCurve(pCenters, num, pOrder, curve_hilbert);
+		FreeArray(pCenters);
+
+		// ˳λ cut ֮ǰΣ֮ôԵ
+		int* pTriangles = AllocArray<int>(num * 3, memory_mesh);
+		MeshChunk* pChunks = AllocArray<MeshChunk>(num / MESH_CHUNK_SIZE + 1, memory_mesh);
+		const int pCuts[] = { 0,num / 8,num / 4,num / 2,num };
+		for (int cut : pCuts)
+		{
+			int count = 0, nFull = 0;
+			for (int k = 0; k < num; k++)
+			{
+				int i = pOrder[k];
+				if ((i < nFullNum) != (k < cut)) continue;
+				const int* t = i < nFullNum ? mesh.pTriangles + i * 3 : coarse.p + (i - nFullNum) * 3;
+				memcpy(pTriangles + count * 3, t, sizeof(int) * 3);
+				count++;
+				if (i < nFullNum) nFull++;
+			}
+
+			// Ѿռ˳Уֱӷֿ
+			int nChunksNum = (count + MESH_CHUNK_SIZE - 1) / MESH_CHUNK_SIZE;
+			for (int c = 0; c < nChunksNum; c++)
+			{
+				pChunks[c] = {};
+				pChunks[c].nFirstPolygon = c * MESH_CHUNK_SIZE;
+				pChunks[c].nPolygonsNum = std::min(MESH_CHUNK_SIZE, count - c * MESH_CHUNK_SIZE);
+			}
+
+			// 嵱ǰ̬ƶ꣨SetChunks м㣩ʱûб仯ͲҪ¼
+			Quaternion3D q;
+			Point3D offset;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				q = orientation;
+				offset = pOffset;
+			}
+			Object3D* pObj = AllocArray<Object3D>(1, memory_scene);
+			pObj->SetMesh(points.p, mesh.pColors ? colors.p : NULL, points.num, pTriangles, count, color);
+			pObj->SetOrientation(q);
+			pObj->SetChunks(pChunks, nChunksNum);
+			Point3D center = pObj->GetPosition();
+			if (offset.x != 0 || offset.y != 0 || offset.z != 0)
+				pObj->MoveTo({ center.x + offset.x,center.y + offset.y,center.z + offset.z });
+			if (!Publish(pObj, cut == 0 ? stream_coarse : (cut < num ? stream_partial : stream_done), nFull, center, offset))
+				break;
+		}
+		FreeArray(pTriangles);
+		FreeArray(pChunks);
+		FreeArray(pOrder);
+		FreeMesh(&mesh);
+
+		// һͷŻµ
+		FreeRetired(true);
 	}
 
 public:
 
-	Object3D()
+	MeshStreamer()
 	{
-		pPolygons = NULL;
-		pRotatedPolygons = NULL;
-		nPolygonsNum = 0;
-		attitude = { 0,0,0 };
-		pCenter = { 0,0,0 };
-		rotate_order[0] = rotate_z;
-		rotate_order[1] = rotate_y;
-		rotate_order[2] = rotate_x;
+		strFile = NULL;
+		scale = 1;
+		color = WHITE;
+		nThreads = 0;
+		pPending = NULL;
+		pendingStage = stream_idle;
+		nPendingTrianglesNum = 0;
+		pRetired = NULL;
+		orientation = { 1,0,0,0 };
+		pOffset = pMeshCenter = pPendingCenter = pPendingOffset = { 0,0,0 };	// ĵԭ
+		bClosing = false;
+		stage = stream_idle;
+		nTrianglesNum = 0;
+		nTotalTrianglesNum = 0;
+		stats = {};
+		for (int i = 0; i < stream_stages_num; i++)
+			pStageTimes[i] = -1;
 	}
 
-	~Object3D()
+	MeshStreamer(const MeshStreamer&) = delete;
+	MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+	~MeshStreamer()
 	{
-		Polygon3D* p = NULL;
-		for (int i = 0; i < 2; i++)
-		{
-			if (i == 0) p = pPolygons;
-			else p = pRotatedPolygons;
-			DeletePolygons(p, nPolygonsNum);
-		}
+		Close();
 	}
 
 	/**
-	 * @brief ת˳
+	 * @brief ʼں̨ģļ
+	 * @param[in] strPath : ļ·ʽ ReadMeshFile
+	 * @param[in] zoom : ű
+	 * @param[in] c : ûжɫʱεɫ
+	 * @param[in] threads : ʹõ߳Ϊ 0 ʱʹкģ
+	 * @note ء֮ǰļȱر
 	*/
-	void SetRotateOrder(int pOrder[3])
+	void Open(const char* strPath, double zoom = 1, Color c = WHITE, int threads = 0)
 	{
-		for (int i = 0; i < 3; i++)
-			rotate_order[i] = pOrder[i];
+		Close();
+		size_t len = strlen(strPath);
+		strFile = AllocArray<char>(len + 1, memory_mesh);
+		memcpy(strFile, strPath, len + 1);
+		scale = zoom;
+		color = c;
+		nThreads = threads;
+
+		pendingStage = stage = stream_loading;
+		nPendingTrianglesNum = nTrianglesNum = nTotalTrianglesNum = 0;
+		stats = {};
+		for (int i = 0; i < stream_stages_num; i++)
+			pStageTimes[i] = -1;
+		bClosing = false;
+		tOpen = std::chrono::steady_clock::now();
+		pStageTimes[stream_loading] = 0;
+		worker = std::thread(&MeshStreamer::run, this);
 	}
 
 	/**
-	 * @brief ȡת˳
+	 * @brief ·һ
+	 * @param[in, out] pObject : ʾģ͵壬ÿζӦͬһ
+	 * @return б仯ʱ true
+	 * @note Ⱦ߳ÿ֡ãûµһʱֻǼ̬ƶԭ񱻻²̨߳ͷ
 	*/
-	int* GetRotateOrder()
+	bool Update(Object3D* pObject)
 	{
-		return rotate_order;
+		Point3D pos = pObject->GetPosition();
+		Point3D offset = { pos.x - pMeshCenter.x,pos.y - pMeshCenter.y,pos.z - pMeshCenter.z };
+		Object3D* p;
+		Point3D center, moved;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			orientation = pObject->GetOrientation();
+			pOffset = offset;
+			if (pendingStage == stream_failed)
+				stage = stream_failed;
+			p = pPending;
+			pPending = NULL;
+			if (!p) return false;
+			stage = pendingStage;
+			nTrianglesNum = nPendingTrianglesNum;
+			center = pPendingCenter;
+			moved = pPendingOffset;
+		}
+
+		// SwapMesh ̬ƶҪµӦ
+		pObject->SwapMesh(*p);
+		pMeshCenter = center;
+		if (moved.x != offset.x || moved.y != offset.y || moved.z != offset.z)
+			pObject->MoveTo({ center.x + offset.x,center.y + offset.y,center.z + offset.z });
+
+		Object3D* pOld;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pOld = pRetired;
+			pRetired = p;
+		}
+		cvRetired.notify_one();
+		FreeArray(pOld);	// ̨̻߳ûüͷһλµ
+		return true;
 	}
 
 	/**
-	 * @brief ȡе
+	 * @brief ȡѻĽ׶
 	*/
-	int GetPointsNum()
+	StreamStage GetStage()
 	{
-		int num = 0;
-		for (int i = 0; i < nPolygonsNum; i++)
-		{
-			num += pPolygons[i].nPointsNum;
-		}
-		return num;
+		std::lock_guard<std::mutex> lock(mtx);
+		return stage;
 	}
 
 	/**
-	 * @brief ȡжε
+	 * @brief жǷڼأûлҲûʧܣ
 	*/
-	int GetPolygonsNum()
+	bool IsLoading()
 	{
-		return nPolygonsNum;
+		StreamStage s = GetStage();
+		return s != stream_idle && s != stream_done && s != stream_failed;
 	}
 
 	/**
-	 * @brief ȡе
-	 * @param[in] rotated : Ƿȡתĵ
-	 * @attention  GetPointsNum ȡ
+	 * @brief ȡѻȵ
 	*/
-	ColorPoint3D* GetPoints(bool rotated = true)
+	int GetTrianglesNum()
 	{
-		Polygon3D* polygons = pPolygons;
-		if (rotated) polygons = pRotatedPolygons;
-		ColorPoint3D* p = new ColorPoint3D[GetPointsNum()];
-		for (int i = 0, index = 0; i < nPolygonsNum; i++)
-		{
-			for (int j = 0; j < polygons[i].nPointsNum; j++)
-			{
-				p[index] = ToColorPoint3D(polygons[i].pPoints[j]);
-				p[index].color = polygons[i].color;
-				index++;
-			}
-		}
-		return p;
+		std::lock_guard<std::mutex> lock(mtx);
+		return nTrianglesNum;
 	}
 
 	/**
-	 * @brief ȡеж
-	 * @param[in] rotated : ǷȡתĶ
-	 * @attention  GetPolygonsNum ȡε
+	 * @brief ȡģ͵ȡļǰΪ 0
 	*/
-	Polygon3D* GetPolygons(bool rotated = true)
+	int GetTotalTrianglesNum()
 	{
-		if (rotated)
-		{
-			return pRotatedPolygons;
-		}
-		else
-		{
-			return pPolygons;
-		}
+		std::lock_guard<std::mutex> lock(mtx);
+		return nTotalTrianglesNum;
 	}
 
 	/**
-	 * @brief ȡĵ
+	 * @brief ȡȡļͳϢȡļǰΪ 0
 	*/
-	Point3D GetCenterPoint()
+	MeshImportStats GetStats()
 	{
-		return pCenter;
+		std::lock_guard<std::mutex> lock(mtx);
+		return stats;
 	}
 
 	/**
-	 * @brief ȡλãЧ GetCenterPoint ͬ
+	 * @brief ȡ Open ĳ׶ε񽨺õʱ䣨룩ûеʱ -1
+	 * @note stream_partial ¼һ
 	*/
-	Point3D GetPosition()
+	double GetStageTime(StreamStage s)
 	{
-		return GetCenterPoint();
+		std::lock_guard<std::mutex> lock(mtx);
+		return s >= 0 && s < stream_stages_num ? pStageTimes[s] : -1;
 	}
 
 	/**
-	 * @brief ƶ嵽ĳλã
+	 * @brief رռ
+	 * @note ڶȡļʱȴȡɡѾ
 	*/
-	void MoveTo(Point3D pNew)
+	void Close()
 	{
-		double offset_x = pNew.x - pCenter.x;
-		double offset_y = pNew.y - pCenter.y;
-		double offset_z = pNew.z - pCenter.z;
-		for (int i = 0; i < nPolygonsNum; i++)
+		if (worker.joinable())
 		{
-			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
 			{
-				pPolygons[i].pPoints[j].x += offset_x;
-				pPolygons[i].pPoints[j].y += offset_y;
-				pPolygons[i].pPoints[j].z += offset_z;
+				std::lock_guard<std::mutex> lock(mtx);
+				bClosing = true;
+			}
+			cvRetired.notify_all();
+			worker.join();
+		}
+		FreeArray(pPending);
+		FreeArray(pRetired);
+		FreeArray(strFile);
+		pPending = pRetired = NULL;
+		strFile = NULL;
+		if (stage == stream_loading || stage == stream_coarse || stage == stream_partial)
+			stage = stream_idle;
+	}
+};
 
-				pRotatedPolygons[i].pPoints[j].x += offset_x;
-				pRotatedPolygons[i].pPoints[j].y += offset_y;
-				pRotatedPolygons[i].pPoints[j].z += offset_z;
+//////// 
+
+/**
+ * @brief յļͷ
+ * @note ֱдڴеĽṹ飬ֽͽṹ岼뻷йأֻΪͬһĻʹãΪʽ
+ *			ļе鶼 16 ֽڶ룬ƫļͷ
+ * @see SaveScenceSnapshot, LoadScenceSnapshot
+*/
+struct SnapshotHeader
+{
+	char strMagic[8];					/** @brief ļʶ "HD3DSNAP" */
+	int nVersion;						/** @brief ʽ汾 SCENE_SNAPSHOT_VERSION */
+	int nObjectsNum;					/** @brief  */
+	int nMeshesNum;						/** @brief ֻͬһݣ */
+	int nLightsNum;						/** @brief Դ */
+	int nTexturesNum;					/** @brief õĳ */
+	unsigned long long nFileSize;		/** @brief ļСֽڣڼļǷ */
+	unsigned long long nObjectsOffset;	/** @brief SnapshotObjectλ */
+	unsigned long long nMeshesOffset;	/** @brief SnapshotMeshλ */
+	unsigned long long nLightsOffset;	/** @brief ԴLight3Dλ */
+	Camera3D camera;					/** @brief  */
+	int mode;							/** @brief Ⱦģʽ */
+	int shade;							/** @brief ɫģʽ */
+	Color ambient;						/** @brief ɫ */
+	int shininess;						/** @brief ߹ָ */
+	double specular;					/** @brief ߹ǿ */
+	int bOcclusionCulling;				/** @brief Ƿڵ޳ */
+};
+
+/**
+ * @brief е
+*/
+struct SnapshotObject
+{
+	int nMesh;					/** @brief е± */
+	int rotate_order[3];		/** @brief ת˳ */
+	Quaternion3D orientation;	/** @brief ̬ */
+	int bOccluder;				/** @brief ǷΪڵ */
+};
+
+/**
+ * @brief еĶ
+ * @note 㡢ɫ갴˳
+*/
+struct SnapshotPolygon
+{
+	int nPointsNum;		/** @brief  */
+	Color color;		/** @brief ɫ */
+	int nTexture;		/** @brief е±꣬-1 ʾû */
+	int bTexCoords;		/** @brief Ƿ */
+};
+
+/**
+ * @brief еĶκ
+*/
+struct SnapshotMesh
+{
+	int nPolygonsNum;					/** @brief  */
+	int nPointsNum;						/** @brief жεĶ֮ */
+	int nTexCoordsNum;					/** @brief ֻдĶα棩 */
+	int nVerticesNum;					/** @brief ȥغĶ */
+	int nEdgesNum;						/** @brief ߵ */
+	int nChunksNum;						/** @brief  */
+	unsigned long long nPolygonsOffset;	/** @brief ΣSnapshotPolygonλ */
+	unsigned long long nPointsOffset;	/** @brief ζ㣨Point3Dλ */
+	unsigned long long nColorsOffset;	/** @brief ɫColorλ */
+	unsigned long long nTexCoordsOffset;/** @brief ꣨TexCoordλ */
+	unsigned long long nVerticesOffset;	/** @brief ȥغĶ㣨Point3Dλ */
+	unsigned long long nNormalsOffset;	/** @brief 㷨ߣPoint3Dλ */
+	unsigned long long nIndicesOffset;	/** @brief intλ */
+	unsigned long long nEdgesOffset;	/** @brief ߣÿ intλ */
+	unsigned long long nChunksOffset;	/** @brief 飨MeshChunkֻʹ nFirstPolygon  nPolygonsNumλ */
+};
+
+/**
+ * @brief ԭʼΣɢֵFNV-1aڿжǷͬ
+*/
+inline unsigned long long HashObjectMesh(Object3D& obj)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	auto add = [&](const void* p, size_t size) {
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ ((const unsigned char*)p)[i]) * 1099511628211ull;
+	};
+	int num = obj.GetPolygonsNum();
+	Polygon3D* pPolygons = obj.GetPolygons(false);
+	add(&num, sizeof num);
+	for (int i = 0; i < num; i++)
+	{
+		add(&pPolygons[i].nPointsNum, sizeof(int));
+		add(&pPolygons[i].color, sizeof(Color));
+		add(pPolygons[i].pPoints, sizeof(Point3D) * pPolygons[i].nPointsNum);
+	}
+	return hash;
+}
+
+/**
+ * @brief ж񣨶Ρ飩Ƿȫͬ
+*/
+inline bool IsSameMesh(Object3D& a, Object3D& b)
+{
+	int num = a.GetPolygonsNum();
+	if (num != b.GetPolygonsNum() || a.GetVerticesNum() != b.GetVerticesNum()
+		|| a.GetEdgesNum() != b.GetEdgesNum() || a.GetChunksNum() != b.GetChunksNum())
+		return false;
+
+	Polygon3D* pa = a.GetPolygons(false);
+	Polygon3D* pb = b.GetPolygons(false);
+	int nPointsNum = 0;
+	for (int i = 0; i < num; i++)
+	{
+		int n = pa[i].nPointsNum;
+		if (n != pb[i].nPointsNum || pa[i].color != pb[i].color || pa[i].pTexture != pb[i].pTexture
+			|| !pa[i].pTexCoords != !pb[i].pTexCoords
+			|| memcmp(pa[i].pPoints, pb[i].pPoints, sizeof(Point3D) * n) != 0
+			|| memcmp(pa[i].pColors, pb[i].pColors, sizeof(Color) * n) != 0
+			|| (pa[i].pTexCoords && memcmp(pa[i].pTexCoords, pb[i].pTexCoords, sizeof(TexCoord) * n) != 0))
+			return false;
+		nPointsNum += n;
+	}
+
+	int nVerticesNum = a.GetVerticesNum();
+	if (nPointsNum > 0 && (memcmp(a.GetVertices(false), b.GetVertices(false), sizeof(Point3D) * nVerticesNum) != 0
+		|| memcmp(a.GetNormals(false), b.GetNormals(false), sizeof(Point3D) * nVerticesNum) != 0
+		|| memcmp(a.GetIndices(), b.GetIndices(), sizeof(int) * nPointsNum) != 0
+		|| memcmp(a.GetEdges(), b.GetEdges(), sizeof(int) * 2 * a.GetEdgesNum()) != 0))
+		return false;
+	for (int c = 0; c < a.GetChunksNum(); c++)
+		if (a.GetChunks()[c].nFirstPolygon != b.GetChunks()[c].nFirstPolygon || a.GetChunks()[c].nPolygonsNum != b.GetChunks()[c].nPolygonsNum)
+			return false;
+	return true;
+}
+
+/**
+ * @brief ѳΪļ
+ * @param[in] pScence : 
+ * @param[in] strFile : ļ·
+ * @param[in] ppTextures : õڱе±걣棬ûʱΪ NULL
+ * @param[in] nTexturesNum : ĳ
+ * @return дʧܻ˲еʱ falseɾдһļ
+ * @note ԭʼΡ̬ת˳ڵá飬ԼԴȾá
+ *			ȫͬʱֻһݡ棬ȡʱͬ
+ * @see LoadScenceSnapshot
+*/
+inline bool SaveScenceSnapshot(Scence3D* pScence, const char* strFile, Texture* const* ppTextures = NULL, int nTexturesNum = 0)
+{
+	int nObjectsNum = pScence->GetObjectsNum();
+	Object3D* pObjects = pScence->GetObjects();
+
+	// ֻͬһݣɢֵͬʱȽ
+	SnapshotObject* pObjectRecords = AllocArray<SnapshotObject>(nObjectsNum + 1, memory_scene);
+	int* pMeshSources = AllocArray<int>(nObjectsNum + 1, memory_scene);
+	unsigned long long* pHashes = AllocArray<unsigned long long>(nObjectsNum + 1, memory_scene);
+	int nMeshesNum = 0;
+	for (int i = 0; i < nObjectsNum; i++)
+	{
+		unsigned long long hash = HashObjectMesh(pObjects[i]);
+		int nMesh = 0;
+		while (nMesh < nMeshesNum && (pHashes[nMesh] != hash || !IsSameMesh(pObjects[pMeshSources[nMesh]], pObjects[i])))
+			nMesh++;
+		if (nMesh == nMeshesNum)
+		{
+			pHashes[nMeshesNum] = hash;
+			pMeshSources[nMeshesNum++] = i;
+		}
+
+		SnapshotObject& rec = pObjectRecords[i];
+		rec = {};
+		rec.nMesh = nMesh;
+		for (int k = 0; k < 3; k++)
+			rec.rotate_order[k] = pObjects[i].GetRotateOrder()[k];
+		rec.orientation = pObjects[i].GetOrientation();
+		rec.bOccluder = pObjects[i].IsOccluder();
+	}
+	FreeArray(pHashes);
+
+	FILE* fp = NULL;
+	if (fopen_s(&fp, strFile, "wb") != 0 || !fp)
+	{
+		FreeArray(pObjectRecords);
+		FreeArray(pMeshSources);
+		return false;
+	}
+
+	//  16 ֽڶд룬дλ
+	bool bSucceed = true;
+	unsigned long long nOffset = 0;
+	auto write = [&](const void* p, size_t size) {
+		static const char zeros[16] = {};
+		size_t pad = (size_t)((16 - nOffset % 16) % 16);
+		if (pad > 0 && fwrite(zeros, 1, pad, fp) != pad)
+			bSucceed = false;
+		nOffset += pad;
+		unsigned long long start = nOffset;
+		if (size > 0 && fwrite(p, 1, size, fp) != size)
+			bSucceed = false;
+		nOffset += size;
+		return start;
+	};
+
+	SnapshotHeader header = {};
+	memcpy(header.strMagic, "HD3DSNAP", 8);
+	header.nVersion = SCENE_SNAPSHOT_VERSION;
+	header.nObjectsNum = nObjectsNum;
+	header.nMeshesNum = nMeshesNum;
+	header.nLightsNum = pScence->GetLightsNum();
+	header.nTexturesNum = nTexturesNum;
+	header.camera = pScence->GetCamera();
+	header.mode = pScence->GetRenderMode();
+	header.shade = pScence->GetShadeMode();
+	header.ambient = pScence->GetAmbientLight();
+	header.specular = pScence->GetSpecular(&header.shininess);
+	header.bOcclusionCulling = pScence->GetOcclusionCullingState();
+
+	// д
+	SnapshotMesh* pMeshes = AllocArray<SnapshotMesh>(nMeshesNum + 1, memory_scene);
+	memset(pMeshes, 0, sizeof(SnapshotMesh) * nMeshesNum);
+	write(&header, sizeof header);
+	header.nObjectsOffset = write(pObjectRecords, sizeof(SnapshotObject) * nObjectsNum);
+	header.nLightsOffset = write(pScence->GetLights(), sizeof(Light3D) * header.nLightsNum);
+	header.nMeshesOffset = write(pMeshes, sizeof(SnapshotMesh) * nMeshesNum);
+
+	for (int m = 0; m < nMeshesNum && bSucceed; m++)
+	{
+		Object3D& obj = pObjects[pMeshSources[m]];
+		Polygon3D* pPolygons = obj.GetPolygons(false);
+		int num = obj.GetPolygonsNum();
+		int nPointsNum = obj.GetPointsNum();
+
+		SnapshotPolygon* pRecords = AllocArray<SnapshotPolygon>(num + 1, memory_scene);
+		Point3D* pPoints = AllocArray<Point3D>(nPointsNum + 1, memory_scene);
+		Color* pColors = AllocArray<Color>(nPointsNum + 1, memory_scene);
+		TexCoord* pTexCoords = AllocArray<TexCoord>(nPointsNum + 1, memory_scene);
+		int nTexCoordsNum = 0;
+		for (int i = 0, index = 0; i < num; i++)
+		{
+			Polygon3D& p = pPolygons[i];
+			pRecords[i] = { p.nPointsNum,p.color,-1,p.pTexCoords != NULL };
+			if (p.pTexture)
+			{
+				while (++pRecords[i].nTexture < nTexturesNum && ppTextures[pRecords[i].nTexture] != p.pTexture);
+				if (pRecords[i].nTexture == nTexturesNum)
+					bSucceed = false;
+			}
+			for (int j = 0; j < p.nPointsNum; j++, index++)
+			{
+				pPoints[index] = p.pPoints[j];
+				pColors[index] = p.pColors[j];
+				if (p.pTexCoords)
+					pTexCoords[nTexCoordsNum++] = p.pTexCoords[j];
+			}
+		}
+
+		SnapshotMesh& rec = pMeshes[m];
+		rec = {};
+		rec.nPolygonsNum = num;
+		rec.nPointsNum = nPointsNum;
+		rec.nTexCoordsNum = nTexCoordsNum;
+		rec.nVerticesNum = nPointsNum > 0 ? obj.GetVerticesNum() : 0;
+		rec.nEdgesNum = nPointsNum > 0 ? obj.GetEdgesNum() : 0;
+		rec.nChunksNum = obj.GetChunks() ? obj.GetChunksNum() : 0;
+		rec.nPolygonsOffset = write(pRecords, sizeof(SnapshotPolygon) * num);
+		rec.nPointsOffset = write(pPoints, sizeof(Point3D) * nPointsNum);
+		rec.nColorsOffset = write(pColors, sizeof(Color) * nPointsNum);
+		rec.nTexCoordsOffset = write(pTexCoords, sizeof(TexCoord) * nTexCoordsNum);
+		rec.nVerticesOffset = write(obj.GetVertices(false), sizeof(Point3D) * rec.nVerticesNum);
+		rec.nNormalsOffset = write(obj.GetNormals(false), sizeof(Point3D) * rec.nVerticesNum);
+		rec.nIndicesOffset = write(obj.GetIndices(), sizeof(int) * (rec.nVerticesNum > 0 ? nPointsNum : 0));
+		rec.nEdgesOffset = write(obj.GetEdges(), sizeof(int) * 2 * rec.nEdgesNum);
+		rec.nChunksOffset = write(obj.GetChunks(), sizeof(MeshChunk) * rec.nChunksNum);
+
+		FreeArray(pRecords);
+		FreeArray(pPoints);
+		FreeArray(pColors);
+		FreeArray(pTexCoords);
+	}
+	header.nFileSize = nOffset;
+
+	// ļͷ
+	if (bSucceed)
+	{
+		bSucceed = fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, fp) == 1
+			&& (nMeshesNum == 0 || (_fseeki64(fp, (long long)header.nMeshesOffset, SEEK_SET) == 0
+				&& fwrite(pMeshes, sizeof(SnapshotMesh) * nMeshesNum, 1, fp) == 1));
+	}
+	if (fclose(fp) != 0)
+		bSucceed = false;
+	if (!bSucceed)
+		remove(strFile);
+
+	FreeArray(pObjectRecords);
+	FreeArray(pMeshSources);
+	FreeArray(pMeshes);
+	return bSucceed;
+}
+
+/**
+ * @brief ӿļָ
+ * @param[out] pScence : ԭе͹Դ滻
+ * @param[in] strFile : ļ· SaveScenceSnapshot
+ * @param[in] ppTextures : 뱣ʱʹõӦûʱΪ NULL
+ * @param[in] nTexturesNum : ĳȣڱʱĳ
+ * @return ļڡ汾Чʱ false
+ * @note ļӳ䵽ڴУƫ鷶ΧֱΪʹã桢㷨ߺԭƵУ Object3D::AttachMesh
+ *			ٺϲ㡢ߺͷߣҲҪ¿ռšȻΪÿζӵԼĶ
+*/
+inline bool LoadScenceSnapshot(Scence3D* pScence, const char* strFile, Texture* const* ppTextures = NULL, int nTexturesNum = 0)
+{
+	MappedFile file;
+	if (!file.Open(strFile) || file.GetSize() < sizeof(SnapshotHeader))
+		return false;
+	const char* pData = file.GetData();
+	size_t nSize = file.GetSize();
+
+	SnapshotHeader header;
+	memcpy(&header, pData, sizeof header);
+	if (memcmp(header.strMagic, "HD3DSNAP", 8) != 0 || header.nVersion != SCENE_SNAPSHOT_VERSION || header.nFileSize != nSize
+		|| header.nObjectsNum < 0 || header.nMeshesNum < 0 || header.nLightsNum < 0
+		|| header.nTexturesNum > nTexturesNum || (header.nTexturesNum > 0 && !ppTextures))
+		return false;
+
+	// ƫתΪָ룬Խûжʱ NULL
+	auto at = [&](unsigned long long offset, int num, size_t size) -> const char* {
+		if (num < 0 || offset % 16 != 0 || offset > nSize || (unsigned long long)num * size > nSize - offset)
+			return NULL;
+		return pData + offset;
+	};
+
+	const SnapshotObject* pObjectRecords = (const SnapshotObject*)at(header.nObjectsOffset, header.nObjectsNum, sizeof(SnapshotObject));
+	const SnapshotMesh* pMeshes = (const SnapshotMesh*)at(header.nMeshesOffset, header.nMeshesNum, sizeof(SnapshotMesh));
+	const Light3D* pLights = (const Light3D*)at(header.nLightsOffset, header.nLightsNum, sizeof(Light3D));
+	if (!pObjectRecords || !pMeshes || !pLights)
+		return false;
+
+	// Ƚ壬ȫɹٻ볡
+	Object3D* pObjects = AllocArray<Object3D>(header.nObjectsNum + 1, memory_scene);
+	bool bSucceed = true;
+	for (int i = 0; i < header.nObjectsNum && bSucceed; i++)
+	{
+		const SnapshotObject& rec = pObjectRecords[i];
+		if (rec.nMesh < 0 || rec.nMesh >= header.nMeshesNum)
+		{
+			bSucceed = false;
+			break;
+		}
+		const SnapshotMesh& mesh = pMeshes[rec.nMesh];
+		const SnapshotPolygon* pRecords = (const SnapshotPolygon*)at(mesh.nPolygonsOffset, mesh.nPolygonsNum, sizeof(SnapshotPolygon));
+		const Point3D* pPoints = (const Point3D*)at(mesh.nPointsOffset, mesh.nPointsNum, sizeof(Point3D));
+		const Color* pColors = (const Color*)at(mesh.nColorsOffset, mesh.nPointsNum, sizeof(Color));
+		const TexCoord* pTexCoords = (const TexCoord*)at(mesh.nTexCoordsOffset, mesh.nTexCoordsNum, sizeof(TexCoord));
+		const Point3D* pVertices = (const Point3D*)at(mesh.nVerticesOffset, mesh.nVerticesNum, sizeof(Point3D));
+		const Point3D* pNormals = (const Point3D*)at(mesh.nNormalsOffset, mesh.nVerticesNum, sizeof(Point3D));
+		const int* pIndices = (const int*)at(mesh.nIndicesOffset, mesh.nVerticesNum > 0 ? mesh.nPointsNum : 0, sizeof(int));
+		const int* pEdges = (const int*)at(mesh.nEdgesOffset, mesh.nEdgesNum, sizeof(int) * 2);
+		const MeshChunk* pChunks = (const MeshChunk*)at(mesh.nChunksOffset, mesh.nChunksNum, sizeof(MeshChunk));
+		if (!pRecords || !pPoints || !pColors || !pTexCoords || !pVertices || !pNormals || !pIndices || !pEdges || !pChunks)
+		{
+			bSucceed = false;
+			break;
+		}
+
+		Polygon3D* pPolygons = new Polygon3D[mesh.nPolygonsNum];
+		for (int k = 0, index = 0, nTexCoord = 0; k < mesh.nPolygonsNum; k++)
+		{
+			const SnapshotPolygon& p = pRecords[k];
+			if (p.nPointsNum < 0 || p.nPointsNum > POLYGON_MAX_SIDES || p.nPointsNum > mesh.nPointsNum - index
+				|| p.nTexture < -1 || p.nTexture >= header.nTexturesNum || (p.bTexCoords && p.nPointsNum > mesh.nTexCoordsNum - nTexCoord))
+			{
+				bSucceed = false;
+				break;
+			}
+			Polygon3D& dst = pPolygons[k];
+			dst.nPointsNum = p.nPointsNum;
+			dst.color = p.color;
+			memcpy(dst.pPoints, pPoints + index, sizeof(Point3D) * p.nPointsNum);
+			memcpy(dst.pColors, pColors + index, sizeof(Color) * p.nPointsNum);
+			if (p.nTexture >= 0)
+				dst.pTexture = ppTextures[p.nTexture];
+			if (p.bTexCoords)
+			{
+				dst.pTexCoords = AllocArray<TexCoord>(POLYGON_MAX_SIDES, memory_polygon);
+				memcpy(dst.pTexCoords, pTexCoords + nTexCoord, sizeof(TexCoord) * p.nPointsNum);
+				nTexCoord += p.nPointsNum;
 			}
+			index += p.nPointsNum;
 		}
 
-		pCenter = pNew;
-	}
+		// ̬AttachMesh ֱӰ̬
+		int pOrder[3] = { rec.rotate_order[0],rec.rotate_order[1],rec.rotate_order[2] };
+		pObjects[i].SetRotateOrder(pOrder);
+		pObjects[i].SetOrientation(rec.orientation);
+		pObjects[i].SetOccluder(rec.bOccluder != 0);
+		if (!bSucceed || !pObjects[i].AttachMesh(pPolygons, mesh.nPolygonsNum, pVertices, pNormals, mesh.nVerticesNum,
+			pIndices, pEdges, mesh.nEdgesNum, mesh.nChunksNum > 0 ? pChunks : NULL, mesh.nChunksNum))
+		{
+			DeletePolygons(pPolygons, mesh.nPolygonsNum);
+			bSucceed = false;
+		}
+	}
+	if (!bSucceed)
+	{
+		FreeArray(pObjects);
+		return false;
+	}
+
+	// е뽨õ̬ͬʱҪ¼
+	Object3D* pDst = pScence->ResetObjects(header.nObjectsNum);
+	for (int i = 0; i < header.nObjectsNum; i++)
+	{
+		pDst[i].SetRotateOrder(pObjects[i].GetRotateOrder());
+		pDst[i].SetOrientation(pObjects[i].GetOrientation());
+		pDst[i].SetOccluder(pObjects[i].IsOccluder());
+		pDst[i].SwapMesh(pObjects[i]);
+	}
+	FreeArray(pObjects);
+
+	while (pScence->GetLightsNum() > 0)
+		pScence->DeleteLight(pScence->GetLightsNum() - 1);
+	for (int i = 0; i < header.nLightsNum; i++)
+		pScence->AddLight(pLights[i]);
+	pScence->SetCamera(header.camera);
+	pScence->SetRenderMode(header.mode == render_wireframe ? render_wireframe : render_fill);
+	pScence->SetShadeMode(header.shade == shade_flat || header.shade == shade_gouraud ? (ShadeMode)header.shade : shade_none);
+	pScence->SetAmbientLight(header.ambient);
+	pScence->SetSpecular(header.specular, header.shininess);
+	pScence->EnableOcclusionCulling(header.bOcclusionCulling != 0);
+	return true;
+}
+
+//////// ؼ֡
+
+/**
+ * @brief ؼ֮֡Ĳֵʽ
+*/
+enum InterpolationMode
+{
+	interpolate_linear,	/** @brief Բֵֵ̬ٹһ */
+	interpolate_slerp	/** @brief Բֵֻ̬ٶȺ㶨 */
+};
+
+/**
+ * @brief  sin(x)x  [0, /2] 
+ * @note ̩նʽչ x^13С 1e-9ֻó˼㣬 SSE2 õȫͬĽ Animator3D::Evaluate
+*/
+inline double SinPolynomial(double x)
+{
+	double x2 = x * x;
+	return x * (1 + x2 * (-1.0 / 6 + x2 * (1.0 / 120 + x2 * (-1.0 / 5040 + x2 * (1.0 / 362880 + x2 * (-1.0 / 39916800 + x2 * (1.0 / 6227020800)))))));
+}
+
+/**
+ * @brief ؼ֡ʱλá̬ؼֵ֡
+ * @note йĹؼ֡ͬһУֵҪĽǶӹʱԤá
+ *			ÿֵ֡飺ҵǰʱڵĶΣ SSE2 ÿζֵλú̬ͬһ㣩
+ *			Ӧõʱֻ±任仯Ŀ꣬¼汾֮£BVH Ȼݴؽ
+ *			λָĵ㣨 Object3D::GetPosition
+*/
+class Animator3D
+{
+private:
+
+	/**
+	 * @brief 
+	*/
+	struct Track
+	{
+		int nTarget;		/** @brief Ŀڳе±꣬ANIMATION_TARGET_CAMERA ʾ */
+		bool bAttitude;		/** @brief ǷΪ̬Ϊλù */
+		int nFirstKey;		/** @brief һؼ֡ڹؼ֡е± */
+		int nKeysNum;		/** @brief ؼ֡ */
+		int nCursor;		/** @brief ϴֵʱڵĶΣʱ仯ʱ￪ʼ */
+	};
 
 	/**
-	 * @brief  x ᷽ƶ
+	 * @brief Ŀ꣬ϲͬһĿλú̬
 	*/
-	void MoveX(double n)
+	struct Target
 	{
-		for (int i = 0; i < nPolygonsNum; i++)
-		{
-			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
-			{
-				pPolygons[i].pPoints[j].x += n;
-				pRotatedPolygons[i].pPoints[j].x += n;
-			}
-		}
+		int nTarget;				/** @brief Ŀ± ANIMATION_TARGET_CAMERA */
+		int nPositionTrack;			/** @brief λùûʱΪ -1 */
+		int nAttitudeTrack;			/** @brief ̬ûʱΪ -1 */
+		Point3D position;			/** @brief ϴӦõλ */
+		Quaternion3D orientation;	/** @brief ϴӦõ̬ */
+		bool bApplied;				/** @brief ǷѾӦù */
+	};
+
+	Track* pTracks;			/** @brief  */
+	int nTracksNum;			/** @brief  */
+
+	double* pTimes;			/** @brief ؼ֡ʱ䣬ÿڲݼ */
+	Quaternion3D* pKeys;	/** @brief ؼֵ̬֡ΪλԪѵǰһ֡ͬһ򣩣λô x, y, z  */
+	double* pAngles;		/** @brief ؼ֡һ֡ԪļнǣֵĶΪ 0 */
+	double* pInvSins;		/** @brief нҵĵֵĶΣÿһ֡Ϊ 0 */
+	int nKeysNum;			/** @brief ؼ֡ */
+
+	Quaternion3D* pValues;	/** @brief ֵ */
+	int* pSegments;			/** @brief ǰεʼؼ֡ */
+	int* pNextKeys;			/** @brief ǰεֹؼ֡ */
+	double* pFactors;		/** @brief ڵǰеĲֵϵ */
+
+	Target* pTargets;		/** @brief Ŀ꣬Ŀ± */
+	int nTargetsNum;		/** @brief Ŀ */
+	int* pDirty;			/** @brief Ӧʱ任仯Ŀ */
+	bool bTargetsChanged;	/** @brief ӹҪؽĿ */
 
-		pCenter.x += n;
+	/**
+	 * @brief չ nNum + nAdd ԪأԭԪ
+	*/
+	template<class T>
+	static void Grow(T*& p, int nNum, int nAdd)
+	{
+		T* pNew = AllocArray<T>(nNum + nAdd, memory_scene);
+		for (int i = 0; i < nNum; i++)
+			pNew[i] = p[i];
+		FreeArray(p);
+		p = pNew;
 	}
 
 	/**
-	 * @brief  y ᷽ƶ
+	 * @brief ӹ
+	 * @return عЧʱ -1
 	*/
-	void MoveY(double n)
+	int AddTrack(int nTarget, bool bAttitude, const double* pKeyTimes, const Quaternion3D* pKeyValues, int num, InterpolationMode mode)
 	{
-		for (int i = 0; i < nPolygonsNum; i++)
+		if (num <= 0 || !pKeyTimes || !pKeyValues || nTarget < ANIMATION_TARGET_CAMERA) return -1;
+		for (int i = 1; i < num; i++)
+			if (!(pKeyTimes[i] >= pKeyTimes[i - 1]))
+				return -1;
+
+		Grow(pTracks, nTracksNum, 1);
+		Grow(pValues, nTracksNum, 1);
+		Grow(pSegments, nTracksNum, 1);
+		Grow(pNextKeys, nTracksNum, 1);
+		Grow(pFactors, nTracksNum, 1);
+		Grow(pTimes, nKeysNum, num);
+		Grow(pKeys, nKeysNum, num);
+		Grow(pAngles, nKeysNum, num);
+		Grow(pInvSins, nKeysNum, num);
+
+		for (int i = 0; i < num; i++)
 		{
-			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			int k = nKeysNum + i;
+			pTimes[k] = pKeyTimes[i];
+			pKeys[k] = pKeyValues[i];
+			pAngles[k] = pInvSins[k] = 0;
+			if (!bAttitude) continue;
+
+			// ǰһ֡ȡͬһ򣬲ֵؽ϶̵Ļ
+			pKeys[k] = NormalizeQuaternion(pKeys[k]);
+			if (i == 0) continue;
+			Quaternion3D& a = pKeys[k - 1];
+			Quaternion3D& b = pKeys[k];
+			double cos_t = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+			if (cos_t < 0)
 			{
-				pPolygons[i].pPoints[j].y += n;
-				pRotatedPolygons[i].pPoints[j].y += n;
+				b = { -b.w,-b.x,-b.y,-b.z };
+				cos_t = -cos_t;
+			}
+			if (mode == interpolate_slerp && cos_t < 0.9995)
+			{
+				pAngles[k - 1] = acos(cos_t);
+				pInvSins[k - 1] = 1 / sin(pAngles[k - 1]);
 			}
 		}
 
-		pCenter.y += n;
+		pTracks[nTracksNum] = { nTarget,bAttitude,nKeysNum,num,0 };
+		pValues[nTracksNum] = pKeys[nKeysNum];
+		nKeysNum += num;
+		nTracksNum++;
+		bTargetsChanged = true;
+		return nTracksNum - 1;
 	}
 
 	/**
-	 * @brief  z ᷽ƶ
+	 * @brief Ŀ±ϲͬһĿֻͬʹӵһ
 	*/
-	void MoveZ(double n)
+	void UpdateTargets()
 	{
-		for (int i = 0; i < nPolygonsNum; i++)
+		int* pOrder = AllocArray<int>(nTracksNum + 1, memory_scene);
+		for (int i = 0; i < nTracksNum; i++)
+			pOrder[i] = i;
+		std::stable_sort(pOrder, pOrder + nTracksNum, [this](int a, int b) {
+			return pTracks[a].nTarget < pTracks[b].nTarget;
+		});
+
+		FreeArray(pTargets);
+		FreeArray(pDirty);
+		pTargets = AllocArray<Target>(nTracksNum + 1, memory_scene);
+		pDirty = AllocArray<int>(nTracksNum + 1, memory_scene);
+		nTargetsNum = 0;
+		for (int i = 0; i < nTracksNum; i++)
 		{
-			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
-			{
-				pPolygons[i].pPoints[j].z += n;
-				pRotatedPolygons[i].pPoints[j].z += n;
-			}
+			const Track& track = pTracks[pOrder[i]];
+			if (nTargetsNum == 0 || pTargets[nTargetsNum - 1].nTarget != track.nTarget)
+				pTargets[nTargetsNum++] = { track.nTarget,-1,-1,{ 0,0,0 },{ 1,0,0,0 },false };
+			Target& target = pTargets[nTargetsNum - 1];
+			(track.bAttitude ? target.nAttitudeTrack : target.nPositionTrack) = pOrder[i];
 		}
+		FreeArray(pOrder);
+		bTargetsChanged = false;
+	}
 
-		pCenter.z += n;
+public:
+
+	Animator3D()
+	{
+		pTracks = NULL;
+		nTracksNum = 0;
+		pTimes = NULL;
+		pKeys = NULL;
+		pAngles = NULL;
+		pInvSins = NULL;
+		nKeysNum = 0;
+		pValues = NULL;
+		pSegments = NULL;
+		pNextKeys = NULL;
+		pFactors = NULL;
+		pTargets = NULL;
+		nTargetsNum = 0;
+		pDirty = NULL;
+		bTargetsChanged = false;
 	}
 
-	/**
-	 * @brief ̬
-	*/
-	void SetAttitude(Attitude3D ati)
+	Animator3D(const Animator3D&) = delete;
+	Animator3D& operator=(const Animator3D&) = delete;
+
+	~Animator3D()
 	{
-		attitude = ati;
+		Clear();
 	}
 
 	/**
-	 * @brief ȡ̬
+	 * @brief ɾй
 	*/
-	Attitude3D GetAttitude()
+	void Clear()
 	{
-		return attitude;
+		FreeArray(pTracks);
+		FreeArray(pTimes);
+		FreeArray(pKeys);
+		FreeArray(pAngles);
+		FreeArray(pInvSins);
+		FreeArray(pValues);
+		FreeArray(pSegments);
+		FreeArray(pNextKeys);
+		FreeArray(pFactors);
+		FreeArray(pTargets);
+		FreeArray(pDirty);
+		pTracks = NULL;
+		pTimes = pAngles = pInvSins = pFactors = NULL;
+		pKeys = pValues = NULL;
+		pSegments = pNextKeys = pDirty = NULL;
+		pTargets = NULL;
+		nTracksNum = nKeysNum = nTargetsNum = 0;
+		bTargetsChanged = false;
 	}
 
 	/**
-	 * @brief  x ˳ʱ̬
+	 * @brief λù
+	 * @param[in] nTarget : Ŀڳе±꣬ ANIMATION_TARGET_CAMERA ʾ
+	 * @param[in] pKeyTimes : ؼ֡ʱ䣨룩ܵݼ
+	 * @param[in] pPositions : ؼ֡λãΪĵ꣩
+	 * @param[in] num : ؼ֡
+	 * @return عЧʱ -1
+	 * @note ؼ֮֡Բֵһ֮֡ǰһ֮֡󱣳βֵͬһĿӶλùʱֻʹһ
 	*/
-	void RotateX(double angle)
+	int AddPositionTrack(int nTarget, const double* pKeyTimes, const Point3D* pPositions, int num)
 	{
-		attitude.r += angle;
+		if (num <= 0 || !pPositions) return -1;
+		Quaternion3D* pKeyValues = AllocArray<Quaternion3D>(num, memory_scene);
+		for (int i = 0; i < num; i++)
+			pKeyValues[i] = { 0,pPositions[i].x,pPositions[i].y,pPositions[i].z };
+		int index = AddTrack(nTarget, false, pKeyTimes, pKeyValues, num, interpolate_linear);
+		FreeArray(pKeyValues);
+		return index;
 	}
 
 	/**
-	 * @brief  y ˳ʱ̬
+	 * @brief ̬
+	 * @param[in] nTarget : Ŀڳе±꣬ ANIMATION_TARGET_CAMERA ʾ
+	 * @param[in] pKeyTimes : ؼ֡ʱ䣨룩ܵݼ
+	 * @param[in] pOrientations : ؼ̬֡ Object3D::SetOrientationCamera3D::orientation ͬ
+	 * @param[in] num : ؼ֡
+	 * @param[in] mode : ֵʽ
+	 * @return عЧʱ -1
+	 * @note ؽ϶̵Ļֵŷ̬ ConvertAttitudeToQuaternion ConvertCameraAttitudeToQuaternionת
 	*/
-	void RotateY(double angle)
+	int AddAttitudeTrack(int nTarget, const double* pKeyTimes, const Quaternion3D* pOrientations, int num, InterpolationMode mode = interpolate_slerp)
 	{
-		attitude.e += angle;
+		return AddTrack(nTarget, true, pKeyTimes, pOrientations, num, mode);
 	}
 
 	/**
-	 * @brief  z ˳ʱ̬
+	 * @brief ȡ
 	*/
-	void RotateZ(double angle)
+	int GetTracksNum()
 	{
-		attitude.a += angle;
+		return nTracksNum;
 	}
 
 	/**
-	 * @brief ȡάα߿
-	 * @param[in] bRotated : ǷȡѾתı߿
-	 * @return ߿
+	 * @brief ȡʱйһؼ֡ʱֵ
 	*/
-	Rectangle3D GetRectangle(bool bRotated = true)
+	double GetDuration()
 	{
-		Rectangle3D r = {};
-		Polygon3D* p = pPolygons;
-		if(bRotated && pRotatedPolygons)
-			p = pRotatedPolygons;
-		for (int i = 0; i < nPolygonsNum; i++)
-		{
-			for (int j = 0; j < p[i].nPointsNum; j++)
-			{
-				// init
-				if (i + j == 0)
-				{
-					r.min_x = r.max_x = p[i].pPoints[j].x;
-					r.min_y = r.max_y = p[i].pPoints[j].y;
-					r.min_z = r.max_z = p[i].pPoints[j].z;
-					continue;
-				}
-
-				if (p[i].pPoints[j].x < r.min_x)
-					r.min_x = p[i].pPoints[j].x;
-				else if (p[i].pPoints[j].x > r.max_x)
-					r.max_x = p[i].pPoints[j].x;
-
-				if (p[i].pPoints[j].y < r.min_y)
-					r.min_y = p[i].pPoints[j].y;
-				else if (p[i].pPoints[j].y > r.max_y)
-					r.max_y = p[i].pPoints[j].y;
-
-				if (p[i].pPoints[j].z < r.min_z)
-					r.min_z = p[i].pPoints[j].z;
-				else if (p[i].pPoints[j].z > r.max_z)
-					r.max_z = p[i].pPoints[j].z;
-			}
-		}
-		return r;
+		double duration = 0;
+		for (int i = 0; i < nTracksNum; i++)
+			duration = std::max(duration, pTimes[pTracks[i].nFirstKey + pTracks[i].nKeysNum - 1]);
+		return duration;
 	}
 
 	/**
-	 * @brief ת飬̬
-	 * @attention û̬󲻻µ꣬Ҫֶ
-	 *			˺м㡣
+	 * @brief йĳһʱ̵ֵ
+	 * @param[in] t : ʱ䣨룩
+	 * @note  GetTrackPosition / GetTrackOrientation ȡ Apply Ӧõ
 	*/
-	void UpdateRotatedPoints()
+	void Evaluate(double t)
 	{
-		for (int i = 0; i < nPolygonsNum; i++)
+		// ڵĶΣʱ仯ʱֻҪǰƶһ
+		for (int i = 0; i < nTracksNum; i++)
 		{
-			for (int j = 0; j < pPolygons[i].nPointsNum; j++)
+			Track& track = pTracks[i];
+			const double* pKeyTimes = pTimes + track.nFirstKey;
+			int k = std::min(std::max(track.nCursor, 0), std::max(track.nKeysNum - 2, 0));
+			double u = 0;
+			if (track.nKeysNum > 1)
 			{
-				pRotatedPolygons[i].pPoints[j] = Rotate3D(pPolygons[i].pPoints[j], attitude.a, attitude.e, attitude.r, pCenter, rotate_order);
+				while (k > 0 && t < pKeyTimes[k])
+					k--;
+				while (k < track.nKeysNum - 2 && t >= pKeyTimes[k + 1])
+					k++;
+				double span = pKeyTimes[k + 1] - pKeyTimes[k];
+				u = span > 0 ? (t - pKeyTimes[k]) / span : (t >= pKeyTimes[k + 1] ? 1 : 0);
+				u = std::min(std::max(u, 0.0), 1.0);
 			}
-			pRotatedPolygons[i].nPointsNum = pPolygons[i].nPointsNum;
-			pRotatedPolygons[i].color = pPolygons[i].color;
+			track.nCursor = k;
+			pSegments[i] = track.nFirstKey + k;
+			pNextKeys[i] = track.nFirstKey + std::min(k + 1, track.nKeysNum - 1);
+			pFactors[i] = u;
 		}
-	}
-
-	/**
-	 * @brief ӵ
-	 * @attention ˺ԵΪλӣÿ㶼Ϊһβ
-	 * @param[in] pNew : Ҫӵĵ
-	 * @param[in] num : Ҫӵĵ
-	 * @return ӵģеĵһʧܷ -1
-	*/
-	int AddPoints(ColorPoint3D* pNew, int num)
-	{
-		if (num <= 0 || !pNew)	return -1;
 
-		Polygon3D* newArray = new Polygon3D[nPolygonsNum + num];
-		CopyPolygons(newArray, pPolygons, nPolygonsNum);
+		int i = 0;
+
+#ifdef HD3D_SSE2
+		const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1);
+
+		//  SinPolynomial ͬ
+		auto sin_poly = [&](__m128d x) {
+			__m128d x2 = _mm_mul_pd(x, x);
+			__m128d s = _mm_set1_pd(1.0 / 6227020800);
+			s = _mm_add_pd(_mm_set1_pd(-1.0 / 39916800), _mm_mul_pd(x2, s));
+			s = _mm_add_pd(_mm_set1_pd(1.0 / 362880), _mm_mul_pd(x2, s));
+			s = _mm_add_pd(_mm_set1_pd(-1.0 / 5040), _mm_mul_pd(x2, s));
+			s = _mm_add_pd(_mm_set1_pd(1.0 / 120), _mm_mul_pd(x2, s));
+			s = _mm_add_pd(_mm_set1_pd(-1.0 / 6), _mm_mul_pd(x2, s));
+			s = _mm_add_pd(one, _mm_mul_pd(x2, s));
+			return _mm_mul_pd(x, s);
+		};
+		auto select = [](__m128d mask, __m128d a, __m128d b) {
+			return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+		};
 
-		for (int i = nPolygonsNum, j = 0; j < num; i++, j++)
+		for (; i + 2 <= nTracksNum; i += 2)
 		{
-			newArray[i].pPoints[0] = pNew[j];
-			newArray[i].nPointsNum = 1;
-			newArray[i].color = pNew[j].color;
+			const Quaternion3D& a0 = pKeys[pSegments[i]];
+			const Quaternion3D& a1 = pKeys[pSegments[i + 1]];
+			const Quaternion3D& b0 = pKeys[pNextKeys[i]];
+			const Quaternion3D& b1 = pKeys[pNextKeys[i + 1]];
+
+			// ֵϵֵΪ sin((1-u))/sin  sin(u)/sinȣΪ 1-u  u
+			__m128d u = _mm_loadu_pd(pFactors + i);
+			__m128d v = _mm_sub_pd(one, u);
+			__m128d theta = _mm_set_pd(pAngles[pSegments[i + 1]], pAngles[pSegments[i]]);
+			__m128d inv = _mm_set_pd(pInvSins[pSegments[i + 1]], pInvSins[pSegments[i]]);
+			__m128d linear = _mm_cmpeq_pd(inv, zero);
+			__m128d ka = select(linear, v, _mm_mul_pd(sin_poly(_mm_mul_pd(v, theta)), inv));
+			__m128d kb = select(linear, u, _mm_mul_pd(sin_poly(_mm_mul_pd(u, theta)), inv));
+
+			__m128d w = _mm_add_pd(_mm_mul_pd(ka, _mm_set_pd(a1.w, a0.w)), _mm_mul_pd(kb, _mm_set_pd(b1.w, b0.w)));
+			__m128d x = _mm_add_pd(_mm_mul_pd(ka, _mm_set_pd(a1.x, a0.x)), _mm_mul_pd(kb, _mm_set_pd(b1.x, b0.x)));
+			__m128d y = _mm_add_pd(_mm_mul_pd(ka, _mm_set_pd(a1.y, a0.y)), _mm_mul_pd(kb, _mm_set_pd(b1.y, b0.y)));
+			__m128d z = _mm_add_pd(_mm_mul_pd(ka, _mm_set_pd(a1.z, a0.z)), _mm_mul_pd(kb, _mm_set_pd(b1.z, b0.z)));
+
+			// ̬һλñֲ
+			__m128d len2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(w, w), _mm_mul_pd(x, x)), _mm_add_pd(_mm_mul_pd(y, y), _mm_mul_pd(z, z)));
+			__m128d attitude = _mm_cmpneq_pd(_mm_set_pd(pTracks[i + 1].bAttitude, pTracks[i].bAttitude), zero);
+			__m128d scale = select(_mm_and_pd(attitude, _mm_cmpgt_pd(len2, zero)), _mm_div_pd(one, _mm_sqrt_pd(len2)), one);
+
+			double r[4][2];
+			_mm_storeu_pd(r[0], _mm_mul_pd(w, scale));
+			_mm_storeu_pd(r[1], _mm_mul_pd(x, scale));
+			_mm_storeu_pd(r[2], _mm_mul_pd(y, scale));
+			_mm_storeu_pd(r[3], _mm_mul_pd(z, scale));
+			for (int m = 0; m < 2; m++)
+				pValues[i + m] = { r[0][m],r[1][m],r[2][m],r[3][m] };
 		}
+#endif
 
-		DeletePolygons(pPolygons, nPolygonsNum);
-
-		pPolygons = newArray;
-		nPolygonsNum += num;
-
-		UpdateArray();
-
-		return nPolygonsNum - num;
+		for (; i < nTracksNum; i++)
+		{
+			const Quaternion3D& a = pKeys[pSegments[i]];
+			const Quaternion3D& b = pKeys[pNextKeys[i]];
+			double u = pFactors[i], v = 1 - u;
+			double theta = pAngles[pSegments[i]], inv = pInvSins[pSegments[i]];
+			double ka = inv == 0 ? v : SinPolynomial(v * theta) * inv;
+			double kb = inv == 0 ? u : SinPolynomial(u * theta) * inv;
+			Quaternion3D q = { ka * a.w + kb * b.w,ka * a.x + kb * b.x,ka * a.y + kb * b.y,ka * a.z + kb * b.z };
+			double len2 = (q.w * q.w + q.x * q.x) + (q.y * q.y + q.z * q.z);
+			double scale = pTracks[i].bAttitude && len2 > 0 ? 1 / sqrt(len2) : 1;
+			pValues[i] = { q.w * scale,q.x * scale,q.y * scale,q.z * scale };
+		}
 	}
 
 	/**
-	 * @brief Ӷ
-	 * @param[in] pNew : ҪӵĶε
-	 * @param[in] num : ҪӵĶε
-	 * @return ӵģеĵһʧܷ -1
+	 * @brief ȡλùϴֵĽ
 	*/
-	int AddPolygons(Polygon3D* pNew, int num)
+	Point3D GetTrackPosition(int index)
 	{
-		if (num <= 0 || !pNew)	return -1;
-
-		Polygon3D* newArray = new Polygon3D[nPolygonsNum + num];
-		CopyPolygons(newArray, pPolygons, nPolygonsNum);
-		CopyPolygons(newArray+ nPolygonsNum, pNew, num);
-
-		DeletePolygons(pPolygons, nPolygonsNum);
-
-		pPolygons = newArray;
-		nPolygonsNum += num;
-
-		UpdateArray();
+		if (index < 0 || index >= nTracksNum) return { 0,0,0 };
+		return { pValues[index].x,pValues[index].y,pValues[index].z };
+	}
 
-		return nPolygonsNum - num;
+	/**
+	 * @brief ȡ̬ϴֵĽ
+	*/
+	Quaternion3D GetTrackOrientation(int index)
+	{
+		if (index < 0 || index >= nTracksNum) return { 1,0,0,0 };
+		return pValues[index];
 	}
 
 	/**
-	 * @brief ɾеĳ
-	 * @param[in] p : Ҫɾĵ
+	 * @brief ϴֵĽӦõе
+	 * @param[in] pScence : 
+	 * @param[in] nThreads : ߳Ϊ 0 ʱʹкģĬֻڵõ߳и
+	 * @return ر任˱仯¼Ŀ
+	 * @note λú̬ϴӦʱͬĿ겻κ޸ģİ汾Ų䣬 BVH ҲҪؽ
+	 *			ֻ̬屣ԭλãֻλù屣ԭ̬±곬Ŀ걻
 	*/
-	void DeletePolygon(int index)
+	int Apply(Scence3D* pScence, int nThreads = 1)
 	{
-		Polygon3D* newArray = new Polygon3D[nPolygonsNum - 1];
-		for (int i = 0, j = 0; j < nPolygonsNum; i++, j++)
+		if (bTargetsChanged)
+			UpdateTargets();
+
+		int nDirtyNum = 0, nCameraNum = 0;
+		Object3D* pObjects = pScence->GetObjects();
+		for (int i = 0; i < nTargetsNum; i++)
 		{
-			if (j != index)
+			Target& target = pTargets[i];
+			bool bCamera = target.nTarget == ANIMATION_TARGET_CAMERA;
+			if (!bCamera && target.nTarget >= pScence->GetObjectsNum())
+				continue;
+
+			Camera3D cam = pScence->GetCamera();
+			Point3D position = bCamera ? cam.pPosition : pObjects[target.nTarget].GetPosition();
+			Quaternion3D orientation = bCamera ? cam.orientation : pObjects[target.nTarget].GetOrientation();
+			if (target.nPositionTrack >= 0)
+				position = GetTrackPosition(target.nPositionTrack);
+			if (target.nAttitudeTrack >= 0)
+				orientation = pValues[target.nAttitudeTrack];
+
+			if (target.bApplied && memcmp(&position, &target.position, sizeof position) == 0
+				&& memcmp(&orientation, &target.orientation, sizeof orientation) == 0)
+				continue;
+			target.position = position;
+			target.orientation = orientation;
+			target.bApplied = true;
+
+			if (bCamera)
 			{
-				newArray[i] = pPolygons[j];
+				cam.pPosition = position;
+				cam.orientation = orientation;
+				pScence->SetCamera(cam);
+				nCameraNum++;
 			}
 			else
 			{
-				i--;
+				pDirty[nDirtyNum++] = i;
 			}
 		}
 
-		DeletePolygons(pPolygons, nPolygonsNum);
-
-		pPolygons = newArray;
-		nPolygonsNum--;
-
-		UpdateArray();
+		// 廥أԲ¼
+		RunParallel(nDirtyNum, nThreads, [&](int k) {
+			const Target& target = pTargets[pDirty[k]];
+			pObjects[target.nTarget].SetTransform(target.position, target.orientation);
+		});
+		return nDirtyNum + nCameraNum;
 	}
-
 };
 
+//////// Ⱦ
 
 /**
- * @brief 3D 
+ * @brief  CRC32 УֵPNG ʹã
+ * @param[in] crc : ǰУֵֵΪ 0xFFFFFFFFսҪȡ
+ * @param[in] p : 
+ * @param[in] len : ݳ
 */
-class Scence3D
+inline unsigned int UpdateCRC32(unsigned int crc, const unsigned char* p, size_t len)
 {
-
-private:
-	Object3D* pObjects;	/** @brief ڵ弯 */
-	int nObjectsNum;	/** @brief ڵ */
-
-	Point3D pCamera;			/** @brief  */
-	Attitude3D attitudeCamera;	/** @brief ̬ */
-	int nViewportWidth;			/** @brief ӿڿ */
-	int nViewportHeight;		/** @brief ӿڸ߶ */
-
-	/**
-	 * @brief 
-	 * @attention Ϊ˻ʾòС 600
-	*/
-	int nFocalLength;
-
-	bool bPerspectiveProjection;	/** @brief Ƿʹ͸ͶӰ */
-
-public:
-
-	Scence3D()
+	struct CRC32Table
 	{
-		pObjects = NULL;
-		nObjectsNum = 0;
-
-		pCamera = { 0,0,0 };
-		attitudeCamera = { 0,0,0 };
+		unsigned int t[256];
+		CRC32Table()
+		{
+			for (unsigned int i = 0; i < 256; i++)
+			{
+				unsigned int c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+		}
+	};
+	static const CRC32Table table;
 
-		nViewportWidth = 640;
-		nViewportHeight = 480;
-		nFocalLength = 1000;
+	for (size_t i = 0; i < len; i++)
+		crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
 
-		bPerspectiveProjection = true;
-	}
+/**
+ * @brief ֡屣Ϊ PPMP6ͼ
+ * @param[in] pImage : ֡
+ * @param[in] fp : öƷʽ򿪵ļ
+ * @return Ƿɹ
+*/
+inline bool SaveImagePPM(const FrameBuffer* pImage, FILE* fp)
+{
+	int w = pImage->GetWidth(), h = pImage->GetHeight();
+	fprintf(fp, "P6\n%d %d\n255\n", w, h);
 
-	~Scence3D()
+	unsigned char* pRow = new unsigned char[(size_t)w * 3];
+	for (int y = 0; y < h; y++)
 	{
-		if (pObjects) delete[] pObjects;
+		const DWORD* pLine = pImage->GetLine(y);
+		for (int x = 0; x < w; x++)
+		{
+			pRow[x * 3 + 0] = (unsigned char)(pLine[x] >> 16);
+			pRow[x * 3 + 1] = (unsigned char)(pLine[x] >> 8);
+			pRow[x * 3 + 2] = (unsigned char)(pLine[x]);
+		}
+		fwrite(pRow, 1, (size_t)w * 3, fp);
 	}
+	delete[] pRow;
+	return !ferror(fp);
+}
 
-	/**
-	 * @brief λ
-	*/
-	void SetCameraPosition(Point3D p)
-	{
-		pCamera = p;
-	}
+/**
+ * @brief ֡屣Ϊ PNG ͼ
+ * @param[in] pImage : ֡
+ * @param[in] fp : öƷʽ򿪵ļ
+ * @return Ƿɹ
+ * @note ΪٶȺͱ zlibʹ deflate Ĳѹstoredд룬ļϴ󵫽֧
+*/
+inline bool SaveImagePNG(const FrameBuffer* pImage, FILE* fp)
+{
+	int w = pImage->GetWidth(), h = pImage->GetHeight();
+	unsigned int nRaw = (unsigned int)h * (1 + 3 * (unsigned int)w);
+	unsigned int nBlocks = (nRaw + 65534) / 65535;
+	unsigned int nZlib = 2 + nBlocks * 5 + nRaw + 4;
+
+	unsigned int crc = 0;
+	auto write = [&](const void* p, size_t n) {
+		fwrite(p, 1, n, fp);
+		crc = UpdateCRC32(crc, (const unsigned char*)p, n);
+	};
+	auto write32 = [&](unsigned int v) {
+		unsigned char b[4] = { (unsigned char)(v >> 24),(unsigned char)(v >> 16),(unsigned char)(v >> 8),(unsigned char)v };
+		write(b, 4);
+	};
+	auto begin_chunk = [&](unsigned int len, const char* type) {
+		write32(len);
+		crc = 0xFFFFFFFF;
+		write(type, 4);
+	};
+	auto end_chunk = [&]() {
+		write32(crc ^ 0xFFFFFFFF);
+	};
+
+	const unsigned char pSignature[8] = { 0x89,'P','N','G','\r','\n',0x1A,'\n' };
+	fwrite(pSignature, 1, 8, fp);
+
+	// IHDR8 λ RGB
+	begin_chunk(13, "IHDR");
+	write32(w);
+	write32(h);
+	const unsigned char pHeader[5] = { 8,2,0,0,0 };
+	write(pHeader, 5);
+	end_chunk();
+
+	// IDATzlib ͷ + stored  + adler32
+	begin_chunk(nZlib, "IDAT");
+	const unsigned char pZlibHeader[2] = { 0x78,0x01 };
+	write(pZlibHeader, 2);
+
+	unsigned int nBlockLeft = 0, nRemain = nRaw;
+	unsigned int s1 = 1, s2 = 0;
+	auto put = [&](const unsigned char* p, unsigned int n) {
+		while (n > 0)
+		{
+			if (nBlockLeft == 0)
+			{
+				nBlockLeft = nRemain < 65535 ? nRemain : 65535;
+				unsigned int nlen = ~nBlockLeft & 0xFFFF;
+				unsigned char b[5] = {
+					(unsigned char)(nRemain <= 65535 ? 1 : 0),
+					(unsigned char)(nBlockLeft & 0xFF),(unsigned char)(nBlockLeft >> 8),
+					(unsigned char)(nlen & 0xFF),(unsigned char)(nlen >> 8)
+				};
+				write(b, 5);
+			}
+			unsigned int k = n < nBlockLeft ? n : nBlockLeft;
+			write(p, k);
+			for (unsigned int i = 0; i < k; i++)
+			{
+				s1 += p[i];
+				s2 += s1;
+				if ((i & 4095) == 4095)
+				{
+					s1 %= 65521;
+					s2 %= 65521;
+				}
+			}
+			s1 %= 65521;
+			s2 %= 65521;
+			p += k;
+			n -= k;
+			nBlockLeft -= k;
+			nRemain -= k;
+		}
+	};
 
-	/**
-	 * @brief ȡλ
-	*/
-	Point3D GetCameraPosition()
+	unsigned char* pRow = new unsigned char[1 + (size_t)w * 3];
+	pRow[0] = 0;	// ʹй
+	for (int y = 0; y < h; y++)
 	{
-		return pCamera;
+		const DWORD* pLine = pImage->GetLine(y);
+		for (int x = 0; x < w; x++)
+		{
+			pRow[1 + x * 3 + 0] = (unsigned char)(pLine[x] >> 16);
+			pRow[1 + x * 3 + 1] = (unsigned char)(pLine[x] >> 8);
+			pRow[1 + x * 3 + 2] = (unsigned char)(pLine[x]);
+		}
+		put(pRow, 1 + w * 3);
 	}
+	delete[] pRow;
 
-	/**
-	 * @brief ƶЧ SetCameraPosition ͬ
-	*/
-	void MoveCameraTo(Point3D p)
-	{
-		SetCameraPosition(p);
-	}
+	write32((s2 << 16) | s1);
+	end_chunk();
 
-	/**
-	 * @brief  x ᷽ƶ
-	*/
-	void MoveCameraX(double n)
-	{
-		pCamera.x += n;
-	}
+	begin_chunk(0, "IEND");
+	end_chunk();
 
-	/**
-	 * @brief  y ᷽ƶ
-	*/
-	void MoveCameraY(double n)
-	{
-		pCamera.y += n;
-	}
+	return !ferror(fp);
+}
 
-	/**
-	 * @brief  z ᷽ƶ
-	*/
-	void MoveCameraZ(double n)
-	{
-		pCamera.z += n;
-	}
+/**
+ * @brief ֡屣Ϊͼļ
+ * @param[in] pImage : ֡
+ * @param[in] strFile : ļ·չΪ .png ʱΪ PNG򱣴Ϊ PPM
+ * @return Ƿɹ
+*/
+inline bool SaveImageFile(const FrameBuffer* pImage, const char* strFile)
+{
+	FILE* fp;
+	if (fopen_s(&fp, strFile, "wb") != 0)
+		return false;
 
-	/**
-	 * @brief ̬
-	*/
-	void SetCameraAttitude(Attitude3D ati)
-	{
-		attitudeCamera = ati;
-	}
+	size_t len = strlen(strFile);
+	bool bPNG = len >= 4 && strFile[len - 4] == '.'
+		&& tolower(strFile[len - 3]) == 'p' && tolower(strFile[len - 2]) == 'n' && tolower(strFile[len - 1]) == 'g';
 
-	/**
-	 * @brief ȡ̬
-	*/
-	Attitude3D GetCameraAttitude()
-	{
-		return attitudeCamera;
-	}
+	bool r = bPNG ? SaveImagePNG(pImage, fp) : SaveImagePPM(pImage, fp);
+	fclose(fp);
+	return r;
+}
 
-	/**
-	 * @brief  x ת
-	*/
-	void RotateCameraX(double angle)
+/**
+ * @brief ȡ PPMP6ÿͨ 8 λͼ֡
+ * @param[out] pImage : ֡壬ͼС´
+ * @param[in] strFile : ļ·
+ * @return Ƿɹ
+ * @note Զȡ SaveImagePPM ļԱȵĲοͼ
+*/
+inline bool LoadImagePPM(FrameBuffer* pImage, const char* strFile)
+{
+	FILE* fp;
+	if (fopen_s(&fp, strFile, "rb") != 0)
+		return false;
+
+	// ļͷħ P6ߡֵ֮пհ׺ # עֵͣһհַ
+	char pMagic[2] = { 0 };
+	bool ok = fread(pMagic, 1, 2, fp) == 2 && pMagic[0] == 'P' && pMagic[1] == '6';
+	int pHeader[3] = { 0 };
+	for (int i = 0; ok && i < 3; i++)
 	{
-		attitudeCamera.r += angle;
+		int c = fgetc(fp);
+		while (c == '#' || isspace(c))
+		{
+			if (c == '#')
+				while (c != '\n' && c != EOF)
+					c = fgetc(fp);
+			c = fgetc(fp);
+		}
+		if (!isdigit(c))
+		{
+			ok = false;
+			break;
+		}
+		for (; isdigit(c) && pHeader[i] < 100000; c = fgetc(fp))
+			pHeader[i] = pHeader[i] * 10 + (c - '0');
 	}
+	int w = pHeader[0], h = pHeader[1];
+	ok = ok && w > 0 && h > 0 && w < 100000 && h < 100000 && pHeader[2] == 255 && pImage->Create(w, h);
 
-	/**
-	 * @brief  y ת
-	*/
-	void RotateCameraY(double angle)
+	unsigned char* pRow = ok ? new unsigned char[(size_t)w * 3] : NULL;
+	for (int y = 0; ok && y < h; y++)
 	{
-		attitudeCamera.e += angle;
+		if (fread(pRow, 1, (size_t)w * 3, fp) != (size_t)w * 3)
+		{
+			ok = false;
+			break;
+		}
+		DWORD* pLine = pImage->GetLine(y);
+		for (int x = 0; x < w; x++)
+			pLine[x] = ((DWORD)pRow[x * 3 + 0] << 16) | ((DWORD)pRow[x * 3 + 1] << 8) | pRow[x * 3 + 2];
 	}
+	delete[] pRow;
+	fclose(fp);
+	return ok;
+}
 
-	/**
-	 * @brief  z ת
-	*/
-	void RotateCameraZ(double angle)
-	{
-		attitudeCamera.a += angle;
-	}
+/**
+ * @brief ͼĲ
+ * @see CompareImages
+*/
+struct ImageDiff
+{
+	int nDiffPixelsNum;		/** @brief һͨĲݲ */
+	int nMaxDiff;			/** @brief еͨ */
+	double fMeanDiff;		/** @brief ÿͨƽ */
+};
 
-	/**
-	 * @brief ӿڴС
-	*/
-	void SetCameraViewportSize(int w, int h)
+/**
+ * @brief رȽͼ
+ * @param[in] pImage : ͼ
+ * @param[in] pReference : οͼ
+ * @param[in] nTolerance : ÿͨĲ0 ~ 255ֵز nDiffPixelsNum
+ * @param[out] pDiff : ز
+ * @param[out] pDiffImage : Ϊ NULLΪ NULL ʱдͼ񣺳ݲΪɫΪȼĲοͼ
+ * @return ͼСͬʱ false
+*/
+inline bool CompareImages(const FrameBuffer* pImage, const FrameBuffer* pReference, int nTolerance, ImageDiff* pDiff, FrameBuffer* pDiffImage = NULL)
+{
+	int w = pImage->GetWidth(), h = pImage->GetHeight();
+	*pDiff = {};
+	if (w != pReference->GetWidth() || h != pReference->GetHeight())
+		return false;
+	if (pDiffImage && !pDiffImage->Create(w, h))
+		pDiffImage = NULL;
+
+	nTolerance = std::min(std::max(nTolerance, 0), 255);
+	long long nSum = 0;
+	int nBad = 0;
+	int nMax = 0;
+	for (int y = 0; y < h; y++)
 	{
-		nViewportWidth = w;
-		nViewportHeight = h;
+		const DWORD* pA = pImage->GetLine(y);
+		const DWORD* pB = pReference->GetLine(y);
+		DWORD* pD = pDiffImage ? pDiffImage->GetLine(y) : NULL;
+		if (pD)
+			for (int x = 0; x < w; x++)
+				pD[x] = (pB[x] >> 1) & 0x7F7F7F;
+
+		int x = 0;
+#ifdef HD3D_SSE2
+		// ÿ 4 أͨľֵͣSADȡֵٰжǷͨݲ
+		const __m128i vZero = _mm_setzero_si128();
+		const __m128i vTolerance = _mm_set1_epi32(nTolerance * 0x010101);
+		const __m128i vMask = _mm_set1_epi32(0xFFFFFF);
+		__m128i vSum = vZero, vMax = vZero;
+		for (; x + 4 <= w; x += 4)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(pA + x));
+			__m128i b = _mm_loadu_si128((const __m128i*)(pB + x));
+			__m128i d = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)), vMask);
+			vSum = _mm_add_epi64(vSum, _mm_sad_epu8(d, vZero));
+			vMax = _mm_max_epu8(vMax, d);
+			int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_subs_epu8(d, vTolerance), vZero)));
+			if (m != 0xF)
+			{
+				nBad += 4 - ((m & 1) + ((m >> 1) & 1) + ((m >> 2) & 1) + ((m >> 3) & 1));
+				if (pD)
+					for (int i = 0; i < 4; i++)
+						if (!(m & (1 << i)))
+							pD[x + i] = 0xFF0000;
+			}
+		}
+		nSum += _mm_cvtsi128_si32(vSum) + _mm_cvtsi128_si32(_mm_srli_si128(vSum, 8));
+		unsigned char pMax[16];
+		_mm_storeu_si128((__m128i*)pMax, vMax);
+		for (int i = 0; i < 16; i++)
+			nMax = std::max(nMax, (int)pMax[i]);
+#endif
+		for (; x < w; x++)
+		{
+			int dr = abs((int)((pA[x] >> 16) & 0xFF) - (int)((pB[x] >> 16) & 0xFF));
+			int dg = abs((int)((pA[x] >> 8) & 0xFF) - (int)((pB[x] >> 8) & 0xFF));
+			int db = abs((int)(pA[x] & 0xFF) - (int)(pB[x] & 0xFF));
+			int d = std::max(std::max(dr, dg), db);
+			nSum += dr + dg + db;
+			nMax = std::max(nMax, d);
+			if (d > nTolerance)
+			{
+				nBad++;
+				if (pD)
+					pD[x] = 0xFF0000;
+			}
+		}
 	}
 
-	/**
-	 * @brief ȡӿڴС
-	 * @param[out]	w : ӿڿ
-	 * @param[out]	h : ӿڸ߶
-	*/
-	void GetCameraViewportSize(int* w, int* h)
-	{
-		*w = nViewportWidth;
-		*h = nViewportHeight;
-	}
+	pDiff->nDiffPixelsNum = nBad;
+	pDiff->nMaxDiff = nMax;
+	pDiff->fMeanDiff = (double)nSum / (3.0 * w * h);
+	return true;
+}
 
-	/**
-	 * @brief 
-	*/
-	void SetCameraFocalLength(int f)
+/**
+ * @brief ȡ·ļ
+ * @param[in] strFile : ļ·ÿһ֡ʽΪ "x y z a e r"̬# ͷΪע
+ * @param[in] camBase : ӿڡࡢͶӰʽ
+ * @param[out] pNum : ضȡ֡
+ * @return 飨Ҫ delete[]ʧʱ NULL
+*/
+inline Camera3D* ReadCameraPath(const char* strFile, Camera3D camBase, int* pNum)
+{
+	FILE* fp;
+	if (fopen_s(&fp, strFile, "r") != 0)
+		return NULL;
+
+	int nCapacity = 64, count = 0;
+	Camera3D* pCameras = new Camera3D[nCapacity];
+
+	char strLine[256] = { 0 };
+	while (fgets(strLine, 256, fp))
 	{
-		nFocalLength = f;
+		if (strLine[0] == '#') continue;
+		Camera3D cam = camBase;
+		Attitude3D ati;
+		if (sscanf_s(strLine, "%lf %lf %lf %lf %lf %lf",
+			&cam.pPosition.x, &cam.pPosition.y, &cam.pPosition.z,
+			&ati.a, &ati.e, &ati.r) != 6)
+		{
+			continue;
+		}
+		cam.orientation = ConvertCameraAttitudeToQuaternion(ati);
+
+		if (count == nCapacity)
+		{
+			Camera3D* pNew = new Camera3D[nCapacity * 2];
+			std::copy(pCameras, pCameras + count, pNew);
+			delete[] pCameras;
+			pCameras = pNew;
+			nCapacity *= 2;
+		}
+		pCameras[count++] = cam;
 	}
+	fclose(fp);
 
-	/**
-	 * @brief ȡ
-	*/
-	int GetCameraFocalLength()
+	*pNum = count;
+	return pCameras;
+}
+
+/**
+ * @brief ɻĳһܵ·ת̨
+ * @param[in] pCenter : 
+ * @param[in] distance : ĵľ
+ * @param[in] num : ֡
+ * @param[in] camBase : ӿڡࡢͶӰʽ
+ * @return 飨Ҫ delete[]
+ * @note  xoz ƽ y תʼճ
+*/
+inline Camera3D* GetTurntableCameras(Point3D pCenter, double distance, int num, Camera3D camBase)
+{
+	Camera3D* pCameras = new Camera3D[num];
+	for (int i = 0; i < num; i++)
 	{
-		return nFocalLength;
+		double angle = 360.0 * i / num;
+		double t = ConvertToRadian(angle);
+		pCameras[i] = camBase;
+		pCameras[i].pPosition = { pCenter.x + distance * sin(t),pCenter.y,pCenter.z - distance * cos(t) };
+		pCameras[i].orientation = ConvertCameraAttitudeToQuaternion({ 0,angle,0 });
 	}
+	return pCameras;
+}
+
+/**
+ * @brief Ⱦ
+*/
+struct BatchRenderSettings
+{
+	int nWidth;				/** @brief ͼ */
+	int nHeight;			/** @brief ͼ߶ */
+	int x;					/** @brief ͼ x ꣨ͬ Scence3D::Render */
+	int y;					/** @brief ͼ y ꣨ͬ Scence3D::Render */
+	Zoom zoom;				/** @brief ͼ */
+	Color bk;				/** @brief ɫ */
+	Color grid;				/** @brief ɫΪʾ */
+	int nThreads;			/** @brief ߳Ϊ 0 ʱʹȫ CPU  */
 
 	/**
-	 * @brief ͸ͶӰĿ
-	 * @param b : Ƿ͸ͶӰ
+	 * @brief ļʽ "out/frame_%04d.png"Ϊ NULL ʱļ
 	*/
-	void EnablePerspectiveProjection(bool b = true)
-	{
-		bPerspectiveProjection = b;
-	}
+	const char* strOutput;
 
 	/**
-	 * @brief ȡ͸ͶӰ״̬
+	 * @brief ׷ãΪ NULL ʱʹùդȾ
+	 * @note е x, y, zoom, bk, nThreads ṹеͬø
 	*/
-	bool GetPerspectiveProjectionState()
+	const RayTraceSettings* pRayTrace;
+};
+
+/**
+ * @brief ֡ȾʱĻص
+ * @param[in] index : ֡
+ * @param[in] pFrame : Ⱦõ֡
+ * @param[in] pUser : û
+ * @attention ڶȾ߳ͬʱã֡˳Ҳ̶
+*/
+typedef void (*FrameCallback)(int index, const FrameBuffer* pFrame, void* pUser);
+
+/**
+ * @brief ߳Ⱦÿ߳Ⱦͬ֡׷ʱ֡Ⱦÿ֡ڲ̣߳
+ * @param[in] pScence : ҪȾĳ
+ * @param[in] pCameras : ÿһ֡
+ * @param[in] nFrames : ֡
+ * @param[in] pSettings : Ⱦ
+ * @param[in] pCallback : ÿ֡ɺĻصΪ NULL
+ * @param[in] pUser : صû
+ * @return ֡ÿ룩ļĺʱ
+ * @attention Ⱦڼ䲻޸ĳ
+*/
+inline double RenderFrames(Scence3D* pScence, const Camera3D* pCameras, int nFrames, const BatchRenderSettings* pSettings,
+	FrameCallback pCallback = NULL, void* pUser = NULL)
+{
+	if (nFrames <= 0) return 0;
+
+	int nThreads = pSettings->nThreads;
+	if (nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads <= 0) nThreads = 1;
+	if (nThreads > nFrames) nThreads = nFrames;
+
+	RayTraceSettings rt = {};
+	if (pSettings->pRayTrace)
 	{
-		return bPerspectiveProjection;
+		rt = *pSettings->pRayTrace;
+		rt.x = pSettings->x;
+		rt.y = pSettings->y;
+		rt.zoom = pSettings->zoom;
+		rt.bk = pSettings->bk;
+		rt.nThreads = pSettings->nThreads;
+		nThreads = 1;
 	}
 
-	/**
-	 * @brief ڳ
-	 * @param[in] obj : Ҫӵ
-	 * @return ӵе
-	*/
-	int AddObject(Object3D& obj)
-	{
-		Object3D* newObjects = new Object3D[nObjectsNum + 1];
-		for (int i = 0; i < nObjectsNum; i++)
+	std::atomic<int> nNext(0);
+	auto worker = [&]() {
+		FrameBuffer frame(pSettings->nWidth, pSettings->nHeight);
+		RenderQueue queue;
+		char strFile[512] = { 0 };
+		for (int i = nNext++; i < nFrames; i = nNext++)
 		{
-			newObjects[i].AddPolygons(pObjects[i].GetPolygons(), pObjects[i].GetPolygonsNum());
-			newObjects[i].SetAttitude(pObjects[i].GetAttitude());
-			newObjects[i].SetRotateOrder(pObjects[i].GetRotateOrder());
+			frame.Clear(pSettings->bk);
+			if (pSettings->pRayTrace)
+				RayTraceScence(pScence, &frame, &pCameras[i], &rt);
+			else
+				pScence->Render(&frame, pSettings->x, pSettings->y, pSettings->zoom, pSettings->grid, &pCameras[i], &queue);
+
+			if (pSettings->strOutput)
+			{
+				sprintf_s(strFile, sizeof strFile, pSettings->strOutput, i);
+				if (!SaveImageFile(&frame, strFile))
+					fprintf(stderr, "Failed to write %s.\n", strFile);
+			}
+			if (pCallback)
+				pCallback(i, &frame, pUser);
 		}
+	};
+
+	auto t = std::chrono::steady_clock::now();
+
+	std::thread* pWorkers = new std::thread[nThreads - 1];
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i] = std::thread(worker);
+	worker();
+	for (int i = 0; i < nThreads - 1; i++)
+		pWorkers[i].join();
+	delete[] pWorkers;
+
+	double cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+	if (cost <= 0)
+		cost = MIN_TIME_COST;
+	return nFrames / cost;
+}
 
-		newObjects[nObjectsNum].AddPolygons(obj.GetPolygons(), obj.GetPolygonsNum());
-		newObjects[nObjectsNum].SetAttitude(obj.GetAttitude());
-		newObjects[nObjectsNum].SetRotateOrder(obj.GetRotateOrder());
+/**
+ * @brief ֡ʽ
+*/
+enum FrameStreamFormat
+{
+	stream_rgb,		/** @brief ļͷ RGB24 ԭʼ */
+	stream_y4m		/** @brief YUV4MPEG24:2:0ֱӱ ffmpeg ȱȡ */
+};
 
-		if (pObjects) delete[] pObjects;
-		pObjects = newObjects;
-		nObjectsNum++;
-		return nObjectsNum - 1;
-	}
+/**
+ * @brief ֡Ⱦõ֡˳дļܵ׼
+ * @note ڲй̶ۣ֡д̰߳֡Ⱦ߳ύ֡ʱȴѹ
+ *			ж೤ڴ涼л Open ʱһԷ䣬ύ֡ʱٷڴ档
+*/
+class FrameStream
+{
+private:
+
+	FILE* fp;						/** @brief ļ */
+	bool bCloseFile;				/** @brief رʱǷҪرļ */
+	FrameStreamFormat format;		/** @brief ʽ */
+	int nWidth;						/** @brief ֡ */
+	int nHeight;					/** @brief ֡߶ */
+	size_t nFrameBytes;				/** @brief ÿֽ֡֡ͷ */
+
+	int nSlotsNum;					/** @brief ֡ */
+	unsigned char* pSlotData;		/** @brief ȫ֡۵ */
+	int* pSlotFrame;				/** @brief ÿ֡дŵ֡ţ-1 ʾ */
+
+	int nNext;						/** @brief һҪ֡ */
+	bool bClosing;					/** @brief Ƿڹر */
+	bool bError;					/** @brief Ƿд */
+
+	std::mutex mtx;
+	std::condition_variable cvFree;		/** @brief ֡ۿճ */
+	std::condition_variable cvReady;	/** @brief ֡ύ */
+	std::thread writer;
 
 	/**
-	 * @brief ɾе
-	 * @param[in] pObj : Ҫɾ
+	 * @brief ֡תΪʽ
 	*/
-	void DeleteObject(int index)
+	void convert(const FrameBuffer* pFrame, unsigned char* pOut)
 	{
-		Object3D* newObjects = new Object3D[nObjectsNum - 1];
-		for (int i = 0, j = 0; j < nObjectsNum; i++, j++)
+		int w = nWidth < pFrame->GetWidth() ? nWidth : pFrame->GetWidth();
+		int h = nHeight < pFrame->GetHeight() ? nHeight : pFrame->GetHeight();
+
+		if (format == stream_rgb)
 		{
-			if (j != index)
+			for (int y = 0; y < h; y++)
 			{
-				newObjects[i] = pObjects[j];
+				const DWORD* pLine = pFrame->GetLine(y);
+				unsigned char* pRow = pOut + (size_t)y * nWidth * 3;
+				for (int x = 0; x < w; x++)
+				{
+					pRow[x * 3 + 0] = (unsigned char)(pLine[x] >> 16);
+					pRow[x * 3 + 1] = (unsigned char)(pLine[x] >> 8);
+					pRow[x * 3 + 2] = (unsigned char)(pLine[x]);
+				}
 			}
-			else
+			return;
+		}
+
+		// BT.601 ޷Χɫȡ 2x2 صƽֵ
+		int cw = (nWidth + 1) / 2, ch = (nHeight + 1) / 2;
+		unsigned char* pY = pOut;
+		unsigned char* pU = pY + (size_t)nWidth * nHeight;
+		unsigned char* pV = pU + (size_t)cw * ch;
+		for (int y = 0; y < h; y++)
+		{
+			const DWORD* pLine = pFrame->GetLine(y);
+			for (int x = 0; x < w; x++)
 			{
-				i--;
+				int r = (pLine[x] >> 16) & 0xFF, g = (pLine[x] >> 8) & 0xFF, b = pLine[x] & 0xFF;
+				pY[(size_t)y * nWidth + x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			}
+		}
+		for (int cy = 0; cy < ch; cy++)
+		{
+			const DWORD* pLine0 = pFrame->GetLine(std::min(cy * 2, h - 1));
+			const DWORD* pLine1 = pFrame->GetLine(std::min(cy * 2 + 1, h - 1));
+			for (int cx = 0; cx < cw; cx++)
+			{
+				int x0 = std::min(cx * 2, w - 1), x1 = std::min(cx * 2 + 1, w - 1);
+				DWORD p[4] = { pLine0[x0],pLine0[x1],pLine1[x0],pLine1[x1] };
+				int r = 0, g = 0, b = 0;
+				for (int k = 0; k < 4; k++)
+				{
+					r += (p[k] >> 16) & 0xFF;
+					g += (p[k] >> 8) & 0xFF;
+					b += p[k] & 0xFF;
+				}
+				r = (r + 2) >> 2;
+				g = (g + 2) >> 2;
+				b = (b + 2) >> 2;
+				pU[(size_t)cy * cw + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				pV[(size_t)cy * cw + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
 			}
 		}
-		if (pObjects)
-			delete[] pObjects;
-		pObjects = newObjects;
-		nObjectsNum--;
 	}
 
 	/**
-	 * @brief ȡļ
+	 * @brief д̣߳ύ֡
 	*/
-	Object3D* GetObjects()
+	void run()
 	{
-		return pObjects;
-	}
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true)
+		{
+			int slot = nNext % nSlotsNum;
+			cvReady.wait(lock, [&] { return pSlotFrame[slot] == nNext || bClosing; });
+			if (pSlotFrame[slot] != nNext)
+				break;
 
-	/**
-	 * @brief ȡ
-	*/
-	int GetObjectsNum()
-	{
-		return nObjectsNum;
+			// дļʱȾ߳̿Լύ֡
+			lock.unlock();
+			bool ok = true;
+			if (format == stream_y4m)
+				ok = fwrite("FRAME\n", 1, 6, fp) == 6;
+			ok = ok && fwrite(pSlotData + nFrameBytes * slot, 1, nFrameBytes, fp) == nFrameBytes;
+			lock.lock();
+
+			if (!ok) bError = true;
+			pSlotFrame[slot] = -1;
+			nNext++;
+			cvFree.notify_all();
+		}
+		fflush(fp);
 	}
 
-	/**
-	 * @brief ȡеĶεܺ
-	*/
-	int GetAllPolygonsNum()
+public:
+
+	FrameStream()
 	{
-		int index = 0;
-		for (int i = 0; i < nObjectsNum; i++)
-			index += pObjects[i].GetPolygonsNum();
-		return index;
+		fp = NULL;
+		bCloseFile = false;
+		format = stream_rgb;
+		nWidth = nHeight = 0;
+		nFrameBytes = 0;
+		nSlotsNum = 0;
+		pSlotData = NULL;
+		pSlotFrame = NULL;
+		nNext = 0;
+		bClosing = false;
+		bError = false;
 	}
 
-	/**
-	 * @brief ȡĶεļ
-	*/
-	Polygon3D* GetAllPolygons()
+	FrameStream(const FrameStream&) = delete;
+	FrameStream& operator=(const FrameStream&) = delete;
+
+	~FrameStream()
 	{
-		Polygon3D* p = new Polygon3D[GetAllPolygonsNum()];
-		for (int i = 0, index = 0; i < nObjectsNum; i++)
-		{
-			Polygon3D* pp = pObjects[i].GetPolygons();
-			int num = pObjects[i].GetPolygonsNum();
-			CopyPolygons(p + index, pp, num);
-			index += num;
-		}
-		return p;
+		Close();
 	}
 
 	/**
-	 * @brief ȡӿϵµĶμϣƽͶӰ
-	 * @param[out] count : ض
+	 * @brief ֡
+	 * @param[in] pFile : ļԶƷʽ򿪣
+	 * @param[in] w : ֡
+	 * @param[in] h : ֡߶
+	 * @param[in] fmt : ʽ
+	 * @param[in] fps : ֡ʣֻд Y4M ļͷ
+	 * @param[in] slots : ֡໺֡ͨȡȾ߳
+	 * @param[in] bOwnFile : ر֡ʱǷͬʱرļ
+	 * @return Ƿɹ
 	*/
-	Polygon3D* GetViewportPolygons(int* count = NULL)
+	bool Open(FILE* pFile, int w, int h, FrameStreamFormat fmt, int fps = 25, int slots = 8, bool bOwnFile = false)
 	{
-		int nAllPolygonsNum = GetAllPolygonsNum();
-		if (nAllPolygonsNum <= 0) return NULL;
-
-		Polygon3D* pAllPolygons = GetAllPolygons();
-		Polygon3D* pRotated = NULL;
-		Polygon3D* pConverted = NULL;
+		Close();
+		if (!pFile || w <= 0 || h <= 0 || slots <= 0) return false;
+
+		fp = pFile;
+		bCloseFile = bOwnFile;
+		format = fmt;
+		nWidth = w;
+		nHeight = h;
+		if (format == stream_y4m)
+			nFrameBytes = (size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+		else
+			nFrameBytes = (size_t)w * h * 3;
 
-		// ӿڵԭ
-		Point3D pOriginViewport = { pCamera.x - nViewportWidth / 2,pCamera.y - nViewportHeight / 2,pCamera.z };
+		nSlotsNum = slots;
+		pSlotData = AllocArray<unsigned char>(nFrameBytes * slots, memory_stream);
+		pSlotFrame = AllocArray<int>(slots, memory_stream);
+		for (int i = 0; i < slots; i++)
+			pSlotFrame[i] = -1;
 
-		// תӽǣƽƣ
-		pRotated = RotateToCamera(pAllPolygons, nAllPolygonsNum, attitudeCamera, pCamera);
+		nNext = 0;
+		bClosing = false;
+		bError = false;
 
-		// ƽƵӿϵ
-		pConverted = ConvertCoordinateSystem(pRotated, nAllPolygonsNum, pOriginViewport);
+		if (format == stream_y4m)
+			fprintf(fp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps);
 
-		DeletePolygons(pAllPolygons, nAllPolygonsNum);
-		DeletePolygons(pRotated, nAllPolygonsNum);
-		
-		return pConverted;
+		writer = std::thread(&FrameStream::run, this);
+		return true;
 	}
 
 	/**
-	 * @brief ȡ GetViewportPolygons صĶμϵı׼豸꣨NDCʽĶμ
+	 * @brief ֡ļ
+	 * @param[in] strFile : ļ·Ϊ "-" ʱ׼
+	 * @note ͬ
 	*/
-	Polygon3D* GetViewportNDCPolygons()
+	bool Open(const char* strFile, int w, int h, FrameStreamFormat fmt, int fps = 25, int slots = 8)
 	{
-		int nPolygonsNum = GetAllPolygonsNum();
-		if (nPolygonsNum <= 0) return NULL;
-		Polygon3D* pPolygons = GetViewportPolygons();
-		Polygon3D* pConverted = ConvertCoordinateSystem(pPolygons, nPolygonsNum, { nViewportWidth / 2.0,nViewportHeight / 2.0,0 });
-
-		for (int i = 0; i < nPolygonsNum; i++)
+		if (strcmp(strFile, "-") == 0)
 		{
-			for (int j = 0; j < pConverted[i].nPointsNum; j++)
-			{
-				pConverted[i].pPoints[j].x /= nViewportWidth / 2.0;
-				pConverted[i].pPoints[j].y /= nViewportHeight / 2.0;
-			}
+			_setmode(_fileno(stdout), _O_BINARY);
+			return Open(stdout, w, h, fmt, fps, slots, false);
 		}
 
-		DeletePolygons(pPolygons, nPolygonsNum);
-		
-		return pConverted;
+		FILE* pFile;
+		if (fopen_s(&pFile, strFile, "wb") != 0)
+			return false;
+		return Open(pFile, w, h, fmt, fps, slots, true);
 	}
 
 	/**
-	 * @brief ȡҪȾĶμ
-	 * @param[out] count : ҪȾĶ
-	 * @return ȾΧڵĶμϣѰ z 
-	 * @note ʹô˺ԻȡҪƵ豸Ķμ
+	 * @brief ֡ļܵ
+	 * @param[in] fd : ļ
+	 * @note ͬ
 	*/
-	Polygon3D* GetRenderPolygons(int* count)
+	bool Open(int fd, int w, int h, FrameStreamFormat fmt, int fps = 25, int slots = 8)
 	{
-		int nPolygonsNum = GetAllPolygonsNum();
-		int nCropNum = 0;
-		if (nPolygonsNum <= 0) return NULL;
-		Polygon3D* pPolygons = GetViewportNDCPolygons();
-		Polygon3D* pCrop = NULL;
-		Polygon3D* pShow = NULL;
-		
-		// ͸ͶӰĻͽм
-		if (bPerspectiveProjection)
-		{
-			////////////////////////////////////////////////////////
-			// ͸ͶӰʱԶŤ bug ʱԽ        //
-			// ͸ӵʱʹö࣬Ȼüʱֻüһ  //
-			////////////////////////////////////////////////////////
-
-			pCrop = CropNDCPolygons(pPolygons, nPolygonsNum, nFocalLength * 2, &nCropNum);
-			pShow = GetPerspectiveProjectionPolygons(pCrop, nCropNum, nFocalLength * 2);
-			Polygon3D* pCrop2 = CropNDCPolygons(pShow, nCropNum, nFocalLength, &nCropNum);
+		_setmode(fd, _O_BINARY);
+		FILE* pFile = _fdopen(fd, "wb");
+		return Open(pFile, w, h, fmt, fps, slots, true);
+	}
 
-			DeletePolygons(pCrop, nCropNum);
-			DeletePolygons(pShow, nCropNum);
+	/**
+	 * @brief ύһ֡
+	 * @param[in] index : ֡ţ 0 ʼţύ
+	 * @param[in] pFrame : ֡壬ߴ֡ͬʱϽǶü
+	 * @note ڶ߳ͬʱá֡ų洰ʱֱǰ֡д
+	 * @return Ƿɹ֡δ򿪻ѷдʱ false
+	*/
+	bool Submit(int index, const FrameBuffer* pFrame)
+	{
+		if (!fp || index < 0) return false;
 
-			pShow = pCrop2;
-		}
-		else
+		int slot = index % nSlotsNum;
 		{
-			pCrop = CropNDCPolygons(pPolygons, nPolygonsNum, nFocalLength, &nCropNum);
-			pShow = pCrop;
+			std::unique_lock<std::mutex> lock(mtx);
+			cvFree.wait(lock, [&] { return (index < nNext + nSlotsNum && pSlotFrame[slot] == -1) || bClosing; });
+			if (bClosing || index < nNext) return false;
 		}
 
-		//  z 
-		std::sort(pShow, pShow + nCropNum);
+		// ֡Ѿ鱾߳УתʱҪ
+		convert(pFrame, pSlotData + nFrameBytes * slot);
 
-		DeletePolygons(pPolygons, nPolygonsNum);
-		*count = nCropNum;
-		return pShow;
+		bool ok;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pSlotFrame[slot] = index;
+			ok = !bError;
+		}
+		cvReady.notify_one();
+		return ok;
 	}
 
 	/**
-	 * @brief ƳĻ
-	 * @param[in] x : ͼĻ x 
-	 * @param[in] y : ͼĻ y 
-	 * @param[in] zoom : ͼ
-	 * @param[in] grid : ɫΪʾ
-	 * @return ػƺʱλ룩
+	 * @brief ȡд֡
 	*/
-	double Render(int x = 0, int y = 0, Zoom zoom = { 1,1 }, Color grid = -1)
+	int GetWrittenFramesNum()
 	{
-		int t = clock();
-
-		int nPolygonsNum = 0;
-		Polygon3D* pPolygons = GetRenderPolygons(&nPolygonsNum);
+		std::lock_guard<std::mutex> lock(mtx);
+		return nNext;
+	}
 
-		if (nPolygonsNum <= 0)
-			return MIN_TIME_COST;
+	/**
+	 * @brief ر֡
+	 * @note дύ֡
+	*/
+	void Close()
+	{
+		if (!fp) return;
 
-		for (int i = nPolygonsNum - 1; i >= 0; i--)
 		{
-			DrawFillPolygon(pPolygons[i], x, y, zoom, grid);
+			std::lock_guard<std::mutex> lock(mtx);
+			bClosing = true;
 		}
-
-		DeletePolygons(pPolygons, nPolygonsNum);
-		
-		double cost = (double)(clock() - t);
-		if(cost <= 0)
-			cost = MIN_TIME_COST;
-
-		return cost / CLOCKS_PER_SEC;
+		cvReady.notify_all();
+		cvFree.notify_all();
+		writer.join();
+
+		if (bCloseFile) fclose(fp);
+		fp = NULL;
+		FreeArray(pSlotData);
+		FreeArray(pSlotFrame);
+		pSlotData = NULL;
+		pSlotFrame = NULL;
 	}
-
 };
 
+/**
+ * @brief RenderFrames Ļص֡ύ֡
+ * @param[in] pUser : FrameStream ָ
+*/
+inline void SubmitFrameToStream(int index, const FrameBuffer* pFrame, void* pUser)
+{
+	((FrameStream*)pUser)->Submit(index, pFrame);
+}
+
 _HD3D_END
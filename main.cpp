@@ -2,89 +2,48 @@
 #include "HuiDong3D.h"
 using namespace HD3D;
 
-#include <vector>
 using namespace std;
 
 /**
  * @brief		ȡ VTK ļĵ
  * @param[in]	strFile: ļ·
- * @param[out]	pNum: ȡĵ
+ * @param[out]	pNum: ȡĶε
  * @param[in]	zoom: ȡĵű
- * @return		ضȡĵ
+ * @param[in]	nThreads: ʹõ߳Ϊ 0 ʱʹкģ
+ * @return		ضȡĶΣΣ
 */
-Polygon3D* ReadVTK(const char* strFile, int* pNum, int zoom = 1000)
+Polygon3D* ReadVTK(const char* strFile, int* pNum, int zoom = 1000, int nThreads = 0)
 {
-	FILE* fp;
-	int r = fopen_s(&fp, strFile, "r");
-	if (r != 0)
+	MeshData mesh;
+	MeshImportStats stats;
+	if (!ReadMeshFile(strFile, &mesh, 1, &stats, nThreads))
 	{
-		printf("Read vtk file error ( %d ).\n", r);
+		fprintf(stderr, "Read vtk file %s error.\n", strFile);
 		return {};
 	}
 
-	// ȥַ
-	char strTemp[1024] = { 0 };
-	for (int i = 0; i < 4; i++)
-		fgets(strTemp, 1024, fp);
-
-	// 
-	int nPointsNum = 0;
-	fscanf_s(fp, "%s %d %s", strTemp, 1024, &nPointsNum, strTemp, 1024);
-
-	ColorPoint3D* pPoints = new ColorPoint3D[nPointsNum];
-	memset(pPoints, 0, sizeof ColorPoint3D * nPointsNum);
-
-	for (int i = 0; i < nPointsNum; i++)
+	Polygon3D* pPolygons = new Polygon3D[mesh.nTrianglesNum];
+	for (int i = 0; i < mesh.nTrianglesNum; i++)
 	{
-		float x = 0, y = 0, z = 0;
-		if (fscanf_s(fp, "%f %f %f", &x, &y, &z))
-		{
-			// ɫ
-			int grey = 255 - ((int)((y * 12 + z * 3) * 80));
-			//if (grey < 0) grey = 0;
-			//int grey = 255;
-			Color c = RGB(grey, grey, grey);
-			pPoints[i] = { x * zoom,y * zoom,z * zoom,c };
-		}
-
-		// read error
-		else
+		pPolygons[i].nPointsNum = 3;
+		for (int j = 0; j < 3; j++)
 		{
-			printf("Error in reading points, have read %d points (%d all).\n", i, nPointsNum);
-			return {};
+			const Point3D& p = mesh.pVertices[mesh.pTriangles[i * 3 + j]];
+
+			// ߶ɻҶȣΪɫ
+			int grey = 255 - ((int)((p.y * 12 + p.z * 3) * 80));
+			if (grey < 0) grey = 0;
+			if (grey > 255) grey = 255;
+			pPolygons[i].pPoints[j] = { p.x * zoom,p.y * zoom,p.z * zoom };
+			pPolygons[i].pColors[j] = RGB(grey, grey, grey);
 		}
+		pPolygons[i].color = -1;
 	}
 
-	// 
-	int nPolygonsNum = 0;
-	fscanf_s(fp, "%s %d %s", strTemp, 1024, &nPolygonsNum, strTemp, 1024);
-
-	// 
-	int nLinesNum = 3;
-
-	Polygon3D* pPolygons = new Polygon3D[nPolygonsNum];
-	for (int i = 0; i < nPolygonsNum; i++)
-	{
-		int a = 0, b = 0, c = 0;
-		if (fscanf_s(fp, "%s %d %d %d", strTemp, 1024, &a, &b, &c))
-		{
-			pPolygons[i].nPointsNum = nLinesNum;
-			pPolygons[i].pPoints[0] = pPoints[a];
-			pPolygons[i].pPoints[1] = pPoints[b];
-			pPolygons[i].pPoints[2] = pPoints[c];
-			//pPolygons[i].color = pPoints[a].color;
-			pPolygons[i].color = -1;
-		}
-		else
-		{
-			printf("Error in reading polygons, have read %d polygons (%d all).\n", i, nPolygonsNum);
-			return pPolygons;
-		}
-	}
-
-	delete[] pPoints;
-	*pNum = nPolygonsNum;
-	printf("Read %d points and %d polygons( %d lines for each polygon) of vtk file successfully.\n", nPointsNum, nPolygonsNum, nLinesNum);
+	*pNum = mesh.nTrianglesNum;
+	fprintf(stderr, "Read %d points and %d triangles of vtk file in %.1f ms (%.1f MB/s).\n",
+		stats.nRawVerticesNum, mesh.nTrianglesNum, stats.fTotalTime * 1000, stats.nFileBytes / stats.fTotalTime / 1e6);
+	FreeMesh(&mesh);
 	return pPolygons;
 }
 
@@ -116,6 +75,29 @@ ColorPoint3D* ReadImageFile(LPCTSTR strFile, int* pNum)
 	return pPoints;
 }
 
+/**
+ * @brief		ͼƬΪһ壬 ReadImageFile ÿضһ
+ * @param[in]	strFile: ͼƬ·
+ * @param[out]	pTexture: صҪڼһֱЧ
+ * @param[in]	w, h: εĿ
+ * @return		壬ͼƬʧʱ NULL
+*/
+Object3D* GetImageQuadObject(LPCTSTR strFile, Texture* pTexture, double w = 200, double h = 200)
+{
+	if (!pTexture->Load(strFile))
+		return NULL;
+
+	Point3D pPoints[4] = { {0,0,0},{w,0,0},{w,h,0},{0,h,0} };
+	Point2D pCoords[4] = { {0,1},{1,1},{1,0},{0,0} };
+	Polygon3D quad(pPoints, 4, WHITE);
+	quad.SetTexture(pTexture, pCoords);
+
+	Object3D* obj = new Object3D;
+	obj->AddPolygons(&quad, 1);
+	quad.clear();
+	return obj;
+}
+
 // ȡһ 3D ӵĶμ
 Polygon3D* GetPillar()
 {
@@ -254,11 +236,632 @@ Object3D* GetModelObject()
 	pPoints = ReadImageFile(L"./conan.png", &nPointsNum);
 	obj->AddPoints(pPoints, nPointsNum);*/
 
+	// ռ˳ֿ飬ƳӿڻڵĲ޳
+	obj->SpatialReorder();
+
 	return obj;
 }
 
-int main()
+/**
+ * @brief		 RRGGBB ʽʮɫ"none" ʾɫ
+*/
+Color ParseColor(const char* str)
+{
+	if (strcmp(str, "none") == 0)
+		return -1;
+	unsigned int c = (unsigned int)strtoul(str, NULL, 16);
+	return RGB((c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF);
+}
+
+/**
+ * @brief		ڴͳ
+ * @param[in]	pScence : 
+ * @param[in]	baseline : Ⱦǰڴͳƣзܺͣ
+ * @param[in]	nFrames : Ⱦ֡
+*/
+void PrintMemoryReport(Scence3D* pScence, MemoryStats baseline, int nFrames)
+{
+	const char* pNames[memory_tags_num] = { "polygon","mesh","scene","texture","framebuffer","bvh","render","stream" };
+	fprintf(stderr, "Memory:\n  %-12s %12s %12s %10s %10s\n", "tag", "bytes", "peak", "allocs", "frees");
+	for (int i = 0; i <= memory_tags_num; i++)
+	{
+		MemoryStats m = GetMemoryStats((MemoryTag)i);
+		fprintf(stderr, "  %-12s %12lld %12lld %10lld %10lld\n", i < memory_tags_num ? pNames[i] : "total", m.nBytes, m.nPeakBytes, m.nAllocs, m.nFrees);
+	}
+
+	size_t* pObjectBytes = new size_t[pScence->GetObjectsNum() + 1];
+	fprintf(stderr, "  scene: %zu bytes\n", pScence->GetMemoryUsage(pObjectBytes));
+	for (int i = 0; i < pScence->GetObjectsNum(); i++)
+	{
+		size_t nPolygonBytes, nMeshBytes;
+		pScence->GetObjects()[i].GetMemoryUsage(&nPolygonBytes, &nMeshBytes);
+		fprintf(stderr, "  object %d: %zu bytes (polygons %zu, mesh %zu)\n", i, pObjectBytes[i], nPolygonBytes, nMeshBytes);
+	}
+	delete[] pObjectBytes;
+
+	MemoryStats total = GetMemoryStats();
+	if (nFrames > 0)
+	{
+		fprintf(stderr, "  per frame: %.1f allocations, transient peak %lld bytes\n",
+			(double)(total.nAllocs - baseline.nAllocs) / nFrames, total.nPeakBytes - baseline.nBytes);
+	}
+}
+
+/**
+ * @brief		Ⱦ÷
+*/
+void PrintBatchRenderUsage()
+{
+	printf(
+		"Usage: HuiDong3D -i <mesh> [options]\n"
+		"  -i <file>           input mesh: ASCII VTK, PLY, OBJ or STL, or a scene snapshot (.hd3d)\n"
+		"  -o <pattern>        output file pattern, e.g. out/frame_%%04d.png (.png or .ppm)\n"
+		"  --stream <file>     stream frames in order to a file, pipe or \"-\" (stdout)\n"
+		"  --format <rgb|y4m>  stream format (default: y4m for *.y4m and stdout, else rgb)\n"
+		"  --fps <n>           frame rate written to the y4m header (default 25)\n"
+		"  --size <W>x<H>      output resolution (default 640x480)\n"
+		"  --scale <n>         mesh scale factor (default 1000)\n"
+		"  --path <file>       camera path, one \"x y z a e r\" line per frame\n"
+		"  --turntable <n>     orbit the mesh in <n> frames (default 36 when no --path)\n"
+		"  --distance <d>      orbit distance (default: twice the mesh size)\n"
+		"  --ortho             parallel projection\n"
+		"  --fov <deg>         vertical field of view (default 60)\n"
+		"  --wireframe         draw unique mesh edges only (no fill)\n"
+		"  --shade <mode>      lighting: none, flat or gouraud (default none)\n"
+		"  --aa <mode>         anti-aliasing: none, fxaa, msaa2 or msaa4 (default none)\n"
+		"  --light <x,y,z>     add a directional light shining along x,y,z\n"
+		"                      (default when shading: 1,-1,2)\n"
+		"  --grid <RRGGBB>     wireframe color or \"none\" (default FFFFFF)\n"
+		"  --bk <RRGGBB>       background color (default 82BEE6)\n"
+		"  --raytrace          ray trace with shadows instead of rasterizing\n"
+		"  --ao <n>            ambient occlusion samples per pixel when ray tracing (default 16)\n"
+		"  --threads <n>       worker threads for rendering and parsing (default: all cores)\n"
+		"  --memory            print memory usage and allocation counts when done\n"
+		"  --spatial <n>       reorder the mesh along a Hilbert curve into chunks of <n> polygons\n"
+		"                      that are culled separately (0 = off, default)\n"
+		"  --optimize          reorder the mesh for vertex cache locality and print ACMR\n"
+		"  --save-scene <file> save the prepared scene as a snapshot (.hd3d) that loads without\n"
+		"                      parsing, welding or reordering; its lights and shading are used\n"
+		"                      unless --shade, --light or --wireframe is given\n"
+		"\n"
+		"Usage: HuiDong3D --regress <dir> [options]   (see RunRegressionTests)\n");
+}
+
+/**
+ * @brief		Ⱦȡģͣ·߳Ⱦÿһ֡Ϊͼ
+ * @return		̷ֵ
+*/
+int RunBatchRender(int argc, char* argv[])
+{
+	const char* strMesh = NULL;
+	const char* strPath = NULL;
+	const char* strStream = NULL;
+	const char* strFormat = NULL;
+	const char* strSaveScene = NULL;
+	int fps = 25;
+	int w = 640, h = 480;
+	int zoom = 1000;
+	int nTurntable = 36;
+	double distance = 0;
+	bool bPerspective = true;
+	double fov = 60;
+	bool bWireframe = false;
+	ShadeMode shade = shade_none;
+	bool bShadeSet = false;
+	AntiAliasMode aa = antialias_none;
+	Light3D pLights[8];
+	int nLightsNum = 0;
+	bool bRayTrace = false;
+	bool bMemory = false;
+	bool bOptimize = false;
+	int nChunkSize = 0;
+	RayTraceSettings rt = {};
+	rt.bShadows = true;
+	rt.nAOSamples = 16;
+
+	BatchRenderSettings settings = {};
+	settings.grid = WHITE;
+	settings.bk = RGB(130, 190, 230);
+	settings.strOutput = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool bHasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-i") == 0 && bHasValue) strMesh = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && bHasValue) settings.strOutput = argv[++i];
+		else if (strcmp(argv[i], "--size") == 0 && bHasValue) sscanf_s(argv[++i], "%dx%d", &w, &h);
+		else if (strcmp(argv[i], "--scale") == 0 && bHasValue) zoom = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--path") == 0 && bHasValue) strPath = argv[++i];
+		else if (strcmp(argv[i], "--stream") == 0 && bHasValue) strStream = argv[++i];
+		else if (strcmp(argv[i], "--format") == 0 && bHasValue) strFormat = argv[++i];
+		else if (strcmp(argv[i], "--fps") == 0 && bHasValue) fps = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--turntable") == 0 && bHasValue) nTurntable = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--distance") == 0 && bHasValue) distance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--ortho") == 0) bPerspective = false;
+		else if (strcmp(argv[i], "--fov") == 0 && bHasValue) fov = atof(argv[++i]);
+		else if (strcmp(argv[i], "--wireframe") == 0) bWireframe = true;
+		else if (strcmp(argv[i], "--shade") == 0 && bHasValue)
+		{
+			const char* str = argv[++i];
+			bShadeSet = true;
+			if (strcmp(str, "flat") == 0) shade = shade_flat;
+			else if (strcmp(str, "gouraud") == 0) shade = shade_gouraud;
+			else shade = shade_none;
+		}
+		else if (strcmp(argv[i], "--aa") == 0 && bHasValue)
+		{
+			const char* str = argv[++i];
+			if (strcmp(str, "fxaa") == 0) aa = antialias_fxaa;
+			else if (strcmp(str, "msaa2") == 0) aa = antialias_msaa2x;
+			else if (strcmp(str, "msaa4") == 0) aa = antialias_msaa4x;
+			else aa = antialias_none;
+		}
+		else if (strcmp(argv[i], "--light") == 0 && bHasValue && nLightsNum < 8)
+		{
+			Light3D light = { light_directional,{ 0,0,0 },WHITE,1 };
+			sscanf_s(argv[++i], "%lf,%lf,%lf", &light.vec.x, &light.vec.y, &light.vec.z);
+			pLights[nLightsNum++] = light;
+		}
+		else if (strcmp(argv[i], "--grid") == 0 && bHasValue) settings.grid = ParseColor(argv[++i]);
+		else if (strcmp(argv[i], "--bk") == 0 && bHasValue) settings.bk = ParseColor(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && bHasValue) settings.nThreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--raytrace") == 0) bRayTrace = true;
+		else if (strcmp(argv[i], "--ao") == 0 && bHasValue) rt.nAOSamples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--memory") == 0) bMemory = true;
+		else if (strcmp(argv[i], "--optimize") == 0) bOptimize = true;
+		else if (strcmp(argv[i], "--spatial") == 0 && bHasValue) nChunkSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--save-scene") == 0 && bHasValue) strSaveScene = argv[++i];
+		else
+		{
+			PrintBatchRenderUsage();
+			return 1;
+		}
+	}
+
+	if (!strMesh || w <= 0 || h <= 0)
+	{
+		PrintBatchRenderUsage();
+		return 1;
+	}
+
+	// ȡģֱͣӻָVTK ʹ ReadVTKʽʹÿеĵ뺯
+	Object3D obj;
+	Scence3D scence;
+	const char* strExt = strrchr(strMesh, '.');
+	bool bSnapshot = strExt && _stricmp(strExt, ".hd3d") == 0;
+	if (bSnapshot)
+	{
+		clock_t start = clock();
+		if (!LoadScenceSnapshot(&scence, strMesh))
+		{
+			fprintf(stderr, "Read scene snapshot %s error.\n", strMesh);
+			return 1;
+		}
+		fprintf(stderr, "Loaded scene snapshot with %d objects and %d polygons in %.1f ms.\n",
+			scence.GetObjectsNum(), scence.GetAllPolygonsNum(), (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+	}
+	else if (strExt && _stricmp(strExt, ".vtk") == 0)
+	{
+		int nPolygonsNum = 0;
+		Polygon3D* pPolygons = ReadVTK(strMesh, &nPolygonsNum, zoom, settings.nThreads);
+		if (!pPolygons || nPolygonsNum <= 0)
+			return 1;
+		obj.AddPolygons(pPolygons, nPolygonsNum);
+		DeletePolygons(pPolygons, nPolygonsNum);
+	}
+	else
+	{
+		MeshData mesh;
+		MeshImportStats stats;
+		if (!ReadMeshFile(strMesh, &mesh, zoom, &stats, settings.nThreads) || mesh.nTrianglesNum <= 0)
+		{
+			fprintf(stderr, "Read mesh file %s error.\n", strMesh);
+			return 1;
+		}
+		fprintf(stderr, "Read %d vertices (%d before welding) and %d triangles in %.1f ms (%.1f MB/s).\n",
+			mesh.nVerticesNum, stats.nRawVerticesNum, mesh.nTrianglesNum, stats.fTotalTime * 1000, stats.nFileBytes / stats.fTotalTime / 1e6);
+		// ûжɫʱʹǳɫյ
+		obj.SetMesh(mesh.pVertices, mesh.pColors, mesh.nVerticesNum, mesh.pTriangles, mesh.nTrianglesNum, RGB(180, 180, 180));
+		FreeMesh(&mesh);
+	}
+
+	// ѾȾãָʱŸ
+	if (!bSnapshot || bWireframe)
+		scence.SetRenderMode(bWireframe ? render_wireframe : render_fill);
+	if (!bSnapshot || bShadeSet || nLightsNum > 0)
+	{
+		if (!bSnapshot || bShadeSet)
+			scence.SetShadeMode(shade);
+		if (scence.GetShadeMode() != shade_none && nLightsNum == 0)
+			pLights[nLightsNum++] = { light_directional,{ 1,-1,2 },WHITE,1 };
+		while (scence.GetLightsNum() > 0)
+			scence.DeleteLight(scence.GetLightsNum() - 1);
+		for (int i = 0; i < nLightsNum; i++)
+			scence.AddLight(pLights[i]);
+	}
+	scence.SetAntiAliasMode(aa);
+	if (nChunkSize > 0 && !bSnapshot)
+	{
+		obj.SpatialReorder(nChunkSize);
+		fprintf(stderr, "Spatially reordered into %d chunks of %d polygons\n", obj.GetChunksNum(), nChunkSize);
+	}
+	if (bOptimize && !bSnapshot)
+	{
+		double acmr = obj.GetACMR();
+		clock_t start = clock();
+		obj.OptimizeVertexCache();
+		fprintf(stderr, "Vertex cache optimized in %.1f ms: ACMR %.3f -> %.3f (cache size %d)\n",
+			(clock() - start) * 1000.0 / CLOCKS_PER_SEC, acmr, obj.GetACMR(), VERTEX_CACHE_SIZE);
+	}
+	if (!bSnapshot)
+		scence.AddObject(obj);
+	if (strSaveScene)
+	{
+		clock_t start = clock();
+		if (!SaveScenceSnapshot(&scence, strSaveScene))
+		{
+			fprintf(stderr, "Save scene snapshot %s error.\n", strSaveScene);
+			return 1;
+		}
+		fprintf(stderr, "Saved scene snapshot %s in %.1f ms.\n", strSaveScene, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+	}
+
+	// ӿںͼһNDC ͼ
+	Camera3D camBase = scence.GetCamera();
+	camBase.nViewportWidth = w;
+	camBase.nViewportHeight = h;
+	camBase.bPerspectiveProjection = bPerspective;
+	camBase.fov = fov;
+
+	settings.nWidth = w;
+	settings.nHeight = h;
+	settings.x = -w / 2;
+	settings.y = -h / 2;
+	settings.zoom = { 0.5,0.5 };
+	settings.pRayTrace = bRayTrace ? &rt : NULL;
+
+	// ·
+	int nFrames = 0;
+	Camera3D* pCameras = NULL;
+	if (strPath)
+	{
+		pCameras = ReadCameraPath(strPath, camBase, &nFrames);
+		if (!pCameras)
+		{
+			fprintf(stderr, "Read camera path error.\n");
+			return 1;
+		}
+	}
+	else
+	{
+		// еΧİΧת
+		Rectangle3D r = obj.GetRectangle();
+		Point3D center = obj.GetCenterPoint();
+		if (bSnapshot)
+		{
+			for (int i = 0; i < scence.GetObjectsNum(); i++)
+			{
+				Rectangle3D b = scence.GetObjects()[i].GetBounds();
+				if (i == 0)
+				{
+					r = b;
+					continue;
+				}
+				r = { std::min(r.min_x,b.min_x),std::min(r.min_y,b.min_y),std::min(r.min_z,b.min_z),
+					std::max(r.max_x,b.max_x),std::max(r.max_y,b.max_y),std::max(r.max_z,b.max_z) };
+			}
+			center = { (r.max_x - r.min_x) / 2 + r.min_x,(r.max_y - r.min_y) / 2 + r.min_y,(r.max_z - r.min_z) / 2 + r.min_z };
+		}
+		if (distance <= 0)
+			distance = 2 * std::max(std::max(r.max_x - r.min_x, r.max_y - r.min_y), r.max_z - r.min_z);
+		nFrames = nTurntable;
+		pCameras = GetTurntableCameras(center, distance, nFrames, camBase);
+	}
+
+	// ֡
+	FrameStream stream;
+	if (strStream)
+	{
+		size_t len = strlen(strStream);
+		bool bY4M = strFormat ? strcmp(strFormat, "y4m") == 0
+			: strcmp(strStream, "-") == 0 || (len >= 4 && strcmp(strStream + len - 4, ".y4m") == 0);
+		if (!stream.Open(strStream, w, h, bY4M ? stream_y4m : stream_rgb, fps, settings.nThreads > 0 ? settings.nThreads * 2 : 8))
+		{
+			fprintf(stderr, "Open stream %s error.\n", strStream);
+			delete[] pCameras;
+			return 1;
+		}
+	}
+
+	// ȾڼڴֵȥȾǰռãΪȾ̵ʱڴ
+	ResetMemoryPeak();
+	MemoryStats baseline = GetMemoryStats();
+
+	double throughput = RenderFrames(&scence, pCameras, nFrames, &settings, strStream ? SubmitFrameToStream : NULL, &stream);
+	stream.Close();
+	fprintf(stderr, "Rendered %d frames (%dx%d): %.2f fps\n", nFrames, w, h, throughput);
+	if (bMemory)
+		PrintMemoryReport(&scence, baseline, nFrames);
+
+	delete[] pCameras;
+	return 0;
+}
+
+/**
+ * @brief		عԵ÷
+*/
+void PrintRegressionUsage()
 {
+	printf(
+		"Usage: HuiDong3D --regress <dir> [options]\n"
+		"  --regress <dir>     directory of the reference images (<case>.ppm) and timings.txt\n"
+		"  --update            render the cases and overwrite the references and timings\n"
+		"  --update-timings    compare images as usual but only write this machine's timings\n"
+		"                      (the reference images in the repository stay untouched)\n"
+		"  --tolerance <n>     allowed difference per color channel (default 4)\n"
+		"  --max-diff <f>      allowed fraction of pixels over the tolerance (default 0.002)\n"
+		"  --slowdown <f>      fail when a stage takes longer than <f> times its reference\n"
+		"                      time (default 1.5)\n"
+		"  --slack <ms>        extra time allowed per stage on top of --slowdown (default 0.5)\n"
+		"  --runs <n>          timed renders per case, the fastest of each stage is used\n"
+		"                      (default 10)\n"
+		"  --no-timing         compare images only\n"
+		"On failure <case>_actual.ppm and <case>_diff.ppm are written next to the reference.\n");
+}
+
+/**
+ * @brief		عԣ򿪴ڣù̶Ⱦӡfran_cut.vtk  bunny.vtk
+ *				뱣ĲοͼȽϣȾ׶εĺʱǷȲοʱ̫
+ * @return		ȫͨʱ 0򷵻 1
+ * @note		οͼ񱣴ڲֿ regress Ŀ¼УڲֿĿ¼ HuiDong3D --regress regress ɱȽϣ
+ *				ֻȷı仯Ԥڵʱ --update ɲһύ
+ *				οʱͻйأύڱһʱ --update-timings  timings.txtͬʱճȽͼ
+*/
+int RunRegressionTests(int argc, char* argv[])
+{
+	const char* strDir = NULL;
+	bool bUpdate = false;
+	bool bUpdateTimings = false;
+	bool bTiming = true;
+	int nTolerance = 4;
+	double fMaxDiff = 0.002;
+	double fSlowdown = 1.5;
+	double fSlack = 0.5;
+	int nRuns = 10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool bHasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--regress") == 0 && bHasValue) strDir = argv[++i];
+		else if (strcmp(argv[i], "--update") == 0) bUpdate = true;
+		else if (strcmp(argv[i], "--update-timings") == 0) bUpdateTimings = true;
+		else if (strcmp(argv[i], "--tolerance") == 0 && bHasValue) nTolerance = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--max-diff") == 0 && bHasValue) fMaxDiff = atof(argv[++i]);
+		else if (strcmp(argv[i], "--slowdown") == 0 && bHasValue) fSlowdown = atof(argv[++i]);
+		else if (strcmp(argv[i], "--slack") == 0 && bHasValue) fSlack = atof(argv[++i]);
+		else if (strcmp(argv[i], "--runs") == 0 && bHasValue) nRuns = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--no-timing") == 0) bTiming = false;
+		else
+		{
+			PrintRegressionUsage();
+			return 1;
+		}
+	}
+	if (!strDir || nRuns < 1)
+	{
+		PrintRegressionUsage();
+		return 1;
+	}
+
+	// ԳÿʹòͬɫͿģʽת̨ķʽģת̶Ƕ
+	struct RegressionCase
+	{
+		const char* strName;	// οͼļչ
+		const char* strMesh;	// ģļΪ NULL ʱʹ GetPillar 
+		ShadeMode shade;
+		AntiAliasMode aa;
+		double angle;			//  y ĽǶ
+	};
+	const RegressionCase pCases[] = {
+		{ "pillar",NULL,shade_flat,antialias_msaa4x,30 },
+		{ "fran_cut","./fran_cut.vtk",shade_gouraud,antialias_none,0 },
+		{ "bunny","./bunny.vtk",shade_none,antialias_fxaa,20 },
+	};
+	const int nCasesNum = sizeof pCases / sizeof pCases[0];
+	const int w = 640, h = 480;
+	const char* pStageNames[render_stages_num] = { "build","sort","draw","resample" };
+
+	// οʱÿΪ " ׶κʱ룩"
+	char strFile[512] = { 0 };
+	double pReferenceTimes[nCasesNum][render_stages_num] = {};
+	bool pHasReferenceTime[nCasesNum] = {};
+	sprintf_s(strFile, sizeof strFile, "%s/timings.txt", strDir);
+	FILE* fp;
+	if (!bUpdate && !bUpdateTimings && bTiming && fopen_s(&fp, strFile, "r") == 0)
+	{
+		char strName[64] = { 0 };
+		double t[render_stages_num] = { 0 };
+		while (fscanf_s(fp, "%63s %lf %lf %lf %lf", strName, (unsigned)sizeof strName, &t[0], &t[1], &t[2], &t[3]) == 1 + render_stages_num)
+		{
+			for (int i = 0; i < nCasesNum; i++)
+			{
+				if (strcmp(strName, pCases[i].strName) == 0)
+				{
+					memcpy(pReferenceTimes[i], t, sizeof t);
+					pHasReferenceTime[i] = true;
+				}
+			}
+		}
+		fclose(fp);
+	}
+
+	double pTimes[nCasesNum][render_stages_num] = {};
+	int nFailedNum = 0;
+	for (int c = 0; c < nCasesNum; c++)
+	{
+		const RegressionCase& rc = pCases[c];
+		bool bPassed = true;
+
+		// 
+		Object3D obj;
+		if (rc.strMesh)
+		{
+			int nPolygonsNum = 0;
+			Polygon3D* pPolygons = ReadVTK(rc.strMesh, &nPolygonsNum);
+			if (!pPolygons || nPolygonsNum <= 0)
+			{
+				printf("%-10s FAIL  cannot read %s\n", rc.strName, rc.strMesh);
+				nFailedNum++;
+				continue;
+			}
+			obj.AddPolygons(pPolygons, nPolygonsNum);
+			DeletePolygons(pPolygons, nPolygonsNum);
+		}
+		else
+		{
+			Polygon3D* pPolygons = GetPillar();
+			obj.AddPolygons(pPolygons, 6);
+			DeletePolygons(pPolygons, 6);
+		}
+
+		Scence3D scence;
+		scence.SetShadeMode(rc.shade);
+		scence.SetAntiAliasMode(rc.aa);
+		if (rc.shade != shade_none)
+			scence.AddLight({ light_directional,{ 1,-1,2 },WHITE,1 });
+		scence.AddObject(obj);
+
+		Rectangle3D r = obj.GetRectangle();
+		Point3D center = obj.GetCenterPoint();
+		double distance = 2 * std::max(std::max(r.max_x - r.min_x, r.max_y - r.min_y), r.max_z - r.min_z);
+		double t = ConvertToRadian(rc.angle);
+		Camera3D cam = scence.GetCamera();
+		cam.nViewportWidth = w;
+		cam.nViewportHeight = h;
+		cam.bPerspectiveProjection = true;
+		cam.fov = 60;
+		cam.pPosition = { center.x + distance * sin(t),center.y,center.z - distance * cos(t) };
+		cam.orientation = ConvertCameraAttitudeToQuaternion({ 0,rc.angle,0 });
+
+		// ȾһΪͼͬʱԤȻͶеڴ棩ٶȾȡ׶ε̺ʱ
+		FrameBuffer frame(w, h);
+		RenderQueue queue;
+		frame.Clear(RGB(130, 190, 230));
+		scence.Render(&frame, -w / 2, -h / 2, { 0.5,0.5 }, -1, &cam, &queue);
+		FrameBuffer timed(w, h);
+		for (int i = 0; bTiming && i < nRuns; i++)
+		{
+			timed.Clear(RGB(130, 190, 230));
+			scence.Render(&timed, -w / 2, -h / 2, { 0.5,0.5 }, -1, &cam, &queue);
+			for (int s = 0; s < render_stages_num; s++)
+			{
+				double ms = queue.GetStageTime((RenderStage)s) * 1000;
+				pTimes[c][s] = i == 0 ? ms : std::min(pTimes[c][s], ms);
+			}
+		}
+
+		sprintf_s(strFile, sizeof strFile, "%s/%s.ppm", strDir, rc.strName);
+		if (bUpdate)
+		{
+			if (!SaveImageFile(&frame, strFile))
+			{
+				printf("%-10s FAIL  cannot write %s\n", rc.strName, strFile);
+				nFailedNum++;
+				continue;
+			}
+			printf("%-10s saved %s\n", rc.strName, strFile);
+			continue;
+		}
+
+		// ͼȽ
+		FrameBuffer reference;
+		ImageDiff diff = {};
+		if (!LoadImagePPM(&reference, strFile))
+		{
+			printf("%-10s FAIL  cannot read reference %s (run with --update first)\n", rc.strName, strFile);
+			bPassed = false;
+		}
+		else
+		{
+			FrameBuffer diffImage;
+			if (!CompareImages(&frame, &reference, nTolerance, &diff, &diffImage))
+			{
+				printf("%-10s FAIL  reference is %dx%d, output is %dx%d\n", rc.strName, reference.GetWidth(), reference.GetHeight(), w, h);
+				bPassed = false;
+			}
+			else
+			{
+				bool bImagePassed = diff.nDiffPixelsNum <= fMaxDiff * w * h;
+				printf("%-10s %s  image: %d pixels over tolerance %d (max diff %d, mean %.3f)\n", rc.strName, bImagePassed ? "ok  " : "FAIL",
+					diff.nDiffPixelsNum, nTolerance, diff.nMaxDiff, diff.fMeanDiff);
+				if (!bImagePassed)
+				{
+					bPassed = false;
+					sprintf_s(strFile, sizeof strFile, "%s/%s_diff.ppm", strDir, rc.strName);
+					SaveImageFile(&diffImage, strFile);
+				}
+			}
+			if (!bPassed)
+			{
+				sprintf_s(strFile, sizeof strFile, "%s/%s_actual.ppm", strDir, rc.strName);
+				SaveImageFile(&frame, strFile);
+			}
+		}
+
+		// ʱȽϣοʱ fSlowdown ټ fSlack ʱʧ
+		if (bTiming && pHasReferenceTime[c])
+		{
+			for (int s = 0; s < render_stages_num; s++)
+			{
+				double limit = pReferenceTimes[c][s] * fSlowdown + fSlack;
+				bool bStagePassed = pTimes[c][s] <= limit;
+				printf("%-10s %s  %-8s %8.3f ms (reference %.3f ms, limit %.3f ms)\n", rc.strName, bStagePassed ? "ok  " : "FAIL",
+					pStageNames[s], pTimes[c][s], pReferenceTimes[c][s], limit);
+				bPassed = bPassed && bStagePassed;
+			}
+		}
+		else if (bTiming && !bUpdateTimings)
+		{
+			printf("%-10s      no reference timings in %s/timings.txt (run with --update-timings), timings not checked\n", rc.strName, strDir);
+		}
+
+		if (!bPassed)
+			nFailedNum++;
+	}
+
+	// οʱ
+	if ((bUpdate || bUpdateTimings) && bTiming)
+	{
+		sprintf_s(strFile, sizeof strFile, "%s/timings.txt", strDir);
+		if (fopen_s(&fp, strFile, "w") != 0)
+		{
+			printf("Cannot write %s\n", strFile);
+			return 1;
+		}
+		for (int c = 0; c < nCasesNum; c++)
+		{
+			fprintf(fp, "%s", pCases[c].strName);
+			for (int s = 0; s < render_stages_num; s++)
+				fprintf(fp, " %.4f", pTimes[c][s]);
+			fprintf(fp, "\n");
+		}
+		fclose(fp);
+		printf("Saved reference timings (ms per stage: build, sort, draw, resample) to %s\n", strFile);
+	}
+
+	if (!bUpdate)
+		printf("%d of %d cases passed\n", nCasesNum - nFailedNum, nCasesNum);
+	return nFailedNum > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	//  --regress ʱлعԣʱȾ
+	if (argc > 1 && strcmp(argv[1], "--regress") == 0)
+		return RunRegressionTests(argc, argv);
+	if (argc > 1)
+		return RunBatchRender(argc, argv);
+
 	// ʼͼ豸
 	InitDrawingDevice(640, 480, 1);
 
@@ -274,17 +877,48 @@ int main()
 	scenceMain.AddObject(*GetPillarObject());
 	//scenceMain.AddObject(*GetModelObject());
 
+	// ͼƬһΣ㣩
+	Texture texConan;
+	//scenceMain.AddObject(*GetImageQuadObject(L"./conan.png", &texConan));
+
 	// ƶ
 	scenceMain.GetObjects()[0].MoveTo({ 0,0,100});
 
+	// Ϊڵ壨 O ڵ޳Ч
+	scenceMain.GetObjects()[0].SetOccluder(true);
+
 	// 
 	//scenceMain.SetCameraFocalLength(1000);
 
+	// ƣʹԼλڽദƽͶӰʱĴС
+	scenceMain.SetCameraPosition({ 0,0,-400 });
+
 	//  /  ͸ͶӰ
 	scenceMain.EnablePerspectiveProjection(true);
 
-	// ڶ
-	scence2.AddObject(*GetModelObject());
+	// ڶģں̨ʽأʾģ𲽻񣬼ڼճ
+	Object3D objModel;
+	scence2.AddObject(objModel);
+	scence2.SetCameraPosition({ 0,0,-500 });
+	MeshStreamer streamer;
+	streamer.Open("./fran_cut.vtk", 1400, RGB(180, 180, 180));
+
+	// ؼ֡ A  / ֹͣڼֵ̬֮ͬʱ¸
+	Animator3D animator;
+	double pAttitudeTimes[4] = { 0,1.5,3,4.5 };
+	Quaternion3D pAttitudes[4] = { { 1,0,0,0 },GetRotateQuaternion(rotate_y, 120),GetRotateQuaternion(rotate_y, 240),{ 1,0,0,0 } };
+	animator.AddAttitudeTrack(0, pAttitudeTimes, pAttitudes, 4);
+	Point3D pPillar = scenceMain.GetObjects()[0].GetPosition();
+	double pPositionTimes[3] = { 0,2.25,4.5 };
+	Point3D pPositions[3] = { pPillar,{ pPillar.x,pPillar.y + 60,pPillar.z },pPillar };
+	animator.AddPositionTrack(0, pPositionTimes, pPositions, 3);
+	bool bAnimate = false;
+	clock_t tAnimateStart = 0;
+
+	// Դ L лɫģʽЧ
+	Light3D light = { light_directional,{ 1,-1,2 },WHITE,1 };
+	scenceMain.AddLight(light);
+	scence2.AddLight(light);
 
 	// ʼͼ
 	BeginBatchDraw();
@@ -293,31 +927,105 @@ int main()
 	ExMessage msg;
 	int old_x = -1, old_y = -1;
 
+	// ϶壨ʱʰȡµ壩
+	int nDragObject = -1;
+
 	// ǰָ
 	Scence3D* pScence = &scenceMain;
 
+	// ȾУÿ֡ظʹ
+	RenderQueue queue;
+
+	// ģʽӿͬʱȾ
+	bool bSplit = false;
+	RenderQueue pSplitQueues[2];
+
+	// ׷ģʽӰͻڱΣ
+	bool bRayTrace = false;
+	RayTraceSettings rt = { -300,-200,{ 0.6,0.6 },-1,true,4,0,0 };
+
 	// Ϣѭ
 	while (true)
 	{
+		// ̨¼غõ
+		streamer.Update(&scence2.GetObjects()[0]);
+
+		// Ŷֻб任仯¼
+		if (bAnimate)
+		{
+			double t = (double)(clock() - tAnimateStart) / CLOCKS_PER_SEC;
+			animator.Evaluate(fmod(t, animator.GetDuration()));
+			animator.Apply(&scenceMain);
+		}
+
 		// óȾȡȾʱ
-		double fps = 1.0 / pScence->Render(-300, -200, { 0.6,0.6 }, WHITE);
+		double fps;
+		if (bSplit)
+		{
+			FrameBuffer fb;
+			fb.AttachDrawingDevice();
+			int w = fb.GetWidth() / 2, h = fb.GetHeight();
+
+			// ӿһNDC 
+			Camera3D pCameras[2] = { scenceMain.GetCamera(),scence2.GetCamera() };
+			Viewport3D pViewports[2];
+			for (int i = 0; i < 2; i++)
+			{
+				pCameras[i].nViewportWidth = w;
+				pCameras[i].nViewportHeight = h;
+				pViewports[i] = { i == 0 ? &scenceMain : &scence2,&pCameras[i],&fb,i * w,0,w,h,-w / 2,-h / 2,{ 0.5,0.5 },WHITE,-1,&pSplitQueues[i],0 };
+			}
+			fps = 1.0 / RenderViewports(pViewports, 2);
+		}
+		else if (bRayTrace)
+		{
+			FrameBuffer fb;
+			fb.AttachDrawingDevice();
+			fps = 1.0 / RayTraceScence(pScence, &fb, NULL, &rt);
+		}
+		else
+		{
+			fps = 1.0 / pScence->Render(-300, -200, { 0.6,0.6 }, WHITE, &queue);
+		}
 
-		// ֡
-		wchar_t str[32] = { 0 };
-		wsprintf(str, L"fps: %d", (int)fps);
+		// ֡ʣڼͬʱѼصֱ̬ʱͬʱֱʱ
+		wchar_t str[64] = { 0 };
+		if (streamer.IsLoading())
+			wsprintf(str, L"fps: %d, loading %d / %d", (int)fps, streamer.GetTrianglesNum(), streamer.GetTotalTrianglesNum());
+		else if (pScence->GetDynamicResolutionTarget() > 0)
+			wsprintf(str, L"fps: %d, resolution %d%%", (int)fps, (int)(queue.GetResolutionScale() * 100 + 0.5));
+		else
+			wsprintf(str, L"fps: %d", (int)fps);
 		outtextxy(0, 0, str);
 
-		// ȡû¼
-		msg = getmessage(EM_MOUSE | EM_KEY);
+		// ȡû¼غͲŶڼ䲻ȴϢԱ㼰ʱʾ¼صͶ
+		if (streamer.IsLoading() || bAnimate)
+		{
+			if (!peekmessage(&msg, EM_MOUSE | EM_KEY))
+			{
+				FlushBatchDraw();
+				cleardevice();
+				continue;
+			}
+		}
+		else
+		{
+			msg = getmessage(EM_MOUSE | EM_KEY);
+		}
 
-		// ϶ת
+		// ϶µת
 		if (msg.lbutton)
 		{
-			if (old_x != -1)
+			if (old_x == -1)
 			{
-				pScence->GetObjects()[0].RotateY(-(old_x - msg.x));
-				pScence->GetObjects()[0].RotateX(-(msg.y - old_y));
-				pScence->GetObjects()[0].UpdateRotatedPoints();
+				RayHit3D hit;
+				nDragObject = !bSplit && pScence->Pick(msg.x, msg.y, -300, -200, { 0.6,0.6 }, &hit) ? hit.nObject : -1;
+			}
+			else if (nDragObject >= 0)
+			{
+				pScence->GetObjects()[nDragObject].RotateY(-(old_x - msg.x));
+				pScence->GetObjects()[nDragObject].RotateX(-(msg.y - old_y));
+				pScence->GetObjects()[nDragObject].UpdateRotatedPoints();
 			}
 
 			old_x = msg.x;
@@ -326,6 +1034,7 @@ int main()
 		else
 		{
 			old_x = old_y = -1;
+			nDragObject = -1;
 		}
 
 		// R 
@@ -355,6 +1064,60 @@ int main()
 			}
 		}
 
+		// V лģʽͰȻڵǰ
+		if (msg.vkcode == 'V' && !msg.prevdown)
+		{
+			bSplit = !bSplit;
+		}
+
+		// T л׷
+		if (msg.vkcode == 'T' && !msg.prevdown)
+		{
+			bRayTrace = !bRayTrace;
+		}
+
+		// O лڵ޳
+		if (msg.vkcode == 'O' && !msg.prevdown)
+		{
+			pScence->EnableOcclusionCulling(!pScence->GetOcclusionCullingState());
+			printf("occlusion culling %s, %d objects and %d chunks culled last frame\n", pScence->GetOcclusionCullingState() ? "on" : "off",
+				queue.GetCulledNum(), queue.GetCulledChunksNum());
+		}
+
+		// W л߿ģʽ
+		if (msg.vkcode == 'W' && !msg.prevdown)
+		{
+			pScence->SetRenderMode(pScence->GetRenderMode() == render_fill ? render_wireframe : render_fill);
+		}
+
+		// L лɫģʽ
+		if (msg.vkcode == 'L' && !msg.prevdown)
+		{
+			pScence->SetShadeMode((ShadeMode)((pScence->GetShadeMode() + 1) % 3));
+		}
+
+		// M лģʽޡFXAA2  4 ز
+		if (msg.vkcode == 'M' && !msg.prevdown)
+		{
+			pScence->SetAntiAliasMode((AntiAliasMode)((pScence->GetAntiAliasMode() + 1) % 4));
+			const char* pNames[4] = { "off","fxaa","msaa 2x","msaa 4x" };
+			printf("anti-aliasing %s\n", pNames[pScence->GetAntiAliasMode()]);
+		}
+
+		// D  / رնֱ̬ʣĿ 60 ֡ÿ룩
+		if (msg.vkcode == 'D' && !msg.prevdown)
+		{
+			pScence->SetDynamicResolution(pScence->GetDynamicResolutionTarget() > 0 ? 0 : 1.0 / 60);
+			printf("dynamic resolution %s\n", pScence->GetDynamicResolutionTarget() > 0 ? "on" : "off");
+		}
+
+		// A  / ֹͣؼ֡
+		if (msg.vkcode == 'A' && !msg.prevdown)
+		{
+			bAnimate = !bAnimate;
+			tAnimateStart = clock();
+		}
+
 		// ֣ı z λ
 		if (msg.wheel != 0)
 		{